@@ -0,0 +1,429 @@
+#include "WProgram.h"
+#include "AudioRouter.h"
+
+AudioRouterClass AudioRouter;
+
+StatusWord_t AudioRouterClass::status;
+u8 AudioRouterClass::formats[AR_CHANNELS];
+u8 AudioRouterClass::budget;
+u8 AudioRouterClass::cost;
+u16 AudioRouterClass::used;
+u8 AudioRouterClass::replan;
+u8 AudioRouterClass::nextSlave;
+AR_slave_t AudioRouterClass::slaves[AR_MAX_SLAVES];
+
+u32 AudioRouterClass::masterAddr;
+u8 AudioRouterClass::slaveWants[AR_MAX_WANTS];
+u8 AudioRouterClass::slaveCount;
+u8 AudioRouterClass::slaveSeq;
+u8 AudioRouterClass::needsPending;
+u8 AudioRouterClass::ackPending;
+
+u8 AudioRouterClass::tx[DSC_DATAGRAM_MAX];
+
+//Bandwidth per ACH_FORMAT_n value, 0 for formats the planner does not know
+static const u8 formatCost[8] = {0, 4, 6, 0, 3, 1, 0, 0};
+
+//NWM_GET_STATUS_S: ACH_SUPPORT and the ACH_FORMAT bytes start at byte 13
+#define AR_STATUS_ACH 13
+
+//////////////////////////////////////////////////////////
+//Planning
+//////////////////////////////////////////////////////////
+
+void AudioRouterClass::readFormats(u8* pData, u8* pFormats) {
+//Turns ACH_SUPPORT (2) and the 8 ACH_FORMAT bytes, as on the wire, into one format per logical
+//channel. Channels the network does not support are AR_FMT_UNUSED
+	u16 nSupport = ((u16)pData[0] << 8) | pData[1];
+	u8 nFormat;
+	u8 i;
+
+	for (i=0; i<AR_CHANNELS; i++) {
+		//Even channels in the high nibble: [7] active, [6:4] format
+		nFormat = (pData[2 + i / 2] >> ((i & 1) ? 0 : 4)) & 0x07;
+		pFormats[i] = (nSupport & (1 << i)) ? nFormat : AR_FMT_UNUSED;
+	}
+}
+
+u16 AudioRouterClass::plan(AR_slave_t* pSlaves, u8 nSlaves, u8* pFormats, u8 nBudget, u8* pCost) {
+//Plans the route of every present slave that has sent its wants. Slaves get their first want before
+//anyone gets a second one, ties are settled by device ID, so the result only depends on the inputs.
+//A want is skipped if its output is taken, its channel is not offered or it does not fit nBudget.
+//Returns the logical channels in use, and their total bandwidth in pCost
+	AR_slave_t* pOrder[AR_MAX_SLAVES];
+	AR_slave_t* s;
+	u16 pOutputs[AR_MAX_SLAVES];
+	u16 nUsed = 0;
+	u8 nCost = 0;
+	u8 nCount = 0;
+	u8 nChannel, nOutput, nWant;
+	u8 i, j;
+
+	//Eligible slaves ordered by device ID as sent on the wire
+	for (i=0; i<nSlaves; i++) {
+		s = &pSlaves[i];
+		if (!s->present || !s->known) continue;
+		for (j=nCount; j>0 && memcmp(&pOrder[j - 1]->DEVICE_ID, &s->DEVICE_ID, 4) > 0; j--) {
+			pOrder[j] = pOrder[j - 1];
+		}
+		pOrder[j] = s;
+		memset(s->route, AR_NOT_USED, AR_CHANNELS);
+		nCount++;
+	}
+	memset(pOutputs, 0, sizeof(pOutputs));
+
+	for (nWant=0; nWant<AR_MAX_WANTS; nWant++) {
+		for (i=0; i<nCount; i++) {
+			s = pOrder[i];
+			if (nWant >= s->count) continue;
+
+			nChannel = s->wants[nWant] & 0x0F;
+			nOutput = s->wants[nWant] >> 4;
+			if (s->route[nChannel] != AR_NOT_USED || (pOutputs[i] & (1 << nOutput))) continue;
+			if (!formatCost[pFormats[nChannel] & 0x07]) continue;
+
+			//A channel already in the plan costs nothing more
+			if (!(nUsed & (1 << nChannel))) {
+				if (nCost + formatCost[pFormats[nChannel] & 0x07] > nBudget) continue;
+				nCost += formatCost[pFormats[nChannel] & 0x07];
+				nUsed |= 1 << nChannel;
+			}
+
+			s->route[nChannel] = nOutput;
+			pOutputs[i] |= 1 << nOutput;
+		}
+	}
+
+	if (pCost) *pCost = nCost;
+	return nUsed;
+}
+
+//////////////////////////////////////////////////////////
+//Common
+//////////////////////////////////////////////////////////
+
+u8 AudioRouterClass::receive(DSC_rx_data_t* pData) {
+//Checks a datagram from DSCMux. Returns its message type, 0 if it is too short to be one
+	switch (pData->DATA[0]) {
+		case AR_MSG_NEEDS:
+			if (pData->LENGTH < AR_NEEDS_HDR || pData->DATA[11] > AR_MAX_WANTS) return 0;
+			if (pData->LENGTH < AR_NEEDS_HDR + pData->DATA[11]) return 0;
+			break;
+		case AR_MSG_ROUTE:
+			if (pData->LENGTH < AR_ROUTE_LENGTH) return 0;
+			break;
+		case AR_MSG_ACK:
+			if (pData->LENGTH < 2) return 0;
+			break;
+	}
+
+	return pData->DATA[0];
+}
+
+void AudioRouterClass::send(u32 nAddr, u8 nLength) {
+//Sends the first nLength bytes of tx to nAddr, a device ID as it appears on the wire
+	DSCMux.send(nAddr, tx, nLength);
+}
+
+//////////////////////////////////////////////////////////
+//Master
+//////////////////////////////////////////////////////////
+
+void AudioRouterClass::beginMaster(u8 nBudget, EHIF_mask_t* pMask) {
+//Starts planning within nBudget (AR_BUDGET if 0). Pass the network status on the next serviceMaster()
+//call. Nothing is planned before the first NEEDS has told what the network offers
+	memset(slaves, 0, sizeof(slaves));
+	memset(formats, AR_FMT_UNUSED, sizeof(formats));
+	budget = nBudget ? nBudget : AR_BUDGET;
+	cost = 0;
+	used = 0;
+	replan = 0;
+	nextSlave = 0;
+
+	DSCMux.attach(AR_MSG_NEEDS, masterReceive);
+	DSCMux.attach(AR_MSG_ACK, masterReceive);
+	DSCMux.setMask(pMask);
+}
+
+void AudioRouterClass::serviceMaster(StatusWord_t nStatus, Master_status_t* pMaster) {
+//Call with a fresh status word when the EHIF interrupt is active, and from loop() for the resends.
+//pMaster: the latest network status after a network change, NULL if it has not been read again.
+//A slave joining, leaving or sending new wants plans all of them again, and only the slaves whose
+//route changed are sent a ROUTE
+	u8 i, n;
+
+	status = nStatus;
+
+	if (pMaster) syncSlaves(pMaster);
+
+	status = DSCMux.service(status);
+
+	if (replan) update();
+
+	for (i=0; i<AR_MAX_SLAVES && status.B.EVT_DSC_TX_AVAIL; i++) {
+		n = nextSlave;
+		nextSlave = (nextSlave + 1) % AR_MAX_SLAVES;
+		if (serveSlave(&slaves[n])) status = CC8531.getStatus();
+	}
+}
+
+void AudioRouterClass::syncSlaves(Master_status_t* pMaster) {
+//Matches the slaves in the network status against the table. A slave that joins, or comes back after
+//a drop, is asked for its wants again. Entries of slaves that left are kept while there is room
+	AR_slave_t* s;
+	u32 nId;
+	u8 nWas = 0;
+	u8 nNew = 0;
+	u8 i, j;
+
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		if (slaves[i].present) nWas |= 1 << i;
+		slaves[i].present = 0;
+	}
+
+	//Known slaves first, so that their entries are not given away
+	for (i=0; i<6; i++) {
+		nId = pMaster->slaveStatus[i].DEVICE_ID;
+		if (!nId || !pMaster->slaveStatus[i].WPS_DSC_EN) continue;
+
+		for (j=0; j<AR_MAX_SLAVES && slaves[j].DEVICE_ID != nId; j++);
+		if (j == AR_MAX_SLAVES) {
+			nNew |= 1 << i;
+			continue;
+		}
+
+		s = &slaves[j];
+		if (!(nWas & (1 << j))) {
+			s->known = 0;
+			s->seq++;
+			s->lastSent = millis() - AR_QUERY_MS;
+		}
+		s->present = 1;
+	}
+
+	//New ones take an empty entry, else one of a slave that has left
+	for (i=0; i<6; i++) {
+		if (!(nNew & (1 << i))) continue;
+
+		for (j=0; j<AR_MAX_SLAVES && slaves[j].DEVICE_ID; j++);
+		if (j == AR_MAX_SLAVES) {
+			for (j=0; j<AR_MAX_SLAVES && slaves[j].present; j++);
+			if (j == AR_MAX_SLAVES) continue;
+		}
+
+		s = &slaves[j];
+		memset(s, 0, sizeof(AR_slave_t));
+		memset(s->route, AR_NOT_USED, AR_CHANNELS);
+		s->DEVICE_ID = pMaster->slaveStatus[i].DEVICE_ID;
+		s->seq = 1;
+		s->present = 1;
+		s->lastSent = millis() - AR_QUERY_MS;
+	}
+
+	//Channels of slaves that left are free for the others
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		if ((nWas & (1 << i)) && !slaves[i].present) replan = 1;
+	}
+}
+
+void AudioRouterClass::masterReceive(DSC_rx_data_t* pData) {
+//Handles a NEEDS or ACK from a slave
+	AR_slave_t* s = NULL;
+	u8* d = pData->DATA;
+	u8 nType = receive(pData);
+	u8 i;
+
+	if (nType != AR_MSG_NEEDS && nType != AR_MSG_ACK) return;
+
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		if (slaves[i].DEVICE_ID && slaves[i].DEVICE_ID == pData->ADDR) s = &slaves[i];
+	}
+	if (!s || !s->present) return;
+
+	if (nType == AR_MSG_ACK) {
+		if (d[1] == s->seq) s->ackSeq = s->seq;
+		return;
+	}
+
+	//All slaves are in the same network, the latest word on what it offers goes
+	readFormats(d + 1, formats);
+	s->count = d[11];
+	memcpy(s->wants, d + AR_NEEDS_HDR, s->count);
+	s->known = 1;
+	replan = 1;
+}
+
+void AudioRouterClass::update() {
+//Plans again and moves the slaves whose route changed to a new sequence
+	u8 pRoutes[AR_MAX_SLAVES][AR_CHANNELS];
+	AR_slave_t* s;
+	u8 i;
+
+	for (i=0; i<AR_MAX_SLAVES; i++) memcpy(pRoutes[i], slaves[i].route, AR_CHANNELS);
+
+	used = plan(slaves, AR_MAX_SLAVES, formats, budget, &cost);
+	replan = 0;
+
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		s = &slaves[i];
+		if (!memcmp(pRoutes[i], s->route, AR_CHANNELS)) continue;
+		if (s->sentSeq == s->seq) s->seq++;
+	}
+}
+
+u8 AudioRouterClass::serveSlave(AR_slave_t* s) {
+//Sends slave s a QUERY while its wants are unknown, else its ROUTE if it is behind and none is on its
+//way. Returns 1 if a datagram was sent
+	u32 nNow = millis();
+
+	if (!s->present) return 0;
+
+	if (!s->known) {
+		if (nNow - s->lastSent < AR_QUERY_MS) return 0;
+		tx[0] = AR_MSG_QUERY;
+		send(s->DEVICE_ID, 1);
+		s->lastSent = nNow;
+		return 1;
+	}
+
+	if (s->seq == s->ackSeq) return 0;
+	if (s->sentSeq == s->seq && nNow - s->lastSent < AR_RETX_MS) return 0;
+
+	tx[0] = AR_MSG_ROUTE;
+	tx[1] = s->seq;
+	memcpy(tx + 2, s->route, AR_CHANNELS);
+	send(s->DEVICE_ID, AR_ROUTE_LENGTH);
+
+	s->sentSeq = s->seq;
+	s->lastSent = nNow;
+	return 1;
+}
+
+AR_slave_t* AudioRouterClass::getSlave(u8 n) {
+//Returns the plan of table entry n, for display
+	return &slaves[n];
+}
+
+u16 AudioRouterClass::getUsed() {
+//Returns the logical channels the plan uses, bit n = channel n
+	return used;
+}
+
+u8 AudioRouterClass::pending() {
+//Returns the number of present slaves that have not yet acknowledged their route
+	u8 nCount = 0;
+	u8 i;
+
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		if (slaves[i].present && (!slaves[i].known || slaves[i].seq != slaves[i].ackSeq)) nCount++;
+	}
+
+	return nCount;
+}
+
+void AudioRouterClass::report(Print& out) {
+//Prints the bandwidth in use and per slave its route as channel>output (* = not acknowledged)
+	AR_slave_t* s;
+	u8 i, j;
+
+	out.print("channels: 0x");
+	out.print(used, HEX);
+	out.print(" bandwidth: ");
+	out.print(cost);
+	out.print("/");
+	out.println(budget);
+
+	for (i=0; i<AR_MAX_SLAVES; i++) {
+		s = &slaves[i];
+		if (!s->DEVICE_ID) continue;
+		out.print(s->DEVICE_ID, HEX);
+		if (!s->present) out.print(" -");
+		else if (!s->known) out.print(" ?");
+		else out.print(s->seq != s->ackSeq ? " *" : "  ");
+		for (j=0; j<AR_CHANNELS; j++) {
+			if (s->route[j] == AR_NOT_USED) continue;
+			out.print(" ");
+			out.print(j);
+			out.print(">");
+			out.print(s->route[j]);
+		}
+		out.println();
+	}
+}
+
+//////////////////////////////////////////////////////////
+//Slave
+//////////////////////////////////////////////////////////
+
+void AudioRouterClass::beginSlave(u8* pWants, u8 nCount, EHIF_mask_t* pMask) {
+//Starts taking routes from the master. pWants: (output << 4) | logical channel, most wanted first.
+//The wants are sent when the master asks for them
+	if (nCount > AR_MAX_WANTS) nCount = AR_MAX_WANTS;
+	memcpy(slaveWants, pWants, nCount);
+	slaveCount = nCount;
+
+	masterAddr = 0;
+	slaveSeq = 0;
+	needsPending = 0;
+	ackPending = 0;
+
+	DSCMux.attach(AR_MSG_QUERY, slaveReceive);
+	DSCMux.attach(AR_MSG_ROUTE, slaveReceive);
+	DSCMux.setMask(pMask);
+}
+
+void AudioRouterClass::serviceSlave(StatusWord_t nStatus) {
+//Call with a fresh status word when the EHIF interrupt is active
+	status = DSCMux.service(nStatus);
+
+	if (needsPending && status.B.EVT_DSC_TX_AVAIL) {
+		sendNeeds();
+		status = CC8531.getStatus();
+	}
+	if (ackPending && status.B.EVT_DSC_TX_AVAIL) sendAck();
+}
+
+void AudioRouterClass::slaveReceive(DSC_rx_data_t* pData) {
+//Handles a QUERY or ROUTE from the master. A ROUTE is applied even if it is a repeat, the master may
+//have started over with the same sequence
+	u8* d = pData->DATA;
+
+	switch (receive(pData)) {
+		case AR_MSG_QUERY:
+			masterAddr = pData->ADDR;
+			needsPending = 1;
+			break;
+
+		case AR_MSG_ROUTE:
+			masterAddr = pData->ADDR;
+			CC8531.Network.confAudioChan((Audio_chan_t*)(d + 2));
+			slaveSeq = d[1];
+			ackPending = 1;
+			break;
+	}
+}
+
+void AudioRouterClass::sendNeeds() {
+//Sends the wants with the channels and formats of the network from NWM_GET_STATUS_S
+	u8 nData[32];
+
+	memset(nData, 0, sizeof(nData));
+	CC8531.Network.getStatusSlave(nData);
+
+	tx[0] = AR_MSG_NEEDS;
+	memcpy(tx + 1, nData + AR_STATUS_ACH, 10);
+	tx[11] = slaveCount;
+	memcpy(tx + AR_NEEDS_HDR, slaveWants, slaveCount);
+	send(masterAddr, AR_NEEDS_HDR + slaveCount);
+
+	needsPending = 0;
+}
+
+void AudioRouterClass::sendAck() {
+//Acknowledges the last ROUTE applied
+	tx[0] = AR_MSG_ACK;
+	tx[1] = slaveSeq;
+	send(masterAddr, 2);
+
+	ackPending = 0;
+}
@@ -0,0 +1,117 @@
+#ifndef _AUDIOROUTER_H_INCLUDED
+#define _AUDIOROUTER_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+#include "DSCMux.h"
+
+//Plans which logical audio channels each slave consumes (NWM_ACH_SET_USAGE) from the master host.
+//Every slave declares what it would like to play as a list of wants in order of preference, each a
+//logical channel and the local audio interface channel (output) it should go to. Alternatives for one
+//output are simply later wants for the same output, e.g. REAR_SECONDARY_LEFT on output 0, else
+//FRONT_PRIMARY_LEFT on output 0. The slave sends its wants with the channels and formats the network
+//offers (ACH_SUPPORT and ACH_FORMAT_n from NWM_GET_STATUS_S), the master plans and sends each slave
+//its Audio_chan_t, which the slave hands to confAudioChan(). Datagrams go through DSCMux, so it runs
+//next to the other DSCMux protocols but not next to DSCTransport. Each datagram is one message:
+//	QUERY	master -> slave	type
+//	NEEDS	slave -> master	type, ACH_SUPPORT (2), ACH_FORMAT bytes (8), count, wants (count)
+//	ROUTE	master -> slave	type, sequence, Audio_chan_t (16)
+//	ACK		slave -> master	type, sequence
+//A want is (output << 4) | logical channel
+#define AR_MSG_QUERY 'Q'
+#define AR_MSG_NEEDS 'N'
+#define AR_MSG_ROUTE 'R'
+#define AR_MSG_ACK 'r'
+
+#define AR_CHANNELS 16
+#define AR_MAX_WANTS 8
+#define AR_NOT_USED 0xFF
+
+#define AR_NEEDS_HDR 12
+#define AR_ROUTE_LENGTH (2 + AR_CHANNELS)
+
+//Audio channel formats, as in ACH_FORMAT_n
+#define AR_FMT_UNUSED 0
+#define AR_FMT_PCM16 1
+#define AR_FMT_PCME24 2
+#define AR_FMT_SLAC 4
+#define AR_FMT_PCMLF 5
+
+//Radio bandwidth of a channel in each format, in units of 4 bits per sample: PCM16 4, PCME24 6,
+//SLAC 3 (compressed to about 12 bits), PCMLF 1 (low frequency channel at a quarter of the rate).
+//The channels the plan uses, counted once however many slaves consume them, must fit AR_BUDGET.
+//The default is four PCM16 channels
+#ifndef AR_BUDGET
+#define AR_BUDGET 16
+#endif
+
+//QUERY repeat interval for slaves that have not sent NEEDS, and ROUTE resend interval without ACK
+#define AR_QUERY_MS 500
+#define AR_RETX_MS 200
+
+#define AR_MAX_SLAVES 6
+
+//Master view of one slave
+typedef struct {
+	u32 DEVICE_ID;	//As in Master_status_t, big-endian
+	u8 count;		//Wants received, 0 before the first NEEDS
+	u8 wants[AR_MAX_WANTS];
+	u8 route[AR_CHANNELS];	//Planned Audio_chan_t, output per logical channel or AR_NOT_USED
+	u8 seq;			//Sequence of the planned route
+	u8 sentSeq;		//Sequence of the last ROUTE
+	u8 ackSeq;		//Sequence the slave last acknowledged
+	u8 known;		//NEEDS received since the slave joined
+	u8 present;		//Listed in the last Master_status_t
+	u32 lastSent;	//millis() of the last QUERY or ROUTE
+} AR_slave_t;
+
+class AudioRouterClass {
+private:
+	static StatusWord_t status;
+	static u8 formats[AR_CHANNELS];
+	static u8 budget;
+	static u8 cost;
+	static u16 used;
+	static u8 replan;
+	static u8 nextSlave;
+	static AR_slave_t slaves[AR_MAX_SLAVES];
+
+	static u32 masterAddr;
+	static u8 slaveWants[AR_MAX_WANTS];
+	static u8 slaveCount;
+	static u8 slaveSeq;
+	static u8 needsPending;
+	static u8 ackPending;
+
+	static u8 tx[DSC_DATAGRAM_MAX];
+
+	static u8 receive(DSC_rx_data_t*);
+	static void send(u32, u8);
+
+	static void syncSlaves(Master_status_t*);
+	static void masterReceive(DSC_rx_data_t*);
+	static void update();
+	static u8 serveSlave(AR_slave_t*);
+
+	static void slaveReceive(DSC_rx_data_t*);
+	static void sendNeeds();
+	static void sendAck();
+public:
+	static void readFormats(u8*, u8*);
+	static u16 plan(AR_slave_t*, u8, u8*, u8, u8*);
+
+	static void beginMaster(u8, EHIF_mask_t*);
+	static void serviceMaster(StatusWord_t, Master_status_t*);
+	static AR_slave_t* getSlave(u8);
+	static u16 getUsed();
+	static u8 pending();
+	static void report(Print&);
+
+	static void beginSlave(u8*, u8, EHIF_mask_t*);
+	static void serviceSlave(StatusWord_t);
+};
+
+extern AudioRouterClass AudioRouter;
+
+#endif
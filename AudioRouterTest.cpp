@@ -0,0 +1,230 @@
+// Unit tests for AudioRouter: format decoding, the planner, and a master, a slave and a scripted second
+// slave talking over the CC85xx stand-in in HostSim.
+// Build: g++ -IHostSim -I. -o AudioRouterTest AudioRouterTest.cpp AudioRouter.cpp DSCMux.cpp HostSim/CC85xxSim.cpp
+// Usage: ./AudioRouterTest (exit status 0 if all checks pass)
+
+#include <stdlib.h>
+#include "CC85xxSim.h"
+#include "AudioRouter.h"
+
+#define FL 0	//FRONT_PRIMARY_LEFT
+#define FR 1
+#define RL 2
+#define RR 3
+#define SUB 5
+#define SIDE_L 6
+
+#define WANT(output, channel) (((output) << 4) | (channel))
+
+// ACH_SUPPORT 0x003F and the ACH_FORMAT bytes: FL, FR, RL, RR PCM16, FRONT_CENTER PCMLF, SUB SLAC
+static u8 achRaw[10] = {0x00, 0x3F, 0x11, 0x11, 0x54, 0, 0, 0, 0, 0};
+
+static int failures;
+
+void check(int ok, const char *what) {
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+void setSlave(AR_slave_t *s, u32 id, const u8 *wants, u8 count) {
+	memset(s, 0, sizeof(*s));
+	s->DEVICE_ID = id;
+	s->present = 1;
+	s->known = 1;
+	s->count = count;
+	memcpy(s->wants, wants, count);
+}
+
+void testFormats() {
+	u8 formats[AR_CHANNELS];
+	u8 expect[AR_CHANNELS] = {1, 1, 1, 1, 5, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+	AudioRouterClass::readFormats(achRaw, formats);
+	check(!memcmp(formats, expect, AR_CHANNELS), "readFormats decodes ACH_SUPPORT and ACH_FORMAT");
+
+	// A format on a channel the network does not support is ignored
+	achRaw[1] = 0x1F;
+	AudioRouterClass::readFormats(achRaw, formats);
+	check(formats[5] == AR_FMT_UNUSED, "readFormats drops unsupported channels");
+	achRaw[1] = 0x3F;
+}
+
+void testPlan() {
+	AR_slave_t s[3];
+	u8 formats[AR_CHANNELS];
+	u8 a[2] = {WANT(0, FL), WANT(1, FR)};
+	u8 b[4] = {WANT(0, RL), WANT(1, RR), WANT(0, FL), WANT(1, FR)};
+	u8 c[1] = {WANT(0, SUB)};
+	u8 cost;
+	u16 used;
+
+	AudioRouterClass::readFormats(achRaw, formats);
+
+	// B sorts first (lowest wire ID), everyone gets a first want before anyone gets a second; A's FR
+	// would take the cost to 19 and does not fit
+	setSlave(&s[0], 0x02000000, a, 2);
+	setSlave(&s[1], 0x01000000, b, 4);
+	setSlave(&s[2], 0x03000000, c, 1);
+	used = AudioRouterClass::plan(s, 3, formats, 16, &cost);
+	check(used == ((1 << FL) | (1 << RL) | (1 << RR) | (1 << SUB)) && cost == 15, "plan within budget 16");
+	check(s[0].route[FL] == 0 && s[0].route[FR] == AR_NOT_USED, "plan: A gets FL only");
+	check(s[1].route[RL] == 0 && s[1].route[RR] == 1 && s[1].route[FL] == AR_NOT_USED, "plan: B keeps its outputs for the rear");
+	check(s[2].route[SUB] == 0, "plan: C gets SUB");
+
+	used = AudioRouterClass::plan(s, 3, formats, 20, &cost);
+	check(used == 0x2F && cost == 19 && s[0].route[FR] == 1, "plan within budget 20");
+
+	// A channel shared by two slaves is counted once
+	setSlave(&s[0], 0x02000000, a, 1);
+	setSlave(&s[1], 0x01000000, a, 1);
+	used = AudioRouterClass::plan(s, 2, formats, 4, &cost);
+	check(used == (1 << FL) && cost == 4 && s[0].route[FL] == 0 && s[1].route[FL] == 0, "plan: shared channel costs once");
+
+	// Channels the network does not offer are skipped in favour of the next want
+	u8 d[2] = {WANT(0, SIDE_L), WANT(0, FL)};
+	setSlave(&s[0], 0x02000000, d, 2);
+	used = AudioRouterClass::plan(s, 1, formats, 16, &cost);
+	check(used == (1 << FL) && s[0].route[SIDE_L] == AR_NOT_USED, "plan: unsupported channel skipped");
+
+	// Absent slaves and slaves without wants are not planned
+	s[0].present = 0;
+	used = AudioRouterClass::plan(s, 1, formats, 16, &cost);
+	check(used == 0 && cost == 0, "plan: absent slave ignored");
+}
+
+//////////////////////////////////////////////////////////
+//Master, slave and a scripted slave over the stand-in
+//////////////////////////////////////////////////////////
+
+static CC85xxSim master(0x0A000000);
+static CC85xxSim slave(0x01000000);
+static CC85xxSim scripted(0x02000000);
+static CC85xxSim *devices[3] = {&master, &slave, &scripted};
+static u8 scriptedRoute[AR_CHANNELS];
+static u8 scriptedWants[2] = {WANT(0, FL), WANT(1, FR)};
+
+void setNetwork(Master_status_t *m, u8 withScripted) {
+	memset(m, 0, sizeof(*m));
+	m->slaveStatus[0].DEVICE_ID = slave.wireId;
+	m->slaveStatus[0].WPS_DSC_EN = 1;
+	if (withScripted) {
+		m->slaveStatus[1].DEVICE_ID = scripted.wireId;
+		m->slaveStatus[1].WPS_DSC_EN = 1;
+	}
+}
+
+void playScripted() {
+	// Answers QUERY with NEEDS and ROUTE with ACK, like a slave running AudioRouter would
+	SimDatagram_t d;
+	u8 reply[AR_NEEDS_HDR + 2];
+
+	while (scripted.receive(&d)) {
+		if (d.DATA[0] == AR_MSG_QUERY) {
+			reply[0] = AR_MSG_NEEDS;
+			memcpy(reply + 1, achRaw, 10);
+			reply[11] = 2;
+			memcpy(reply + AR_NEEDS_HDR, scriptedWants, 2);
+			scripted.queue(master.wireId, reply, AR_NEEDS_HDR + 2);
+		}
+		else if (d.DATA[0] == AR_MSG_ROUTE) {
+			memcpy(scriptedRoute, d.DATA + 2, AR_CHANNELS);
+			reply[0] = AR_MSG_ACK;
+			reply[1] = d.DATA[1];
+			scripted.queue(master.wireId, reply, 2);
+		}
+	}
+}
+
+void run(Master_status_t *m, unsigned long ms) {
+	// Services everything once per millisecond. The network status is handed over on the first pass
+	unsigned long end = simMillis + ms;
+
+	for (; simMillis < end; simMillis++) {
+		CC85xxSim::select(&master);
+		AudioRouter.serviceMaster(CC8531.getStatus(), m);
+		m = NULL;
+		CC85xxSim::select(&slave);
+		AudioRouter.serviceSlave(CC8531.getStatus());
+		playScripted();
+		simLink(devices, 3);
+	}
+}
+
+void start() {
+	u8 wants[4] = {WANT(0, RL), WANT(1, RR), WANT(0, FL), WANT(1, FR)};
+	EHIF_mask_t mask;
+
+	memset(&mask, 0, sizeof(mask));
+	memcpy(slave.status + 13, achRaw, 10);
+	memset(scriptedRoute, AR_NOT_USED, sizeof(scriptedRoute));
+	slave.audioChanSets = 0;
+	memset(slave.audioChan, AR_NOT_USED, sizeof(slave.audioChan));
+
+	CC85xxSim::select(&master);
+	AudioRouter.beginMaster(16, &mask);
+	CC85xxSim::select(&slave);
+	AudioRouter.beginSlave(wants, 4, &mask);
+}
+
+void testNetwork() {
+	Master_status_t m;
+	u16 sets;
+
+	start();
+	setNetwork(&m, 1);
+	run(&m, 1000);
+
+	// The slave (lower ID) plans first: RL, then the scripted slave FL, then RR and FR. Budget 16 is
+	// exactly four PCM16 channels
+	check(AudioRouter.getUsed() == 0x0F, "network: all four front/rear channels planned");
+	check(slave.audioChan[RL] == 0 && slave.audioChan[RR] == 1 && slave.audioChan[FL] == AR_NOT_USED, "network: slave applied its route");
+	check(scriptedRoute[FL] == 0 && scriptedRoute[FR] == 1 && scriptedRoute[RL] == AR_NOT_USED, "network: scripted slave got its route");
+	check(AudioRouter.pending() == 0, "network: all routes acknowledged");
+
+	// The scripted slave leaves: its channels are freed, the slave's route does not change, so it is
+	// not sent again
+	sets = slave.audioChanSets;
+	setNetwork(&m, 0);
+	run(&m, 1000);
+	check(AudioRouter.getUsed() == ((1 << RL) | (1 << RR)), "network: channels of a slave that left are freed");
+	check(slave.audioChanSets == sets, "network: unchanged route not resent");
+
+	// It comes back and is asked for its wants again
+	setNetwork(&m, 1);
+	memset(scriptedRoute, AR_NOT_USED, sizeof(scriptedRoute));
+	run(&m, 1000);
+	check(scriptedRoute[FL] == 0 && scriptedRoute[FR] == 1 && AudioRouter.pending() == 0, "network: returning slave planned again");
+	check(!master.txOverflows && !slave.txOverflows && !scripted.txOverflows, "network: no datagram sent into a full queue");
+}
+
+void testLoss() {
+	Master_status_t m;
+
+	srand(1);
+	linkLoss = 0.3;
+	start();
+	setNetwork(&m, 1);
+	run(&m, 5000);
+	linkLoss = 0;
+
+	check(master.rxDropped && slave.rxDropped, "loss: datagrams were lost both ways");
+	check(slave.audioChan[RL] == 0 && slave.audioChan[RR] == 1, "loss: slave route applied");
+	check(scriptedRoute[FL] == 0 && scriptedRoute[FR] == 1, "loss: scripted slave route applied");
+	check(AudioRouter.pending() == 0, "loss: all routes acknowledged");
+}
+
+int main() {
+	testFormats();
+	testPlan();
+	testNetwork();
+	testLoss();
+
+	CC85xxSim::select(&master);
+	AudioRouter.report(Serial);
+
+	if (failures) printf("%d check(s) failed\n", failures);
+	else printf("all checks passed\n");
+	return failures ? 1 : 0;
+}
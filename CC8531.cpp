@@ -5,6 +5,24 @@
 
 CC8531Class CC8531;
 
+CC8531Class::CC8531Class() {
+//Hands every command group the chip it talks to
+	waitReadyError = 0;
+	Bootloader.pChip = this;
+	Info.pChip = this;
+	EHIFCtrl.pChip = this;
+	Network.pChip = this;
+	RC.pChip = this;
+	DSC.pChip = this;
+	Power.pChip = this;
+	Volume.pChip = this;
+	Statistics.pChip = this;
+	Utility.pChip = this;
+	RFTest.pChip = this;
+	AudioTest.pChip = this;
+	IOTest.pChip = this;
+}
+
 void CC8531Class::begin() {
 	SPI.setBitOrder(MSBFIRST);	//MSB first
 	SPI.setDataMode(SPI_MODE0);	//CPOL=0, CPHA=0
@@ -36,7 +54,7 @@ void CC8531Class::waitReadyMs(u16 nTimeout) {
 
 StatusWord_t CC8531Class::writeWord(u8 nFirstByte, u8 nSecondByte) {
 //Writes (and reads) one word to CC8531
-	StatusWord_t nStatus
+	StatusWord_t nStatus;
 
 	//Select CC8531 (CSn low)
 	SELECT_CC8531();
@@ -44,8 +62,8 @@ StatusWord_t CC8531Class::writeWord(u8 nFirstByte, u8 nSecondByte) {
 	//Wait for MISO to be high
 	waitReady();
 
-	nStatus = (SPI.transfer(nFirstByte)) << 8;
-	nStatus |= SPI.transfer(nSecondByte);
+	nStatus.nStatus = (u16)SPI.transfer(nFirstByte) << 8;
+	nStatus.nStatus |= SPI.transfer(nSecondByte);
 
 	return nStatus;
 }
@@ -134,10 +152,10 @@ StatusWord_t CC8531Class::readBC(u8* nDataBuffer, u16* nDataLength) {
 	u16 i=0;
 
 	nStatus = writeWord(0xA0, 0x00);
-	nNumBytes = writeWord(0xA0,0x00);
+	nNumBytes = writeWord(0xA0,0x00).nStatus;
 
-	if (nNumBytes > *nDataMaxLength) {
-		nNumBytes = *nDataMaxLength;
+	if (nNumBytes > *nDataLength) {	//Buffer size in, bytes read out
+		nNumBytes = *nDataLength;
 	}
 	*nDataLength = nNumBytes;
 
@@ -205,7 +223,7 @@ void CC8531Class::bootReset() {
 	return;
 }
 
-u8 CC8531::hexVal(u8 nByte) {
+u8 CC8531Class::hexVal(u8 nByte) {
 //Returns hex value of ASCII byte, 0xFF if not valid
 	if ((nByte >= '0') && (nByte <= '9')) return ((nByte - '0') & 0x0F);
 	if ((nByte >= 'a') && (nByte <= 'f')) return ((nByte - 'a' + 0x0A) & 0x0F);
@@ -213,12 +231,12 @@ u8 CC8531::hexVal(u8 nByte) {
 	return 0xFF;
 }
 
-u8 CC8531::readByte(File dataFile) {
+u8 CC8531Class::readByte(File dataFile) {
 //Reads byte from data stream: 0 1 A 4 F 7 -> 0x01, 0xA4, 0xF7
 	return ( (hexVal(dataFile.read()) << 4) | hexVal(dataFile.read()) );
 }
 
-u16 CC8531::readInt(File dataFile) {
+u16 CC8531Class::readInt(File dataFile) {
 //Reads unsigned int from data stream: 1 8 F 0 -> 0x18F0
 	return ((hexVal(dataFile.read()) & 0x0F) << 12) |
 			((hexVal(dataFile.read()) & 0x0F) << 8) |
@@ -231,7 +249,7 @@ u16 CC8531::readInt(File dataFile) {
 //Basic Functions (public)
 //////////////////////////////////////////////////////////
 
-u8 getWaitReadyError() {
+u8 CC8531Class::getWaitReadyError() {
 	return waitReadyError;
 }
 
@@ -243,23 +261,23 @@ StatusWord_t CC8531Class::BootloaderClass::unlock() {
 //Unlocks the SPI commands provided by the bootloader for flash programming
 	u8 nCmd[4] = {0x25, 0x05, 0xB0, 0x07};
 	
-	cmdReq(0x00, 4, nCmd);
+	pChip->cmdReq(0x00, 4, nCmd);
 
-	waitReadyMs(1);
-	return getStatus();
+	pChip->waitReadyMs(1);
+	return pChip->getStatus();
 }
 
 StatusWord_t CC8531Class::BootloaderClass::flashMassErase() {
 //Erases all flash contents, always run before programming
 	u8 nCmd[4] = {0x25, 0x05, 0x13, 0x37};
 
-	cmdReq(0x03, 4, nCmd);
+	pChip->cmdReq(0x03, 4, nCmd);
 
-	waitReadyMs(25);
-	return getStatus();
+	pChip->waitReadyMs(25);
+	return pChip->getStatus();
 }
 
-StatusWord_t CC8531Class::BootloaderClass::flashPageProg(u16 nRAMAddr, u16* nFlashAddr) {
+StatusWord_t CC8531Class::BootloaderClass::flashPageProg(u16 nRAMAddr, u16 nFlashAddr) {
 //Programs a single 1kB flash page using data which has been written to the given
 //RAM location. 
 	u8 nCmd[10] = {0,0, 0,0, 0x10,0x00, 0x25, 0x05, 0x13, 0x37};
@@ -269,9 +287,9 @@ StatusWord_t CC8531Class::BootloaderClass::flashPageProg(u16 nRAMAddr, u16* nFla
 	nCmd[2] = (u8)((nFlashAddr >> 8) & 0xFF);
 	nCmd[3] = (u8)(nFlashAddr & 0xFF);
 
-	cmdReq(0x07, 10, nCmd);
-	waitReadyMs(10);
-	return getStatus();
+	pChip->cmdReq(0x07, 10, nCmd);
+	pChip->waitReadyMs(10);
+	return pChip->getStatus();
 }
 
 StatusWord_t CC8531Class::BootloaderClass::flashVerify(u16 nByteCount, u8* nCRC) {
@@ -279,37 +297,36 @@ StatusWord_t CC8531Class::BootloaderClass::flashVerify(u16 nByteCount, u8* nCRC)
 //the entire image and comparing it against the expected checksum value. nByteCount
 //is the size of the unpadded FW image (intel hex @ 0x801C)
 	u8 nCmd[8] = {0x00,0x00,0x80,0x00,0x00,0x00,0,0};
-	u16nStatus;
 
 	nCmd[6] = (u8)((nByteCount >> 8) & 0xFF);
 	nCmd[7] = (u8)(nByteCount & 0xFF);
 
-	cmdReq(0x0F, 8, nCmd);
-	waitReadyMs(15);
-	return read(4, nCRC);
+	pChip->cmdReq(0x0F, 8, nCmd);
+	pChip->waitReadyMs(15);
+	return pChip->read(4, nCRC);
 }
 
 StatusWord_t CC8531Class::flashProgram(u8* nFlashImage) {
 //Flash programming algorithm
 	
-	u16 nStatus;
+	StatusWord_t nStatus;
 	u16 nOffset;
 	u8 nActualCRCVal[sizeof(u32)];
 	u16 i;
 	u32 nImageSize;
-	const u8* nExpectedCRCVal
+	const u8* nExpectedCRCVal;
 
-	nImageSize = (nFlashImage[0x1E] << 8) | nFlashImage[0x1F]);
+	nImageSize = ((u16)nFlashImage[0x1E] << 8) | nFlashImage[0x1F];
 	nExpectedCRCVal = nFlashImage + nImageSize;
 
 	//Enter bootloader
 	bootReset();
 	nStatus = Bootloader.unlock();
-	if (nStatus != BL_SPI_LOADER_READY) return nStatus;
+	if (nStatus.nStatus != BL_SPI_LOADER_READY) return nStatus;
 
 	//Erase flash
 	nStatus = Bootloader.flashMassErase();
-	if (nStatus != BL_ERASE_DONE) return nStatus;
+	if (nStatus.nStatus != BL_ERASE_DONE) return nStatus;
 
 	//For each flash page
 	for (nOffset=0x0000; nOffset<0x8000; nOffset += 0x0400) {
@@ -323,14 +340,14 @@ StatusWord_t CC8531Class::flashProgram(u8* nFlashImage) {
 
 		//Program the page
 		nStatus = Bootloader.flashPageProg(0x6000, 0x8000 + nOffset);
-		if (nStatus != BL_PROG_DONE) return nStatus;
+		if (nStatus.nStatus != BL_PROG_DONE) return nStatus;
 	}
 
 	//Verify the flash contents
-	nStatus = Bootloader.flashVerify(nByteCount, nActualCRCVal);
+	nStatus = Bootloader.flashVerify(nImageSize, nActualCRCVal);
 	for (i=0; i<sizeof(nActualCRCVal); i++) {
 		if (nActualCRCVal[i] != nExpectedCRCVal[i]) {
-			nStatus = BL_VERIFY_FAILED;
+			nStatus.nStatus = BL_VERIFY_FAILED;
 		}
 	}
 
@@ -339,28 +356,30 @@ StatusWord_t CC8531Class::flashProgram(u8* nFlashImage) {
 	return nStatus;
 }
 
-StatusWord_t CC8531::flashHex(File dataFile) {
+StatusWord_t CC8531Class::flashHex(File dataFile) {
 //Parses intel hex file
 	u8 nData;			//Interpreted byte
 	u8 nByteCount;		//Line byte count
 	u16 nAddress;		//Address
 	u8 nRecordType;		//Record type
 	u8 nChecksum;		//Checksum
+	u8 nSum;			//Sum of the record bytes before the checksum
 	u16 nDataIndex = 0;	//Data buffer index
 	u8 nIndex = 0;		//Line byte index
 	StatusWord_t nStatus;
 	u16 nImageSize = 0;		//Size of image (0x7BFC = 31740B)
 	u8 nExpectedCRCVal[4];	//Expected CRC value
 	u8 nActualCRCVal[4];	//Actual CRC Value
+	u16 i;
 
 	//Enter bootloader
 	bootReset();
 	nStatus = Bootloader.unlock();
-	if (nStatus != BL_SPI_LOADER_READY) return nStatus;
+	if (nStatus.nStatus != BL_SPI_LOADER_READY) return nStatus;
 
 	//Erase flash
 	nStatus = Bootloader.flashMassErase();
-	if (nStatus != BL_ERASE_DONE) return nStatus;
+	if (nStatus.nStatus != BL_ERASE_DONE) return nStatus;
 
 	SELECT_CC8531();
 	setAddr(0x6000);
@@ -374,11 +393,14 @@ StatusWord_t CC8531::flashHex(File dataFile) {
 			nAddress = readInt(dataFile);		//Read 16b address
 
 			nRecordType = readByte(dataFile);	//Read record type
+
+			nSum = nByteCount + (nAddress >> 8) + nAddress + nRecordType;
 			
 			if (nRecordType == DATA_RECORD) {	//If data record
 				nIndex = 0;
 				while (nIndex < nByteCount) {	//Read data
 					nData = readByte(dataFile);
+					nSum += nData;
 
 					SPI.transfer(nData);
 
@@ -389,8 +411,8 @@ StatusWord_t CC8531::flashHex(File dataFile) {
 						DESELECT_CC8531();	//Deselect to end write op
 
 						//Program page
-						nStatus = Bootloader.flashPageProg(0x6000, 0x8000 + nOffset);
-						if (nStatus != BL_PROG_DONE) return nStatus;
+						nStatus = Bootloader.flashPageProg(0x6000, 0x8000 + nDataIndex - 0x0400);
+						if (nStatus.nStatus != BL_PROG_DONE) return nStatus;
 
 						setAddr(0x6000);
 						writeWord(0x84, 0x00);	//Start write op of 0x0400 bytes
@@ -410,7 +432,7 @@ StatusWord_t CC8531::flashHex(File dataFile) {
 				nStatus = Bootloader.flashVerify(nByteCount, nActualCRCVal);
 				for (i=0; i<sizeof(nActualCRCVal); i++) {
 					if (nActualCRCVal[i] != nExpectedCRCVal[i]) {
-						nStatus = BL_VERIFY_FAILED;
+						nStatus.nStatus = BL_VERIFY_FAILED;
 					}
 				}
 
@@ -421,12 +443,75 @@ StatusWord_t CC8531::flashHex(File dataFile) {
 			}
 
 			nChecksum = readByte(dataFile);
+
+			//The record has gone to the CC8531 already, so a bad one fails the whole programming
+			if (nRecordType == DATA_RECORD && (u8)(nSum + nChecksum) != 0) {
+				DESELECT_CC8531();
+				nStatus.nStatus = BL_PROG_FAILED;
+				return nStatus;
+			}
 		}
 	}
 	
-	return BL_PROG_FAILED;
+	nStatus.nStatus = BL_PROG_FAILED;
+	return nStatus;
 }
 
+StatusWord_t CC8531Class::flashFile(File dataFile, u16 nFileSize) {
+//Programs a binary flash image read from the current position of dataFile. nFileSize bytes are
+//written, padded with 0xFF to whole pages; the image size and expected CRC come from the image itself
+	StatusWord_t nStatus;
+	u16 nOffset;
+	u16 nDataIndex = 0;	//Data buffer index
+	u16 nImageSize = 0;	//Size of image (@ 0x1E)
+	u8 nExpectedCRCVal[4];	//Expected CRC value
+	u8 nActualCRCVal[4];	//Actual CRC Value
+	u8 nData;
+	u16 i;
+
+	//Enter bootloader
+	bootReset();
+	nStatus = Bootloader.unlock();
+	if (nStatus.nStatus != BL_SPI_LOADER_READY) return nStatus;
+
+	//Erase flash
+	nStatus = Bootloader.flashMassErase();
+	if (nStatus.nStatus != BL_ERASE_DONE) return nStatus;
+
+	for (nOffset=0x0000; nOffset<nFileSize; nOffset += 0x0400) {
+		setAddr(0x6000);
+		SELECT_CC8531();
+		writeWord(0x84, 0x00);	//Start write op of 0x0400 bytes
+
+		for (i=0; i<0x0400; i++, nDataIndex++) {
+			nData = (nDataIndex < nFileSize) ? dataFile.read() : 0xFF;
+			SPI.transfer(nData);
+
+			if (nDataIndex == 0x1E) nImageSize = (u16)nData << 8;
+			if (nDataIndex == 0x1F) nImageSize |= (u16)nData;
+			if (nDataIndex >= 0x20 && nDataIndex >= nImageSize && nDataIndex < nImageSize + 4) {
+				nExpectedCRCVal[nDataIndex - nImageSize] = nData;
+			}
+		}
+		DESELECT_CC8531();	//Deselect to end write op
+
+		//Program page
+		nStatus = Bootloader.flashPageProg(0x6000, 0x8000 + nOffset);
+		if (nStatus.nStatus != BL_PROG_DONE) return nStatus;
+	}
+
+	//Verify the flash contents
+	nStatus = Bootloader.flashVerify(nImageSize, nActualCRCVal);
+	for (i=0; i<sizeof(nActualCRCVal); i++) {
+		if (nActualCRCVal[i] != nExpectedCRCVal[i]) {
+			nStatus.nStatus = BL_VERIFY_FAILED;
+		}
+	}
+
+	sysReset(0);
+
+	return nStatus;
+}
 
 //////////////////////////////////////////////////////////
 //Device Info
@@ -434,15 +519,15 @@ StatusWord_t CC8531::flashHex(File dataFile) {
 
 StatusWord_t CC8531Class::InfoClass::getChipInfo(Chip_info_t* chipInfo) {
 //Returns hardware/firmware info
-	u8 nCmd[2] = {0, 0x00,0xB0};
-	cmdReq(0x1F, 2, nCmd);
-	return read(24, chipInfo);
+	u8 nCmd[2] = {0x00, 0xB0};
+	pChip->cmdReq(0x1F, 2, nCmd);
+	return pChip->read(24, (u8*)chipInfo);
 }
 
 StatusWord_t CC8531Class::InfoClass::getDeviceInfo(Device_info_t* devInfo) {
 //Returns unique device ID and manufacturer-specific info
-	cmdReq(0x1E, 0, 0);
-	return read(12, devInfo);
+	pChip->cmdReq(0x1E, 0, 0);
+	return pChip->read(12, (u8*)devInfo);
 }
 
 //////////////////////////////////////////////////////////
@@ -451,70 +536,72 @@ StatusWord_t CC8531Class::InfoClass::getDeviceInfo(Device_info_t* devInfo) {
 
 StatusWord_t CC8531Class::EHIFCtrlClass::confInterruptMask(EHIF_mask_t* evtMask) {
 //Configures EHIF interrupt pin event mask
-	return cmdReq(0x19, 2, evtMask);
+	return pChip->cmdReq(0x19, 2, (u8*)evtMask);
 }
 
 StatusWord_t CC8531Class::EHIFCtrlClass::clearEventFlags(EHIF_flags_t* flags) {
 //Clear EHIF event flags
-	return cmdReq(0x19, 1, flags);
+	return pChip->cmdReq(0x19, 1, (u8*)flags);
 }
 
 //////////////////////////////////////////////////////////
 //Audio Network Control and Status Commands
 //////////////////////////////////////////////////////////
 
-StatusWord_t CC8531Class::NetworkClass::scan(Scan_param_t* scanParam, u8* nDataBuffer) {
+StatusWord_t CC8531Class::NetworkClass::scan(Scan_param_t* scanParam, u8* nDataBuffer, u16* nDataLength) {
 //Used by protocol slaves to perform a scan of the entire band for matching 
-//networks
-	cmdReq(0x08, 16, scanParam);
-	return readBC(nDataBuffer);
+//networks. nDataLength: buffer size in, bytes read out
+	pChip->cmdReq(0x08, 16, (u8*)scanParam);
+	return pChip->readBC(nDataBuffer, nDataLength);
 }
 
 StatusWord_t CC8531Class::NetworkClass::join(Join_param_t* joinParam) {
 //Used by protocol slaves to join a specific network or the first found that
 //matches specified criteria
-	return cmdReq(0x08, 18, joinParam);
+	return pChip->cmdReq(0x08, 18, (u8*)joinParam);
 }
 
 StatusWord_t CC8531Class::NetworkClass::getStatusSlave(u8* nDataBuffer) {
-//Returns status about current audio network status and other network nodes
-	cmdReq(0x0A, 0, NULL);
-	return readBC(nDataBuffer);
+//Returns status about current audio network status and other network nodes. nDataBuffer
+//holds NWM_STATUS_LENGTH bytes
+	u16 nDataLength = NWM_STATUS_LENGTH;
+	pChip->cmdReq(0x0A, 0, NULL);
+	return pChip->readBC(nDataBuffer, &nDataLength);
 }
 
 StatusWord_t CC8531Class::NetworkClass::confAudioChan(Audio_chan_t* audioChan) {
 //Defines mapping of audio channels for slaves
-	return cmdReq(0x0B, 16, audioChan);
+	return pChip->cmdReq(0x0B, 16, (u8*)audioChan);
 }
 
 StatusWord_t CC8531Class::NetworkClass::enableNetworkControl() {
 //Enables formation/maintenance of network (protocol master)
 	u8 nCmd[2] = {0x00, 0x01};
-	return cmdReq(0x0C, 2, nCmd);
+	return pChip->cmdReq(0x0C, 2, nCmd);
 }
 
 StatusWord_t CC8531Class::NetworkClass::disableNetworkControl() {
 //Disables formation/maintenance of network (protocol master)
 	u8 nCmd[2] = {0x00, 0x00};
-	return cmdReq(0x0C, 2, nCmd);
+	return pChip->cmdReq(0x0C, 2, nCmd);
 }
 
 StatusWord_t CC8531Class::NetworkClass::enablePairingSignal() {
 //Master sends pairing signal
 	u8 nCmd[2] = {0x00, 0x01};
-	return cmdReq(0x0D, 2, nCmd);
+	return pChip->cmdReq(0x0D, 2, nCmd);
 }
 
 StatusWord_t CC8531Class::NetworkClass::disablePairingSignal() {
 //Master does not send pairing signal
 	u8 nCmd[2] = {0x00, 0x00};
-	return cmdReq(0x0D, 2, nCmd);
+	return pChip->cmdReq(0x0D, 2, nCmd);
 }
 
 StatusWord_t CC8531Class::NetworkClass::setChanMask(Wireless_chan_mask_t* wirelessChanMask) {
 //Master sets currently used or to be used RF channel mask or to enable/disable radio
 //Selecting 0-5 RF channels suspends network maintenance
-	return cmdReq(0x0E, 4, wirelessChanMask);
+	return pChip->cmdReq(0x0E, 4, (u8*)wirelessChanMask);
 }
 
 //////////////////////////////////////////////////////////
@@ -523,13 +610,13 @@ StatusWord_t CC8531Class::NetworkClass::setChanMask(Wireless_chan_mask_t* wirele
 
 StatusWord_t CC8531Class::RCClass::setData(RC_data_t* RCdata) {
 //Slave communicates pre-defined or custom-defined remote control info to the master
-	return cmdReq(0x2D, 13, RCdata);
+	return pChip->cmdReq(0x2D, 13, (u8*)RCdata);
 }
 
 StatusWord_t CC8531Class::RCClass::getData(RC_data_t* RCdataBuffer, u8* nSlaveID) {
 //Master retreives remote control button/keyboard/mouse data
-	cmdReq(0x2E, 1, nSlaveID);
-	return read(13, RCdataBuffer);
+	pChip->cmdReq(0x2E, 1, nSlaveID);
+	return pChip->read(13, (u8*)RCdataBuffer);
 }
 
 //////////////////////////////////////////////////////////
@@ -538,14 +625,14 @@ StatusWord_t CC8531Class::RCClass::getData(RC_data_t* RCdataBuffer, u8* nSlaveID
 
 StatusWord_t CC8531Class::DSCClass::txData(DSC_tx_data_t* DSCdata, u16 nDataLength, u8* nData) {
 //Queues data for side channel transmission
-	cmdReq(0x04, 5, DSCdata);
-	return write(nDataLength, nData);
+	pChip->cmdReq(0x04, 5, (u8*)DSCdata);
+	return pChip->write(nDataLength, nData);
 }
 
-StatusWord_t CC8531Class::DSCClass::rxData(DSC_rx_data* DSCdata, u16* nDataLength) {
-//Receives data from side channel transmission if available
-	cmdReq(0x05, 0, NULL);
-	return readBC(DSCdata, nDataLength);
+StatusWord_t CC8531Class::DSCClass::rxData(DSC_rx_data_t* DSCdata, u16* nDataLength) {
+//Receives data from side channel transmission if available. nDataLength: buffer size in, bytes read out
+	pChip->cmdReq(0x05, 0, NULL);
+	return pChip->readBC((u8*)DSCdata, nDataLength);
 }
 
 //////////////////////////////////////////////////////////
@@ -554,13 +641,13 @@ StatusWord_t CC8531Class::DSCClass::rxData(DSC_rx_data* DSCdata, u16* nDataLengt
 
 StatusWord_t CC8531Class::PowerClass::setPower(PM_set_state_t* PMstate) {
 //Sets the device power state 
-	return cmdReq(0x1C, 1, PMstate);
+	return pChip->cmdReq(0x1C, 1, (u8*)PMstate);
 }
 
 StatusWord_t CC8531Class::PowerClass::getPower(PM_get_state_t* PMstate) {
 //Returns power management-related info
-	cmdReq(0x1D, 0, NULL);
-	return read(14, PMstate);
+	pChip->cmdReq(0x1D, 0, NULL);
+	return pChip->read(14, (u8*)PMstate);
 }
 
 //////////////////////////////////////////////////////////
@@ -569,14 +656,14 @@ StatusWord_t CC8531Class::PowerClass::getPower(PM_get_state_t* PMstate) {
 
 StatusWord_t CC8531Class::VolumeClass::setVolume(Volume_set_t* VolumeSet) {
 //Configures slave global/remote or local input or output volume
-	return cmdReq(0x17, 4, VolumeSet);
+	return pChip->cmdReq(0x17, 4, (u8*)VolumeSet);
 }
 
 StatusWord_t CC8531Class::VolumeClass::getVolume(Volume_get_t* VolumeGet, Volume_data_t* VolumeData) {
 //Master: Returns slave global/remote or local input or output volume
 //Slave: Returns local input, output volume and other info
-	cmdReq(0x16, 1, VolumeGet);
-	return read(2, VolumeData);
+	pChip->cmdReq(0x16, 1, (u8*)VolumeGet);
+	return pChip->read(2, (u8*)VolumeData);
 }
 
 //////////////////////////////////////////////////////////
@@ -585,14 +672,14 @@ StatusWord_t CC8531Class::VolumeClass::getVolume(Volume_get_t* VolumeGet, Volume
 
 StatusWord_t CC8531Class::StatisticsClass::audioStats(Audio_stat_t* AudioStat, u16* nDataLength) {
 //Requests and returns audio statistics gathered since the last command/chip reset
-	cmdReq(0x11, 0, NULL);
-	return readBC(AudioStat, nDataLength);
+	pChip->cmdReq(0x11, 0, NULL);
+	return pChip->readBC((u8*)AudioStat, nDataLength);
 }
 
 StatusWord_t CC8531Class::StatisticsClass::rfStats(RF_stat_t* RFstat, u16* nDataLength) {
 //Requests and returns RF statistics gathered since the last command/chip reset
-	cmdReq(0x10, 0, NULL);
-	return readBC(RFstat, nDataLength);
+	pChip->cmdReq(0x10, 0, NULL);
+	return pChip->readBC((u8*)RFstat, nDataLength);
 }
 
 //////////////////////////////////////////////////////////
@@ -601,19 +688,19 @@ StatusWord_t CC8531Class::StatisticsClass::rfStats(RF_stat_t* RFstat, u16* nData
 
 StatusWord_t CC8531Class::UtilityClass::getGIO(GIO_data_t* GIOdata) {
 //Polls the current value of I/O pins GIO1 through GIO15
-	cmdReq(0x2A, 0, NULL);
-	return read(4, GIOdata);
+	pChip->cmdReq(0x2A, 0, NULL);
+	return pChip->read(4, (u8*)GIOdata);
 }
 
 StatusWord_t CC8531Class::UtilityClass::getFlash(Flash_param_t* FlashParam, u8* nData) {
 //Reads data from non-volatile storage in the CC8531 internal flash memory
-	cmdReq(0x2B, 1, FlashParam);
-	return read(4, nData);
+	pChip->cmdReq(0x2B, 1, (u8*)FlashParam);
+	return pChip->read(4, nData);
 }
 
 StatusWord_t CC8531Class::UtilityClass::setFlash(Flash_data_t* FlashData) {
 //Writes data to non-volatile storage in the CC8531 internal flash memory
-	return cmdReq(0x2C, 5, FlashData);
+	return pChip->cmdReq(0x2C, 5, (u8*)FlashData);
 }
 
 //////////////////////////////////////////////////////////
@@ -622,39 +709,39 @@ StatusWord_t CC8531Class::UtilityClass::setFlash(Flash_data_t* FlashData) {
 
 StatusWord_t CC8531Class::RFTestClass::txWave(RF_tx_test_t* txTest) {
 //Outputs a continuous wave RF signal at a specified frequency
-	return cmdReq(0x15, 3, txTest);
+	return pChip->cmdReq(0x15, 3, (u8*)txTest);
 }
 
 StatusWord_t CC8531Class::RFTestClass::txRand(RF_tx_test_t* txTest) {
 //Outputs a pseudo-random modulated RF signal at a specified frequency
-	return cmdReq(0x14, 3, txTest);
+	return pChip->cmdReq(0x14, 3, (u8*)txTest);
 }
 
 StatusWord_t CC8531Class::RFTestClass::rxWave(RF_rx_test_t* rxTest) {
 //Enables continuous reception at a specific frequency
-	return cmdReq(0x25, 2, rxTest);
+	return pChip->cmdReq(0x25, 2, (u8*)rxTest);
 }
 
 StatusWord_t CC8531Class::RFTestClass::rxRSSI(u8* FreqOffset, s8* RSSI) {
 //Measures RSSI at a specific frequency
-	cmdReq(0x26, 1, FreqOffset);
-	return read(1, RSSI);
+	pChip->cmdReq(0x26, 1, FreqOffset);
+	return pChip->read(1, (u8*)RSSI);
 }
 
 StatusWord_t CC8531Class::RFTestClass::txError(RF_tx_error_t* txError) {
 //Runs transmitter side of packet error rate test
-	return cmdReq(0x13, 8, txError);
+	return pChip->cmdReq(0x13, 8, (u8*)txError);
 }
 
 StatusWord_t CC8531Class::RFTestClass::rxError(RF_rx_error_param_t* rxError, RF_rx_error_data_t* rxData) {
 //Runs receiver side of the packet error rate test
-	cmdReq(0x12, 11, rxError);
-	return read(244, rxData);
+	pChip->cmdReq(0x12, 11, (u8*)rxError);
+	return pChip->read(244, (u8*)rxData);
 }
 
 StatusWord_t CC8531Class::RFTestClass::networkSim(Network_sim_t* nwkSim) {
 //Simulates the RF behavior of a master/slave without establishing a network
-	return cmdReq(0x27, 14, nwkSim);
+	return pChip->cmdReq(0x27, 14, (u8*)nwkSim);
 }
 
 //////////////////////////////////////////////////////////
@@ -663,13 +750,13 @@ StatusWord_t CC8531Class::RFTestClass::networkSim(Network_sim_t* nwkSim) {
 
 StatusWord_t CC8531Class::AudioTestClass::genTone(Audio_tone_t* audioTone) {
 //Enables/disables tone generation on a specific audio channel
-	return cmdReq(0x20, 5, audioTone);
+	return pChip->cmdReq(0x20, 5, (u8*)audioTone);
 }
 
 StatusWord_t CC8531Class::AudioTestClass::detectTone(u8* nChannel, Audio_det_t* detTone) {
 //Estimates amplitude and frequency of the specified audio channel
-	cmdReq(0x21, 1, nChannel);
-	return read(4, detTone);
+	pChip->cmdReq(0x21, 1, nChannel);
+	return pChip->read(4, (u8*)detTone);
 }
 
 //////////////////////////////////////////////////////////
@@ -678,11 +765,11 @@ StatusWord_t CC8531Class::AudioTestClass::detectTone(u8* nChannel, Audio_det_t*
 
 StatusWord_t CC8531Class::IOTestClass::input(IOTest_param_t* IOparam, IOTest_data_t* IOdata) {
 //Selected pins are configured as input and their logical value is returned
-	cmdReq(0x22, 4, IOparam);
-	return read(4, IOdata);
+	pChip->cmdReq(0x22, 4, (u8*)IOparam);
+	return pChip->read(4, (u8*)IOdata);
 }
 
 StatusWord_t CC8531Class::IOTestClass::output(IOTest_output_t* IOoutput) {
 //Selected pins are configured as output and driven to the logical value in x_VAL
-	cmdReq(0x23, 8, IOoutput);
+	return pChip->cmdReq(0x23, 8, (u8*)IOoutput);
 }
\ No newline at end of file
@@ -89,7 +89,7 @@ typedef struct {
 
 	u32 FW_IMAGE_SIZE:32;	//Size of firmware image in bytes
 	u16 CHIP_ID:16;		//ID of silicon device
-	u16 CHIP_CAPS:16	//Chip capabilities
+	u16 CHIP_CAPS:16;	//Chip capabilities
 } Chip_info_t;
 
 //Device Info
@@ -199,6 +199,9 @@ typedef struct {
 	u32 PROD_ID_REF:32;
 } Join_param_t;
 
+//Bytes getStatusSlave() reads at most, the size of the buffer it is given
+#define NWM_STATUS_LENGTH 32
+
 //Status Results - Slave
 typedef struct {
 	u32 DEVICE_ID:32;	//Network ID of current network (0 = no network)
@@ -295,6 +298,10 @@ typedef struct {
 } Audio_chan_t;
 
 //RF Channel Mask
+#define RF_NUM_CHANNELS 18
+#define RF_MIN_CHANNELS 6	//Fewer enabled channels suspend network maintenance
+#define RF_NUM_USAGE 20	//PS_RF_STATS channel usage counters, indexed by RF channel number
+
 typedef struct {
 	u32:1;
 	u32 RF_CH_MASK:18;	//Enabled (1) or disabled (0) RF channels 1-18
@@ -331,14 +338,22 @@ typedef struct {
 	u32 ADDR:32;	//32b device ID of datagram destination
 } DSC_tx_data_t;
 
-//Data Side Channel  Params (rx)
+//Largest data side channel datagram the host sends or accepts, in bytes
+#ifndef DSC_DATAGRAM_MAX
+#define DSC_DATAGRAM_MAX 32
+#endif
+
+//Data Side Channel Data (rx), as read back by DSC_RX_DATAGRAM
 typedef struct {
-	DSC_data_T DSCdata;
-	u8* data;
-} DSC_rx_data_t
+	u8 CONN_RESET:1;	//Set in the first datagram after the sender reset/opened the connection
+	u8:7;
+	u32 ADDR:32;	//32b device ID of datagram source
+	u8 LENGTH;		//Number of bytes in DATA
+	u8 DATA[DSC_DATAGRAM_MAX];
+} DSC_rx_data_t;
 
 //Power Management Set State
-typedef PM_set_state_t u8;	//6,7 Reserved, 5 active, 4 low power, 3 local standby
+typedef u8 PM_set_state_t;	//6,7 Reserved, 5 active, 4 low power, 3 local standby
 							//2 network standby, 1 Reserved, 0 off
 
 //Power Management Get State
@@ -347,7 +362,7 @@ typedef struct {
 	u32 OUT_SILENCE_TIME;	//Time with digital silence on all local output channels (x10ms)
 	u32 NWK_INACTIVITY_TIME;	//Time without any network connections (x10ms)
 	u16 VBAT_VOLTAGE;	//Last measured battery voltage (mV)
-} PM_state_get_t;
+} PM_get_state_t;
 
 //Volume Set 
 typedef struct {
@@ -368,7 +383,7 @@ typedef union {
 		u8:6;
 	} MASTER;
 	struct {
-		u8 IS_CHANNEL OFFSET:1;	//0 Volume setting, 1 Mono/logical channel offset
+		u8 IS_CHANNEL_OFFSET:1;	//0 Volume setting, 1 Mono/logical channel offset
 		u8 IS_IN_VOL:1;	//0 Output vol, 1 Input vol
 		u8 LOG_CHANNEL:4;	//Logical channel
 		u8:2;
@@ -376,7 +391,7 @@ typedef union {
 } Volume_get_t;
 
 //Volume Data
-typedef Volume_data_t s16;	//Volume (x0.125dB)
+typedef s16 Volume_data_t;	//Volume (x0.125dB)
 
 //Audio Statistics Data
 typedef struct {
@@ -405,7 +420,7 @@ typedef struct {
 	u8 NWK_JOIN_COUNT;	//S:#successful network joins, M:#successful slave joins
 	u8 NWK_DROP_COUNT;	//S:#network drops, M:#slave drops
 	u16 AFH_SWAP_COUNT;	//S:N/A, M:#times adaptive frequency hopping swapped out an active channel
-	u16* AFH_CH_USAGE;	//Number of times RF channel is used
+	u16 AFH_CH_USAGE[RF_NUM_USAGE];	//Number of times RF channel is used, [n] is channel n
 } RF_stat_t;
 
 //GIO Data
@@ -635,41 +650,50 @@ private:
 	StatusWord_t write(u16, u8*);
 	StatusWord_t read(u16, u8*);
 	StatusWord_t readBC(u8*, u16*);
-	StatusWord_t getStatus();
 	void sysReset(u8);
 	void bootReset();
 	u8 hexVal(u8);
 	u8 readByte(File);
 	u16 readInt(File);
+
+	//Base of the command groups below, which reach the chip through the object that owns them
+	class CommandGroup {
+	protected:
+		CC8531Class* pChip;
+		friend class CC8531Class;
+	};
 public:
+	CC8531Class();
 	void begin();
 	StatusWord_t flashProgram(u8*);
 	StatusWord_t flashHex(File);
+	StatusWord_t flashFile(File, u16);
 	u8 getWaitReadyError();
+	StatusWord_t getStatus();
 
-	class BootloaderClass {
+	class BootloaderClass : public CommandGroup {
 	public:
 		StatusWord_t unlock();
 		StatusWord_t flashMassErase();
-		StatusWord_t flashPageProg(u16, u16*);
+		StatusWord_t flashPageProg(u16, u16);
 		StatusWord_t flashVerify(u16, u8*);
 	} Bootloader;
 
-	class InfoClass {
+	class InfoClass : public CommandGroup {
 	public:
 		StatusWord_t getChipInfo(Chip_info_t*);
 		StatusWord_t getDeviceInfo(Device_info_t*);
 	} Info;
 
-	class EHIFCtrlClass {
+	class EHIFCtrlClass : public CommandGroup {
 	public:
 		StatusWord_t confInterruptMask(EHIF_mask_t*);
 		StatusWord_t clearEventFlags(EHIF_flags_t*);
 	} EHIFCtrl;
 
-	class NetworkClass {
+	class NetworkClass : public CommandGroup {
 	public:
-		StatusWord_t scan(Scan_param_t*, u8*);
+		StatusWord_t scan(Scan_param_t*, u8*, u16*);
 		StatusWord_t join(Join_param_t*);
 		StatusWord_t getStatusSlave(u8*);
 		StatusWord_t confAudioChan(Audio_chan_t*);
@@ -680,44 +704,44 @@ public:
 		StatusWord_t setChanMask(Wireless_chan_mask_t*);
 	} Network;
 
-	class RCClass {
+	class RCClass : public CommandGroup {
 	public:
 		StatusWord_t setData(RC_data_t*);
 		StatusWord_t getData(RC_data_t*, u8*);
 	} RC;
 
-	class DSCClass {
+	class DSCClass : public CommandGroup {
 	public:
 		StatusWord_t txData(DSC_tx_data_t*, u16, u8*);
-		StatusWord_t rxData(DSC_rx_data_t*, u16*;
+		StatusWord_t rxData(DSC_rx_data_t*, u16*);
 	} DSC;
 
-	class PowerClass {
+	class PowerClass : public CommandGroup {
 	public:
 		StatusWord_t setPower(PM_set_state_t*);
-		StatusWord_t getPower(PM_state_get_t*);
+		StatusWord_t getPower(PM_get_state_t*);
 	} Power;
 
-	class VolumeClass {
+	class VolumeClass : public CommandGroup {
 	public:
 		StatusWord_t setVolume(Volume_set_t*);
 		StatusWord_t getVolume(Volume_get_t*, Volume_data_t*);
 	} Volume;
 
-	class StatisticsClass {
+	class StatisticsClass : public CommandGroup {
 	public:
 		StatusWord_t audioStats(Audio_stat_t*, u16*);
 		StatusWord_t rfStats(RF_stat_t*, u16*);
 	} Statistics;
 
-	class UtilityClass {
+	class UtilityClass : public CommandGroup {
 	public:
 		StatusWord_t getGIO(GIO_data_t*);
 		StatusWord_t getFlash(Flash_param_t*, u8*);
 		StatusWord_t setFlash(Flash_data_t*);
 	} Utility;
 
-	class RFTestClass {
+	class RFTestClass : public CommandGroup {
 	public:
 		StatusWord_t txWave(RF_tx_test_t*);
 		StatusWord_t txRand(RF_tx_test_t*);
@@ -728,13 +752,13 @@ public:
 		StatusWord_t networkSim(Network_sim_t*);	
 	} RFTest;
 
-	class AudioTestClass {
+	class AudioTestClass : public CommandGroup {
 	public:
 		StatusWord_t genTone(Audio_tone_t*);
 		StatusWord_t detectTone(u8*, Audio_det_t*);
 	} AudioTest;
 
-	class IOTestClass {
+	class IOTestClass : public CommandGroup {
 	public:
 		StatusWord_t input(IOTest_param_t*, IOTest_data_t*);
 		StatusWord_t output(IOTest_output_t*);
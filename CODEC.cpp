@@ -2,7 +2,22 @@
 
 CODECClass CODEC;
 
-#define PAGE_SELECT(x) write(0x00, x)
+u8 CODECClass::shadow[CODEC_SHADOW_PAGES][CODEC_NUM_REGS];
+u8 CODECClass::valid[CODEC_SHADOW_PAGES][CODEC_NUM_REGS / 8];
+u8 CODECClass::dirty[CODEC_SHADOW_PAGES][CODEC_NUM_REGS / 8];
+u8 CODECClass::nPage = CODEC_PAGE_UNKNOWN;
+u8 CODECClass::nWorkPage = 0;
+u32 CODECClass::nTransactions = 0;
+u32 CODECClass::nSaved = 0;
+s8 CODECClass::nDriverVolume = 0;
+s8 CODECClass::nDriverTarget = 0;
+
+//Only sets the page that following writes refer to, the codec sees it on the next flush
+#define PAGE_SELECT(x) usePage(x)
+
+#define BIT_IS_SET(a, n) ((a)[(n) >> 3] & (1 << ((n) & 0x07)))
+#define BIT_SET(a, n) ((a)[(n) >> 3] |= (1 << ((n) & 0x07)))
+#define BIT_CLEAR(a, n) ((a)[(n) >> 3] &= ~(1 << ((n) & 0x07)))
 
 void CODECClass::begin() {
 	SPI.setBitOrder(MSBFIRST);	//MSB first
@@ -19,40 +34,176 @@ void CODECClass::off() {
 	digitalWrite(RESET_CODEC, HIGH);
 }
 
+//////////////////////////////////////////////////////////
+//Register shadow
+//////////////////////////////////////////////////////////
+
+void CODECClass::invalidate() {
+//After a reset nothing is known about the registers, and the codec is on page 0
+	memset(valid, 0, sizeof(valid));
+	memset(dirty, 0, sizeof(dirty));
+	nPage = 0;
+	return;
+}
+
+void CODECClass::selectPage(u8 nNewPage) {
+//Writes the page register, unless the codec is already on that page
+	if (nNewPage == nPage) {
+		nSaved++;	//Page select skipped
+		return;
+	}
+	SELECT_CODEC();
+	SPI.transfer(0x00);	//Page select is register 0 on every page
+	SPI.transfer(nNewPage);
+	DESELECT_CODEC();
+	nTransactions++;
+	nPage = nNewPage;
+	return;
+}
+
+void CODECClass::usePage(u8 nNewPage) {
+//Writes queued for the old page go out first, so the order between pages is kept
+	if (nNewPage != nWorkPage) flush();
+	nWorkPage = nNewPage;
+	return;
+}
+
+void CODECClass::flush() {
+//Sends every dirty register, contiguous ones in a single auto-increment burst.
+//Within a page the registers go out in address order, call flush() where order matters
+	u8 nShadowPage;
+	u8 nAddress;
+	u8 nEnd;
+
+	for (nShadowPage = 0; nShadowPage < CODEC_SHADOW_PAGES; nShadowPage++) {
+		nAddress = 1;
+		while (nAddress < CODEC_NUM_REGS) {
+			if (!BIT_IS_SET(dirty[nShadowPage], nAddress)) {
+				nAddress++;
+				continue;
+			}
+
+			selectPage(nShadowPage);
+
+			SELECT_CODEC();
+			SPI.transfer(nAddress << 1);	//7-bit address, LSB is 0
+			for (nEnd = nAddress; nEnd < CODEC_NUM_REGS && BIT_IS_SET(dirty[nShadowPage], nEnd); nEnd++) {
+				SPI.transfer(shadow[nShadowPage][nEnd]);
+				BIT_CLEAR(dirty[nShadowPage], nEnd);
+			}
+			DESELECT_CODEC();
+
+			nTransactions++;
+			nSaved += nEnd - nAddress - 1;	//One chip select for the whole run
+			nAddress = nEnd;
+		}
+	}
+	return;
+}
+
 void CODECClass::write(u8 nAddress, u8 nData) {
+//Queues a register write on the working page. Writing the value a register already holds costs nothing
+	if (nWorkPage >= CODEC_SHADOW_PAGES) {
+		writeBlock(nAddress, &nData, 1);
+		return;
+	}
+	if (BIT_IS_SET(valid[nWorkPage], nAddress) && shadow[nWorkPage][nAddress] == nData) {
+		if (!BIT_IS_SET(dirty[nWorkPage], nAddress)) nSaved++;
+		return;
+	}
+	if (BIT_IS_SET(dirty[nWorkPage], nAddress)) nSaved++;	//Overwritten before it was sent
+	shadow[nWorkPage][nAddress] = nData;
+	BIT_SET(valid[nWorkPage], nAddress);
+	BIT_SET(dirty[nWorkPage], nAddress);
+	return;
+}
+
+void CODECClass::writeBlock(u8 nAddress, const u8* pData, u8 nLength) {
+//Writes consecutive registers. Pages without a shadow get one burst right away
+	u8 i;
+
+	if (nWorkPage < CODEC_SHADOW_PAGES) {
+		for (i = 0; i < nLength; i++) write(nAddress + i, pData[i]);
+		return;
+	}
+
+	flush();
+	selectPage(nWorkPage);
 	SELECT_CODEC();
-	// 7-bit address, LSB is 0
-	SPI.transfer((nAddress << 1) & (~0x01));
-	SPI.transfer(nData);
+	SPI.transfer(nAddress << 1);	//7-bit address, LSB is 0
+	for (i = 0; i < nLength; i++) SPI.transfer(pData[i]);
 	DESELECT_CODEC();
+	nTransactions++;
+	nSaved += nLength - 1;
 	return;
 }
 
 u8 CODECClass::read(u8 nAddress) {
+//Answers from the shadow when it can, pending writes are part of the answer
 	u8 nData;
+
+	if (nWorkPage < CODEC_SHADOW_PAGES && BIT_IS_SET(valid[nWorkPage], nAddress)) {
+		nSaved++;
+		return shadow[nWorkPage][nAddress];
+	}
+
+	selectPage(nWorkPage);
 	SELECT_CODEC();
 	//7-bit address, LSB is 1
 	SPI.transfer((nAddress << 1) | 0x01);
 	nData = SPI.transfer(0x00);	
 	DESELECT_CODEC();
+	nTransactions++;
+
+	if (nWorkPage < CODEC_SHADOW_PAGES) {
+		shadow[nWorkPage][nAddress] = nData;
+		BIT_SET(valid[nWorkPage], nAddress);
+	}
 	return nData;
 }
 
+u32 CODECClass::getTransactions() {
+//SPI transactions sent since power up
+	return nTransactions;
+}
+
+u32 CODECClass::getSavedTransactions() {
+//SPI transactions the shadow made unnecessary: repeated writes and page selects, reads and burst bytes
+	return nSaved;
+}
+
+//////////////////////////////////////////////////////////
+//Control
+//////////////////////////////////////////////////////////
+
 void CODECClass::hardReset() {
 	digitalWrite(RESET_CODEC, LOW);
 	delayMicroseconds(1);
 	digitalWrite(RESET_CODEC, HIGH);
 	delay(2);
+	invalidate();
 	return;
 }
 
 void CODECClass::softReset() {
 	PAGE_SELECT(0x00);
-	write(0x01, 0x01);
+	flush();
+	selectPage(0x00);
+	SELECT_CODEC();
+	SPI.transfer(0x01 << 1);
+	SPI.transfer(0x01);	//Self-clearing software reset
+	DESELECT_CODEC();
+	nTransactions++;
+	invalidate();
 	return;
 }
 
 void CODECClass::configure() {
+	//1Hz high pass filter coefficients, 24 bit
+	static const u8 coeffN0[3] = {0x7F, 0xFF, 0x00};
+	static const u8 coeffN1[3] = {0x80, 0x01, 0x00};
+	static const u8 coeffD1[3] = {0x7F, 0xFC, 0x00};
+
 	hardReset();
 	PAGE_SELECT(0x00);
 	softReset();
@@ -95,31 +246,18 @@ void CODECClass::configure() {
 	write(0x36, 0xC0);	//CM -> MICPGA L-, 40k
 	write(0x37, 0xC0);	//IN1R -> MICPGA R+, 40k
 	write(0x39, 0xC0);	//CM -> MICPGA R-, 40k
-	
+
 	//1Hz filter L
 	PAGE_SELECT(0x08);
-	write(0x18, 0x7F);
-	write(0x19, 0xFF);
-	write(0x1A, 0x00);
-	write(0x1C, 0x80);
-	write(0x1D, 0x01);
-	write(0x1E, 0x00);
-	write(0x20, 0x7F);
-	write(0x21, 0xFC);
-	write(0x22, 0x00);
+	writeBlock(0x18, coeffN0, 3);
+	writeBlock(0x1C, coeffN1, 3);
+	writeBlock(0x20, coeffD1, 3);
 
 	//1Hz filter R
 	PAGE_SELECT(0x09);
-	write(0x20, 0x7F);
-	write(0x21, 0xFF);
-	write(0x22, 0x00);
-	write(0x24, 0x80);
-	write(0x25, 0x01);
-	write(0x26, 0x00);
-	write(0x28, 0x7F);
-	write(0x29, 0xFC);
-	write(0x2A, 0x00);
-
+	writeBlock(0x20, coeffN0, 3);
+	writeBlock(0x24, coeffN1, 3);
+	writeBlock(0x28, coeffD1, 3);
 	return;
 }
 
@@ -127,8 +265,9 @@ void CODECClass::lineOutOn() {
 	u8 nReg;
 	PAGE_SELECT(0x01);
 	nReg = read(0x09);	//Read output driver register
-	write(0x12, 0x00);	//Unmute left line out
-	write(0x13, 0x00);	//Unmute right line out
+	write(0x12, nDriverVolume & 0x3F);	//Unmute left line out at the driver gain it had
+	write(0x13, nDriverVolume & 0x3F);	//Unmute right line out
+	flush();
 	write(0x09, nReg | 0x0C);	//Power on line out
 	DACOn();
 	return;
@@ -140,6 +279,7 @@ void CODECClass::lineOutOff() {
 	nReg = read(0x09);
 	write(0x12, 0x40);	//Mute left line out
 	write(0x13, 0x40);	//Mute right line out
+	flush();
 	write(0x09, nReg & 0xF3);	//Power off line out
 	DACOff();
 	return;
@@ -149,8 +289,9 @@ void CODECClass::headphoneOn() {
 	u8 nReg;
 	PAGE_SELECT(0x01);
 	nReg = read(0x09);	//Read output driver register
-	write(0x10, 0x00);	//Unmute left headphone
-	write(0x11, 0x00);	//Unmute right headphone
+	write(0x10, nDriverVolume & 0x3F);	//Unmute left headphone at the driver gain it had
+	write(0x11, nDriverVolume & 0x3F);	//Unmute right headphone
+	flush();
 	write(0x09, nReg | 0x30);	//Power on headphone
 	DACOn();
 	return;
@@ -162,6 +303,7 @@ void CODECClass::headphoneOff() {
 	nReg = read(0x09);
 	write(0x10, 0x40);	//Mute left headphone
 	write(0x11, 0x40);	//Mute right headphone
+	flush();
 	write(0x09, nReg & 0xCF);	//Power off headphone
 	DACOff();
 	return;
@@ -171,6 +313,7 @@ void CODECClass::feedthroughOn() {
 	PAGE_SELECT(0x01);
 	write(0x0C, 0x04);	//IN1L -> HPL
 	write(0x0D, 0x04);	//IN1R -> HPR
+	flush();
 	return;
 }
 
@@ -178,6 +321,7 @@ void CODECClass::feedthroughOff() {
 	PAGE_SELECT(0x01);	
 	write(0x0C, 0x08);	//Left DAC -> HPL
 	write(0x0D, 0x08);	//Right DAC -> HPR
+	flush();
 	return;
 }
 
@@ -189,31 +333,38 @@ void CODECClass::setFeedthroughVolume(s8 nDBTimesTwo) {
 	nDBTimesTwo &= 0x7F;
 	write(0x22, nDBTimesTwo);
 	write(0x23, nDBTimesTwo);
+	flush();
 }
 
 void CODECClass::ADCOn() {
 	PAGE_SELECT(0x00);
 	write(0x52, 0x00);	//Unmutes left and right ADC
+	flush();
 	write(0x51, 0xC0);	//Powers on ADC
+	flush();
 	return;
 }
 
 void CODECClass::ADCOff() {
 	PAGE_SELECT(0x00);
 	write(0x52, 0x88);	//Mutes left and right ADC
+	flush();
 	write(0x51, 0x00);	//Powers off ADC
+	flush();
 	return;
 }
 
 void CODECClass::DACOn() {
 	PAGE_SELECT(0x00);
-	write(0x3F, 0xD6);	//Powers on DAC
+	write(0x3F, 0xD4);	//Powers on DAC, volume changes soft-step one step per sample
+	flush();
 	return;
 }
 
 void CODECClass::DACOff() {
 	PAGE_SELECT(0x00);
 	write(0x3F, 0x00);	//Powers off DAC
+	flush();
 }
 
 void CODECClass::setDACVolume(s8 nDBTimesTwo) {
@@ -222,12 +373,15 @@ void CODECClass::setDACVolume(s8 nDBTimesTwo) {
 	PAGE_SELECT(0x00);
 	write(0x41, nDBTimesTwo);
 	write(0x42, nDBTimesTwo);
+	flush();
 	return;
 }
 
 void CODECClass::setDriverVolume(s8 nDB) {
-	if (nDB > 29) nDB = 29;	//Between +29 and -6 dB
-	if (nDB < -6) nDB = -6;
+	if (nDB > CODEC_DRIVER_MAX_DB) nDB = CODEC_DRIVER_MAX_DB;	//Between +29 and -6 dB
+	if (nDB < CODEC_DRIVER_MIN_DB) nDB = CODEC_DRIVER_MIN_DB;
+	nDriverVolume = nDB;
+	nDriverTarget = nDB;
 	if (nDB < 0) nDB &= 0x3F;	//translate s8 --> s6
 	nDB &= 0x7F;	// Ensure not muted
 	PAGE_SELECT(0x01);
@@ -236,9 +390,30 @@ void CODECClass::setDriverVolume(s8 nDB) {
 
 	write(0x10, nDB);	//Set headphone volume
 	write(0x11, nDB);
+	flush();	//Registers 0x10-0x13, one burst
+	return;
+}
+
+void CODECClass::rampDriverVolume(s8 nDB) {
+//Sets the gain volumeTick() moves to. Only the target changes, so presses faster than the ramp add up
+	if (nDB > CODEC_DRIVER_MAX_DB) nDB = CODEC_DRIVER_MAX_DB;
+	if (nDB < CODEC_DRIVER_MIN_DB) nDB = CODEC_DRIVER_MIN_DB;
+	nDriverTarget = nDB;
 	return;
 }
 
+u8 CODECClass::volumeTick() {
+//Call every CODEC_VOLUME_TICK_MS. The driver gain has no soft-stepping of its own, so it moves
+//1 dB per tick, one SPI transaction each. Returns 1 while the ramp is running
+	s8 nTarget = nDriverTarget;
+
+	if (nDriverVolume == nTarget) return 0;
+
+	setDriverVolume(nDriverVolume + ((nTarget > nDriverVolume) ? 1 : -1));
+	nDriverTarget = nTarget;
+	return 1;
+}
+
 void CODECClass::setADCVolume(s8 nDBTimesTwo) {
 	if (nDBTimesTwo > 40) nDBTimesTwo = 40;	//Between +40 and -24 dB
 	if (nDBTimesTwo < -24) nDBTimesTwo = -24;	// --> +20 to -12dB
@@ -246,6 +421,7 @@ void CODECClass::setADCVolume(s8 nDBTimesTwo) {
 	nDBTimesTwo &= 0x7F;
 	write(0x41, nDBTimesTwo);
 	write(0x42, nDBTimesTwo);
+	flush();
 	return;
 }
 
@@ -256,5 +432,6 @@ void CODECClass::setMICPGAVolume(s8 nDBTimesTwo) {
 	nDBTimesTwo &= 0x7F;
 	write(0x3B, nDBTimesTwo);
 	write(0x3C, nDBTimesTwo);
+	flush();
 	return;
 }
@@ -17,12 +17,39 @@
 #define SELECT_CODEC() digitalWrite(SS_CODEC, LOW)
 #define DESELECT_CODEC() digitalWrite(SS_CODEC, HIGH)
 
+//Register shadow: pages 0 and 1 hold all the control registers. Other pages
+//(filter coefficients) are written through without being remembered
+#define CODEC_SHADOW_PAGES 2
+#define CODEC_NUM_REGS 128
+#define CODEC_PAGE_UNKNOWN 0xFF
+
+//Output driver gain range in dB, and the ramp run by volumeTick()
+#define CODEC_DRIVER_MIN_DB -6
+#define CODEC_DRIVER_MAX_DB 29
+#define CODEC_VOLUME_TICK_MS 10
+
 class CODECClass {
 private:
+	static u8 shadow[CODEC_SHADOW_PAGES][CODEC_NUM_REGS];
+	static u8 valid[CODEC_SHADOW_PAGES][CODEC_NUM_REGS / 8];
+	static u8 dirty[CODEC_SHADOW_PAGES][CODEC_NUM_REGS / 8];
+	static u8 nPage;	//Page selected in the codec
+	static u8 nWorkPage;	//Page that write() and read() refer to
+	static u32 nTransactions;
+	static u32 nSaved;
+	static s8 nDriverVolume;	//Output driver gain the codec has, dB
+	static s8 nDriverTarget;	//Gain volumeTick() is ramping to
+
+	static void usePage(u8);
+	static void selectPage(u8);
+	static void invalidate();
+	static void flush();
 	static void write(u8, u8);
+	static void writeBlock(u8, const u8*, u8);
 	static u8 read(u8);
 public:	
 	static void on();
+	static void off();
 	static void begin();
 
 	static void hardReset();
@@ -38,7 +65,7 @@ public:
 
 	static void feedthroughOn();
 	static void feedthroughOff();
-	static void setFeedthroughVolume();
+	static void setFeedthroughVolume(s8);
 
 	static void ADCOn();
 	static void ADCOff();
@@ -48,8 +75,13 @@ public:
 
 	static void setDACVolume(s8);
 	static void setDriverVolume(s8);
+	static void rampDriverVolume(s8);
+	static u8 volumeTick();
 	static void setADCVolume(s8);
 	static void setMICPGAVolume(s8);
+
+	static u32 getTransactions();
+	static u32 getSavedTransactions();
 };
 
 extern CODECClass CODEC;
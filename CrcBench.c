@@ -0,0 +1,119 @@
+// Times the AT42QT1110 CRC-8 of the UC3A3 touch driver (AT42QT1110_calc_crc in AT42QT1110.c) against
+// the bit-serial loop it replaced, on a PC, after checking both agree for every CRC and byte value.
+// Build with -DAT42QT1110_CRC_NIBBLE_TABLE=1 to time the 16 byte table instead of the 256 byte one.
+// Host times say nothing about the UC3A3, where either fits the 150us byte spacing.
+// Build: gcc -O2 -IHostSim/UC3A3 -IWirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src -o CrcBench CrcBench.c WirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src/AT42QT1110.c
+// Usage: ./CrcBench [bytes to time] (exit status 1 if the table and the loop disagree)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "compiler.h"
+#include "spi_master.h"
+#include "delay.h"
+#include "task_SPI.h"
+#include "AT42QT1110.h"
+
+#define BUFFER_BYTES 4096
+
+// What AT42QT1110.c needs from the rest of the firmware, the bench never talks to the device
+volatile avr32_spi_t AVR32_SPI0;
+volatile avr32_spi_t AVR32_SPI1;
+struct spi_device spi_device_touch;
+
+void spi_select_device(volatile avr32_spi_t *spi, struct spi_device *device) {
+}
+
+void spi_deselect_device(volatile avr32_spi_t *spi, struct spi_device *device) {
+}
+
+void spi_write_single(volatile avr32_spi_t *spi, uint8_t data) {
+}
+
+void spi_read_single(volatile avr32_spi_t *spi, uint8_t *data) {
+	*data = 0;
+}
+
+bool spi_is_rx_full(volatile avr32_spi_t *spi) {
+	return true;
+}
+
+void delay_us(uint32_t us) {
+}
+
+// The CRC as the AT42QT1110 datasheet gives it: X^8+X^5+X^4+1, LSB first
+uint8_t crc_bit_serial(uint8_t crc, const uint8_t *data, uint8_t length) {
+	uint8_t byte;
+	uint8_t fb;
+	uint8_t i;
+
+	while (length--) {
+		byte = *data++;
+		for (i = 0; i < 8; i++) {
+			fb = (crc ^ byte) & 1;
+			byte >>= 1;
+			crc >>= 1;
+			if (fb) crc ^= 0x8C;
+		}
+	}
+
+	return crc;
+}
+
+double now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Runs crc over the buffer until bytes have gone through, printing the time per byte
+uint8_t time_crc(const char *name, uint8_t (*crc)(uint8_t, const uint8_t *, uint8_t), const uint8_t *buffer, long bytes) {
+	uint8_t result = 0;
+	double start;
+	long done;
+	uint32_t i;
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned long long tsc = __rdtsc();
+#endif
+
+	start = now_ns();
+	for (done = 0; done < bytes; done += BUFFER_BYTES) {
+		// Reports are short, so the CRC is run 64 bytes at a time like a burst of them
+		for (i = 0; i < BUFFER_BYTES; i += 64) result = crc(result, &buffer[i], 64);
+	}
+	printf("%-12s %6.2f ns/byte", name, (now_ns() - start) / done);
+#if defined(__x86_64__) || defined(__i386__)
+	printf(", %6.2f TSC cycles/byte", (double)(__rdtsc() - tsc) / done);
+#endif
+	printf(" (%02X)\n", result);
+
+	return result;
+}
+
+int main(int argc, char **argv) {
+	long bytes = (argc > 1) ? atol(argv[1]) : 64L * 1024 * 1024;
+	uint8_t buffer[BUFFER_BYTES];
+	uint32_t bad = 0;
+	uint8_t byte;
+	uint32_t c, b;
+
+	for (c = 0; c < 256; c++) {
+		for (b = 0; b < 256; b++) {
+			byte = b;
+			if (AT42QT1110_calc_crc(c, &byte, 1) != crc_bit_serial(c, &byte, 1)) bad++;
+		}
+	}
+	printf("%s table: %u of 65536 CRC and byte values differ from the bit-serial loop\n",
+		AT42QT1110_CRC_NIBBLE_TABLE ? "16 byte" : "256 byte", bad);
+
+	srand(1);
+	for (c = 0; c < BUFFER_BYTES; c++) buffer[c] = rand();
+
+	if (time_crc("table", AT42QT1110_calc_crc, buffer, bytes) != time_crc("bit-serial", crc_bit_serial, buffer, bytes)) bad++;
+
+	return bad ? 1 : 0;
+}
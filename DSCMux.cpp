@@ -0,0 +1,104 @@
+#include "WProgram.h"
+#include "DSCMux.h"
+
+DSCMuxClass DSCMux;
+
+u8 DSCMuxClass::count;
+u8 DSCMuxClass::types[DSCM_MAX_TYPES];
+DSCM_handler_t DSCMuxClass::handlers[DSCM_MAX_TYPES];
+DSC_rx_data_t DSCMuxClass::rx;
+DSCM_stats_t DSCMuxClass::stats;
+
+void DSCMuxClass::setMask(EHIF_mask_t* pMask) {
+//Adds the DSC events to the caller's interrupt mask
+	pMask->MSK_DSC_RESET = 1;
+	pMask->MSK_DSC_TX_AVAIL = 1;
+	pMask->MSK_DSC_RX_AVAIL = 1;
+	CC8531.EHIFCtrl.confInterruptMask(pMask);
+}
+
+u8 DSCMuxClass::attach(u8 nType, DSCM_handler_t pHandler) {
+//Hands received datagrams of type nType to pHandler, replacing the handler it had. Returns 0 if
+//all DSCM_MAX_TYPES entries are taken
+	u8 i;
+
+	for (i=0; i<count; i++) {
+		if (types[i] == nType) {
+			handlers[i] = pHandler;
+			return 1;
+		}
+	}
+	if (count >= DSCM_MAX_TYPES) return 0;
+
+	types[count] = nType;
+	handlers[count] = pHandler;
+	count++;
+	return 1;
+}
+
+void DSCMuxClass::detach(u8 nType) {
+//Drops datagrams of type nType from now on
+	u8 i;
+
+	for (i=0; i<count; i++) {
+		if (types[i] == nType) {
+			count--;
+			types[i] = types[count];
+			handlers[i] = handlers[count];
+			return;
+		}
+	}
+}
+
+StatusWord_t DSCMuxClass::service(StatusWord_t nStatus) {
+//Clears a data side channel reset and hands every waiting datagram to the handler of its type.
+//Returns the status word after that, for the caller's transmit decisions
+	EHIF_flags_t flags;
+	u16 nLength;
+	u8 i;
+
+	if (nStatus.B.EVT_DSC_RESET) {
+		memset(&flags, 0, sizeof(flags));
+		flags.MSK_DSC_RESET = 1;
+		CC8531.EHIFCtrl.clearEventFlags(&flags);
+		stats.resets++;
+		nStatus = CC8531.getStatus();
+	}
+
+	while (nStatus.B.EVT_DSC_RX_AVAIL) {
+		nLength = sizeof(DSC_rx_data_t);
+		CC8531.DSC.rxData(&rx, &nLength);
+
+		//A status word from before another protocol's pass may still flag datagrams already read
+		if (nLength < 6 + 1 || rx.LENGTH < 1 || rx.LENGTH > DSC_DATAGRAM_MAX) {
+			if (nLength) stats.unknown++;
+			nStatus = CC8531.getStatus();
+			continue;
+		}
+
+		for (i=0; i<count && types[i] != rx.DATA[0]; i++);
+		if (i < count) {
+			stats.rxDatagrams++;
+			handlers[i](&rx);
+		}
+		else stats.unknown++;
+
+		nStatus = CC8531.getStatus();
+	}
+
+	return nStatus;
+}
+
+void DSCMuxClass::send(u32 nAddr, u8* pData, u8 nLength) {
+//Sends nLength bytes of pData, starting with the type, to nAddr, a device ID as it appears on the wire
+	DSC_tx_data_t dsc;
+
+	memset(&dsc, 0, sizeof(dsc));
+	dsc.ADDR = nAddr;
+	CC8531.DSC.txData(&dsc, nLength, pData);
+}
+
+DSCM_stats_t* DSCMuxClass::getStats() {
+//Returns the demultiplexer statistics
+	return &stats;
+}
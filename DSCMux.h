@@ -0,0 +1,47 @@
+#ifndef _DSCMUX_H_INCLUDED
+#define _DSCMUX_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+
+//Shares the data side channel between the protocols that send one message per datagram. The first
+//byte of every datagram is its message type, and each protocol attaches a handler for the types it
+//receives. The service() call of whichever protocol runs first reads every waiting datagram and hands
+//it to its handler, so the protocols can be serviced in any order from the same status word.
+//Types in use:
+//	ImageDist		'A' 'D' 'S'
+//	VolumeManager	'V' 'v'
+//	AudioRouter		'Q' 'N' 'R' 'r'
+//	RemoteEHIF		'E' 'e'
+//DSCTransport has its own header and keeps the data side channel to itself
+#define DSCM_MAX_TYPES 12
+
+typedef void (*DSCM_handler_t)(DSC_rx_data_t*);
+
+//Demultiplexer statistics
+typedef struct {
+	u32 rxDatagrams;	//Datagrams handed to a handler
+	u16 unknown;		//Datagrams of a type nobody attached, or empty
+	u16 resets;			//Data side channel resets cleared
+} DSCM_stats_t;
+
+class DSCMuxClass {
+private:
+	static u8 count;
+	static u8 types[DSCM_MAX_TYPES];
+	static DSCM_handler_t handlers[DSCM_MAX_TYPES];
+	static DSC_rx_data_t rx;
+	static DSCM_stats_t stats;
+public:
+	static void setMask(EHIF_mask_t*);
+	static u8 attach(u8, DSCM_handler_t);
+	static void detach(u8);
+	static StatusWord_t service(StatusWord_t);
+	static void send(u32, u8*, u8);
+	static DSCM_stats_t* getStats();
+};
+
+extern DSCMuxClass DSCMux;
+
+#endif
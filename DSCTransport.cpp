@@ -0,0 +1,444 @@
+#include "WProgram.h"
+#include "DSCTransport.h"
+
+DSCTransportClass DSCTransport;
+
+#define TX_MASK (DSCT_TX_SLOTS - 1)
+#define RX_MASK (DSCT_RX_SLOTS - 1)
+
+//Slot state kept next to the header flags
+#define SLOT_SENT 0x10
+#define SLOT_SACKED 0x20
+#define SLOT_LOST 0x40
+#define SLOT_PRESENT 0x10
+
+#define EPOCH_NONE 0xFF
+
+u32 DSCTransportClass::nPeerAddr;
+StatusWord_t DSCTransportClass::status;
+u8 DSCTransportClass::connReset;
+u8 DSCTransportClass::ackPending;
+
+u8 DSCTransportClass::txBuf[DSCT_TX_SLOTS][DSC_DATAGRAM_MAX];
+u8 DSCTransportClass::txLen[DSCT_TX_SLOTS];
+u8 DSCTransportClass::txFlags[DSCT_TX_SLOTS];
+u32 DSCTransportClass::txTime[DSCT_TX_SLOTS];
+u8 DSCTransportClass::txMap[DSCT_TX_SLOTS];
+u8 DSCTransportClass::txBase;
+u8 DSCTransportClass::txNext;
+u8 DSCTransportClass::txHead;
+u8 DSCTransportClass::txOpen;
+u8 DSCTransportClass::txDiscard;
+u8 DSCTransportClass::txEpoch;
+u8 DSCTransportClass::peerWin;
+u32 DSCTransportClass::lastSend;
+
+DSC_rx_data_t DSCTransportClass::rxBuf[DSCT_RX_SLOTS + 1];
+u8 DSCTransportClass::rxFlags[DSCT_RX_SLOTS + 1];
+u8 DSCTransportClass::rxMap[DSCT_RX_SLOTS];
+u8 DSCTransportClass::rxSpare;
+u8 DSCTransportClass::rxRead;
+u8 DSCTransportClass::rxReady;
+u8 DSCTransportClass::rxBase;
+u8 DSCTransportClass::rxEpoch;
+u8 DSCTransportClass::lastWin;
+
+DSCT_stats_t DSCTransportClass::stats;
+
+//////////////////////////////////////////////////////////
+//Setup
+//////////////////////////////////////////////////////////
+
+void DSCTransportClass::begin(u32 nPeer, EHIF_mask_t* pMask) {
+//Opens the transport to the device with ID nPeer. The DSC events are added to the caller's interrupt
+//mask, the transport only moves data when service() is given a status word with them set
+	u8 i;
+
+	//EHIF fields are big-endian on the wire
+	nPeerAddr = ((nPeer & 0xFF) << 24) | ((nPeer & 0xFF00) << 8) | ((nPeer >> 8) & 0xFF00) | (nPeer >> 24);
+
+	pMask->MSK_DSC_RESET = 1;
+	pMask->MSK_DSC_TX_AVAIL = 1;
+	pMask->MSK_DSC_RX_AVAIL = 1;
+	CC8531.EHIFCtrl.confInterruptMask(pMask);
+
+	for (i=0; i<DSCT_TX_SLOTS; i++) {
+		txMap[i] = i;
+		txFlags[i] = 0;
+	}
+	for (i=0; i<DSCT_RX_SLOTS; i++) rxMap[i] = i;
+	rxSpare = DSCT_RX_SLOTS;
+	txBase = txNext = txHead = 0;
+	txOpen = txDiscard = 0;
+	txEpoch = 0;
+	memset(&stats, 0, sizeof(stats));
+
+	reset();
+	service(CC8531.getStatus());
+}
+
+void DSCTransportClass::reset() {
+//Starts a new connection: the first datagram resets the DSC connection and the peer starts over
+	restart(1);
+	connReset = 1;
+}
+
+void DSCTransportClass::restart(u8 nLocal) {
+//Drops everything received but not yet released, and renumbers what is left to send from 0. The oldest
+//unacknowledged message is sent again from its start, the peer has dropped its first segments too.
+//nLocal: the restart starts here and the peer learns of it from the new epoch
+	u8 pMap[DSCT_TX_SLOTS];
+	u8 nFrom = txBase;
+	u8 i, b;
+
+	//A message whose first segment was already acknowledged cannot be completed any more
+	while (nFrom != txHead && !(txFlags[txMap[nFrom & TX_MASK]] & DSCT_FLAG_SOM)) {
+		nFrom++;
+		stats.dropped++;
+	}
+	if (nFrom == txHead && txOpen) txDiscard = 1;
+
+	//Rotate the slots so that the first segment left becomes sequence number 0
+	for (i=0; i<DSCT_TX_SLOTS; i++) {
+		b = txMap[(nFrom + i) & TX_MASK];
+		pMap[i] = b;
+		txFlags[b] &= DSCT_FLAG_SOM | DSCT_FLAG_EOM;
+	}
+	memcpy(txMap, pMap, sizeof(txMap));
+	txHead -= nFrom;
+	txBase = txNext = 0;
+	peerWin = DSCT_WINDOW;
+	if (nLocal) txEpoch = (txEpoch + 1) & 0x0F;
+
+	for (i=0; i<=DSCT_RX_SLOTS; i++) rxFlags[i] = 0;
+	rxRead = rxReady = rxBase = 0;
+	rxEpoch = EPOCH_NONE;
+	lastWin = DSCT_RX_SLOTS;
+
+	//Tell the peer about the new epoch even with nothing to send
+	ackPending = 1;
+	stats.resets++;
+}
+
+//////////////////////////////////////////////////////////
+//Event handling
+//////////////////////////////////////////////////////////
+
+void DSCTransportClass::service() {
+//Call from loop(): retransmits on timeout using the last status word, no SPI traffic if nothing is due
+	service(status);
+}
+
+void DSCTransportClass::service(StatusWord_t nStatus) {
+//Call with a fresh status word when the EHIF interrupt is active. Reads what has arrived, then sends
+//for as long as the CC8531 has room. When EVT_DSC_TX_AVAIL clears the interrupt brings us back
+	EHIF_flags_t flags;
+
+	status = nStatus;
+
+	if (status.B.EVT_DSC_RESET) {
+		//Connection dropped by the CC8531 (network change). The peer sees the new epoch
+		memset(&flags, 0, sizeof(flags));
+		flags.MSK_DSC_RESET = 1;
+		CC8531.EHIFCtrl.clearEventFlags(&flags);
+		restart(1);
+		status = CC8531.getStatus();
+	}
+
+	while (status.B.EVT_DSC_RX_AVAIL) {
+		receive();
+		status = CC8531.getStatus();
+	}
+
+	//The status word returned by a transfer is sampled before it, so look again after each datagram
+	while (status.B.EVT_DSC_TX_AVAIL && sendNext()) {
+		status = CC8531.getStatus();
+	}
+}
+
+//////////////////////////////////////////////////////////
+//Receive
+//////////////////////////////////////////////////////////
+
+void DSCTransportClass::receive() {
+//Reads one datagram straight into the spare buffer
+	DSC_rx_data_t* pRx = &rxBuf[rxSpare];
+	u16 nLength = sizeof(DSC_rx_data_t);
+	u8* h = pRx->DATA;
+	u8 nEpoch;
+
+	CC8531.DSC.rxData(pRx, &nLength);
+
+	if (nLength < 6 + DSCT_HDR_LEN || pRx->LENGTH < DSCT_HDR_LEN || pRx->LENGTH > DSC_DATAGRAM_MAX) return;
+	stats.rxDatagrams++;
+
+	//The peer restarted: start over on this side as well, without a new epoch of our own
+	nEpoch = h[0] >> 4;
+	if (pRx->CONN_RESET || (rxEpoch != EPOCH_NONE && nEpoch != rxEpoch)) restart(0);
+	rxEpoch = nEpoch;
+
+	//Acknowledgements from before our last restart are for other data
+	if ((h[0] & DSCT_FLAG_ACK) && (h[4] >> 4) == txEpoch) handleAck(h[2], h[3], h[4] & 0x0F);
+
+	if (h[0] & DSCT_FLAG_DATA) handleData(h[1], h[0] & (DSCT_FLAG_SOM | DSCT_FLAG_EOM));
+}
+
+void DSCTransportClass::handleAck(u8 nAck, u8 nSack, u8 nWin) {
+//Releases acknowledged segments and marks the holes below selectively acknowledged ones as lost
+	u8 nInFlight = txNext - txBase;
+	u8 nTop = 0;
+	u8 i, b;
+
+	if ((u8)(nAck - txBase) > nInFlight) return;
+
+	while (txBase != nAck) {
+		b = txMap[txBase & TX_MASK];
+		stats.bytesAcked += txLen[b];
+		txFlags[b] = 0;
+		txBase++;
+	}
+
+	nInFlight = txNext - txBase;
+	for (i=0; i<8; i++) {
+		if (!(nSack & (1 << i)) || (u8)(i + 1) >= nInFlight) continue;
+		txFlags[txMap[(u8)(nAck + 1 + i) & TX_MASK]] |= SLOT_SACKED;
+		nTop = i + 1;
+	}
+	for (i=0; i<nTop; i++) {
+		b = txMap[(u8)(nAck + i) & TX_MASK];
+		if (!(txFlags[b] & SLOT_SACKED)) txFlags[b] |= SLOT_LOST;
+	}
+
+	peerWin = nWin;
+}
+
+void DSCTransportClass::handleData(u8 nSeq, u8 nFlags) {
+//Swaps the spare buffer into the segment's slot and moves past complete messages
+	u8 nAhead = nSeq - rxBase;
+	u8 nRoom = DSCT_RX_SLOTS - (u8)(rxBase - rxRead);
+	u8 nSlot = nSeq & RX_MASK;
+	u8 b;
+
+	ackPending = 1;
+
+	//Already delivered, or beyond the window we offered
+	if (nAhead >= nRoom) {
+		if ((u8)(rxBase - nSeq) <= DSCT_RX_SLOTS) stats.duplicates++;
+		return;
+	}
+	if (rxFlags[rxMap[nSlot]] & SLOT_PRESENT) {
+		stats.duplicates++;
+		return;
+	}
+	if (nAhead) stats.outOfOrder++;
+
+	b = rxMap[nSlot];
+	rxMap[nSlot] = rxSpare;
+	rxFlags[rxSpare] = nFlags | SLOT_PRESENT;
+	rxSpare = b;
+
+	while ((u8)(rxBase - rxRead) < DSCT_RX_SLOTS) {
+		nFlags = rxFlags[rxMap[rxBase & RX_MASK]];
+		if (!(nFlags & SLOT_PRESENT)) break;
+		rxBase++;
+		if (nFlags & DSCT_FLAG_EOM) rxReady = rxBase;
+	}
+}
+
+//////////////////////////////////////////////////////////
+//Transmit
+//////////////////////////////////////////////////////////
+
+void DSCTransportClass::fillAck(u8* h) {
+//Fills in the acknowledgement part of a header
+	u8 nSack = 0;
+	u8 nWin = DSCT_RX_SLOTS - (u8)(rxBase - rxRead);
+	u8 i;
+
+	for (i=0; i<8 && (u8)(i + 1) < nWin; i++) {
+		if (rxFlags[rxMap[(u8)(rxBase + 1 + i) & RX_MASK]] & SLOT_PRESENT) nSack |= 1 << i;
+	}
+	if (nWin > 0x0F) nWin = 0x0F;
+
+	h[0] = txEpoch << 4;
+	if (rxEpoch != EPOCH_NONE) h[0] |= DSCT_FLAG_ACK;
+	h[2] = rxBase;
+	h[3] = nSack;
+	h[4] = ((rxEpoch & 0x0F) << 4) | nWin;
+
+	lastWin = nWin;
+	ackPending = 0;
+}
+
+u8 DSCTransportClass::sendNext() {
+//Sends one datagram: a lost segment, a new one, a window probe or a bare acknowledgement. 0 if nothing
+	u32 nNow = millis();
+	u8 nInFlight = txNext - txBase;
+	u8 nWin = (peerWin < DSCT_WINDOW) ? peerWin : DSCT_WINDOW;
+	u8 i, b;
+
+	for (i=0; i<nInFlight; i++) {
+		b = txMap[(u8)(txBase + i) & TX_MASK];
+		if (txFlags[b] & SLOT_SACKED) continue;
+		if (((txFlags[b] & SLOT_LOST) && (nNow - txTime[b] >= DSCT_RETX_GAP_MS)) || (nNow - txTime[b] >= DSCT_RTO_MS)) {
+			stats.retransmits++;
+			sendSegment(txBase + i);
+			return 1;
+		}
+	}
+
+	if (txNext != txHead) {
+		//The peer had no room: probe with one segment so that the window update cannot get lost
+		if (nInFlight < nWin || (!nInFlight && nNow - lastSend >= DSCT_RTO_MS)) {
+			sendSegment(txNext++);
+			return 1;
+		}
+	}
+
+	if (ackPending) {
+		sendAck();
+		return 1;
+	}
+
+	return 0;
+}
+
+void DSCTransportClass::sendSegment(u8 nSeq) {
+//Sends a segment straight from its slot, the header goes in front of the payload
+	DSC_tx_data_t dsc;
+	u8 b = txMap[nSeq & TX_MASK];
+	u8* h = txBuf[b];
+
+	fillAck(h);
+	h[0] |= DSCT_FLAG_DATA | (txFlags[b] & (DSCT_FLAG_SOM | DSCT_FLAG_EOM));
+	h[1] = nSeq;
+
+	memset(&dsc, 0, sizeof(dsc));
+	dsc.CONN_RESET = connReset;
+	dsc.ADDR = nPeerAddr;
+	CC8531.DSC.txData(&dsc, DSCT_HDR_LEN + txLen[b], h);
+
+	connReset = 0;
+	txFlags[b] = (txFlags[b] | SLOT_SENT) & ~SLOT_LOST;
+	lastSend = txTime[b] = millis();
+	stats.txDatagrams++;
+}
+
+void DSCTransportClass::sendAck() {
+//Sends a header without payload
+	DSC_tx_data_t dsc;
+	u8 h[DSCT_HDR_LEN];
+
+	fillAck(h);
+	h[1] = txNext;
+
+	memset(&dsc, 0, sizeof(dsc));
+	dsc.CONN_RESET = connReset;
+	dsc.ADDR = nPeerAddr;
+	CC8531.DSC.txData(&dsc, DSCT_HDR_LEN, h);
+
+	connReset = 0;
+	stats.txDatagrams++;
+}
+
+//////////////////////////////////////////////////////////
+//Application interface
+//////////////////////////////////////////////////////////
+
+u16 DSCTransportClass::write(u8* nData, u16 nLength) {
+//Queues a whole message of 1 to DSCT_MSG_MAX bytes. Returns nLength, or 0 if there is no room yet
+	u8 nSegments = (nLength + DSCT_SEG_MAX - 1) / DSCT_SEG_MAX;
+	u16 nTotal = nLength;
+	u8 nPart;
+	u8* p;
+
+	if (!nLength || nLength > DSCT_MSG_MAX || txOpen) return 0;
+	if ((u8)(DSCT_TX_SLOTS - (u8)(txHead - txBase)) < nSegments) return 0;
+
+	do {
+		nPart = (nLength > DSCT_SEG_MAX) ? DSCT_SEG_MAX : nLength;
+		p = txSegment();
+		memcpy(p, nData, nPart);
+		nData += nPart;
+		nLength -= nPart;
+		txCommit(nPart, !nLength);
+	} while (nLength);
+
+	return nTotal;
+}
+
+u8* DSCTransportClass::txSegment() {
+//Zero-copy send: returns where the next DSCT_SEG_MAX bytes of payload go, NULL while all slots are in use
+	if ((u8)(txHead - txBase) >= DSCT_TX_SLOTS) return NULL;
+	return txBuf[txMap[txHead & TX_MASK]] + DSCT_HDR_LEN;
+}
+
+void DSCTransportClass::txCommit(u8 nLength, u8 nEnd) {
+//Queues the segment filled in through txSegment(). nEnd: it is the last one of the message. A message
+//must not span more than DSCT_MSG_SLOTS segments
+	u8 b = txMap[txHead & TX_MASK];
+
+	if (txDiscard) {
+		if (nEnd) txDiscard = txOpen = 0;
+		return;
+	}
+
+	txLen[b] = nLength;
+	txFlags[b] = (txOpen ? 0 : DSCT_FLAG_SOM) | (nEnd ? DSCT_FLAG_EOM : 0);
+	txOpen = !nEnd;
+	txHead++;
+}
+
+u8 DSCTransportClass::available() {
+//Returns 1 if a complete message is waiting
+	return rxRead != rxReady;
+}
+
+u8 DSCTransportClass::rxSegment(u8** pData, u8* pEnd) {
+//Zero-copy receive: points pData at the oldest segment of a complete message and returns its length,
+//0 if there is none. pEnd is set on the last segment. Release it with rxRelease()
+	DSC_rx_data_t* pRx;
+
+	if (rxRead == rxReady) return 0;
+
+	pRx = &rxBuf[rxMap[rxRead & RX_MASK]];
+	*pData = pRx->DATA + DSCT_HDR_LEN;
+	*pEnd = (rxFlags[rxMap[rxRead & RX_MASK]] & DSCT_FLAG_EOM) != 0;
+	return pRx->LENGTH - DSCT_HDR_LEN;
+}
+
+void DSCTransportClass::rxRelease() {
+//Frees the segment returned by rxSegment()
+	u8 b = rxMap[rxRead & RX_MASK];
+
+	if (rxRead == rxReady) return;
+
+	stats.bytesDelivered += rxBuf[b].LENGTH - DSCT_HDR_LEN;
+	rxFlags[b] = 0;
+	rxRead++;
+
+	//The peer stops at a closed window, reopen it
+	if (!lastWin) ackPending = 1;
+}
+
+u16 DSCTransportClass::read(u8* nBuffer, u16 nMax) {
+//Copies out one complete message. Bytes beyond nMax are dropped. Returns the number of bytes copied
+	u16 nCopied = 0;
+	u8* pData;
+	u8 nEnd = 0;
+	u8 nLength;
+
+	while (!nEnd && (nLength = rxSegment(&pData, &nEnd))) {
+		if (nLength > nMax - nCopied) nLength = nMax - nCopied;
+		memcpy(nBuffer + nCopied, pData, nLength);
+		nCopied += nLength;
+		rxRelease();
+	}
+
+	return nCopied;
+}
+
+DSCT_stats_t* DSCTransportClass::getStats() {
+//Returns the transport statistics
+	return &stats;
+}
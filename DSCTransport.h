@@ -0,0 +1,125 @@
+#ifndef _DSCTRANSPORT_H_INCLUDED
+#define _DSCTRANSPORT_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+
+//Reliable message transport over the data side channel. Messages are split into segments of up to
+//DSCT_SEG_MAX bytes, one per datagram. Each datagram starts with a DSCT_HDR_LEN byte header:
+//	[0]	flags (bits 3:0) and sender epoch (bits 7:4)
+//	[1]	segment sequence number
+//	[2]	acknowledgement: next sequence number expected from the peer
+//	[3]	selective acknowledgement: bit n set if segment [2]+1+n has arrived
+//	[4]	free receive slots (bits 3:0) and the peer epoch the acknowledgement refers to (bits 7:4)
+//The epoch changes whenever a side restarts, and the other side then starts over as well
+#define DSCT_HDR_LEN 5
+#define DSCT_SEG_MAX (DSC_DATAGRAM_MAX - DSCT_HDR_LEN)
+
+//Header flags
+#define DSCT_FLAG_DATA 0x01	//Datagram carries a segment
+#define DSCT_FLAG_SOM 0x02	//First segment of a message
+#define DSCT_FLAG_EOM 0x04	//Last segment of a message
+#define DSCT_FLAG_ACK 0x08	//Acknowledgement fields are valid
+
+//Segment slots on each end, powers of two. A message must fit in both
+#ifndef DSCT_TX_SLOTS
+#define DSCT_TX_SLOTS 8
+#endif
+#ifndef DSCT_RX_SLOTS
+#define DSCT_RX_SLOTS 8
+#endif
+#define DSCT_MSG_SLOTS ((DSCT_TX_SLOTS < DSCT_RX_SLOTS) ? DSCT_TX_SLOTS : DSCT_RX_SLOTS)
+#define DSCT_MSG_MAX (DSCT_MSG_SLOTS * DSCT_SEG_MAX)
+
+//Segments in flight, at most 8 (the width of the selective acknowledgement)
+#ifndef DSCT_WINDOW
+#define DSCT_WINDOW 4
+#endif
+
+//A segment is sent again after DSCT_RTO_MS without acknowledgement, or once a later segment has been
+//acknowledged, but no sooner than DSCT_RETX_GAP_MS after it was last sent
+#ifndef DSCT_RTO_MS
+#define DSCT_RTO_MS 100
+#endif
+#ifndef DSCT_RETX_GAP_MS
+#define DSCT_RETX_GAP_MS 20
+#endif
+
+//Transport statistics
+typedef struct {
+	u32 txDatagrams;	//Datagrams sent, including retransmissions and acknowledgements
+	u32 retransmits;	//Segments sent again
+	u32 rxDatagrams;	//Datagrams received
+	u32 duplicates;		//Segments received more than once
+	u32 outOfOrder;		//Segments received ahead of a missing one
+	u32 bytesAcked;		//Payload bytes acknowledged by the peer
+	u32 bytesDelivered;	//Payload bytes released by the application
+	u16 resets;			//Connection restarts, local or by the peer
+	u16 dropped;		//Segments of messages cut by a restart
+} DSCT_stats_t;
+
+class DSCTransportClass {
+private:
+	static u32 nPeerAddr;
+	static StatusWord_t status;
+	static u8 connReset;
+	static u8 ackPending;
+
+	//Transmit side. Buffers are reached through txMap, indexed by sequence number
+	static u8 txBuf[DSCT_TX_SLOTS][DSC_DATAGRAM_MAX];
+	static u8 txLen[DSCT_TX_SLOTS];
+	static u8 txFlags[DSCT_TX_SLOTS];
+	static u32 txTime[DSCT_TX_SLOTS];
+	static u8 txMap[DSCT_TX_SLOTS];
+	static u8 txBase;	//Oldest unacknowledged
+	static u8 txNext;	//Next to send for the first time
+	static u8 txHead;	//Next to fill
+	static u8 txOpen;	//A message has been started with txCommit() but not ended
+	static u8 txDiscard;	//The open message was cut by a restart, drop the rest of it
+	static u8 txEpoch;
+	static u8 peerWin;
+	static u32 lastSend;
+
+	//Receive side. One spare buffer more than slots, datagrams are read into the spare and swapped in
+	static DSC_rx_data_t rxBuf[DSCT_RX_SLOTS + 1];
+	static u8 rxFlags[DSCT_RX_SLOTS + 1];
+	static u8 rxMap[DSCT_RX_SLOTS];
+	static u8 rxSpare;
+	static u8 rxRead;	//Oldest not released by the application
+	static u8 rxReady;	//End of the last complete message
+	static u8 rxBase;	//Next expected
+	static u8 rxEpoch;
+	static u8 lastWin;
+
+	static DSCT_stats_t stats;
+
+	static void restart(u8);
+	static void receive();
+	static void handleAck(u8, u8, u8);
+	static void handleData(u8, u8);
+	static void fillAck(u8*);
+	static u8 sendNext();
+	static void sendSegment(u8);
+	static void sendAck();
+public:
+	static void begin(u32, EHIF_mask_t*);
+	static void reset();
+	static void service();
+	static void service(StatusWord_t);
+
+	static u16 write(u8*, u16);
+	static u8* txSegment();
+	static void txCommit(u8, u8);
+
+	static u8 available();
+	static u8 rxSegment(u8**, u8*);
+	static void rxRelease();
+	static u16 read(u8*, u16);
+
+	static DSCT_stats_t* getStats();
+};
+
+extern DSCTransportClass DSCTransport;
+
+#endif
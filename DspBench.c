@@ -0,0 +1,126 @@
+// x86 reference build of the UC3A3 DSP chain (task_DSP.c). It checks what each crossover mode puts on
+// the two channels, then times every stage per block with the module's own cycle counters, which read
+// the TSC here.
+// The host times say nothing about the UC3A3, where task_dsp_get_cycles_max holds the real figures.
+// Build: gcc -O3 -IHostSim/UC3A3 -IWirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src -o DspBench DspBench.c WirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src/task_DSP.c -lm
+//        add -fopt-info-vec-optimized to see which loops gcc vectorized
+// Usage: ./DspBench [blocks to time] (exit status 0 if all checks pass)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <x86intrin.h>
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "task_DSP.h"
+
+#define FS 48000
+
+static int failures;
+
+uint32_t Get_sys_count(void) {
+	return (uint32_t)__rdtsc();
+}
+
+void check(int ok, const char *what) {
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+// Fills a block with a sine of freq Hz at amplitude amp, continuing from *phase
+void sine_block(dsp_block_t *block, double freq, double amp, double *phase) {
+	uint32_t i;
+
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		block->left[i] = (int16_t)(amp * sin(*phase));
+		block->right[i] = block->left[i];
+		*phase += 2 * M_PI * freq / FS;
+	}
+}
+
+// Peak output level of a sine through the chain once it has settled, and whether left equalled right
+int32_t run_tone(uint32_t mode, double freq, int *same) {
+	dsp_block_t block;
+	double phase = 0;
+	int32_t peak = 0;
+	uint32_t b, i;
+
+	task_dsp_reset();
+	task_dsp_set_crossover(mode);
+	*same = 1;
+
+	// One second, the last half is measured
+	for (b = 0; b < FS / DSP_BLOCK_FRAMES; b++) {
+		sine_block(&block, freq, 8000, &phase);
+		task_dsp_process(&block);
+		if (b < FS / DSP_BLOCK_FRAMES / 2) continue;
+		for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+			if (abs(block.left[i]) > peak) peak = abs(block.left[i]);
+			if (block.left[i] != block.right[i]) *same = 0;
+		}
+	}
+
+	return peak;
+}
+
+void test_modes(void) {
+	int same;
+
+	check(run_tone(DSP_CROSSOVER_OFF, 1000, &same) > 7900 && same, "off: 1kHz passes");
+	check(run_tone(DSP_CROSSOVER_OFF, 40, &same) > 7900, "off: 40Hz passes");
+	check(run_tone(DSP_CROSSOVER_MAINS, 1000, &same) > 7900, "mains: 1kHz passes");
+	check(run_tone(DSP_CROSSOVER_MAINS, 25, &same) < 800, "mains: 25Hz is 20dB down");
+	check(run_tone(DSP_CROSSOVER_SUB, 40, &same) > 7000 && same, "sub: 40Hz on both channels");
+	check(run_tone(DSP_CROSSOVER_SUB, 1000, &same) < 80 && same, "sub: 1kHz is 40dB down");
+}
+
+void time_mode(uint32_t mode, const char *name, long blocks) {
+	static const char *stages[DSP_NUM_STAGES] = {"eq", "crossover", "limiter"};
+	dsp_block_t block;
+	double sum[DSP_NUM_STAGES] = {0};
+	uint32_t stage, i;
+	long b;
+
+	task_dsp_reset();
+	task_dsp_set_crossover(mode);
+	task_dsp_clear_cycles();
+	srand(1);
+
+	for (b = 0; b < blocks; b++) {
+		for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+			block.left[i] = rand() % 65536 - 32768;
+			block.right[i] = rand() % 65536 - 32768;
+		}
+		task_dsp_process(&block);
+		for (stage = 0; stage < DSP_NUM_STAGES; stage++) sum[stage] += task_dsp_get_cycles(stage);
+	}
+
+	printf("%-6s", name);
+	for (stage = 0; stage < DSP_NUM_STAGES; stage++) {
+		printf("  %s %.0f", stages[stage], sum[stage] / blocks);
+	}
+	printf(" mean TSC cycles per %d frame block\n", DSP_BLOCK_FRAMES);
+}
+
+int main(int argc, char **argv) {
+	long blocks = (argc > 1) ? atol(argv[1]) : 100000;
+	// +6dB peaking EQ at 1kHz, Q 1, and a 40Hz high pass, both Q14
+	const dsp_biquad_coef_t peak = {17104, -31053, 14217, -31053, 14937};
+	const dsp_biquad_coef_t highpass = {16323, -32647, 16323, -32647, 16263};
+
+	task_dsp_init();
+	task_dsp_set_fs(FS);
+	test_modes();
+
+	task_dsp_set_eq(0, &peak);
+	task_dsp_set_eq(1, &highpass);
+	time_mode(DSP_CROSSOVER_OFF, "off", blocks);
+	time_mode(DSP_CROSSOVER_MAINS, "mains", blocks);
+	time_mode(DSP_CROSSOVER_SUB, "sub", blocks);
+
+	if (failures) printf("%d check(s) failed\n", failures);
+	else printf("all checks passed\n");
+	return failures ? 1 : 0;
+}
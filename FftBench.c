@@ -0,0 +1,126 @@
+// Runs the UC3A3 spectrum analyzer FFT kernel (task_fft_transform in task_FFT.c) on a PC. It checks the
+// kernel against a double precision DFT scaled the same way (1/FFT_SIZE), then times it.
+// The host time says nothing about the UC3A3. FFT_CYCLE_BUDGET is checked on target, in fft_stats.
+// Build: gcc -O2 -IHostSim/UC3A3 -IWirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src -IWirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src/config -o FftBench FftBench.c WirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src/task_FFT.c -lm
+// Usage: ./FftBench [transforms to time] (exit status 1 if the kernel is off by more than 8 LSB)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "compiler.h"
+#include "semphr.h"
+#include "task_FFT.h"
+#include "rtos_mem.h"
+
+// What task_FFT.c needs from the rest of the firmware
+volatile long hostsim_semaphores[HOSTSIM_SEMAPHORES];
+uint32_t hostsim_semaphores_used;
+
+uint32_t Get_sys_count(void) {
+	return 0;
+}
+
+bool rtos_mem_task_create(uint32_t task, pdTASK_CODE code) {
+	return true;
+}
+
+void rtos_mem_halt(uint32_t task) {
+}
+
+uint32_t task_leds_get_mode(void) {
+	return 0;
+}
+
+void task_leds_set_RGB(uint16_t red_top, uint16_t green_top, uint16_t blue_top, uint16_t red_bot, uint16_t green_bot, uint16_t blue_bot) {
+}
+
+// Largest difference between the kernel and the DFT, in LSB
+double check_transform(const int16_t *input) {
+	int16_t re[FFT_SIZE];
+	int16_t im[FFT_SIZE];
+	double sr, si, err, max_err = 0;
+	int k, n;
+
+	memcpy(re, input, sizeof(re));
+	memset(im, 0, sizeof(im));
+	task_fft_transform(re, im);
+
+	for (k = 0; k < FFT_SIZE; k++) {
+		sr = 0;
+		si = 0;
+		for (n = 0; n < FFT_SIZE; n++) {
+			sr += input[n] * cos(2 * M_PI * k * n / FFT_SIZE);
+			si -= input[n] * sin(2 * M_PI * k * n / FFT_SIZE);
+		}
+		err = fabs(re[k] - sr / FFT_SIZE);
+		if (err > max_err) max_err = err;
+		err = fabs(im[k] - si / FFT_SIZE);
+		if (err > max_err) max_err = err;
+	}
+
+	return max_err;
+}
+
+double now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+	long count = (argc > 1) ? atol(argv[1]) : 200000;
+	int16_t input[FFT_SIZE];
+	int16_t re[FFT_SIZE];
+	int16_t im[FFT_SIZE];
+	double err, max_err = 0;
+	double start, ns;
+	long i;
+	int n;
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned long long tsc;
+#endif
+
+	// Full scale sines on and between bins, two tones, and full scale noise
+	for (n = 0; n < FFT_SIZE; n++) input[n] = (int16_t)(32767 * sin(2 * M_PI * 10 * n / FFT_SIZE));
+	max_err = check_transform(input);
+	for (n = 0; n < FFT_SIZE; n++) input[n] = (int16_t)(32767 * sin(2 * M_PI * 37.5 * n / FFT_SIZE));
+	err = check_transform(input);
+	if (err > max_err) max_err = err;
+	for (n = 0; n < FFT_SIZE; n++) input[n] = (int16_t)(16000 * sin(2 * M_PI * 3 * n / FFT_SIZE) + 16000 * cos(2 * M_PI * 90 * n / FFT_SIZE));
+	err = check_transform(input);
+	if (err > max_err) max_err = err;
+	srand(1);
+	for (i = 0; i < 20; i++) {
+		for (n = 0; n < FFT_SIZE; n++) input[n] = (int16_t)(rand() % 65536 - 32768);
+		err = check_transform(input);
+		if (err > max_err) max_err = err;
+	}
+	printf("%d point radix-4, largest error against the scaled DFT: %.2f LSB\n", FFT_SIZE, max_err);
+
+	// The input is copied in every time, as the analyzer windows a fresh frame each time
+	start = now_ns();
+#if defined(__x86_64__) || defined(__i386__)
+	tsc = __rdtsc();
+#endif
+	for (i = 0; i < count; i++) {
+		memcpy(re, input, sizeof(re));
+		memset(im, 0, sizeof(im));
+		task_fft_transform(re, im);
+	}
+	ns = (now_ns() - start) / count;
+	printf("%ld transforms: %.0f ns each", count, ns);
+#if defined(__x86_64__) || defined(__i386__)
+	printf(", %.0f TSC cycles each", (double)(__rdtsc() - tsc) / count);
+#endif
+	printf(" (%d)\n", re[1]);	// Keeps the loop from being optimised away
+
+	printf("on target the budget is %d cycles per %d point frame, see fft_stats.cycles_max\n", FFT_CYCLE_BUDGET, FFT_SIZE);
+
+	return (max_err > 8) ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#ifndef _HOSTSIM_ARDUINO_H_INCLUDED
+#define _HOSTSIM_ARDUINO_H_INCLUDED
+
+//Host stand-in for the parts of the Arduino core the library classes use, so that the test programs
+//in the repository root can run them on a PC. Time is simulated: millis() only moves when the test
+//program moves it (simMillis) or calls delay()
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define HEX 16
+#define DEC 10
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define RISING 3
+
+#define A2 16
+#define MISO 12
+
+extern unsigned long simMillis;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+
+//Prints to stdout
+class Print {
+public:
+	void print(const char*);
+	void print(char);
+	void print(int, int = DEC);
+	void print(unsigned int, int = DEC);
+	void print(long, int = DEC);
+	void print(unsigned long, int = DEC);
+	void println(const char*);
+	void println(int, int = DEC);
+	void println(unsigned int, int = DEC);
+	void println(long, int = DEC);
+	void println(unsigned long, int = DEC);
+	void println();
+};
+
+extern Print Serial;
+
+//Only declared, nothing in the host programs opens files
+class File {
+public:
+	int read();
+	int available();
+	void close();
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include "CC85xxSim.h"
+
+CC8531Class CC8531;
+Print Serial;
+
+unsigned long simMillis;
+double linkLoss;
+
+static CC85xxSim* pSelected;
+
+//////////////////////////////////////////////////////////
+//Arduino core
+//////////////////////////////////////////////////////////
+
+unsigned long millis() {
+	return simMillis;
+}
+
+unsigned long micros() {
+	return simMillis * 1000;
+}
+
+void delay(unsigned long nMs) {
+	simMillis += nMs;
+}
+
+void delayMicroseconds(unsigned int nUs) {
+}
+
+void pinMode(uint8_t nPin, uint8_t nMode) {
+}
+
+void digitalWrite(uint8_t nPin, uint8_t nValue) {
+}
+
+int digitalRead(uint8_t nPin) {
+	return HIGH;
+}
+
+static void printNumber(unsigned long nValue, int nBase, int nNegative) {
+	if (nNegative) printf("-%lu", nValue);
+	else printf(nBase == HEX ? "%lX" : "%lu", nValue);
+}
+
+void Print::print(const char* pText) { fputs(pText, stdout); }
+void Print::print(char cChar) { putchar(cChar); }
+void Print::print(int nValue, int nBase) { print((long)nValue, nBase); }
+void Print::print(unsigned int nValue, int nBase) { printNumber(nValue, nBase, 0); }
+void Print::print(long nValue, int nBase) {
+	if (nBase == DEC && nValue < 0) printNumber(-(unsigned long)nValue, nBase, 1);
+	else printNumber((unsigned long)nValue, nBase, 0);
+}
+void Print::print(unsigned long nValue, int nBase) { printNumber(nValue, nBase, 0); }
+void Print::println(const char* pText) { print(pText); println(); }
+void Print::println(int nValue, int nBase) { print(nValue, nBase); println(); }
+void Print::println(unsigned int nValue, int nBase) { print(nValue, nBase); println(); }
+void Print::println(long nValue, int nBase) { print(nValue, nBase); println(); }
+void Print::println(unsigned long nValue, int nBase) { print(nValue, nBase); println(); }
+void Print::println() { putchar('\n'); }
+
+//////////////////////////////////////////////////////////
+//Device
+//////////////////////////////////////////////////////////
+
+CC85xxSim::CC85xxSim(u32 nWireId) {
+	memset(this, 0, sizeof(*this));
+	wireId = nWireId;
+	txQueueMax = 4;
+	rxQueueMax = 4;
+	memset(audioChan, 0xFF, sizeof(audioChan));
+}
+
+void CC85xxSim::select(CC85xxSim* pDevice) {
+//Points the CC8531 object at pDevice
+	pSelected = pDevice;
+}
+
+CC85xxSim* CC85xxSim::selected() {
+	return pSelected;
+}
+
+void CC85xxSim::inject(u32 nFrom, u8* pData, u8 nLength) {
+//Puts a datagram from nFrom straight into the receive queue, as if it had come over the air
+	SimDatagram_t* d;
+
+	if (rxCount >= rxQueueMax) {
+		rxDropped++;
+		return;
+	}
+	d = &rxQueue[rxCount++];
+	memset(d, 0, sizeof(*d));
+	d->ADDR = nFrom;
+	d->LENGTH = nLength;
+	memcpy(d->DATA, pData, nLength);
+}
+
+u8 CC85xxSim::take(SimDatagram_t* pDatagram) {
+//Removes the oldest datagram from the transmit queue, for tests that play the other side themselves.
+//Returns 0 if there is none
+	if (!txCount) return 0;
+	*pDatagram = txQueue[0];
+	memmove(txQueue, txQueue + 1, --txCount * sizeof(SimDatagram_t));
+	return 1;
+}
+
+u8 CC85xxSim::receive(SimDatagram_t* pDatagram) {
+//Removes the oldest datagram from the receive queue, for devices the test program plays itself.
+//Returns 0 if there is none
+	if (!rxCount) return 0;
+	*pDatagram = rxQueue[0];
+	memmove(rxQueue, rxQueue + 1, --rxCount * sizeof(SimDatagram_t));
+	return 1;
+}
+
+void CC85xxSim::queue(u32 nTo, u8* pData, u8 nLength) {
+//Queues a datagram to nTo as DSC_TX_DATAGRAM would, for devices the test program plays itself
+	SimDatagram_t* d;
+
+	if (txCount >= txQueueMax) {
+		txOverflows++;
+		return;
+	}
+	d = &txQueue[txCount++];
+	memset(d, 0, sizeof(*d));
+	d->ADDR = nTo;
+	d->LENGTH = nLength;
+	memcpy(d->DATA, pData, nLength);
+}
+
+StatusWord_t CC85xxSim::getStatus() {
+//The status word as the CC85xx would return it now
+	StatusWord_t nStatus;
+
+	nStatus.nStatus = 0;
+	nStatus.B.EVT_DSC_RESET = dscReset;
+	nStatus.B.EVT_DSC_TX_AVAIL = txCount < txQueueMax;
+	nStatus.B.EVT_DSC_RX_AVAIL = rxCount > 0;
+	nStatus.B.WASP_CONN = 1;
+	nStatus.B.PWR_STATE = 5;
+	nStatus.B.CMDREQ_RDY = 1;
+	return nStatus;
+}
+
+void simLink(CC85xxSim** pDevices, u8 nDevices) {
+//Moves at most one datagram per device every SIM_LINK_MS. Datagrams to unknown devices vanish
+	CC85xxSim* s;
+	SimDatagram_t d;
+	u8 i, j;
+
+	for (i=0; i<nDevices; i++) {
+		s = pDevices[i];
+		if (simMillis < s->nextLink || !s->take(&d)) continue;
+		s->nextLink = simMillis + SIM_LINK_MS;
+
+		for (j=0; j<nDevices && pDevices[j]->wireId != d.ADDR; j++);
+		if (j == nDevices) continue;
+		if (d.CONN_RESET) pDevices[j]->dscReset = 1;
+		if ((double)rand() / RAND_MAX < linkLoss) {
+			pDevices[j]->rxDropped++;
+			continue;
+		}
+		pDevices[j]->inject(s->wireId, d.DATA, d.LENGTH);
+	}
+}
+
+//////////////////////////////////////////////////////////
+//CC8531Class commands
+//////////////////////////////////////////////////////////
+
+CC8531Class::CC8531Class() {
+	waitReadyError = 0;
+	Network.pChip = this;
+	DSC.pChip = this;
+	EHIFCtrl.pChip = this;
+}
+
+StatusWord_t CC8531Class::getStatus() {
+	pSelected->commands++;
+	return pSelected->getStatus();
+}
+
+StatusWord_t CC8531Class::EHIFCtrlClass::confInterruptMask(EHIF_mask_t* evtMask) {
+	pSelected->commands++;
+	return pSelected->getStatus();
+}
+
+StatusWord_t CC8531Class::EHIFCtrlClass::clearEventFlags(EHIF_flags_t* flags) {
+	StatusWord_t nStatus = pSelected->getStatus();
+
+	pSelected->commands++;
+	if (flags->MSK_DSC_RESET) pSelected->dscReset = 0;
+	return nStatus;
+}
+
+StatusWord_t CC8531Class::DSCClass::txData(DSC_tx_data_t* DSCdata, u16 nDataLength, u8* nData) {
+	StatusWord_t nStatus = pSelected->getStatus();
+	SimDatagram_t* d;
+
+	pSelected->commands++;
+	if (pSelected->txCount >= pSelected->txQueueMax || nDataLength > DSC_DATAGRAM_MAX) {
+		pSelected->txOverflows++;
+		return nStatus;
+	}
+	d = &pSelected->txQueue[pSelected->txCount++];
+	memset(d, 0, sizeof(*d));
+	d->ADDR = DSCdata->ADDR;
+	d->CONN_RESET = DSCdata->CONN_RESET;
+	d->LENGTH = nDataLength;
+	memcpy(d->DATA, nData, nDataLength);
+	return nStatus;
+}
+
+StatusWord_t CC8531Class::DSCClass::rxData(DSC_rx_data_t* DSCdata, u16* nDataLength) {
+	StatusWord_t nStatus = pSelected->getStatus();
+	SimDatagram_t* d = &pSelected->rxQueue[0];
+
+	pSelected->commands++;
+	if (!pSelected->rxCount) {
+		*nDataLength = 0;
+		return nStatus;
+	}
+	memset(DSCdata, 0, sizeof(*DSCdata));
+	DSCdata->CONN_RESET = d->CONN_RESET;
+	DSCdata->ADDR = d->ADDR;
+	DSCdata->LENGTH = d->LENGTH;
+	memcpy(DSCdata->DATA, d->DATA, d->LENGTH);
+	*nDataLength = 6 + d->LENGTH;
+
+	memmove(d, d + 1, --pSelected->rxCount * sizeof(SimDatagram_t));
+	return nStatus;
+}
+
+StatusWord_t CC8531Class::NetworkClass::getStatusSlave(u8* nDataBuffer) {
+	pSelected->commands++;
+	memcpy(nDataBuffer, pSelected->status, NWM_STATUS_LENGTH);
+	return pSelected->getStatus();
+}
+
+StatusWord_t CC8531Class::NetworkClass::confAudioChan(Audio_chan_t* audioChan) {
+	pSelected->commands++;
+	memcpy(pSelected->audioChan, audioChan, sizeof(pSelected->audioChan));
+	pSelected->audioChanSets++;
+	return pSelected->getStatus();
+}
@@ -0,0 +1,57 @@
+#ifndef _CC85XXSIM_H_INCLUDED
+#define _CC85XXSIM_H_INCLUDED
+
+#include <Arduino.h>
+#include "CC8531.h"
+
+//Software stand-in for the CC85xx behind the CC8531 object, for running the library classes on a PC.
+//It implements the CC8531Class commands the data side channel classes use: the status word, the
+//interrupt mask and event flags, DSC_TX_DATAGRAM, DSC_RX_DATAGRAM, NWM_GET_STATUS_S and
+//NWM_ACH_SET_USAGE. Several devices can exist; the CC8531 object talks to the one select() picked,
+//so a test program selects a device before servicing the classes that run on it.
+//simLink() plays the radio: every SIM_LINK_MS it moves the oldest queued datagram of each device to
+//the device it is addressed to, losing it with probability linkLoss
+#define SIM_QUEUE_MAX 8
+#define SIM_LINK_MS 2
+
+typedef struct {
+	u32 ADDR;		//Destination on the TX side, source on the RX side, as on the wire
+	u8 CONN_RESET;
+	u8 LENGTH;
+	u8 DATA[DSC_DATAGRAM_MAX];
+} SimDatagram_t;
+
+class CC85xxSim {
+public:
+	u32 wireId;			//Device ID as it appears on the wire (DEVICE_ID fields, DSC addresses)
+	u8 txQueueMax;		//DSC transmit queue, in datagrams, EVT_DSC_TX_AVAIL while not full
+	u8 rxQueueMax;		//DSC receive queue, datagrams arriving when full are dropped
+	u8 dscReset;		//EVT_DSC_RESET
+	u8 status[NWM_STATUS_LENGTH];	//NWM_GET_STATUS_S result
+	u8 audioChan[16];	//Last NWM_ACH_SET_USAGE
+	u16 audioChanSets;
+	u32 commands;		//EHIF operations the host has issued
+	u32 txOverflows;	//DSC_TX_DATAGRAM with the queue full
+	u32 rxDropped;		//Datagrams lost on the air or to a full receive queue
+
+	SimDatagram_t txQueue[SIM_QUEUE_MAX];
+	u8 txCount;
+	SimDatagram_t rxQueue[SIM_QUEUE_MAX];
+	u8 rxCount;
+	u32 nextLink;
+
+	CC85xxSim(u32);
+	static void select(CC85xxSim*);
+	static CC85xxSim* selected();
+	void inject(u32, u8*, u8);
+	u8 take(SimDatagram_t*);
+	u8 receive(SimDatagram_t*);
+	void queue(u32, u8*, u8);
+	StatusWord_t getStatus();
+};
+
+extern double linkLoss;
+
+void simLink(CC85xxSim**, u8);
+
+#endif
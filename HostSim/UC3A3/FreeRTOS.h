@@ -0,0 +1,23 @@
+#ifndef _HOSTSIM_FREERTOS_H_INCLUDED
+#define _HOSTSIM_FREERTOS_H_INCLUDED
+
+//Host stand-in for the FreeRTOS 7 names the UC3A3 modules run on a PC use. There is no scheduler: the
+//test program calls the module functions itself and defines the kernel functions they reach
+
+#include "compiler.h"
+
+typedef long portBASE_TYPE;
+typedef unsigned long portTickType;
+typedef void (*pdTASK_CODE)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define portMAX_DELAY ((portTickType)-1)
+#define portTICK_RATE_MS 1
+#define tskIDLE_PRIORITY 0
+#define configMINIMAL_STACK_SIZE 256
+
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _HOSTSIM_COMPILER_H_INCLUDED
+#define _HOSTSIM_COMPILER_H_INCLUDED
+
+//Host stand-in for the ASF compiler.h and the AVR32 part header, with just what the UC3A3 modules that
+//run on a PC (reg_map.c) need from them
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+	uint32_t written;	//Bytes the test program saw written
+} avr32_spi_t;
+
+extern volatile avr32_spi_t AVR32_SPI0;
+extern volatile avr32_spi_t AVR32_SPI1;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _HOSTSIM_CYCLE_COUNTER_H_INCLUDED
+#define _HOSTSIM_CYCLE_COUNTER_H_INCLUDED
+
+//Host stand-in for the ASF cycle counter, the test program defines the count
+
+#include "compiler.h"
+
+extern uint32_t Get_sys_count(void);
+
+#endif
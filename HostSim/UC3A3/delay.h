@@ -0,0 +1,10 @@
+#ifndef _HOSTSIM_DELAY_H_INCLUDED
+#define _HOSTSIM_DELAY_H_INCLUDED
+
+//Host stand-in for the ASF delay service, the test programs define delay_us
+
+#include "compiler.h"
+
+void delay_us(uint32_t us);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _HOSTSIM_GPIO_H_INCLUDED
+#define _HOSTSIM_GPIO_H_INCLUDED
+
+//Host stand-in for the ASF gpio.h, nothing the modules run on a PC use from it
+
+#include "compiler.h"
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _HOSTSIM_POWER_CLOCKS_LIB_H_INCLUDED
+#define _HOSTSIM_POWER_CLOCKS_LIB_H_INCLUDED
+
+//Host stand-in for the ASF power_clocks_lib.h, nothing the modules run on a PC use from it
+
+#include "compiler.h"
+
+#endif
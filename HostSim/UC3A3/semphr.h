@@ -0,0 +1,21 @@
+#ifndef _HOSTSIM_SEMPHR_H_INCLUDED
+#define _HOSTSIM_SEMPHR_H_INCLUDED
+
+//Host stand-in for the FreeRTOS semaphores: a semaphore is a count the test program can look at.
+//Taking one never blocks, it fails if the count is 0. The test program defines the pool
+//(HOSTSIM_SEMAPHORES of them)
+
+#include "FreeRTOS.h"
+
+#define HOSTSIM_SEMAPHORES 8
+
+typedef volatile long *xSemaphoreHandle;
+
+extern volatile long hostsim_semaphores[HOSTSIM_SEMAPHORES];
+extern uint32_t hostsim_semaphores_used;
+
+#define vSemaphoreCreateBinary(s)	((s) = &hostsim_semaphores[hostsim_semaphores_used++], *(s) = 1)
+#define xSemaphoreTake(s, t)		((*(s) > 0) ? (--*(s), pdTRUE) : pdFALSE)
+#define xSemaphoreGive(s)			((*(s) < 1) ? (++*(s), pdTRUE) : pdFALSE)
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _HOSTSIM_SPI_MASTER_H_INCLUDED
+#define _HOSTSIM_SPI_MASTER_H_INCLUDED
+
+//Host stand-in for the ASF SPI master service, the test programs define the functions they reach
+
+#include "compiler.h"
+
+struct spi_device {
+	uint8_t id;
+};
+
+void spi_select_device(volatile avr32_spi_t *spi, struct spi_device *device);
+void spi_deselect_device(volatile avr32_spi_t *spi, struct spi_device *device);
+void spi_write_single(volatile avr32_spi_t *spi, uint8_t data);
+void spi_read_single(volatile avr32_spi_t *spi, uint8_t *data);
+bool spi_is_rx_full(volatile avr32_spi_t *spi);
+
+#endif
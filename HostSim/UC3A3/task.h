@@ -0,0 +1,8 @@
+#ifndef _HOSTSIM_TASK_H_INCLUDED
+#define _HOSTSIM_TASK_H_INCLUDED
+
+//Host stand-in for the FreeRTOS task API, see FreeRTOS.h
+
+#include "FreeRTOS.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _HOSTSIM_WPROGRAM_H_INCLUDED
+#define _HOSTSIM_WPROGRAM_H_INCLUDED
+
+#include "Arduino.h"
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _HOSTSIM_PGMSPACE_H_INCLUDED
+#define _HOSTSIM_PGMSPACE_H_INCLUDED
+
+//Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+#endif
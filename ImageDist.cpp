@@ -0,0 +1,550 @@
+#include "WProgram.h"
+#include "ImageDist.h"
+
+ImageDistClass ImageDist;
+
+//Slave not staging anything, never reported
+#define IMG_STATE_IDLE 0xFF
+
+StatusWord_t ImageDistClass::status;
+File ImageDistClass::image;
+u32 ImageDistClass::imageId;
+u16 ImageDistClass::imageSize;
+u8 ImageDistClass::imageKind;
+u8 ImageDistClass::nextSlave;
+Img_slave_t ImageDistClass::slaves[IMG_MAX_SLAVES];
+
+File ImageDistClass::stage;
+u32 ImageDistClass::masterAddr;
+u32 ImageDistClass::doneId;
+u16 ImageDistClass::staged;
+u8 ImageDistClass::slaveState = IMG_STATE_IDLE;
+u8 ImageDistClass::statusPending;
+u8 ImageDistClass::sinceAck;
+u8 ImageDistClass::gapSent;
+void (*ImageDistClass::configHandler)(File&);
+
+u8 ImageDistClass::tx[DSC_DATAGRAM_MAX];
+
+//CRC-32 (IEEE 802.3, reflected), four bits at a time
+static const u32 crcTable[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+//////////////////////////////////////////////////////////
+//Common
+//////////////////////////////////////////////////////////
+
+u32 ImageDistClass::crc(File& dataFile, u16 nLength) {
+//Returns the CRC-32 of the next nLength bytes of dataFile
+	u32 nCrc = 0xFFFFFFFF;
+	u8 nData;
+
+	while (nLength--) {
+		nData = dataFile.read();
+		nCrc = (nCrc >> 4) ^ crcTable[(nCrc ^ nData) & 0x0F];
+		nCrc = (nCrc >> 4) ^ crcTable[(nCrc ^ (nData >> 4)) & 0x0F];
+	}
+
+	return ~nCrc;
+}
+
+void ImageDistClass::put32(u8* pData, u32 nValue) {
+//Stores nValue big-endian
+	pData[0] = nValue >> 24;
+	pData[1] = nValue >> 16;
+	pData[2] = nValue >> 8;
+	pData[3] = nValue;
+}
+
+u32 ImageDistClass::get32(u8* pData) {
+//Loads a big-endian value
+	return ((u32)pData[0] << 24) | ((u32)pData[1] << 16) | ((u32)pData[2] << 8) | pData[3];
+}
+
+u8 ImageDistClass::receive(DSC_rx_data_t* pData) {
+//Checks a datagram from DSCMux. Returns its message type, 0 if it is too short to be one
+	if (pData->LENGTH < 8) return 0;
+	return pData->DATA[0];
+}
+
+void ImageDistClass::send(u32 nAddr, u8 nLength) {
+//Sends the first nLength bytes of tx to nAddr, a device ID as it appears on the wire
+	DSCMux.send(nAddr, tx, nLength);
+}
+
+//////////////////////////////////////////////////////////
+//Master
+//////////////////////////////////////////////////////////
+
+u8 ImageDistClass::beginMaster(File imageFile, u8 nKind, EHIF_mask_t* pMask) {
+//Starts distributing imageFile to every slave with a data side channel, the ones that join later
+//included. Pass the network status on the next serviceMaster() call. Returns 0 if the image is empty
+//or too large
+	u32 nSize = imageFile.size();
+	u8 i;
+
+	if (!nSize || nSize > 0xFFFF) return 0;
+
+	image = imageFile;
+	imageSize = nSize;
+	imageKind = nKind;
+	image.seek(0);
+	imageId = crc(image, imageSize);
+
+	for (i=0; i<IMG_MAX_SLAVES; i++) slaves[i].state = IMG_SLAVE_NONE;
+	nextSlave = 0;
+
+	DSCMux.attach(IMG_MSG_STATUS, masterReceive);
+	DSCMux.setMask(pMask);
+	return 1;
+}
+
+void ImageDistClass::end() {
+//Stops distributing. The slaves keep what they have staged and resume if the same image comes again
+	imageSize = 0;
+}
+
+void ImageDistClass::serviceMaster(StatusWord_t nStatus, Master_status_t* pMaster) {
+//Call with a fresh status word when the EHIF interrupt is active, and from loop() for the timeouts.
+//pMaster: the latest network status after a network change, NULL if it has not been read again.
+//Every pass offers one datagram to each slave in turn, so all of them progress together
+	u8 i, n;
+
+	status = nStatus;
+
+	if (pMaster) syncSlaves(pMaster);
+
+	status = DSCMux.service(status);
+
+	if (!imageSize) return;
+
+	for (i=0; i<IMG_MAX_SLAVES && status.B.EVT_DSC_TX_AVAIL; i++) {
+		n = nextSlave;
+		nextSlave = (nextSlave + 1) % IMG_MAX_SLAVES;
+		if (serveSlave(n)) status = CC8531.getStatus();
+	}
+}
+
+void ImageDistClass::syncSlaves(Master_status_t* pMaster) {
+//Matches the slaves in the network status against the table. Entries of slaves that left are kept
+//while there is room, so a slave that comes back resumes where it left off
+	Img_slave_t* s;
+	u32 nId;
+	u8 nWasPresent = 0;
+	u8 i, j, nFree;
+
+	if (!imageSize) return;
+
+	//Bit i: entry i was listed last time, so a slave missing from this list has really left
+	for (i=0; i<IMG_MAX_SLAVES; i++) {
+		if (slaves[i].present) nWasPresent |= 1 << i;
+		slaves[i].present = 0;
+	}
+
+	for (i=0; i<6; i++) {
+		nId = pMaster->slaveStatus[i].DEVICE_ID;
+		if (!nId || !pMaster->slaveStatus[i].WPS_DSC_EN) continue;
+
+		//Known slave, else an empty entry, else one of a slave that has left
+		nFree = IMG_MAX_SLAVES;
+		for (j=0; j<IMG_MAX_SLAVES; j++) {
+			if (slaves[j].state != IMG_SLAVE_NONE && slaves[j].DEVICE_ID == nId) break;
+			if (nFree == IMG_MAX_SLAVES && slaves[j].state == IMG_SLAVE_NONE) nFree = j;
+		}
+		if (j == IMG_MAX_SLAVES) {
+			for (j=0; nFree == IMG_MAX_SLAVES && j<IMG_MAX_SLAVES; j++) {
+				if (!slaves[j].present) nFree = j;
+			}
+			if (nFree == IMG_MAX_SLAVES) continue;
+			j = nFree;
+			slaves[j].DEVICE_ID = nId;
+			slaves[j].state = IMG_SLAVE_NONE;
+		}
+		s = &slaves[j];
+
+		//New or back after a drop: ask for its offset before sending more
+		if (s->state == IMG_SLAVE_NONE) {
+			s->ackOffset = s->sendOffset = 0;
+			s->attempts = 0;
+		}
+		if (s->state == IMG_SLAVE_NONE || (s->state == IMG_SLAVE_SENDING && !(nWasPresent & (1 << j)))) {
+			s->state = IMG_SLAVE_ANNOUNCE;
+			s->lastAnnounce = millis() - IMG_ANNOUNCE_MS;
+		}
+		s->present = 1;
+	}
+}
+
+void ImageDistClass::masterReceive(DSC_rx_data_t* pData) {
+//Handles a STATUS from a slave
+	Img_slave_t* s = NULL;
+	u8* d = pData->DATA;
+	u16 nOffset;
+	u8 i;
+
+	if (receive(pData) != IMG_MSG_STATUS || !imageSize || get32(d + 1) != imageId) return;
+
+	for (i=0; i<IMG_MAX_SLAVES; i++) {
+		if (slaves[i].state != IMG_SLAVE_NONE && slaves[i].DEVICE_ID == pData->ADDR) s = &slaves[i];
+	}
+	if (!s || s->state == IMG_SLAVE_DONE || s->state == IMG_SLAVE_FAILED) return;
+
+	nOffset = ((u16)d[5] << 8) | d[6];
+	if (nOffset > imageSize) return;
+	s->lastHeard = millis();
+
+	switch (d[7]) {
+		case IMG_STATE_RECEIVING:
+			//Statuses arrive in order, so a lower offset means the slave lost unsaved data
+			s->ackOffset = nOffset;
+			if (s->state == IMG_SLAVE_ANNOUNCE || s->sendOffset < nOffset) s->sendOffset = nOffset;
+			s->state = IMG_SLAVE_SENDING;
+			break;
+		case IMG_STATE_GAP:
+			s->ackOffset = s->sendOffset = nOffset;
+			s->state = IMG_SLAVE_SENDING;
+			break;
+		case IMG_STATE_VERIFIED:
+			s->ackOffset = s->sendOffset = imageSize;
+			s->state = IMG_SLAVE_INSTALLING;
+			s->lastAnnounce = millis();
+			break;
+		case IMG_STATE_DONE:
+			s->state = IMG_SLAVE_DONE;
+			break;
+		case IMG_STATE_FAILED:
+			//The slave has dropped its copy, start over a limited number of times
+			if (++s->attempts >= IMG_MAX_ATTEMPTS) {
+				s->state = IMG_SLAVE_FAILED;
+				break;
+			}
+			s->ackOffset = s->sendOffset = 0;
+			s->state = IMG_SLAVE_ANNOUNCE;
+			s->lastAnnounce = millis() - IMG_ANNOUNCE_MS;
+			break;
+	}
+}
+
+u8 ImageDistClass::serveSlave(u8 n) {
+//Sends the next datagram slave n needs, if any. Returns 1 if one was sent
+	Img_slave_t* s = &slaves[n];
+	u32 nNow = millis();
+	u16 nLength;
+
+	if (!s->present) return 0;
+
+	//No word from the slave: send again from what it last reported, and if that does not help go back
+	//to announcing, its answer gives the offset to resume from
+	if (s->state == IMG_SLAVE_SENDING && nNow - s->lastHeard >= IMG_RETX_MS) {
+		if (nNow - s->lastHeard >= IMG_TIMEOUT_MS) {
+			s->sendOffset = s->ackOffset;
+			s->state = IMG_SLAVE_ANNOUNCE;
+			s->lastAnnounce = nNow - IMG_ANNOUNCE_MS;
+		}
+		else if (nNow - s->lastRetx >= IMG_RETX_MS) {
+			s->sendOffset = s->ackOffset;
+			s->lastRetx = nNow;
+		}
+	}
+
+	switch (s->state) {
+		case IMG_SLAVE_ANNOUNCE:
+		case IMG_SLAVE_INSTALLING:
+			//While installing, the answer is DONE once the slave is back
+			if (nNow - s->lastAnnounce < IMG_ANNOUNCE_MS) return 0;
+			tx[0] = IMG_MSG_ANNOUNCE;
+			put32(tx + 1, imageId);
+			tx[5] = imageSize >> 8;
+			tx[6] = imageSize;
+			tx[7] = imageKind;
+			send(s->DEVICE_ID, 8);
+			s->lastAnnounce = nNow;
+			return 1;
+
+		case IMG_SLAVE_SENDING:
+			if (s->sendOffset >= imageSize) return 0;
+			if (s->sendOffset - s->ackOffset >= IMG_WINDOW * IMG_CHUNK_MAX) return 0;
+
+			nLength = imageSize - s->sendOffset;
+			if (nLength > IMG_CHUNK_MAX) nLength = IMG_CHUNK_MAX;
+
+			tx[0] = IMG_MSG_DATA;
+			put32(tx + 1, imageId);
+			tx[5] = s->sendOffset >> 8;
+			tx[6] = s->sendOffset;
+			image.seek(s->sendOffset);
+			image.read(tx + IMG_DATA_HDR, nLength);
+			send(s->DEVICE_ID, IMG_DATA_HDR + nLength);
+			s->sendOffset += nLength;
+			return 1;
+	}
+
+	return 0;
+}
+
+Img_slave_t* ImageDistClass::getSlave(u8 n) {
+//Returns the progress of table entry n, for display
+	return &slaves[n];
+}
+
+u8 ImageDistClass::pending() {
+//Returns the number of slaves that have not yet installed or given up on the image. Slaves that have
+//left count until they come back, a slave installing CC85xx firmware is away for a while
+	u8 nCount = 0;
+	u8 i;
+
+	for (i=0; i<IMG_MAX_SLAVES; i++) {
+		if (slaves[i].state >= IMG_SLAVE_ANNOUNCE && slaves[i].state <= IMG_SLAVE_INSTALLING) nCount++;
+	}
+
+	return nCount;
+}
+
+//////////////////////////////////////////////////////////
+//Slave
+//////////////////////////////////////////////////////////
+
+void ImageDistClass::beginSlave(void (*pHandler)(File&), EHIF_mask_t* pMask) {
+//Starts accepting images. Config images are passed to pHandler, positioned at their first byte.
+//A partly staged image from before a power cycle is picked up again
+	File f;
+	u8 pHdr[IMG_STAGE_HDR];
+
+	configHandler = pHandler;
+	doneId = 0;
+	slaveState = IMG_STATE_IDLE;
+	statusPending = 0;
+
+	f = SD.open(IMG_DONE_FILE, FILE_READ);
+	if (f) {
+		if (f.read(pHdr, 4) == 4) doneId = get32(pHdr);
+		f.close();
+	}
+
+	f = SD.open(IMG_STAGE_FILE, FILE_READ);
+	if (f) {
+		if (f.read(pHdr, IMG_STAGE_HDR) == IMG_STAGE_HDR) {
+			imageId = get32(pHdr);
+			imageSize = ((u16)pHdr[4] << 8) | pHdr[5];
+			imageKind = pHdr[6];
+			if (f.size() - IMG_STAGE_HDR <= imageSize) {
+				staged = f.size() - IMG_STAGE_HDR;
+				slaveState = IMG_STATE_RECEIVING;
+			}
+		}
+		f.close();
+	}
+
+	if (slaveState == IMG_STATE_RECEIVING) {
+		stage = SD.open(IMG_STAGE_FILE, FILE_WRITE);
+		//All there before the power cycle: no DATA will come to complete it, so check it now.
+		//serviceSlave then installs it, or the master starts over on FAILED
+		if (staged == imageSize) verify();
+	}
+	else SD.remove(IMG_STAGE_FILE);
+
+	DSCMux.attach(IMG_MSG_ANNOUNCE, slaveReceive);
+	DSCMux.attach(IMG_MSG_DATA, slaveReceive);
+	DSCMux.setMask(pMask);
+}
+
+void ImageDistClass::serviceSlave(StatusWord_t nStatus) {
+//Call with a fresh status word when the EHIF interrupt is active. A complete image is installed once
+//the VERIFIED status has been handed to the CC8531
+	status = DSCMux.service(nStatus);
+
+	if (statusPending && status.B.EVT_DSC_TX_AVAIL) sendStatus();
+
+	if (slaveState == IMG_STATE_VERIFIED && !statusPending) install();
+}
+
+void ImageDistClass::slaveReceive(DSC_rx_data_t* pData) {
+//Handles an ANNOUNCE or DATA from the master
+	u8* d = pData->DATA;
+	u32 nId;
+	u16 nValue;
+	u8 nLength;
+
+	switch (receive(pData)) {
+		case IMG_MSG_ANNOUNCE:
+			nId = get32(d + 1);
+			nValue = ((u16)d[5] << 8) | d[6];
+			masterAddr = pData->ADDR;
+
+			if (nId == doneId) {
+				if (stage) stage.close();
+				SD.remove(IMG_STAGE_FILE);
+				slaveState = IMG_STATE_DONE;
+				imageId = nId;
+				staged = imageSize = nValue;
+			}
+			else if (nId != imageId || slaveState == IMG_STATE_IDLE || slaveState == IMG_STATE_FAILED
+					|| slaveState == IMG_STATE_DONE) {
+				openStage(nId, nValue, d[7]);
+			}
+			statusPending = 1;
+			break;
+
+		case IMG_MSG_DATA:
+			if (get32(d + 1) != imageId) return;
+			if (slaveState != IMG_STATE_RECEIVING && slaveState != IMG_STATE_GAP) {
+				//Late copies after the last chunk: the master only needs the state again
+				statusPending = 1;
+				return;
+			}
+
+			nValue = ((u16)d[5] << 8) | d[6];
+			nLength = pData->LENGTH - IMG_DATA_HDR;
+
+			//Only in order. Ahead means something was lost: say so once, then wait for the resend
+			if (nValue != staged) {
+				if (nValue > staged && !gapSent) {
+					gapSent = 1;
+					slaveState = IMG_STATE_GAP;
+					statusPending = 1;
+				}
+				//A resend of staged data: the master missed our last status
+				if (nValue < staged) statusPending = 1;
+				return;
+			}
+			if (nLength > imageSize - staged) nLength = imageSize - staged;
+
+			stage.write(d + IMG_DATA_HDR, nLength);
+			staged += nLength;
+			gapSent = 0;
+			slaveState = IMG_STATE_RECEIVING;
+
+			if (staged == imageSize) {
+				verify();
+				return;
+			}
+			if (++sinceAck >= IMG_ACK_EVERY) {
+				//What has been acknowledged must survive a power cycle
+				stage.flush();
+				sinceAck = 0;
+				statusPending = 1;
+			}
+			break;
+	}
+}
+
+void ImageDistClass::openStage(u32 nId, u16 nSize, u8 nKind) {
+//Drops whatever was staged and starts on image nId
+	u8 pHdr[IMG_STAGE_HDR];
+
+	if (stage) stage.close();
+	SD.remove(IMG_STAGE_FILE);
+
+	imageId = nId;
+	imageSize = nSize;
+	imageKind = nKind;
+	staged = 0;
+	sinceAck = gapSent = 0;
+
+	put32(pHdr, nId);
+	pHdr[4] = nSize >> 8;
+	pHdr[5] = nSize;
+	pHdr[6] = nKind;
+
+	stage = SD.open(IMG_STAGE_FILE, FILE_WRITE);
+	if (!stage || stage.write(pHdr, IMG_STAGE_HDR) != IMG_STAGE_HDR) {
+		fail();
+		return;
+	}
+	stage.flush();
+	slaveState = IMG_STATE_RECEIVING;
+}
+
+void ImageDistClass::verify() {
+//Checks the staged image against its ID, the CRC-32 the master computed
+	stage.close();
+	stage = SD.open(IMG_STAGE_FILE, FILE_READ);
+	if (!stage) {
+		fail();
+		return;
+	}
+
+	stage.seek(IMG_STAGE_HDR);
+	if (crc(stage, imageSize) != imageId) {
+		fail();
+		return;
+	}
+
+	slaveState = IMG_STATE_VERIFIED;
+	statusPending = 1;
+}
+
+void ImageDistClass::install() {
+//Installs the verified image. A CC85xx image goes through the SPI bootloader, which checks the flash
+//against the CRC inside the image as well. The CC85xx restarts and leaves the network, so the master
+//learns of the result from the answer to its next ANNOUNCE. Without working firmware it cannot rejoin,
+//so a failed programming is retried from the staged copy first
+	File f;
+	StatusWord_t nStatus;
+	u8 pId[4];
+	u8 i;
+
+	if (imageKind == IMG_KIND_CC85XX) {
+		for (i=0; i<IMG_MAX_ATTEMPTS; i++) {
+			stage.seek(IMG_STAGE_HDR);
+			nStatus = CC8531.flashFile(stage, imageSize);
+			if (nStatus.nStatus == BL_VERIFY_OK) break;
+		}
+		if (i == IMG_MAX_ATTEMPTS) {
+			fail();
+			return;
+		}
+	}
+	else if (configHandler) {
+		stage.seek(IMG_STAGE_HDR);
+		configHandler(stage);
+	}
+
+	stage.close();
+	SD.remove(IMG_STAGE_FILE);
+
+	doneId = imageId;
+	put32(pId, doneId);
+	SD.remove(IMG_DONE_FILE);
+	f = SD.open(IMG_DONE_FILE, FILE_WRITE);
+	if (f) {
+		f.write(pId, 4);
+		f.close();
+	}
+
+	slaveState = IMG_STATE_DONE;
+	statusPending = 1;
+}
+
+void ImageDistClass::fail() {
+//Drops the staged copy and reports FAILED. The master decides whether to start over
+	if (stage) stage.close();
+	SD.remove(IMG_STAGE_FILE);
+
+	slaveState = IMG_STATE_FAILED;
+	statusPending = 1;
+}
+
+void ImageDistClass::sendStatus() {
+//Reports the image ID, the bytes staged and the state to the master
+	if (slaveState == IMG_STATE_IDLE || !masterAddr) {
+		statusPending = 0;
+		return;
+	}
+
+	tx[0] = IMG_MSG_STATUS;
+	put32(tx + 1, imageId);
+	tx[5] = staged >> 8;
+	tx[6] = staged;
+	tx[7] = slaveState;
+	send(masterAddr, 8);
+
+	statusPending = 0;
+}
+
+u8 ImageDistClass::getSlaveState() {
+//Returns the IMG_STATE of the image being received, 0xFF if there is none
+	return slaveState;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef _IMAGEDIST_H_INCLUDED
+#define _IMAGEDIST_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include <SD.h>
+#include "CC8531.h"
+#include "DSCMux.h"
+
+//Distributes a firmware or configuration image from the master host to the hosts of all connected
+//slaves over the data side channel. Datagrams go through DSCMux, so it runs next to the other DSCMux
+//protocols but not next to DSCTransport. Each datagram is one message, multi-byte fields big-endian:
+//	ANNOUNCE	master -> slave	type, image ID (4), size (2), kind
+//	DATA		master -> slave	type, image ID (4), offset (2), data
+//	STATUS		slave -> master	type, image ID (4), bytes staged (2), state
+//The image ID is the CRC-32 of the image. Slaves stage it in IMG_STAGE_FILE, only accept data in
+//order and report their staged length, so a slave that drops out resumes where it left off
+#define IMG_MSG_ANNOUNCE 'A'
+#define IMG_MSG_DATA 'D'
+#define IMG_MSG_STATUS 'S'
+
+#define IMG_DATA_HDR 7
+#define IMG_CHUNK_MAX (DSC_DATAGRAM_MAX - IMG_DATA_HDR)
+
+//Image kinds
+#define IMG_KIND_CC85XX 0	//CC85xx flash image, programmed through the SPI bootloader
+#define IMG_KIND_CONFIG 1	//Host configuration, handed to the config handler
+
+//Slave states, as reported in STATUS
+#define IMG_STATE_RECEIVING 0	//Bytes staged so far
+#define IMG_STATE_GAP 1			//Data arrived beyond the bytes staged, resend from there
+#define IMG_STATE_VERIFIED 2	//Complete and CRC checked, installing
+#define IMG_STATE_DONE 3		//Installed
+#define IMG_STATE_FAILED 4		//CRC or install failed, the staged copy was dropped
+
+//Master per-slave progress
+#define IMG_SLAVE_NONE 0		//Slot empty, or slave without data side channel
+#define IMG_SLAVE_ANNOUNCE 1	//Waiting for the first STATUS
+#define IMG_SLAVE_SENDING 2
+#define IMG_SLAVE_INSTALLING 3
+#define IMG_SLAVE_DONE 4
+#define IMG_SLAVE_FAILED 5
+
+#define IMG_MAX_SLAVES 6
+
+//Data sent ahead of the last STATUS per slave, in chunks. The slave sends STATUS every IMG_ACK_EVERY
+#define IMG_WINDOW 4
+#define IMG_ACK_EVERY 2
+
+//Silence after which the master sends again from the last reported offset, and after which it goes
+//back to announcing. ANNOUNCE repeat interval
+#define IMG_RETX_MS 100
+#define IMG_TIMEOUT_MS 1000
+#define IMG_ANNOUNCE_MS 500
+
+//A slave that fails verification this many times is given up on
+#define IMG_MAX_ATTEMPTS 3
+
+//Slave staging file: image ID (4), size (2), kind, then the image. Once installed it is removed and
+//the image ID goes to IMG_DONE_FILE, so that the slave answers a later ANNOUNCE of it with DONE
+#define IMG_STAGE_FILE "IMGSTAGE.BIN"
+#define IMG_STAGE_HDR 7
+#define IMG_DONE_FILE "IMGDONE.BIN"
+
+//Master view of one slave
+typedef struct {
+	u32 DEVICE_ID;	//As in Master_status_t, big-endian
+	u16 sendOffset;	//Next byte to send
+	u16 ackOffset;	//Bytes the slave has reported staged
+	u32 lastHeard;	//millis() of the last STATUS
+	u32 lastRetx;	//millis() of the last go back to ackOffset
+	u32 lastAnnounce;
+	u8 state;
+	u8 attempts;	//Failed verifications
+	u8 present;		//Listed in the last Master_status_t
+} Img_slave_t;
+
+class ImageDistClass {
+private:
+	static StatusWord_t status;
+	static File image;
+	static u32 imageId;
+	static u16 imageSize;
+	static u8 imageKind;
+	static u8 nextSlave;
+	static Img_slave_t slaves[IMG_MAX_SLAVES];
+
+	static File stage;
+	static u32 masterAddr;
+	static u32 doneId;
+	static u16 staged;
+	static u8 slaveState;
+	static u8 statusPending;
+	static u8 sinceAck;
+	static u8 gapSent;
+	static void (*configHandler)(File&);
+
+	static u8 tx[DSC_DATAGRAM_MAX];
+
+	static void put32(u8*, u32);
+	static u32 get32(u8*);
+	static u8 receive(DSC_rx_data_t*);
+	static void send(u32, u8);
+
+	static void syncSlaves(Master_status_t*);
+	static void masterReceive(DSC_rx_data_t*);
+	static u8 serveSlave(u8);
+
+	static void slaveReceive(DSC_rx_data_t*);
+	static void openStage(u32, u16, u8);
+	static void verify();
+	static void install();
+	static void fail();
+	static void sendStatus();
+public:
+	static u32 crc(File&, u16);
+
+	static u8 beginMaster(File, u8, EHIF_mask_t*);
+	static void end();
+	static void serviceMaster(StatusWord_t, Master_status_t*);
+	static Img_slave_t* getSlave(u8);
+	static u8 pending();
+
+	static void beginSlave(void (*)(File&), EHIF_mask_t*);
+	static void serviceSlave(StatusWord_t);
+	static u8 getSlaveState();
+};
+
+extern ImageDistClass ImageDist;
+
+#endif
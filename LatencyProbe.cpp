@@ -0,0 +1,185 @@
+#include "WProgram.h"
+#include "LatencyProbe.h"
+
+LatencyProbeClass LatencyProbe;
+
+volatile u32 LatencyProbeClass::triggerTime;
+volatile u8 LatencyProbeClass::triggered;
+u32 LatencyProbeClass::burstStart;
+u8 LatencyProbeClass::burstOn;
+Latency_stats_t LatencyProbeClass::stats;
+
+//////////////////////////////////////////////////////////
+//Setup
+//////////////////////////////////////////////////////////
+
+void LatencyProbeClass::beginMaster() {
+//Master side: drives the trigger line and generates the bursts
+	pinMode(LATENCY_TRIGGER_PIN, OUTPUT);
+	digitalWrite(LATENCY_TRIGGER_PIN, LOW);
+	burstOn = 0;
+	clear();
+}
+
+void LatencyProbeClass::beginSlave() {
+//Slave side: timestamps the trigger edge and polls the tone detector
+	pinMode(LATENCY_TRIGGER_PIN, INPUT);
+	triggered = 0;
+	clear();
+	attachInterrupt(LATENCY_TRIGGER_INT, triggerISR, RISING);
+}
+
+void LatencyProbeClass::triggerISR() {
+//Rising edge on the trigger line: the master has just started a burst
+	triggerTime = micros();
+	triggered = 1;
+}
+
+//////////////////////////////////////////////////////////
+//Measurement
+//////////////////////////////////////////////////////////
+
+u8 LatencyProbeClass::sendBurst() {
+//Master: starts one LATENCY_BURST_MS tone burst and marks its start on the trigger line. serviceMaster()
+//ends it. Returns 0 if the previous burst is still playing
+	Audio_tone_t tone;
+
+	if (burstOn) return 0;
+
+	tone.CHANNEL = LATENCY_TONE_CHANNEL;
+	tone.AMP_TONE = LATENCY_TONE_AMP;
+	//EHIF fields are big-endian on the wire
+	tone.FREQ_TONE = (LATENCY_TONE_FREQ << 8) | (LATENCY_TONE_FREQ >> 8);
+
+	//The tone starts once the command has been executed, so raise the trigger right after it
+	CC8531.AudioTest.genTone(&tone);
+	digitalWrite(LATENCY_TRIGGER_PIN, HIGH);
+
+	burstStart = millis();
+	burstOn = 1;
+	return 1;
+}
+
+void LatencyProbeClass::serviceMaster() {
+//Master: call from loop(). Stops the burst once it has played for LATENCY_BURST_MS
+	Audio_tone_t tone;
+
+	if (!burstOn || millis() - burstStart < LATENCY_BURST_MS) return;
+
+	tone.CHANNEL = LATENCY_TONE_CHANNEL;
+	tone.AMP_TONE = 0;
+	tone.FREQ_TONE = (LATENCY_TONE_FREQ << 8) | (LATENCY_TONE_FREQ >> 8);
+	CC8531.AudioTest.genTone(&tone);
+	digitalWrite(LATENCY_TRIGGER_PIN, LOW);
+
+	burstOn = 0;
+}
+
+u8 LatencyProbeClass::poll() {
+//Slave: call as often as possible from loop(). Returns 1 when a burst has been measured or missed
+//Resolution is one AT_DET_TONE round trip (a few hundred us), on top of the detector's own settling
+	u8 nChannel = LATENCY_TONE_CHANNEL;
+	Audio_det_t det;
+	u32 nElapsed;
+	s16 nFreqErr;
+
+	if (!triggered) return 0;
+
+	nElapsed = micros() - triggerTime;
+
+	CC8531.AudioTest.detectTone(&nChannel, &det);
+
+	//Detector output is big-endian too
+	det.AMP_TONE = (det.AMP_TONE << 8) | (det.AMP_TONE >> 8);
+	det.FREQ_TONE = (det.FREQ_TONE << 8) | (det.FREQ_TONE >> 8);
+	nFreqErr = (s16)det.FREQ_TONE - LATENCY_TONE_FREQ;
+
+	if ((det.AMP_TONE >= LATENCY_DET_AMP_MIN) && (nFreqErr <= LATENCY_DET_FREQ_TOL) && (nFreqErr >= -LATENCY_DET_FREQ_TOL)) {
+		addSample(nElapsed);
+		triggered = 0;
+		return 1;
+	}
+
+	if (nElapsed > LATENCY_TIMEOUT_US) {
+		stats.missed++;
+		triggered = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+void LatencyProbeClass::addSample(u32 nLatency) {
+//Adds one measurement to the statistics
+	u32 nBin = 0;
+
+	if (nLatency > LATENCY_BIN_START_US) nBin = (nLatency - LATENCY_BIN_START_US) / LATENCY_BIN_US;
+	if (nBin >= LATENCY_NUM_BINS) nBin = LATENCY_NUM_BINS - 1;
+	stats.bins[nBin]++;
+
+	if (!stats.count || nLatency < stats.min) stats.min = nLatency;
+	if (nLatency > stats.max) stats.max = nLatency;
+	stats.sum += nLatency;
+	stats.count++;
+}
+
+//////////////////////////////////////////////////////////
+//Results
+//////////////////////////////////////////////////////////
+
+void LatencyProbeClass::clear() {
+//Clears the statistics
+	memset(&stats, 0, sizeof(stats));
+}
+
+Latency_stats_t* LatencyProbeClass::getStats() {
+//Returns the statistics gathered so far
+	return &stats;
+}
+
+u32 LatencyProbeClass::getReportedLatency() {
+//Slave: returns the audio latency the CC8531 reports in NWM_GET_STATUS_S, in us (0 if not connected)
+	u8 nData[32];
+	u16 nLatency;
+	u16 nSampleRate;
+
+	CC8531.Network.getStatusSlave(nData);
+
+	//[24:25] tsPeriod[15:12] smplRate[11:0] (x25Hz), [26:27] nwkState[15:12] audioLatency[11:0] (samples)
+	nSampleRate = (((u16)nData[24] << 8) | nData[25]) & 0x0FFF;
+	nLatency = (((u16)nData[26] << 8) | nData[27]) & 0x0FFF;
+
+	if (!nSampleRate) return 0;
+
+	return ((u32)nLatency * 40000UL) / nSampleRate;
+}
+
+void LatencyProbeClass::report(Print& out) {
+//Prints the histogram and summary next to the latency the network reports
+	u32 nReported = getReportedLatency();
+	u16 i;
+
+	out.print("bursts: ");
+	out.print(stats.count);
+	out.print(" missed: ");
+	out.println(stats.missed);
+
+	if (stats.count) {
+		out.print("min/mean/max us: ");
+		out.print(stats.min);
+		out.print("/");
+		out.print(stats.sum / stats.count);
+		out.print("/");
+		out.println(stats.max);
+	}
+
+	out.print("reported (LATENCY) us: ");
+	out.println(nReported);
+
+	for (i=0; i<LATENCY_NUM_BINS; i++) {
+		if (!stats.bins[i]) continue;
+		out.print(i ? LATENCY_BIN_START_US + i * LATENCY_BIN_US : 0UL);	//Lower edge
+		out.print((i == LATENCY_NUM_BINS - 1) ? "+ us: " : " us: ");
+		out.println(stats.bins[i]);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef _LATENCYPROBE_H_INCLUDED
+#define _LATENCYPROBE_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+
+//Trigger line between the master and slave hosts (INT0 on the slave)
+#define LATENCY_TRIGGER_PIN 2
+#define LATENCY_TRIGGER_INT 0
+
+//Test burst: channel 0 (front left), 1kHz, 16-bit amplitude 0x4000
+#define LATENCY_TONE_CHANNEL 0
+#define LATENCY_TONE_AMP 0x40
+#define LATENCY_TONE_FREQ 100
+#define LATENCY_BURST_MS 100
+
+//Detection threshold on the AT_DET_TONE amplitude estimate and frequency tolerance (x10Hz)
+#define LATENCY_DET_AMP_MIN 0x1000
+#define LATENCY_DET_FREQ_TOL 10
+
+//A burst not seen within this time counts as missed
+#define LATENCY_TIMEOUT_US 200000UL
+
+//Histogram: LATENCY_NUM_BINS bins of LATENCY_BIN_US from LATENCY_BIN_START_US, 10 to 58ms, which brackets
+//the latency the network reports (getReportedLatency). The first bin also collects everything below,
+//the last everything above
+#define LATENCY_BIN_START_US 10000UL
+#define LATENCY_NUM_BINS 24
+#define LATENCY_BIN_US 2000
+
+//Latency statistics, all times in us
+typedef struct {
+	u16 count;
+	u16 missed;
+	u32 min;
+	u32 max;
+	u32 sum;
+	u16 bins[LATENCY_NUM_BINS];
+} Latency_stats_t;
+
+class LatencyProbeClass {
+private:
+	static volatile u32 triggerTime;
+	static volatile u8 triggered;
+	static u32 burstStart;
+	static u8 burstOn;
+	static void triggerISR();
+	static Latency_stats_t stats;
+	static void addSample(u32);
+public:
+	static void beginMaster();
+	static void beginSlave();
+
+	static u8 sendBurst();
+	static void serviceMaster();
+	static u8 poll();
+
+	static void clear();
+	static Latency_stats_t* getStats();
+	static u32 getReportedLatency();
+	static void report(Print&);
+};
+
+extern LatencyProbeClass LatencyProbe;
+
+#endif
@@ -0,0 +1,222 @@
+#include "WProgram.h"
+#include "RFManager.h"
+
+RFManagerClass RFManager;
+
+u8 RFManagerClass::enabled;
+u32 RFManagerClass::mask;
+u32 RFManagerClass::lastSample;
+u32 RFManagerClass::lastChange;
+u8 RFManagerClass::score[RF_NUM_CHANNELS];
+RFM_stats_t RFManagerClass::stats;
+
+//////////////////////////////////////////////////////////
+//Setup
+//////////////////////////////////////////////////////////
+
+void RFManagerClass::begin(u32 nMask) {
+//Starts managing the channel mask from nMask (bit n = RF channel n+1). The mask is set right away,
+//changes follow once there are statistics to go on
+	RF_stat_t rfStat;
+	u16 nLength = sizeof(rfStat);
+	u8 nCount = 0;
+	u8 i;
+
+	nMask &= RFM_ALL_CHANNELS;
+	for (i=0; i<RF_NUM_CHANNELS; i++) {
+		if (nMask & (1UL << i)) nCount++;
+		score[i] = 0;
+	}
+	if (nCount < RF_MIN_CHANNELS) nMask = RFM_ALL_CHANNELS;
+
+	memset(&stats, 0, sizeof(stats));
+	setMask(nMask);
+	stats.maskChanges = 0;
+
+	//Reading the statistics restarts them, the first sample then covers a whole interval
+	CC8531.Statistics.rfStats(&rfStat, &nLength);
+
+	lastSample = millis();
+	enabled = 1;
+}
+
+void RFManagerClass::end() {
+//Stops sampling and leaves the current mask in place
+	enabled = 0;
+}
+
+//////////////////////////////////////////////////////////
+//Sampling
+//////////////////////////////////////////////////////////
+
+void RFManagerClass::service() {
+//Call from loop(). Costs one PS_RF_STATS read per RFM_SAMPLE_MS, and a mask update when one is due
+	u32 nNow = millis();
+	u32 nMask;
+
+	if (!enabled || nNow - lastSample < RFM_SAMPLE_MS) return;
+	lastSample = nNow;
+
+	sample();
+
+	if (nNow - lastChange < RFM_HOLD_MS) return;
+	nMask = chooseMask();
+	if (nMask != mask) setMask(nMask);
+}
+
+u16 RFManagerClass::get16(u16 nValue) {
+//EHIF fields are big-endian on the wire
+	return (nValue << 8) | (nValue >> 8);
+}
+
+u32 RFManagerClass::get32(u32 nValue) {
+//EHIF fields are big-endian on the wire
+	return ((nValue & 0xFF) << 24) | ((nValue & 0xFF00) << 8) | ((nValue >> 8) & 0xFF00) | (nValue >> 24);
+}
+
+void RFManagerClass::sample() {
+//Reads the statistics of the last interval and updates the channel scores
+	RF_stat_t rfStat;
+	u16 nLength = sizeof(rfStat);
+	u32 nAttempts, nErrors;
+	u16 nSwaps;
+	s16 nScore;
+	u8 i;
+
+	memset(&rfStat, 0, sizeof(rfStat));
+	CC8531.Statistics.rfStats(&rfStat, &nLength);
+
+	nAttempts = get32(rfStat.RX_PKT_COUNT) + get32(rfStat.RX_SLICE_COUNT);
+	nErrors = get32(rfStat.RX_PKT_FAIL_COUNT) + get32(rfStat.RX_SLICE_ERR_COUNT);
+	nSwaps = get16(rfStat.AFH_SWAP_COUNT);
+
+	//No traffic (no slaves, or the network is down): nothing to learn from
+	if (!nAttempts) return;
+
+	stats.samples++;
+	stats.rxPkt += get32(rfStat.RX_PKT_COUNT);
+	stats.rxPktFail += get32(rfStat.RX_PKT_FAIL_COUNT);
+	stats.rxSlice += get32(rfStat.RX_SLICE_COUNT);
+	stats.rxSliceErr += get32(rfStat.RX_SLICE_ERR_COUNT);
+	stats.afhSwaps += nSwaps;
+
+	//Score of this interval
+	if (nErrors >= nAttempts / RFM_ERR_GAIN) nScore = 255;
+	else nScore = (nErrors * 256UL * RFM_ERR_GAIN) / nAttempts;
+	nScore += (nSwaps > 255 / RFM_SWAP_SCORE) ? 255 : nSwaps * RFM_SWAP_SCORE;
+	if (nScore > 255) nScore = 255;
+
+	//score[i] is RF channel i+1, the usage counters are indexed by channel number
+	for (i=0; i<RF_NUM_CHANNELS; i++) {
+		if (get16(rfStat.AFH_CH_USAGE[i + 1])) score[i] += (nScore - score[i]) >> RFM_EWMA_SHIFT;
+		else score[i] -= score[i] >> RFM_DECAY_SHIFT;
+	}
+}
+
+//////////////////////////////////////////////////////////
+//Channel mask
+//////////////////////////////////////////////////////////
+
+u32 RFManagerClass::chooseMask() {
+//Keeps enabled channels up to the drop level and brings back dropped ones below the mean. Below
+//RF_MIN_CHANNELS the best of the rest are added, whatever their score
+	u32 nMask = 0;
+	u16 nSum = 0;
+	u8 nCount = 0;
+	u8 nMean, nDrop;
+	u8 nBest;
+	u8 i;
+
+	for (i=0; i<RF_NUM_CHANNELS; i++) {
+		if (!(mask & (1UL << i))) continue;
+		nSum += score[i];
+		nCount++;
+	}
+	nMean = nSum / nCount;
+	nDrop = (nMean > 255 - RFM_DROP_MARGIN) ? 255 : nMean + RFM_DROP_MARGIN;
+	if (nDrop < RFM_DROP_MIN) nDrop = RFM_DROP_MIN;
+
+	nCount = 0;
+	for (i=0; i<RF_NUM_CHANNELS; i++) {
+		if ((mask & (1UL << i)) ? (score[i] <= nDrop) : (score[i] < nMean)) {
+			nMask |= 1UL << i;
+			nCount++;
+		}
+	}
+
+	while (nCount < RF_MIN_CHANNELS) {
+		nBest = RF_NUM_CHANNELS;
+		for (i=0; i<RF_NUM_CHANNELS; i++) {
+			if (nMask & (1UL << i)) continue;
+			if (nBest == RF_NUM_CHANNELS || score[i] < score[nBest]) nBest = i;
+		}
+		nMask |= 1UL << nBest;
+		nCount++;
+	}
+
+	return nMask;
+}
+
+void RFManagerClass::setMask(u32 nMask) {
+//Sends NWM_SET_RF_CH_MASK. Channels 1-18 are bits 18:1 of the big-endian parameter
+	Wireless_chan_mask_t chanMask;
+	u8* p = (u8*)&chanMask;
+	u32 nParam = nMask << 1;
+
+	p[0] = nParam >> 24;
+	p[1] = nParam >> 16;
+	p[2] = nParam >> 8;
+	p[3] = nParam;
+	CC8531.Network.setChanMask(&chanMask);
+
+	mask = nMask;
+	lastChange = millis();
+	stats.maskChanges++;
+}
+
+//////////////////////////////////////////////////////////
+//Results
+//////////////////////////////////////////////////////////
+
+u32 RFManagerClass::getMask() {
+//Returns the mask in use, bit n = RF channel n+1
+	return mask;
+}
+
+u8 RFManagerClass::getScore(u8 nChannel) {
+//Returns the score of RF channel nChannel (1-18), 0 is clean
+	if (nChannel < 1 || nChannel > RF_NUM_CHANNELS) return 0;
+	return score[nChannel - 1];
+}
+
+RFM_stats_t* RFManagerClass::getStats() {
+//Returns the totals since begin()
+	return &stats;
+}
+
+void RFManagerClass::report(Print& out) {
+//Prints the mask, the channel scores (* = enabled) and the totals
+	u8 i;
+
+	out.print("mask: 0x");
+	out.print(mask, HEX);
+	out.print(" changes: ");
+	out.println(stats.maskChanges);
+
+	for (i=0; i<RF_NUM_CHANNELS; i++) {
+		out.print(i + 1);
+		out.print((mask & (1UL << i)) ? "* " : "  ");
+		out.println(score[i]);
+	}
+
+	out.print("pkt fail/total: ");
+	out.print(stats.rxPktFail);
+	out.print("/");
+	out.println(stats.rxPkt);
+	out.print("slice err/total: ");
+	out.print(stats.rxSliceErr);
+	out.print("/");
+	out.println(stats.rxSlice);
+	out.print("AFH swaps: ");
+	out.println(stats.afhSwaps);
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef _RFMANAGER_H_INCLUDED
+#define _RFMANAGER_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+
+//Master only: keeps a quality score per RF channel from PS_RF_STATS and narrows the channel mask to
+//the good ones. Each sample reads the statistics gathered since the previous one. The error rate of
+//the interval (failed packets and slices with errors) is charged to every channel AFH used in it, so
+//channels that keep turning up in bad intervals build up a high score. Channels left out of the mask
+//are never used and their score decays, which lets them back in after a while
+#ifndef RFM_SAMPLE_MS
+#define RFM_SAMPLE_MS 2000
+#endif
+
+//Scores are 0 (clean) to 255. Error rate to score: RFM_ERR_GAIN * 256 * errors / attempts, so with the
+//default gain of 4 an error rate of 25% or more counts as the worst
+#define RFM_ERR_GAIN 4
+
+//EWMA weight of a new sample, and decay of unused channels, as shifts (1/4 and 1/16 per sample)
+#define RFM_EWMA_SHIFT 2
+#define RFM_DECAY_SHIFT 4
+
+//AFH swapping out a channel counts as this much extra error score for the interval, per swap
+#define RFM_SWAP_SCORE 16
+
+//Channels are judged against the mean score of the enabled ones, which follows the general level of
+//interference. An enabled channel is dropped more than RFM_DROP_MARGIN above the mean, but never below
+//RFM_DROP_MIN. A dropped one returns once its score has decayed below the mean. The mask is changed
+//at most once per RFM_HOLD_MS
+#define RFM_DROP_MARGIN 24
+#define RFM_DROP_MIN 16
+#define RFM_HOLD_MS 30000UL
+
+//Mask bit n is RF channel n+1
+#define RFM_ALL_CHANNELS ((1UL << RF_NUM_CHANNELS) - 1)
+
+//Manager statistics
+typedef struct {
+	u32 samples;		//PS_RF_STATS reads that had traffic
+	u32 rxPkt;			//Totals over all samples
+	u32 rxPktFail;
+	u32 rxSlice;
+	u32 rxSliceErr;
+	u16 afhSwaps;
+	u16 maskChanges;	//NWM_SET_RF_CH_MASK commands sent
+} RFM_stats_t;
+
+class RFManagerClass {
+private:
+	static u8 enabled;
+	static u32 mask;
+	static u32 lastSample;
+	static u32 lastChange;
+	static u8 score[RF_NUM_CHANNELS];
+	static RFM_stats_t stats;
+
+	static u16 get16(u16);
+	static u32 get32(u32);
+	static void sample();
+	static u32 chooseMask();
+	static void setMask(u32);
+public:
+	static void begin(u32);
+	static void end();
+	static void service();
+
+	static u32 getMask();
+	static u8 getScore(u8);
+	static RFM_stats_t* getStats();
+	static void report(Print&);
+};
+
+extern RFManagerClass RFManager;
+
+#endif
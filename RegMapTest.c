@@ -0,0 +1,241 @@
+// Unit tests for the UC3A3 register map planner (reg_map.c): the transfers it plans for the CS4270 and
+// CS2300 maps on a full write, a volume change and a rate change, how it merges runs, and where the
+// freeze writes go. reg_map_apply is checked against a stand-in for the SPI DMA write.
+// Build: gcc -IHostSim/UC3A3 -IWirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src -o RegMapTest RegMapTest.c WirelessAudioInterface-UC3A3/WirelessAudioInterface-UC3A3/src/reg_map.c
+// Usage: ./RegMapTest (exit status 0 if all checks pass)
+
+#include <stdio.h>
+#include <string.h>
+#include "compiler.h"
+#include "spi_master.h"
+#include "task_SPI.h"
+#include "reg_map.h"
+
+#define CHIP 0x9E
+
+// The maps of CS4270.c and CS2300.c. CS4270: MAP 0x02-0x08, freeze in PWR_CTRL (0x02)
+static const reg_map_reg_t CS4270_REGS[7] = {
+	{0x02, 0x00}, {0x03, 0x00}, {0x04, 0x00}, {0x05, 0x00}, {0x06, 0x00}, {0x07, 0x00}, {0x08, 0x00}
+};
+static const reg_map_t CS4270_MAP = {CHIP, 7, 0, 0x80, CS4270_REGS};
+
+// CS2300: three runs with gaps, freeze in GLOBAL_CFG (0x05), enable_config bits always set
+static const reg_map_reg_t CS2300_REGS[10] = {
+	{0x02, 0x00}, {0x03, 0x01}, {0x05, 0x01}, {0x06, 0x00}, {0x07, 0x00},
+	{0x08, 0x00}, {0x09, 0x00}, {0x16, 0x10}, {0x17, 0x00}, {0x1E, 0x00}
+};
+static const reg_map_t CS2300_MAP = {CHIP, 10, 2, 0x08, CS2300_REGS};
+
+// A CS4270 configuration: slave mode, I2S 24 bit, soft ramp and zero cross, 0dB
+static const uint8_t CS4270_CONFIG[7] = {0x00, 0x30, 0x09, 0x60, 0x00, 0x00, 0x00};
+
+// A CS2300 configuration for 24.576MHz from the 12MHz crystal (ratio 0x0020C49B) and the ratio for
+// 22.5792MHz, which has the same top byte
+static const uint8_t CS2300_CONFIG[10] = {0x02, 0x00, 0x00, 0x00, 0x20, 0xC4, 0x9B, 0x80, 0x00, 0x00};
+static const uint8_t RATIO_44K1[4] = {0x00, 0x1E, 0x1B, 0x08};
+
+volatile avr32_spi_t AVR32_SPI0;
+volatile avr32_spi_t AVR32_SPI1;
+struct spi_device spi_device_codec;
+
+// What task_spi_write_dma was handed, in the reg_map_seq_t layout
+static reg_map_seq_t sent;
+
+static int failures;
+
+void task_spi_write_dma(volatile avr32_spi_t *spi, struct spi_device *device, const uint8_t *data, uint32_t length) {
+	sent.b[sent.length] = length;
+	memcpy(&sent.b[sent.length + 1], data, length);
+	sent.length += length + 1;
+	sent.transfers++;
+	spi->written += length;
+}
+
+void check(int ok, const char *what) {
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+void print_seq(const reg_map_seq_t *seq) {
+	const uint8_t *p = seq->b;
+	uint8_t i, j;
+
+	for (i = 0; i < seq->transfers; i++) {
+		printf("  [");
+		for (j = 1; j <= p[0]; j++) printf(" %02X", p[j]);
+		printf(" ]\n");
+		p += p[0] + 1;
+	}
+}
+
+// Compares a sequence with the expected one, given as the reg_map_seq_t bytes
+void check_seq(const reg_map_seq_t *seq, uint8_t transfers, const uint8_t *expect, uint8_t length, const char *what) {
+	int ok = (seq->transfers == transfers && seq->length == length && !memcmp(seq->b, expect, length));
+
+	check(ok, what);
+	if (!ok) {
+		printf("  got %u transfers:\n", seq->transfers);
+		print_seq(seq);
+	}
+}
+
+void test_full_write(void) {
+	reg_map_seq_t seq;
+	// CS4270: one run from PWR_CTRL, so freeze leads it and the last transfer clears it
+	const uint8_t cs4270[] = {
+		9, CHIP, 0x82, 0x80, 0x30, 0x09, 0x60, 0x00, 0x00, 0x00,
+		3, CHIP, 0x02, 0x00
+	};
+	// CS2300: freeze on its own first, three runs with the enable bits set, then unfreeze
+	const uint8_t cs2300[] = {
+		3, CHIP, 0x05, 0x09,
+		4, CHIP, 0x82, 0x02, 0x01,
+		6, CHIP, 0x86, 0x00, 0x20, 0xC4, 0x9B,
+		4, CHIP, 0x96, 0x90, 0x00,
+		3, CHIP, 0x1E, 0x00,
+		3, CHIP, 0x05, 0x01
+	};
+
+	check(reg_map_plan(&CS4270_MAP, NULL, CS4270_CONFIG, &seq) == 2, "full write: CS4270 transfer count returned");
+	check_seq(&seq, 2, cs4270, sizeof(cs4270), "full write: CS4270 frozen single run");
+
+	reg_map_plan(&CS2300_MAP, NULL, CS2300_CONFIG, &seq);
+	check_seq(&seq, 6, cs2300, sizeof(cs2300), "full write: CS2300 runs between freeze and unfreeze");
+
+	check(seq.length <= REG_MAP_SEQ_MAX, "full write: CS2300 plan fits REG_MAP_SEQ_MAX");
+}
+
+void test_volume_change(void) {
+	reg_map_seq_t seq;
+	uint8_t target[7];
+	const uint8_t expect[] = {4, CHIP, 0x87, 0x10, 0x10};
+
+	// Both DAC volumes in one auto increment transfer, no freeze for a single transfer
+	memcpy(target, CS4270_CONFIG, 7);
+	target[5] = 0x10;
+	target[6] = 0x10;
+	reg_map_plan(&CS4270_MAP, CS4270_CONFIG, target, &seq);
+	check_seq(&seq, 1, expect, sizeof(expect), "volume change: one transfer");
+
+	check(reg_map_plan(&CS4270_MAP, CS4270_CONFIG, CS4270_CONFIG, &seq) == 0 && seq.length == 0, "no change: nothing planned");
+}
+
+void test_rate_change(void) {
+	reg_map_seq_t seq;
+	uint8_t current[10];
+	uint8_t target[10];
+	uint8_t i;
+	const uint8_t expect[] = {5, CHIP, 0x87, 0x1E, 0x1B, 0x08};
+
+	// The shadow holds the enable bits, so only the three low ratio bytes differ
+	for (i = 0; i < 10; i++) current[i] = CS2300_CONFIG[i] | CS2300_REGS[i].set;
+	memcpy(target, CS2300_CONFIG, 10);
+	memcpy(&target[3], RATIO_44K1, 4);
+	reg_map_plan(&CS2300_MAP, current, target, &seq);
+	check_seq(&seq, 1, expect, sizeof(expect), "rate change: only the ratio");
+}
+
+void test_run_merging(void) {
+	reg_map_seq_t seq;
+	uint8_t target[7];
+	// One unchanged register between two changes is written again
+	const uint8_t merged[] = {5, CHIP, 0x83, 0x31, 0x09, 0x61};
+	// Two unchanged registers end the run. PWR_CTRL is next to the first change, so freeze leads it
+	const uint8_t split[] = {
+		4, CHIP, 0x82, 0x80, 0x31,
+		3, CHIP, 0x06, 0x01,
+		3, CHIP, 0x02, 0x00
+	};
+
+	memcpy(target, CS4270_CONFIG, 7);
+	target[1] = 0x31;
+	target[3] = 0x61;
+	reg_map_plan(&CS4270_MAP, CS4270_CONFIG, target, &seq);
+	check_seq(&seq, 1, merged, sizeof(merged), "run merging: gap of one bridged");
+
+	memcpy(target, CS4270_CONFIG, 7);
+	target[1] = 0x31;
+	target[4] = 0x01;
+	reg_map_plan(&CS4270_MAP, CS4270_CONFIG, target, &seq);
+	check_seq(&seq, 3, split, sizeof(split), "run merging: gap of two splits, frozen");
+}
+
+void test_freeze_ordering(void) {
+	reg_map_seq_t seq;
+	uint8_t target[7];
+	// Freeze cannot lead the first run, so it goes first on its own and keeps the chip's other bits
+	const uint8_t apart[] = {
+		3, CHIP, 0x02, 0x82,
+		3, CHIP, 0x05, 0x61,
+		3, CHIP, 0x08, 0x10,
+		3, CHIP, 0x02, 0x02
+	};
+	// The freeze register changes along with another one: its old value frozen, then the new one
+	const uint8_t with_freeze[] = {
+		4, CHIP, 0x82, 0x82, 0x31,
+		3, CHIP, 0x02, 0x22
+	};
+	// The freeze register alone is a single byte write, nothing to hold back
+	const uint8_t freeze_only[] = {3, CHIP, 0x02, 0x22};
+	uint8_t current[7];
+
+	memcpy(current, CS4270_CONFIG, 7);
+	current[0] = 0x02;
+	memcpy(target, current, 7);
+	target[3] = 0x61;
+	target[6] = 0x10;
+	reg_map_plan(&CS4270_MAP, current, target, &seq);
+	check_seq(&seq, 4, apart, sizeof(apart), "freeze ordering: freeze first, unfreeze last");
+
+	memcpy(target, current, 7);
+	target[0] = 0x22;
+	target[1] = 0x31;
+	reg_map_plan(&CS4270_MAP, current, target, &seq);
+	check_seq(&seq, 2, with_freeze, sizeof(with_freeze), "freeze ordering: freeze register in the run");
+
+	// A target with the freeze bit set is written with it clear
+	memcpy(target, current, 7);
+	target[0] = 0x22 | 0x80;
+	reg_map_plan(&CS4270_MAP, current, target, &seq);
+	check_seq(&seq, 1, freeze_only, sizeof(freeze_only), "freeze ordering: freeze register alone, freeze bit cleared");
+}
+
+void test_apply(void) {
+	reg_map_dev_t dev = {&CS4270_MAP, &AVR32_SPI0, &spi_device_codec, false, {0}};
+	reg_map_seq_t seq;
+	uint8_t target[7];
+
+	memset(&sent, 0, sizeof(sent));
+	check(reg_map_apply(&dev, CS4270_CONFIG) == 2, "apply: first write is the full one");
+	reg_map_plan(&CS4270_MAP, NULL, CS4270_CONFIG, &seq);
+	check(sent.transfers == 2 && !memcmp(sent.b, seq.b, seq.length), "apply: sends the plan");
+	check(dev.valid && !memcmp(dev.value, CS4270_CONFIG, 7), "apply: shadow updated");
+
+	memset(&sent, 0, sizeof(sent));
+	check(reg_map_apply(&dev, CS4270_CONFIG) == 0 && sent.transfers == 0, "apply: same target sends nothing");
+
+	memcpy(target, CS4270_CONFIG, 7);
+	target[5] = 0x10;
+	target[6] = 0x10;
+	check(reg_map_apply(&dev, target) == 1 && sent.b[0] == 4, "apply: volume change from the shadow");
+
+	reg_map_invalidate(&dev);
+	memset(&sent, 0, sizeof(sent));
+	check(reg_map_apply(&dev, target) == 2, "apply: everything again after invalidate");
+	check(AVR32_SPI0.written == 9 + 3 + 4 + 9 + 3, "apply: bytes on the bus");
+}
+
+int main(void) {
+	test_full_write();
+	test_volume_change();
+	test_rate_change();
+	test_run_merging();
+	test_freeze_ordering();
+	test_apply();
+
+	if (failures) printf("%d check(s) failed\n", failures);
+	else printf("all checks passed\n");
+	return failures ? 1 : 0;
+}
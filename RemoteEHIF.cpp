@@ -0,0 +1,409 @@
+#include "WProgram.h"
+#include "RemoteEHIF.h"
+
+RemoteEHIFClass RemoteEHIF;
+
+StatusWord_t RemoteEHIFClass::status;
+u8 RemoteEHIFClass::nextSlave;
+RP_slave_t RemoteEHIFClass::slaves[RP_MAX_SLAVES];
+
+u32 RemoteEHIFClass::masterAddr;
+u8 RemoteEHIFClass::slaveTag;
+u8 RemoteEHIFClass::slaveValid;
+u8 RemoteEHIFClass::slavePending;
+u16 RemoteEHIFClass::slaveTotal;
+u16 RemoteEHIFClass::slaveOffset;
+u8 RemoteEHIFClass::slaveResult[RP_RESULT_MAX];
+
+u8 RemoteEHIFClass::tx[DSC_DATAGRAM_MAX];
+
+//////////////////////////////////////////////////////////
+//Common
+//////////////////////////////////////////////////////////
+
+u8 RemoteEHIFClass::allowed(u8 nCmd) {
+//Returns 1 if slaves run nCmd
+	switch (nCmd) {
+		case RP_CMD_DI_GET_DEVICE_INFO:
+		case RP_CMD_PS_RF_STATS:
+		case RP_CMD_PS_AUDIO_STATS:
+		case RP_CMD_VC_GET_VOLUME:
+			return 1;
+	}
+
+	return 0;
+}
+
+u8 RemoteEHIFClass::receive(DSC_rx_data_t* pData) {
+//Checks a datagram from DSCMux. Returns its message type, 0 if it is too short to be one
+	if (pData->LENGTH < RP_REQ_HDR) return 0;
+
+	switch (pData->DATA[0]) {
+		case RP_MSG_REQ:
+			if (pData->DATA[4] > RP_MAX_CMDS || pData->LENGTH < RP_REQ_HDR + 2 * pData->DATA[4]) return 0;
+			break;
+		case RP_MSG_RESP:
+			if (pData->LENGTH < RP_RESP_HDR) return 0;
+			break;
+	}
+
+	return pData->DATA[0];
+}
+
+void RemoteEHIFClass::send(u32 nAddr, u8 nLength) {
+//Sends the first nLength bytes of tx to nAddr, a device ID as it appears on the wire
+	DSCMux.send(nAddr, tx, nLength);
+}
+
+//////////////////////////////////////////////////////////
+//Master
+//////////////////////////////////////////////////////////
+
+void RemoteEHIFClass::beginMaster(EHIF_mask_t* pMask) {
+//Starts with nothing queued. Pass the network status on the next serviceMaster() call
+	memset(slaves, 0, sizeof(slaves));
+	nextSlave = 0;
+
+	DSCMux.attach(RP_MSG_RESP, masterReceive);
+	DSCMux.setMask(pMask);
+}
+
+void RemoteEHIFClass::serviceMaster(StatusWord_t nStatus, Master_status_t* pMaster) {
+//Call with a fresh status word when the EHIF interrupt is active, and from loop() for the resends.
+//pMaster: the latest network status after a network change, NULL if it has not been read again.
+//Every slave with queued commands is sent its REQ in the same pass
+	u8 i, n;
+
+	status = nStatus;
+
+	if (pMaster) syncSlaves(pMaster);
+
+	status = DSCMux.service(status);
+
+	for (i=0; i<RP_MAX_SLAVES && status.B.EVT_DSC_TX_AVAIL; i++) {
+		n = nextSlave;
+		nextSlave = (nextSlave + 1) % RP_MAX_SLAVES;
+		if (serveSlave(&slaves[n])) status = CC8531.getStatus();
+	}
+}
+
+void RemoteEHIFClass::syncSlaves(Master_status_t* pMaster) {
+//Matches the slaves in the network status against the table. A slave that drops out keeps its entry
+//while there is room, and a REQ under way resumes when it is back
+	RP_slave_t* s;
+	u32 nId;
+	u8 nNew = 0;
+	u8 i, j;
+
+	for (i=0; i<RP_MAX_SLAVES; i++) slaves[i].present = 0;
+
+	//Known slaves first, so that their entries are not given away
+	for (i=0; i<6; i++) {
+		nId = pMaster->slaveStatus[i].DEVICE_ID;
+		if (!nId || !pMaster->slaveStatus[i].WPS_DSC_EN) continue;
+
+		for (j=0; j<RP_MAX_SLAVES && slaves[j].DEVICE_ID != nId; j++);
+		if (j == RP_MAX_SLAVES) nNew |= 1 << i;
+		else slaves[j].present = 1;
+	}
+
+	//New ones take an empty entry, else one of a slave that has left
+	for (i=0; i<6; i++) {
+		if (!(nNew & (1 << i))) continue;
+
+		for (j=0; j<RP_MAX_SLAVES && slaves[j].DEVICE_ID; j++);
+		if (j == RP_MAX_SLAVES) {
+			for (j=0; j<RP_MAX_SLAVES && slaves[j].present; j++);
+			if (j == RP_MAX_SLAVES) continue;
+		}
+
+		s = &slaves[j];
+		memset(s, 0, sizeof(RP_slave_t));
+		s->DEVICE_ID = pMaster->slaveStatus[i].DEVICE_ID;
+		s->present = 1;
+		//Tags must not start over after a restart: a slave still holding the same tag would take the
+		//first REQ for a repeat and send back its old results. When a slave joins varies with the radio
+		s->tag = micros();
+	}
+}
+
+void RemoteEHIFClass::masterReceive(DSC_rx_data_t* pData) {
+//Handles a RESP from a slave. Only the next bytes of the stream are taken, anything else waits for
+//the resend from the offset reached
+	RP_slave_t* s = NULL;
+	u8* d = pData->DATA;
+	u16 nOffset, nTotal, nLength;
+	u8 i;
+
+	if (receive(pData) != RP_MSG_RESP) return;
+
+	for (i=0; i<RP_MAX_SLAVES; i++) {
+		if (slaves[i].DEVICE_ID && slaves[i].DEVICE_ID == pData->ADDR) s = &slaves[i];
+	}
+	if (!s || s->state != RP_SLAVE_WAITING || d[1] != s->tag) return;
+
+	nOffset = ((u16)d[2] << 8) | d[3];
+	nTotal = ((u16)d[4] << 8) | d[5];
+	nLength = pData->LENGTH - RP_RESP_HDR;
+	if (nOffset != s->received || nTotal > RP_RESULT_MAX || nOffset + nLength > nTotal) return;
+
+	memcpy(s->result + nOffset, d + RP_RESP_HDR, nLength);
+	s->received += nLength;
+	s->total = nTotal;
+	s->attempts = 0;
+	s->lastHeard = millis();
+
+	if (s->received >= s->total) s->state = RP_SLAVE_DONE;
+}
+
+u8 RemoteEHIFClass::serveSlave(RP_slave_t* s) {
+//Sends slave s its REQ, or sends it again from the offset reached if the results have stalled.
+//Returns 1 if one was sent
+	u32 nNow = millis();
+	u8 i;
+
+	if (!s->present) return 0;
+
+	switch (s->state) {
+		case RP_SLAVE_QUEUED:
+			s->tag++;
+			s->received = s->total = 0;
+			s->attempts = 0;
+			s->state = RP_SLAVE_WAITING;
+			break;
+
+		case RP_SLAVE_WAITING:
+			if (nNow - s->lastHeard < RP_RETX_MS) return 0;
+			if (++s->attempts > RP_MAX_ATTEMPTS) {
+				s->state = RP_SLAVE_FAILED;
+				return 0;
+			}
+			break;
+
+		default:
+			return 0;
+	}
+
+	tx[0] = RP_MSG_REQ;
+	tx[1] = s->tag;
+	tx[2] = s->received >> 8;
+	tx[3] = s->received;
+	tx[4] = s->count;
+	for (i=0; i<s->count; i++) {
+		tx[RP_REQ_HDR + 2 * i] = s->cmds[i];
+		tx[RP_REQ_HDR + 2 * i + 1] = s->params[i];
+	}
+	send(s->DEVICE_ID, RP_REQ_HDR + 2 * s->count);
+
+	s->lastHeard = nNow;
+	return 1;
+}
+
+u8 RemoteEHIFClass::queue(u8 n, u8 nCmd, u8 nParam) {
+//Queues nCmd with its one byte parameter (VC_GET_VOLUME only, 0 otherwise) for the slave in table
+//entry n. The first command queued after a REQ has completed drops its results. Returns 0 if the
+//slave is not there, the command is not allowed, the queue is full or a REQ is under way
+	RP_slave_t* s;
+
+	if (n >= RP_MAX_SLAVES || !allowed(nCmd)) return 0;
+	s = &slaves[n];
+	if (!s->present || s->state == RP_SLAVE_WAITING) return 0;
+
+	if (s->state != RP_SLAVE_QUEUED) {
+		s->count = 0;
+		s->received = s->total = 0;
+		s->state = RP_SLAVE_QUEUED;
+	}
+	if (s->count >= RP_MAX_CMDS) return 0;
+
+	s->cmds[s->count] = nCmd;
+	s->params[s->count] = nParam;
+	s->count++;
+	return 1;
+}
+
+u8 RemoteEHIFClass::snapshot() {
+//Queues device info, RF and audio statistics and the output volume for every present slave. Returns
+//the number of slaves queued
+	u8 nCount = 0;
+	u8 i;
+
+	for (i=0; i<RP_MAX_SLAVES; i++) {
+		if (!queue(i, RP_CMD_DI_GET_DEVICE_INFO, 0)) continue;
+		queue(i, RP_CMD_PS_RF_STATS, 0);
+		queue(i, RP_CMD_PS_AUDIO_STATS, 0);
+		queue(i, RP_CMD_VC_GET_VOLUME, 0);
+		nCount++;
+	}
+
+	return nCount;
+}
+
+u8 RemoteEHIFClass::pending() {
+//Returns the number of present slaves with commands queued or under way
+	u8 nCount = 0;
+	u8 i;
+
+	for (i=0; i<RP_MAX_SLAVES; i++) {
+		if (!slaves[i].present) continue;
+		if (slaves[i].state == RP_SLAVE_QUEUED || slaves[i].state == RP_SLAVE_WAITING) nCount++;
+	}
+
+	return nCount;
+}
+
+RP_slave_t* RemoteEHIFClass::getSlave(u8 n) {
+//Returns the state of table entry n, for display
+	return &slaves[n];
+}
+
+u8* RemoteEHIFClass::getResult(u8 n, u8 nCmd, u8* pLength) {
+//Returns the data nCmd read on the slave in table entry n, as sent by its CC8531, and its length in
+//pLength. NULL if the result has not (completely) arrived. A length of 0 means the slave refused it
+	RP_slave_t* s;
+	u16 i;
+
+	if (n >= RP_MAX_SLAVES) return NULL;
+	s = &slaves[n];
+
+	for (i=0; i + 2 <= s->received; i += 2 + s->result[i + 1]) {
+		if (s->result[i] != nCmd) continue;
+		if (i + 2 + s->result[i + 1] > s->received) return NULL;
+		*pLength = s->result[i + 1];
+		return s->result + i + 2;
+	}
+
+	return NULL;
+}
+
+void RemoteEHIFClass::report(Print& out) {
+//Prints per slave its state, the result bytes received and the commands with their result length
+	RP_slave_t* s;
+	u16 i;
+	u8 n;
+
+	for (n=0; n<RP_MAX_SLAVES; n++) {
+		s = &slaves[n];
+		if (!s->DEVICE_ID) continue;
+		out.print(s->DEVICE_ID, HEX);
+		out.print(s->present ? " " : " - ");
+		out.print(s->state);
+		out.print(" ");
+		out.print(s->received);
+		out.print("/");
+		out.print(s->total);
+
+		for (i=0; i + 2 <= s->received; i += 2 + s->result[i + 1]) {
+			out.print(" 0x");
+			out.print(s->result[i], HEX);
+			out.print(":");
+			out.print(s->result[i + 1]);
+		}
+		out.println();
+	}
+}
+
+//////////////////////////////////////////////////////////
+//Slave
+//////////////////////////////////////////////////////////
+
+void RemoteEHIFClass::beginSlave(EHIF_mask_t* pMask) {
+//Starts answering REQs from the master
+	masterAddr = 0;
+	slaveValid = 0;
+	slavePending = 0;
+
+	DSCMux.attach(RP_MSG_REQ, slaveReceive);
+	DSCMux.setMask(pMask);
+}
+
+void RemoteEHIFClass::serviceSlave(StatusWord_t nStatus) {
+//Call with a fresh status word when the EHIF interrupt is active. Results go out as long as there is
+//room in the DSC queue
+	status = DSCMux.service(nStatus);
+
+	while (slavePending && status.B.EVT_DSC_TX_AVAIL) {
+		sendResult();
+		status = CC8531.getStatus();
+	}
+}
+
+void RemoteEHIFClass::slaveReceive(DSC_rx_data_t* pData) {
+//Handles a REQ from the master. A new tag runs the commands, a repeated one only moves the offset
+	u8* d = pData->DATA;
+	u16 nOffset;
+	u8 nLength;
+	u8 i;
+
+	if (receive(pData) != RP_MSG_REQ) return;
+	masterAddr = pData->ADDR;
+
+	if (!slaveValid || d[1] != slaveTag) {
+		slaveTotal = 0;
+		for (i=0; i<d[4] && slaveTotal + 2 <= RP_RESULT_MAX; i++) {
+			nLength = 0;
+			if (allowed(d[RP_REQ_HDR + 2 * i])) {
+				nLength = execute(d[RP_REQ_HDR + 2 * i], d[RP_REQ_HDR + 2 * i + 1],
+					slaveResult + slaveTotal + 2, RP_RESULT_MAX - slaveTotal - 2);
+			}
+			slaveResult[slaveTotal] = d[RP_REQ_HDR + 2 * i];
+			slaveResult[slaveTotal + 1] = nLength;
+			slaveTotal += 2 + nLength;
+		}
+		slaveTag = d[1];
+		slaveValid = 1;
+	}
+
+	nOffset = ((u16)d[2] << 8) | d[3];
+	slaveOffset = (nOffset < slaveTotal) ? nOffset : slaveTotal;
+	slavePending = 1;
+}
+
+u16 RemoteEHIFClass::execute(u8 nCmd, u8 nParam, u8* pData, u16 nSpace) {
+//Runs a whitelisted command and stores what it read in pData. Returns the bytes stored, 0 if they
+//would not fit
+	Volume_get_t volGet;
+	u16 nLength = nSpace;
+
+	switch (nCmd) {
+		case RP_CMD_DI_GET_DEVICE_INFO:
+			if (nSpace < 12) return 0;
+			CC8531.Info.getDeviceInfo((Device_info_t*)pData);
+			return 12;
+
+		case RP_CMD_PS_RF_STATS:
+			CC8531.Statistics.rfStats((RF_stat_t*)pData, &nLength);
+			return nLength;
+
+		case RP_CMD_PS_AUDIO_STATS:
+			CC8531.Statistics.audioStats((Audio_stat_t*)pData, &nLength);
+			return nLength;
+
+		case RP_CMD_VC_GET_VOLUME:
+			if (nSpace < 2) return 0;
+			memcpy(&volGet, &nParam, 1);
+			CC8531.Volume.getVolume(&volGet, (Volume_data_t*)pData);
+			return 2;
+	}
+
+	return 0;
+}
+
+void RemoteEHIFClass::sendResult() {
+//Sends the next part of the results. An empty result stream still gets one RESP
+	u16 nLength = slaveTotal - slaveOffset;
+
+	if (nLength > RP_CHUNK_MAX) nLength = RP_CHUNK_MAX;
+
+	tx[0] = RP_MSG_RESP;
+	tx[1] = slaveTag;
+	tx[2] = slaveOffset >> 8;
+	tx[3] = slaveOffset;
+	tx[4] = slaveTotal >> 8;
+	tx[5] = slaveTotal;
+	memcpy(tx + RP_RESP_HDR, slaveResult + slaveOffset, nLength);
+	send(masterAddr, RP_RESP_HDR + nLength);
+
+	slaveOffset += nLength;
+	if (slaveOffset >= slaveTotal) slavePending = 0;
+}
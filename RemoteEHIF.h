@@ -0,0 +1,113 @@
+#ifndef _REMOTEEHIF_H_INCLUDED
+#define _REMOTEEHIF_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+#include "DSCMux.h"
+
+//Runs read-only EHIF commands on the slaves from the master host, for diagnosing a slave without
+//access to its host port. Commands for one slave are queued and go out together in one REQ, and every
+//slave with queued commands gets its REQ in the same pass, so the slaves work on them in parallel.
+//The slave runs the commands in order and streams the results back in RESP datagrams. Datagrams go
+//through DSCMux, so it runs next to the other DSCMux protocols but not next to DSCTransport.
+//Each datagram is one message, multi-byte fields big-endian:
+//	REQ		master -> slave	type, tag, resume offset (2), count, command ID and parameter per command
+//	RESP	slave -> master	type, tag, offset (2), total (2), result bytes
+//The results of a REQ are one stream: per command its ID, the length read and the data read. The
+//slave keeps the stream of the last tag, so a REQ sent again for the same tag resumes at the offset
+//the master has reached without running the commands again (the statistics restart on every read)
+#define RP_MSG_REQ 'E'
+#define RP_MSG_RESP 'e'
+
+#define RP_REQ_HDR 5
+#define RP_RESP_HDR 6
+#define RP_CHUNK_MAX (DSC_DATAGRAM_MAX - RP_RESP_HDR)
+
+//Commands a slave runs. Nothing that changes the slave is allowed
+#define RP_CMD_DI_GET_DEVICE_INFO 0x1E
+#define RP_CMD_PS_RF_STATS 0x10
+#define RP_CMD_PS_AUDIO_STATS 0x11
+#define RP_CMD_VC_GET_VOLUME 0x16
+
+//Commands per REQ, and bytes of results per slave. The default holds a full health snapshot: device
+//info (12), RF statistics (64), audio statistics of up to four channels (14 + 4 per channel) and the
+//volume (2), each with its 2 byte header
+#define RP_MAX_CMDS 8
+#ifndef RP_RESULT_MAX
+#define RP_RESULT_MAX 128
+#endif
+
+//A REQ without progress is sent again from the offset reached after RP_RETX_MS, this many times
+#define RP_RETX_MS 200
+#define RP_MAX_ATTEMPTS 5
+
+#define RP_MAX_SLAVES 6
+
+//Master per-slave state
+#define RP_SLAVE_IDLE 0		//Nothing queued, results of the last REQ (if any) are kept
+#define RP_SLAVE_QUEUED 1	//Commands queued, REQ not sent yet
+#define RP_SLAVE_WAITING 2	//REQ sent, results coming in
+#define RP_SLAVE_DONE 3		//All results in
+#define RP_SLAVE_FAILED 4	//No answer after RP_MAX_ATTEMPTS, results incomplete
+
+//Master view of one slave
+typedef struct {
+	u32 DEVICE_ID;	//As in Master_status_t, big-endian
+	u8 count;		//Commands queued or sent
+	u8 cmds[RP_MAX_CMDS];
+	u8 params[RP_MAX_CMDS];
+	u8 tag;
+	u8 state;
+	u8 attempts;
+	u8 present;		//Listed in the last Master_status_t
+	u16 received;	//Result bytes received in order
+	u16 total;		//Result bytes the slave has, 0 until the first RESP
+	u32 lastHeard;	//millis() of the last REQ or RESP
+	u8 result[RP_RESULT_MAX];
+} RP_slave_t;
+
+class RemoteEHIFClass {
+private:
+	static StatusWord_t status;
+	static u8 nextSlave;
+	static RP_slave_t slaves[RP_MAX_SLAVES];
+
+	static u32 masterAddr;
+	static u8 slaveTag;
+	static u8 slaveValid;
+	static u8 slavePending;
+	static u16 slaveTotal;
+	static u16 slaveOffset;
+	static u8 slaveResult[RP_RESULT_MAX];
+
+	static u8 tx[DSC_DATAGRAM_MAX];
+
+	static u8 allowed(u8);
+	static u8 receive(DSC_rx_data_t*);
+	static void send(u32, u8);
+
+	static void syncSlaves(Master_status_t*);
+	static void masterReceive(DSC_rx_data_t*);
+	static u8 serveSlave(RP_slave_t*);
+
+	static void slaveReceive(DSC_rx_data_t*);
+	static u16 execute(u8, u8, u8*, u16);
+	static void sendResult();
+public:
+	static void beginMaster(EHIF_mask_t*);
+	static void serviceMaster(StatusWord_t, Master_status_t*);
+	static u8 queue(u8, u8, u8);
+	static u8 snapshot();
+	static u8 pending();
+	static RP_slave_t* getSlave(u8);
+	static u8* getResult(u8, u8, u8*);
+	static void report(Print&);
+
+	static void beginSlave(EHIF_mask_t*);
+	static void serviceSlave(StatusWord_t);
+};
+
+extern RemoteEHIFClass RemoteEHIF;
+
+#endif
@@ -0,0 +1,131 @@
+// Prints the per-task CPU statistics the UC3A3 sends over its CDC port as a top-like view, with the time
+// in each power state below it.
+// Build: gcc -o RtosStatsTop RtosStatsTop.c
+// Usage: ./RtosStatsTop [/dev/ttyACM0]
+// Frame layout: see rtos_stats.h and task_power.h in the UC3A3 project
+
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#define CPU_HZ 66000000UL
+
+#define SYNC0 0xA5
+#define SYNC1 0x5A
+#define FRAME_TASKS 0x54
+#define SLOT_BYTES 11
+#define FRAME_POWER 0x50
+#define POWER_STATES 8
+
+// Statistics slots, in the order of RTOS_TASK_xxx shifted by one
+static const char *slotNames[] = {"IDLE", "AUDIO", "EHIF", "CLOCK", "TOUCH", "LEDS", "FFT"};
+#define NUM_NAMES (sizeof(slotNames) / sizeof(slotNames[0]))
+
+// CC85xx PWR_STATE values, the slots of the power frame
+static const char *stateNames[POWER_STATES] = {"OFF", "1", "NWK_STANDBY", "LOCAL_STANDBY", "LOW_POWER", "ACTIVE", "6", "7"};
+
+uint32_t getBE(const uint8_t *p, int bytes) {
+	uint32_t value = 0;
+	while (bytes--) value = (value << 8) | *p++;
+	return value;
+}
+
+void printFrame(const uint8_t *payload, uint8_t length) {
+	uint32_t window = getBE(payload, 4);
+	uint8_t slots = payload[4];
+	const uint8_t *p = payload + 5;
+	double seconds = (double)window / CPU_HZ;
+	double busy = 0;
+	int i;
+
+	if (length < 5 + slots * SLOT_BYTES || window == 0) return;
+
+	printf("\033[H\033[2J");	//Clear screen
+	printf("window %.3f s\n\n", seconds);
+	printf("%-6s %7s %8s %8s %10s\n", "TASK", "CPU%", "SW/s", "PRE/s", "LAT max us");
+
+	for (i = 0; i < slots; i++, p += SLOT_BYTES) {
+		uint8_t slot = p[0];
+		uint32_t run = getBE(p + 1, 4);
+		uint16_t switches = getBE(p + 5, 2);
+		uint16_t preemptions = getBE(p + 7, 2);
+		uint16_t latency = getBE(p + 9, 2);
+		double load = 100.0 * run / window;
+
+		if (slot != 0) busy += load;
+
+		printf("%-6s %6.2f%% %8.0f %8.0f %10.2f\n",
+			(slot < NUM_NAMES) ? slotNames[slot] : "?",
+			load, switches / seconds, preemptions / seconds, latency * 1e6 / CPU_HZ);
+	}
+
+	printf("\nCPU busy %.2f%%\n", busy);
+	fflush(stdout);
+}
+
+// Time in each power state since power up, printed under the task view it follows
+void printPower(const uint8_t *payload, uint8_t length) {
+	const uint8_t *p = payload + POWER_STATES * 4;
+	double total = 0;
+	int i;
+
+	if (length < POWER_STATES * 4 + 5) return;
+
+	for (i = 0; i < POWER_STATES; i++) total += getBE(payload + 4 * i, 4);
+	if (total == 0) return;
+
+	printf("\npower, %.0f s since power up:", total / 1000);
+	for (i = 0; i < POWER_STATES; i++) {
+		uint32_t ms = getBE(payload + 4 * i, 4);
+		if (ms) printf(" %s %.1f%%", stateNames[i], 100.0 * ms / total);
+	}
+	printf("\n%u state changes, VBAT %u mV, codec and LEDs %s\n", getBE(p, 2), getBE(p + 2, 2), p[4] ? "on" : "off");
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	const char *device = (argc > 1) ? argv[1] : "/dev/ttyACM0";
+	struct termios tio;
+	uint8_t frame[4 + 255 + 1];
+	uint8_t byte, sum;
+	int index = 0;
+	int length = 0;
+	int fd, i;
+
+	fd = open(device, O_RDONLY | O_NOCTTY);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	while (read(fd, &byte, 1) == 1) {
+		//Hunt for the sync bytes, then collect type, length, payload and checksum
+		if (index == 0 && byte != SYNC0) continue;
+		if (index == 1 && byte != SYNC1) {
+			index = (byte == SYNC0) ? 1 : 0;
+			continue;
+		}
+
+		frame[index++] = byte;
+		if (index == 4) length = frame[3];
+		if (index < 4 || index < 4 + length + 1) continue;
+
+		sum = 0;
+		for (i = 2; i < index; i++) sum += frame[i];	//Includes the checksum, so 0 if intact
+		if (sum == 0 && frame[2] == FRAME_TASKS) printFrame(frame + 4, length);
+		else if (sum == 0 && frame[2] == FRAME_POWER) printPower(frame + 4, length);
+		else if (sum != 0) fprintf(stderr, "bad checksum\n");
+
+		index = 0;
+	}
+
+	close(fd);
+	return 0;
+}
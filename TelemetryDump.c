@@ -0,0 +1,119 @@
+// Asks the UC3A3 for its telemetry history over the CDC port ('D') and prints every bucket of the dump,
+// seconds, then minutes, then hours. Checks that the sequence numbers of each level run without gaps.
+// Build: gcc -o TelemetryDump TelemetryDump.c
+// Usage: ./TelemetryDump [/dev/ttyACM0] (exit status 1 on a bad checksum or a gap in the dump)
+// Frame layout: see telemetry.h in the UC3A3 project
+
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#define SYNC0 0xA5
+#define SYNC1 0x5A
+#define FRAME_BUCKET 0x42
+#define FRAME_DUMP 0x80
+#define CMD_DUMP 'D'
+#define METRICS 6
+#define LEVELS 3
+
+static const char *levelNames[LEVELS] = {"second", "minute", "hour"};
+static const char *metricNames[METRICS] = {"conceal/s", "muted/s", "pkt fail/s", "PER/10000", "slice err/s", "AFH swap/s"};
+
+// Next sequence number expected per level, -1 before the first bucket of the level
+static long nextSeq[LEVELS] = {-1, -1, -1};
+static int errors;
+
+uint32_t getBE(const uint8_t *p, int bytes) {
+	uint32_t value = 0;
+	while (bytes--) value = (value << 8) | *p++;
+	return value;
+}
+
+void printBucket(const uint8_t *payload, uint8_t length) {
+	uint8_t level = payload[0] & ~FRAME_DUMP;
+	uint32_t seq = getBE(payload + 1, 4);
+	uint16_t samples = getBE(payload + 5, 2);
+	const uint8_t *p = payload + 7;
+	int i;
+
+	// Streamed buckets go on while the dump runs, only the dumped ones are wanted
+	if (!(payload[0] & FRAME_DUMP) || level >= LEVELS || length < 7 + METRICS * 8) return;
+
+	if (nextSeq[level] >= 0 && seq != (uint32_t)nextSeq[level]) {
+		printf("gap: %s bucket %u after %ld\n", levelNames[level], seq, nextSeq[level] - 1);
+		errors++;
+	}
+	nextSeq[level] = seq + 1;
+
+	printf("%-6s %6u  %4u s sampled", levelNames[level], seq, samples);
+	for (i = 0; i < METRICS; i++, p += 8) {
+		if (!samples) continue;
+		printf("  %s %u/%.1f/%u", metricNames[i], getBE(p, 2), (double)getBE(p + 4, 4) / samples, getBE(p + 2, 2));
+	}
+	printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+	const char *device = (argc > 1) ? argv[1] : "/dev/ttyACM0";
+	struct termios tio;
+	uint8_t frame[4 + 255 + 1];
+	uint8_t byte = CMD_DUMP;
+	uint8_t sum;
+	int index = 0;
+	int length = 0;
+	int fd, i;
+
+	fd = open(device, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	// Raw, and read() gives up after a second without data: the dump is over. Frames that came in
+	// before went through the old line settings, so they are thrown away
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 10;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	tcflush(fd, TCIFLUSH);
+
+	if (write(fd, &byte, 1) != 1) {
+		perror(device);
+		return 1;
+	}
+
+	while (read(fd, &byte, 1) == 1) {
+		//Hunt for the sync bytes, then collect type, length, payload and checksum
+		if (index == 0 && byte != SYNC0) continue;
+		if (index == 1 && byte != SYNC1) {
+			index = (byte == SYNC0) ? 1 : 0;
+			continue;
+		}
+
+		frame[index++] = byte;
+		if (index == 4) length = frame[3];
+		if (index < 4 || index < 4 + length + 1) continue;
+
+		sum = 0;
+		for (i = 2; i < index; i++) sum += frame[i];	//Includes the checksum, so 0 if intact
+		if (sum == 0 && frame[2] == FRAME_BUCKET) printBucket(frame + 4, length);
+		else if (sum != 0) {
+			fprintf(stderr, "bad checksum\n");
+			errors++;
+		}
+
+		index = 0;
+	}
+
+	if (nextSeq[0] < 0) {
+		printf("no dump received\n");
+		errors++;
+	}
+
+	close(fd);
+	return errors ? 1 : 0;
+}
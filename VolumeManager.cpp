@@ -0,0 +1,442 @@
+#include "WProgram.h"
+#include "VolumeManager.h"
+
+VolumeManagerClass VolumeManager;
+
+//Parts of the group state not yet sent with VC_SET_VOLUME
+#define VOLM_DIRTY_VOLUME 0x01
+#define VOLM_DIRTY_MUTE 0x02
+
+//VC_SET_VOLUME operations
+#define VOLM_SET_ABSOLUTE 1
+#define VOLM_SET_CHANNEL_OFFSET 3
+#define VOLM_MUTE 1
+#define VOLM_UNMUTE 2
+
+StatusWord_t VolumeManagerClass::status;
+s16 VolumeManagerClass::groupVolume;
+u8 VolumeManagerClass::groupMute;
+u8 VolumeManagerClass::groupDirty;
+u8 VolumeManagerClass::nextSlave;
+VolM_slave_t VolumeManagerClass::slaves[VOLM_MAX_SLAVES];
+VolM_stats_t VolumeManagerClass::stats;
+
+u32 VolumeManagerClass::masterAddr;
+u8 VolumeManagerClass::slaveSeq;
+s16 VolumeManagerClass::slaveVolume;
+s16 VolumeManagerClass::slaveOffset[VOLM_CHANNELS];
+u8 VolumeManagerClass::statusPending;
+
+u8 VolumeManagerClass::tx[DSC_DATAGRAM_MAX];
+
+//////////////////////////////////////////////////////////
+//Common
+//////////////////////////////////////////////////////////
+
+void VolumeManagerClass::setMask(EHIF_mask_t* pMask) {
+//Adds the volume and DSC events to the caller's interrupt mask
+	pMask->MSK_VOL_CHG = 1;
+	DSCMux.setMask(pMask);
+}
+
+s16 VolumeManagerClass::clamp(s16 nValue) {
+//Limits nValue to what fits in the VC_SET_VOLUME value
+	if (nValue < VOLM_MIN) return VOLM_MIN;
+	if (nValue > VOLM_MAX) return VOLM_MAX;
+	return nValue;
+}
+
+void VolumeManagerClass::put16(u8* pData, s16 nValue) {
+//Stores nValue big-endian
+	pData[0] = nValue >> 8;
+	pData[1] = nValue;
+}
+
+s16 VolumeManagerClass::get16(u8* pData) {
+//Loads a big-endian value
+	return (s16)(((u16)pData[0] << 8) | pData[1]);
+}
+
+void VolumeManagerClass::setVolume(u8 nLocal, u8 nSetOp, u8 nMuteOp, u8 nChannel, s16 nValue) {
+//Sends VC_SET_VOLUME for the output volume. The value is the low 11 bits of the big-endian parameter
+	Volume_set_t volSet;
+	u8* p = (u8*)&volSet;
+
+	p[0] = nLocal;
+	p[1] = (nChannel & 0x0F) | (nSetOp << 4) | (nMuteOp << 6);
+	p[2] = (nValue >> 8) & 0x07;
+	p[3] = nValue;
+	CC8531.Volume.setVolume(&volSet);
+}
+
+s16 VolumeManagerClass::getVolume(Volume_get_t* pGet) {
+//Sends VC_GET_VOLUME and returns the volume or offset read
+	Volume_data_t nData = 0;
+
+	CC8531.Volume.getVolume(pGet, &nData);
+	return get16((u8*)&nData);
+}
+
+u8 VolumeManagerClass::receive(DSC_rx_data_t* pData) {
+//Checks a datagram from DSCMux. Returns its message type, 0 if it is too short to be one
+	if (pData->LENGTH < VOLM_SET_LENGTH) return 0;
+	if (pData->DATA[0] == VOLM_MSG_STATUS && pData->LENGTH < VOLM_STATUS_LENGTH) return 0;
+	return pData->DATA[0];
+}
+
+void VolumeManagerClass::send(u32 nAddr, u8 nLength) {
+//Sends the first nLength bytes of tx to nAddr, a device ID as it appears on the wire
+	DSCMux.send(nAddr, tx, nLength);
+}
+
+//////////////////////////////////////////////////////////
+//Master
+//////////////////////////////////////////////////////////
+
+void VolumeManagerClass::beginMaster(EHIF_mask_t* pMask) {
+//Starts with the current remote volume as the group volume and no offsets. Pass the network status
+//on the next serviceMaster() call. The CC8531 cannot report the mute state, it is taken as unmuted
+	Volume_get_t volGet;
+
+	memset(slaves, 0, sizeof(slaves));
+	memset(&stats, 0, sizeof(stats));
+	nextSlave = 0;
+
+	memset(&volGet, 0, sizeof(volGet));
+	volGet.MASTER.IS_LOCAL = 0;
+	groupVolume = getVolume(&volGet);
+	groupMute = 0;
+	groupDirty = 0;
+
+	DSCMux.attach(VOLM_MSG_STATUS, masterReceive);
+	setMask(pMask);
+}
+
+void VolumeManagerClass::serviceMaster(StatusWord_t nStatus, Master_status_t* pMaster) {
+//Call with a fresh status word when the EHIF interrupt is active, and from loop() for the resends.
+//pMaster: the latest network status after a network change, NULL if it has not been read again.
+//Costs at most one VC_SET_VOLUME, and one SET datagram for each slave that is behind
+	EHIF_flags_t flags;
+	Volume_get_t volGet;
+	u8 i, n;
+
+	status = nStatus;
+
+	//Someone else changed the remote volume (a slave's volume control): follow it, unless a change of
+	//our own is about to overwrite it anyway
+	if (status.B.EVT_VOL_CHG) {
+		memset(&flags, 0, sizeof(flags));
+		flags.MSK_VOL_CHG = 1;
+		CC8531.EHIFCtrl.clearEventFlags(&flags);
+		stats.volChanges++;
+
+		if (!(groupDirty & VOLM_DIRTY_VOLUME)) {
+			memset(&volGet, 0, sizeof(volGet));
+			volGet.MASTER.IS_LOCAL = 0;
+			groupVolume = getVolume(&volGet);
+		}
+		status = CC8531.getStatus();
+	}
+
+	if (pMaster) syncSlaves(pMaster);
+
+	status = DSCMux.service(status);
+
+	if (groupDirty) {
+		setVolume(0, (groupDirty & VOLM_DIRTY_VOLUME) ? VOLM_SET_ABSOLUTE : 0,
+			(groupDirty & VOLM_DIRTY_MUTE) ? (groupMute ? VOLM_MUTE : VOLM_UNMUTE) : 0, 0, groupVolume);
+		groupDirty = 0;
+		stats.groupCmds++;
+	}
+
+	//SETs are not waited for, so every slave that is behind gets one now while there is room
+	for (i=0; i<VOLM_MAX_SLAVES && status.B.EVT_DSC_TX_AVAIL; i++) {
+		n = nextSlave;
+		nextSlave = (nextSlave + 1) % VOLM_MAX_SLAVES;
+		if (serveSlave(&slaves[n])) status = CC8531.getStatus();
+	}
+}
+
+void VolumeManagerClass::syncSlaves(Master_status_t* pMaster) {
+//Matches the slaves in the network status against the table. A slave that joins, or comes back after
+//a drop, is sent its offsets again. Entries of slaves that left are kept while there is room
+	VolM_slave_t* s;
+	u32 nId;
+	u8 nWas = 0;
+	u8 nNew = 0;
+	u8 i, j;
+
+	for (i=0; i<VOLM_MAX_SLAVES; i++) {
+		if (slaves[i].present) nWas |= 1 << i;
+		slaves[i].present = 0;
+	}
+
+	//Known slaves first, so that their entries are not given away
+	for (i=0; i<6; i++) {
+		nId = pMaster->slaveStatus[i].DEVICE_ID;
+		if (!nId || !pMaster->slaveStatus[i].WPS_DSC_EN) continue;
+
+		for (j=0; j<VOLM_MAX_SLAVES && slaves[j].DEVICE_ID != nId; j++);
+		if (j == VOLM_MAX_SLAVES) {
+			nNew |= 1 << i;
+			continue;
+		}
+
+		s = &slaves[j];
+		if (!(nWas & (1 << j))) {
+			s->seq++;
+			s->heard = 0;
+		}
+		s->present = 1;
+	}
+
+	//New ones take an empty entry, else one of a slave that has left
+	for (i=0; i<6; i++) {
+		if (!(nNew & (1 << i))) continue;
+
+		for (j=0; j<VOLM_MAX_SLAVES && slaves[j].DEVICE_ID; j++);
+		if (j == VOLM_MAX_SLAVES) {
+			for (j=0; j<VOLM_MAX_SLAVES && slaves[j].present; j++);
+			if (j == VOLM_MAX_SLAVES) continue;
+		}
+
+		s = &slaves[j];
+		memset(s, 0, sizeof(VolM_slave_t));
+		s->DEVICE_ID = pMaster->slaveStatus[i].DEVICE_ID;
+		s->volume = groupVolume;
+		s->seq = 1;
+		s->present = 1;
+	}
+}
+
+void VolumeManagerClass::masterReceive(DSC_rx_data_t* pData) {
+//Handles a STATUS from a slave. Once the slave has caught up with the wanted offsets, what it reports
+//is taken as the wanted offsets, so changes made on the slave itself are kept
+	VolM_slave_t* s = NULL;
+	u8* d = pData->DATA;
+	u8 i;
+
+	if (receive(pData) != VOLM_MSG_STATUS) return;
+
+	for (i=0; i<VOLM_MAX_SLAVES; i++) {
+		if (slaves[i].DEVICE_ID && slaves[i].DEVICE_ID == pData->ADDR) s = &slaves[i];
+	}
+	if (!s) return;
+
+	stats.statusRx++;
+	s->heard = 1;
+	s->volume = get16(d + 2);
+	for (i=0; i<VOLM_CHANNELS; i++) s->applied[i] = get16(d + 4 + 2 * i);
+
+	if (d[1] == s->seq) {
+		s->ackSeq = s->seq;
+		memcpy(s->offset, s->applied, sizeof(s->offset));
+	}
+}
+
+u8 VolumeManagerClass::serveSlave(VolM_slave_t* s) {
+//Sends a SET to slave s if it is behind and none is on its way. Returns 1 if one was sent
+	u32 nNow = millis();
+	u8 i;
+
+	if (!s->present || s->seq == s->ackSeq) return 0;
+	if (s->sentSeq == s->seq && nNow - s->lastSent < VOLM_RETX_MS) return 0;
+	if (s->sentSeq == s->seq) stats.retx++;
+
+	tx[0] = VOLM_MSG_SET;
+	tx[1] = s->seq;
+	for (i=0; i<VOLM_CHANNELS; i++) put16(tx + 2 + 2 * i, s->offset[i]);
+	send(s->DEVICE_ID, VOLM_SET_LENGTH);
+
+	s->sentSeq = s->seq;
+	s->lastSent = nNow;
+	stats.setSent++;
+	return 1;
+}
+
+void VolumeManagerClass::setGroupVolume(s16 nVolume) {
+//Sets the output volume of all slaves (x0.125dB), sent on the next serviceMaster()
+	groupVolume = clamp(nVolume);
+	groupDirty |= VOLM_DIRTY_VOLUME;
+}
+
+void VolumeManagerClass::stepGroupVolume(s16 nStep) {
+//Changes the group volume by nStep. Steps before the next serviceMaster() add up to one command
+	setGroupVolume(groupVolume + nStep);
+}
+
+void VolumeManagerClass::setGroupMute(u8 nMute) {
+//Mutes (1) or unmutes (0) all slaves, sent on the next serviceMaster()
+	groupMute = nMute ? 1 : 0;
+	groupDirty |= VOLM_DIRTY_MUTE;
+}
+
+s16 VolumeManagerClass::getGroupVolume() {
+//Returns the group volume, x0.125dB
+	return groupVolume;
+}
+
+u8 VolumeManagerClass::getGroupMute() {
+//Returns 1 if the group was last muted from here
+	return groupMute;
+}
+
+u8 VolumeManagerClass::setOffset(u8 n, u8 nChannel, s16 nOffset) {
+//Sets the offset of logical channel nChannel on the slave in table entry n (x0.125dB). Offsets set
+//before the next serviceMaster() go out in one SET. Returns 0 if there is no such slave or channel
+	VolM_slave_t* s;
+
+	if (n >= VOLM_MAX_SLAVES || nChannel >= VOLM_CHANNELS) return 0;
+	s = &slaves[n];
+	if (!s->DEVICE_ID) return 0;
+
+	nOffset = clamp(nOffset);
+	if (s->offset[nChannel] == nOffset) return 1;
+	s->offset[nChannel] = nOffset;
+
+	//Only a SET that was sent with the current sequence can be answered with it
+	if (s->sentSeq == s->seq) s->seq++;
+	return 1;
+}
+
+VolM_slave_t* VolumeManagerClass::getSlave(u8 n) {
+//Returns the model of table entry n, for display
+	return &slaves[n];
+}
+
+u8 VolumeManagerClass::pending() {
+//Returns the number of present slaves that have not yet confirmed their wanted offsets
+	u8 nCount = 0;
+	u8 i;
+
+	for (i=0; i<VOLM_MAX_SLAVES; i++) {
+		if (slaves[i].present && slaves[i].seq != slaves[i].ackSeq) nCount++;
+	}
+
+	return nCount;
+}
+
+VolM_stats_t* VolumeManagerClass::getStats() {
+//Returns the totals since beginMaster()
+	return &stats;
+}
+
+void VolumeManagerClass::report(Print& out) {
+//Prints the group state and per slave its volume and offsets, wanted/reported (* = not confirmed)
+	VolM_slave_t* s;
+	u8 i, j;
+
+	out.print("group: ");
+	out.print(groupVolume);
+	out.println(groupMute ? " muted" : "");
+
+	for (i=0; i<VOLM_MAX_SLAVES; i++) {
+		s = &slaves[i];
+		if (!s->DEVICE_ID) continue;
+		out.print(s->DEVICE_ID, HEX);
+		out.print(s->present ? (s->seq != s->ackSeq ? "* " : "  ") : "- ");
+		out.print(s->heard ? s->volume : groupVolume);
+		for (j=0; j<VOLM_CHANNELS; j++) {
+			out.print(" ");
+			out.print(s->offset[j]);
+			out.print("/");
+			out.print(s->applied[j]);
+		}
+		out.println();
+	}
+
+	out.print("group cmds: ");
+	out.print(stats.groupCmds);
+	out.print(" vol chg: ");
+	out.println(stats.volChanges);
+	out.print("SET sent/retx: ");
+	out.print(stats.setSent);
+	out.print("/");
+	out.print(stats.retx);
+	out.print(" STATUS: ");
+	out.println(stats.statusRx);
+}
+
+//////////////////////////////////////////////////////////
+//Slave
+//////////////////////////////////////////////////////////
+
+void VolumeManagerClass::beginSlave(EHIF_mask_t* pMask) {
+//Starts taking offsets from the master. STATUS goes out once the first SET has given its address
+	masterAddr = 0;
+	slaveSeq = 0;
+	statusPending = 0;
+	readSlave();
+
+	DSCMux.attach(VOLM_MSG_SET, slaveReceive);
+	setMask(pMask);
+}
+
+void VolumeManagerClass::serviceSlave(StatusWord_t nStatus) {
+//Call with a fresh status word when the EHIF interrupt is active
+	EHIF_flags_t flags;
+
+	status = nStatus;
+
+	//The master's group volume, the local volume control or our own offsets: report what it is now
+	if (status.B.EVT_VOL_CHG) {
+		memset(&flags, 0, sizeof(flags));
+		flags.MSK_VOL_CHG = 1;
+		CC8531.EHIFCtrl.clearEventFlags(&flags);
+		readSlave();
+		statusPending = 1;
+		status = CC8531.getStatus();
+	}
+
+	status = DSCMux.service(status);
+
+	if (statusPending && masterAddr && status.B.EVT_DSC_TX_AVAIL) sendStatus();
+}
+
+void VolumeManagerClass::slaveReceive(DSC_rx_data_t* pData) {
+//Handles a SET from the master. Only the offsets that differ are written
+	u8* d = pData->DATA;
+	s16 nOffset;
+	u8 i;
+
+	if (receive(pData) != VOLM_MSG_SET) return;
+	masterAddr = pData->ADDR;
+
+	for (i=0; i<VOLM_CHANNELS; i++) {
+		nOffset = clamp(get16(d + 2 + 2 * i));
+		if (nOffset != slaveOffset[i]) setVolume(0, VOLM_SET_CHANNEL_OFFSET, 0, i, nOffset);
+	}
+
+	slaveSeq = d[1];
+	readSlave();
+	statusPending = 1;
+}
+
+void VolumeManagerClass::readSlave() {
+//Reads the output volume and the logical channel offsets with VC_GET_VOLUME
+	Volume_get_t volGet;
+	u8 i;
+
+	memset(&volGet, 0, sizeof(volGet));
+	volGet.SLAVE.IS_CHANNEL_OFFSET = 0;
+	slaveVolume = getVolume(&volGet);
+
+	for (i=0; i<VOLM_CHANNELS; i++) {
+		volGet.SLAVE.IS_CHANNEL_OFFSET = 1;
+		volGet.SLAVE.LOG_CHANNEL = i;
+		slaveOffset[i] = getVolume(&volGet);
+	}
+}
+
+void VolumeManagerClass::sendStatus() {
+//Reports the volume, the offsets and the last SET applied to the master
+	u8 i;
+
+	tx[0] = VOLM_MSG_STATUS;
+	tx[1] = slaveSeq;
+	put16(tx + 2, slaveVolume);
+	for (i=0; i<VOLM_CHANNELS; i++) put16(tx + 4 + 2 * i, slaveOffset[i]);
+	send(masterAddr, VOLM_STATUS_LENGTH);
+
+	statusPending = 0;
+}
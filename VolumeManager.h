@@ -0,0 +1,116 @@
+#ifndef _VOLUMEMANAGER_H_INCLUDED
+#define _VOLUMEMANAGER_H_INCLUDED
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "CC8531.h"
+#include "DSCMux.h"
+
+//Keeps the volume of the whole network from the master host. The group volume and mute are the
+//master's remote volume, which the CC8531 passes on to every slave itself, so a group change is one
+//VC_SET_VOLUME however many slaves there are. Changes made between two service() calls are merged
+//into that one command. Logical channel offsets can only be set on the slave, so the master keeps a
+//model of each slave's offsets and sends them to its host over the data side channel. Datagrams go
+//through DSCMux, so it runs next to the other DSCMux protocols but not next to DSCTransport. Each
+//datagram is one message, multi-byte fields big-endian:
+//	SET		master -> slave	type, sequence, offset (2) per logical channel
+//	STATUS	slave -> master	type, sequence, output volume (2), offset (2) per logical channel
+//The master sends SET to every slave that is behind in one pass and collects the STATUS answers as
+//they come, so the slaves are updated in parallel. The slave sends STATUS after each SET and when its
+//volume changes (EVT_VOL_CHG), with the sequence of the last SET it applied
+#define VOLM_MSG_SET 'V'
+#define VOLM_MSG_STATUS 'v'
+
+//Logical channels with an offset in the model
+#define VOLM_CHANNELS 4
+
+#define VOLM_SET_LENGTH (2 + 2 * VOLM_CHANNELS)
+#define VOLM_STATUS_LENGTH (4 + 2 * VOLM_CHANNELS)
+
+//Volumes and offsets are x0.125dB and go into the 11-bit VC_SET_VOLUME value
+#define VOLM_MIN -1024
+#define VOLM_MAX 1023
+
+//A SET without STATUS is sent again after this long
+#define VOLM_RETX_MS 200
+
+#define VOLM_MAX_SLAVES 6
+
+//Master view of one slave
+typedef struct {
+	u32 DEVICE_ID;	//As in Master_status_t, big-endian
+	s16 offset[VOLM_CHANNELS];	//Wanted logical channel offsets
+	s16 applied[VOLM_CHANNELS];	//Offsets as last reported by the slave
+	s16 volume;		//Output volume as last reported by the slave
+	u8 seq;			//Sequence of the wanted offsets
+	u8 sentSeq;		//Sequence of the last SET
+	u8 ackSeq;		//Sequence the slave last reported
+	u8 heard;		//A STATUS has arrived since the slave joined
+	u8 present;		//Listed in the last Master_status_t
+	u32 lastSent;	//millis() of the last SET
+} VolM_slave_t;
+
+//Manager statistics
+typedef struct {
+	u16 groupCmds;	//VC_SET_VOLUME commands for the group volume and mute
+	u16 volChanges;	//EVT_VOL_CHG events, each read back with VC_GET_VOLUME
+	u16 setSent;	//SET datagrams, resends included
+	u16 retx;		//SET datagrams sent again for lack of an answer
+	u16 statusRx;	//STATUS datagrams
+} VolM_stats_t;
+
+class VolumeManagerClass {
+private:
+	static StatusWord_t status;
+	static s16 groupVolume;
+	static u8 groupMute;
+	static u8 groupDirty;
+	static u8 nextSlave;
+	static VolM_slave_t slaves[VOLM_MAX_SLAVES];
+	static VolM_stats_t stats;
+
+	static u32 masterAddr;
+	static u8 slaveSeq;
+	static s16 slaveVolume;
+	static s16 slaveOffset[VOLM_CHANNELS];
+	static u8 statusPending;
+
+	static u8 tx[DSC_DATAGRAM_MAX];
+
+	static void setMask(EHIF_mask_t*);
+	static s16 clamp(s16);
+	static void put16(u8*, s16);
+	static s16 get16(u8*);
+	static void setVolume(u8, u8, u8, u8, s16);
+	static s16 getVolume(Volume_get_t*);
+	static u8 receive(DSC_rx_data_t*);
+	static void send(u32, u8);
+
+	static void syncSlaves(Master_status_t*);
+	static void masterReceive(DSC_rx_data_t*);
+	static u8 serveSlave(VolM_slave_t*);
+
+	static void slaveReceive(DSC_rx_data_t*);
+	static void readSlave();
+	static void sendStatus();
+public:
+	static void beginMaster(EHIF_mask_t*);
+	static void serviceMaster(StatusWord_t, Master_status_t*);
+	static void setGroupVolume(s16);
+	static void stepGroupVolume(s16);
+	static void setGroupMute(u8);
+	static s16 getGroupVolume();
+	static u8 getGroupMute();
+	static u8 setOffset(u8, u8, s16);
+	static VolM_slave_t* getSlave(u8);
+	static u8 pending();
+	static VolM_stats_t* getStats();
+	static void report(Print&);
+
+	static void beginSlave(EHIF_mask_t*);
+	static void serviceSlave(StatusWord_t);
+};
+
+extern VolumeManagerClass VolumeManager;
+
+#endif
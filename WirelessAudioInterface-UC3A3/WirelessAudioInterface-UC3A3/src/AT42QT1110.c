@@ -9,102 +9,13 @@
 #include "board.h"
 #include "gpio.h"
 #include "power_clocks_lib.h"
+#include "delay.h"
 #include "spi_master.h"
 #include "task_SPI.h"
 #include "AT42QT1110.h"
 
-uint8_t AT42QT1110_calc_crc(uint8_t* data, uint8_t length) {
-	uint8_t index;
-	uint8_t fb;
-	uint8_t i;
-	uint8_t crc = 0;
-	
-	for (i=0; i<length; i++) {
-		index = 8;
-		do {
-			fb = (crc ^ data[i]) & 0x01;
-			data[i] >>= 1;
-			crc >>= 1;
-			if (fb) crc ^= 0x8C;
-		} while (--index);
-	}
-	
-	return crc;
-}
-
-void AT42QT1110_spi_read_timeout(uint8_t* data, uint32_t timeout_us) {
-	uint32_t t = 0;
-
-	while (!spi_is_rx_full(SPI_TOUCH)) {
-		delay_us(1);
-		if(t++ > timeout_us) return;
-	}
-	t = 0;
-	spi_read_single(&SPI_TOUCH, data);
-	
-	return;
-}
-
-void AT42QT1110_send_data(uint8_t* data, uint8_t length) {
-	uint8_t i;
-	
-	spi_select_device(SPI_TOUCH, &spi_device_touch);
-	
-	for (i=0; i<length; i++) {
-		delay_us(150);
-		spi_write_single(SPI_TOUCH, data[i]);
-	}
-	
-	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
-	
-	return;
-}
-
-uint8_t AT42QT1110_send_cmd(uint8_t cmd) {
-	uint8_t data;
-	
-	spi_select_device(SPI_TOUCH, &spi_device_touch);
-	
-	spi_write_single(SPI_TOUCH, cmd);
-	
-	data = AT42QT1110_spi_read_timeout(&data, 100);
-	
-	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
-	
-	return data;
-}
-
-void AT42QT1110_get_data(uint8_t cmd, uint8_t* data, uint8_t length) {
-	uint8_t idle;
-	uint8_t i;
-	
-	spi_select_device(SPI_TOUCH, &spi_device_touch);
-	
-	idle = AT42QT1110_send_cmd(cmd);
-	
-	if (idle != 0x55) return;
-	
-	for (i=0; i<length; i++) {
-		delay_us(150);
-		spi_write_single(SPI_TOUCH, 0x00);
-		AT42QT1110_spi_read_timeout(data, 100);
-	}	
-	
-	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
-	
-	return;
-}
-
-uint32_t AT42QT1110_get_key(uint32_t key) {
-	all_keys_t all_keys;
-	
-	AT42QT1110_get_data(RPT_REQ_SEND_ALL_KEYS, all_keys.b, LENGTH_SEND_ALL_KEYS);
-	
-	return ((all_keys.c & (1 << key)) ? 1 : 0);
-}
-
-int32_t AT42QT1110_init(void) {
-	setups.a = {
+static const setups_t AT42QT1110_setups = {
+	.a = {
 		.device_mode = {
 			.key_ac = KEY_AC_SRC_TIMED,
 			.mode = MODE_11_KEY,
@@ -116,8 +27,8 @@ int32_t AT42QT1110_init(void) {
 			.guard_key = 0,
 			.guard_key_en = 0,
 			.quick_spi_en = 0,
-			.chg_mode = CHG_MODE_DATA,
-			.crc_en = 0
+			.chg_mode = CHG_MODE_DATA,	//CHANGE stays low until the new data is read
+			.crc_en = 1	//Every report ends with a CRC
 		},
 		.dil_dht = {
 			.dil = 3,
@@ -213,59 +124,235 @@ int32_t AT42QT1110_init(void) {
 		},
 		.ndrift_nrd[0] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[1] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[2] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[3] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[4] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[5] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[6] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[7] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[8] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[9] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
 		},
 		.ndrift_nrd[10] = {
 			.ndrift = 7,	//2240ms
-			.ndr = 10	//25.6s
+			.nrd = 10	//25.6s
+		}
+	}
+};
+
+/*
+	CRC-8, polynomial X^8+X^5+X^4+1 fed LSB first, as the device calculates it. The
+	tables hold the CRC of every byte (or nibble) value from a zero start, so one
+	lookup replaces eight shift and XOR steps.
+*/
+#if AT42QT1110_CRC_NIBBLE_TABLE
+static const uint8_t AT42QT1110_crc_table[16] = {
+	0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8, 0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+#else
+static const uint8_t AT42QT1110_crc_table[256] = {
+	0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83, 0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
+	0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E, 0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
+	0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0, 0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+	0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D, 0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
+	0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5, 0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
+	0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58, 0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+	0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6, 0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
+	0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B, 0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
+	0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F, 0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+	0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92, 0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
+	0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C, 0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
+	0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1, 0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+	0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49, 0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
+	0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4, 0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
+	0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A, 0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+	0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7, 0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
+};
+#endif
+
+//! Adds one byte to a CRC
+uint8_t AT42QT1110_crc_byte(uint8_t crc, uint8_t byte) {
+	
+	crc ^= byte;
+#if AT42QT1110_CRC_NIBBLE_TABLE
+	crc = (crc >> 4) ^ AT42QT1110_crc_table[crc & 0x0F];
+	crc = (crc >> 4) ^ AT42QT1110_crc_table[crc & 0x0F];
+#else
+	crc = AT42QT1110_crc_table[crc];
+#endif
+	
+	return crc;
+}
+
+//! Adds a block of bytes to a CRC
+/*! \param crc value to continue from, 0 for a new message
+	\param data bytes to add, left untouched
+	\param length number of bytes
+*/
+uint8_t AT42QT1110_calc_crc(uint8_t crc, const uint8_t* data, uint8_t length) {
+	
+	while (length--) {
+		crc = AT42QT1110_crc_byte(crc, *data++);
+	}
+	
+	return crc;
+}
+
+//! Starts receiving a report, the CRC covers the request byte first
+/*! \param cmd report request, RPT_REQ_xxx
+	\param data receives the report
+	\param length report length, not counting the CRC
+*/
+void AT42QT1110_frame_begin(report_frame_t* frame, uint8_t cmd, uint8_t* data, uint8_t length) {
+	
+	frame->data = data;
+	frame->length = length;
+	frame->count = 0;
+	frame->crc = AT42QT1110_crc_byte(0, cmd);
+	
+	return;
+}
+
+//! Takes the next byte of a report, the byte after the report is checked as its CRC
+/*! \return REPORT_FRAME_MORE until the CRC byte, then REPORT_FRAME_OK or REPORT_FRAME_CRC_ERROR
+*/
+uint32_t AT42QT1110_frame_put(report_frame_t* frame, uint8_t byte) {
+	
+	if (frame->count < frame->length) {
+		frame->data[frame->count++] = byte;
+		frame->crc = AT42QT1110_crc_byte(frame->crc, byte);
+		return REPORT_FRAME_MORE;
+	}
+	
+	return (byte == frame->crc) ? REPORT_FRAME_OK : REPORT_FRAME_CRC_ERROR;
+}
+
+//! Sends one byte and reads the byte shifted back at the same time. The device must be selected
+/*! \param tx byte to send
+	\param rx byte received, may be NULL
+	\return false if nothing came back within AT42QT1110_RX_TIMEOUT_US
+*/
+bool AT42QT1110_exchange(uint8_t tx, uint8_t* rx) {
+	uint32_t t = 0;
+	uint8_t data;
+	
+	spi_write_single(SPI_TOUCH, tx);
+	
+	while (!spi_is_rx_full(SPI_TOUCH)) {
+		delay_us(1);
+		if (t++ > AT42QT1110_RX_TIMEOUT_US) return false;
+	}
+	
+	spi_read_single(SPI_TOUCH, &data);
+	if (rx) *rx = data;
+	
+	return true;
+}
+
+//! Sends a block of data with its CRC, in a transfer of its own
+/*! The CRC is updated while each byte waits out the byte spacing.
+*/
+void AT42QT1110_send_data(const uint8_t* data, uint8_t length) {
+	uint8_t crc = 0;
+	uint8_t i;
+	
+	spi_select_device(SPI_TOUCH, &spi_device_touch);
+	
+	for (i=0; i<length; i++) {
+		delay_us(AT42QT1110_BYTE_SPACING_US);
+		AT42QT1110_exchange(data[i], NULL);
+		crc = AT42QT1110_crc_byte(crc, data[i]);
+	}
+	delay_us(AT42QT1110_BYTE_SPACING_US);
+	AT42QT1110_exchange(crc, NULL);
+	
+	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
+	
+	return;
+}
+
+//! Sends a control command
+/*! \return the byte shifted back, AT42QT1110_IDLE if the device was ready
+*/
+uint8_t AT42QT1110_send_cmd(uint8_t cmd) {
+	uint8_t data = 0;
+	
+	spi_select_device(SPI_TOUCH, &spi_device_touch);
+	
+	AT42QT1110_exchange(cmd, &data);
+	
+	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
+	
+	return data;
+}
+
+//! Reads a report and its CRC in one burst, with a single chip select
+/*! Each byte is checked into the CRC as it arrives, so the result is known when the
+	last byte is in.
+	\param cmd report request, RPT_REQ_xxx
+	\param data receives LENGTH_xxx bytes
+	\param length report length, at most AT42QT1110_REPORT_MAX
+	\return false if the device was busy, did not answer or the CRC did not match
+*/
+bool AT42QT1110_read_report(uint8_t cmd, uint8_t* data, uint8_t length) {
+	report_frame_t frame;
+	uint32_t state = REPORT_FRAME_MORE;
+	uint8_t byte = 0;
+	
+	spi_select_device(SPI_TOUCH, &spi_device_touch);
+	
+	if (AT42QT1110_exchange(cmd, &byte) && byte == AT42QT1110_IDLE) {
+		AT42QT1110_frame_begin(&frame, cmd, data, length);
+		
+		while (state == REPORT_FRAME_MORE) {
+			delay_us(AT42QT1110_BYTE_SPACING_US);
+			if (!AT42QT1110_exchange(0x00, &byte)) break;
+			state = AT42QT1110_frame_put(&frame, byte);
 		}
-	};
+	}
+	
+	spi_deselect_device(SPI_TOUCH, &spi_device_touch);
 	
-	//uint8_t crc = AT42QT1110_calc_crc(setups.b, 42);
+	return (state == REPORT_FRAME_OK);
+}
+
+//! Loads the setups into the device. CHANGE goes low when key data is waiting to be read
+/*! \return 0 on success, -1 if the device did not answer
+*/
+int32_t AT42QT1110_init(void) {
 	
-	AT42QT1110_send_cmd(CTRL_CMD_SEND_SETUPS);
+	if (AT42QT1110_send_cmd(CTRL_CMD_SEND_SETUPS) != AT42QT1110_IDLE) return -1;
 	
-	AT42QT1110_send_data(setups.b, 42);
+	AT42QT1110_send_data(AT42QT1110_setups.b, LENGTH_SETUPS);
 	
-	//if (AT42QT1110_send_cmd(crc) == crc)
-		//return 0;
-	//else
-		//return -1;
 	return 0;
-}
+}
\ No newline at end of file
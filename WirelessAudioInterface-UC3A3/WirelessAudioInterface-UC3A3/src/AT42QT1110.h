@@ -463,7 +463,8 @@ typedef union {
 	uint8_t b;
 } ndrift_nrd_t;
 
-volatile static union {
+//! The 42 setup bytes in the order CTRL_CMD_SEND_SETUPS sends them
+typedef union {
 	struct {
 		device_mode_t device_mode;	//0
 		guard_key_com_opts_t guard_key_com_opts;	//1
@@ -481,16 +482,45 @@ volatile static union {
 		extend_pulse_time_t extend_pulse_time;	//30
 		ndrift_nrd_t ndrift_nrd[11];	//31-41
 	} a;		
-	uint8_t b[42];
-} setups;
-
-
-extern uint8_t AT42QT1110_calc_crc(uint8_t* data, uint8_t length);
-extern void AT42QT1110_spi_read_timeout(uint8_t* data, uint32_t timeout_us);
-extern void AT42QT1110_send_data(uint8_t* data, uint8_t length);
+	uint8_t b[LENGTH_SETUPS];
+} setups_t;
+
+
+//! Minimum gap between bytes of a transfer
+#define AT42QT1110_BYTE_SPACING_US	150
+//! Longest wait for a byte to come back
+#define AT42QT1110_RX_TIMEOUT_US	100
+//! Reply to the command byte while the device is ready
+#define AT42QT1110_IDLE			0x55
+//! Longest report read in one burst, not counting the CRC
+#define AT42QT1110_REPORT_MAX	LENGTH_SETUPS
+
+//! 1 for a 16 byte CRC table instead of the 256 byte one, for about twice the time per byte
+#ifndef AT42QT1110_CRC_NIBBLE_TABLE
+#define AT42QT1110_CRC_NIBBLE_TABLE	0
+#endif
+
+//! Report frame states
+#define REPORT_FRAME_MORE		0
+#define REPORT_FRAME_OK			1
+#define REPORT_FRAME_CRC_ERROR	2
+
+//! A report being received, its CRC is updated with every byte that comes off SPI
+typedef struct {
+	uint8_t* data;
+	uint8_t length;
+	uint8_t count;
+	uint8_t crc;
+} report_frame_t;
+
+extern uint8_t AT42QT1110_crc_byte(uint8_t crc, uint8_t byte);
+extern uint8_t AT42QT1110_calc_crc(uint8_t crc, const uint8_t* data, uint8_t length);
+extern void AT42QT1110_frame_begin(report_frame_t* frame, uint8_t cmd, uint8_t* data, uint8_t length);
+extern uint32_t AT42QT1110_frame_put(report_frame_t* frame, uint8_t byte);
+extern bool AT42QT1110_exchange(uint8_t tx, uint8_t* rx);
+extern void AT42QT1110_send_data(const uint8_t* data, uint8_t length);
 extern uint8_t AT42QT1110_send_cmd(uint8_t cmd);
-extern void AT42QT1110_get_data(uint8_t cmd, uint8_t* data, uint8_t length);
-extern uint32_t AT42QT1110_get_key(uint32_t key);
+extern bool AT42QT1110_read_report(uint8_t cmd, uint8_t* data, uint8_t length);
 extern int32_t AT42QT1110_init(void);
 
 #endif /* AT42QT1110_H_ */
\ No newline at end of file
@@ -12,8 +12,41 @@
 #include "spi_master.h"
 #include "task_SPI.h"
 #include "task_clock.h"
+#include "reg_map.h"
 #include "CS2300.h"
 
+// enable_config must be set in all three registers for a change to take effect
+static const reg_map_reg_t CS2300_REGS[CS2300_NUM_REGS] = {
+	{MAP_DEV_CTRL, 0x00},
+	{MAP_DEV_CFG, CS2300_DEV_CFG_ENABLE},
+	{MAP_GLOBAL_CFG, CS2300_GLOBAL_CFG_ENABLE},
+	{MAP_RATIO_MSB, 0x00},
+	{MAP_RATIO_2SB, 0x00},
+	{MAP_RATIO_3SB, 0x00},
+	{MAP_RATIO_LSB, 0x00},
+	{MAP_FUNC_CFG1, CS2300_FUNC_CFG1_ENABLE},
+	{MAP_FUNC_CFG2, 0x00},
+	{MAP_FUNC_CFG3, 0x00}
+};
+
+static const reg_map_t CS2300_MAP = {
+	.chip_addr = CS2300_ADDRESS,
+	.count = CS2300_NUM_REGS,
+	.freeze = CS2300_FREEZE_REG,
+	.freeze_mask = CS2300_FREEZE,
+	.regs = CS2300_REGS
+};
+
+static reg_map_dev_t cs2300_dev = {
+	.map = &CS2300_MAP,
+	.spi = SPI_CLOCK,
+	.device = &spi_device_clock,
+	.valid = false
+};
+
+//! Last target state, set_ratio changes it and applies it again
+static cs2300_regs_t cs2300_regs;
+
 // The lowest of low level 
 
 void CS2300_send_data(uint8_t* data, uint8_t length, uint8_t start_reg) {
@@ -42,11 +75,32 @@ void CS2300_send_data(uint8_t* data, uint8_t length, uint8_t start_reg) {
 
 // Getting a bit higher!
 
+//! Writes whatever differs between the chip and regs
+/*! \return number of SPI transfers it took
+*/
+uint32_t CS2300_apply(const cs2300_regs_t *regs) {
+	
+	cs2300_regs = *regs;
+	
+	return reg_map_apply(&cs2300_dev, cs2300_regs.b);
+}
+
+//! Call after the chip has been reset, the next apply writes every register
+void CS2300_reset(void) {
+	
+	reg_map_invalidate(&cs2300_dev);
+	
+	return;
+}
+
 void CS2300_set_ratio(uint32_t ratio) {
-	ratio_t ratio_packet = {
-		.b = ratio
-	};
-	CS2300_send_data(ratio_packet.c, 4, MAP_RATIO_MSB);
+	cs2300_regs_t regs = cs2300_regs;
+	
+	regs.ratio[0] = ratio >> 24;
+	regs.ratio[1] = ratio >> 16;
+	regs.ratio[2] = ratio >> 8;
+	regs.ratio[3] = ratio;
+	CS2300_apply(&regs);
 }
 
 // Because laziness
@@ -65,19 +119,21 @@ void CS2300_set_MCLK(uint32_t mclk_hz) {
 
 void CS2300_config(uint32_t fs) {
 	uint32_t mclk_hz;
+	uint32_t ratio;
 	
 	if ((fs % 44100) == 0) mclk_hz = 22579200;
 	else if ((fs % 48000) == 0) mclk_hz = 24576000;
 	else return;//error
 	
-	// Lock PLL, disable aux and output
+	cs2300_regs_t regs;
+	
+	// Lock PLL, aux disabled, clock output on
 	device_control_t control = {
 		{.unlock = 0,
 		.aux_output_disable = 1,
-		.clock_out_disable = 1}
+		.clock_out_disable = 0}
 	};
-	
-	CS2300_send_data(&control.b, 1, MAP_DEV_CTRL);
+	regs.control = control;
 	
 	// Set R_mod to x1, aux is pll lock signal
 	device_config_t device_config = {
@@ -85,19 +141,21 @@ void CS2300_config(uint32_t fs) {
 		.aux_src_sel = PLL_LOCK,
 		.enable_config = 1}
 	};
-	
-	CS2300_send_data(&device_config.b, 1, MAP_DEV_CFG);
+	regs.device_config = device_config;
 	
 	// Update configs
 	global_config_t global_config = {
 		{.freeze = 0,
 		.enable_config = 1}
 	};
-	
-	CS2300_send_data(&global_config.b, 1, MAP_GLOBAL_CFG);
+	regs.global_config = global_config;
 	
 	// Set ratio
-	CS2300_set_MCLK(mclk_hz);
+	ratio = CS2300_calculate_ratio(BOARD_OSC0_HZ, mclk_hz);
+	regs.ratio[0] = ratio >> 24;
+	regs.ratio[1] = ratio >> 16;
+	regs.ratio[2] = ratio >> 8;
+	regs.ratio[3] = ratio;
 	
 	// Clock skip is enabled, unlock = high
 	function_config1_t cfg1 = {
@@ -105,30 +163,23 @@ void CS2300_config(uint32_t fs) {
 		.aux_lock_config = 0,
 		.enable_config = 1}
 	};
-	
-	CS2300_send_data(&cfg1.b, 1, MAP_FUNC_CFG1);
+	regs.cfg1 = cfg1;
 	
 	// Clock is low when PLL is unlocked, LF ratio is high accuracy 
 	function_config2_t cfg2 = {
 		{.clock_out_unlock = 0,
 		.lf_ratio_config = HIGH_ACCURACY}
 	};
-	
-	CS2300_send_data(&cfg2.b, 1, MAP_FUNC_CFG2);
+	regs.cfg2 = cfg2;
 	
 	// Clock input bandwidth is 1Hz for low jitter
 	function_config3_t cfg3 = {
 		{.clkin_bw = MIN_BW_1HZ}
 	};
+	regs.cfg3 = cfg3;
 	
-	CS2300_send_data(&cfg3.b, 1, MAP_FUNC_CFG3);
-	
-	// Enable output clock
-	control.unlock = 0;
-	control.aux_output_disable = 1;
-	control.clock_out_disable = 0;
-	
-	CS2300_send_data(&control.b, 1, MAP_DEV_CTRL);
+	// The first call writes everything frozen, a rate change after it only the ratio
+	CS2300_apply(&regs);
 	
 	return;
 }
\ No newline at end of file
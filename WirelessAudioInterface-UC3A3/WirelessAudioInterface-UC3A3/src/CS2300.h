@@ -24,6 +24,16 @@
 #define MAP_FUNC_CFG2	0x17
 #define MAP_FUNC_CFG3	0x1E
 
+// Writable registers, MAP_DEV_CTRL to MAP_FUNC_CFG3
+#define CS2300_NUM_REGS	10
+// Index of MAP_GLOBAL_CFG in the map, and global_config_t.freeze
+#define CS2300_FREEZE_REG	2
+#define CS2300_FREEZE	0x08
+// enable_config in device_config_t, global_config_t and function_config1_t
+#define CS2300_DEV_CFG_ENABLE	0x01
+#define CS2300_GLOBAL_CFG_ENABLE	0x01
+#define CS2300_FUNC_CFG1_ENABLE	0x10
+
 // Values for device_config.r_mod_sel
 #define R_MOD_X1	0x0
 #define R_MOD_X2	0x1
@@ -138,11 +148,27 @@ typedef union{
 }function_config3_t;
 
 
+// Target state for the register map, in address order
+typedef union{
+	struct {
+		device_control_t control;
+		device_config_t device_config;
+		global_config_t global_config;
+		uint8_t ratio[4];	//MSB first
+		function_config1_t cfg1;
+		function_config2_t cfg2;
+		function_config3_t cfg3;
+	};
+	uint8_t b[CS2300_NUM_REGS];
+}cs2300_regs_t;
+
 // Function prototypes
 extern void CS2300_send_data(uint8_t* data, uint8_t length, uint8_t start_reg);
 extern void CS2300_set_ratio(uint32_t ratio);
 extern uint32_t CS2300_calculate_ratio(uint32_t freq_in_hz, uint32_t freq_out_hz);
 extern void CS2300_set_MCLK(uint32_t mclk_hz);
 extern void CS2300_config(uint32_t fs);
+extern uint32_t CS2300_apply(const cs2300_regs_t *regs);
+extern void CS2300_reset(void);
 
 #endif /* CS2300_H_ */
\ No newline at end of file
@@ -12,8 +12,37 @@
 #include "spi_master.h"
 #include "task_SPI.h"
 #include "task_clock.h"
+#include "reg_map.h"
 #include "CS4270.h"
 
+static const reg_map_reg_t CS4270_REGS[CS4270_NUM_REGS] = {
+	{MAP_PWR_CTRL, 0x00},
+	{MAP_MODE_CTRL, 0x00},
+	{MAP_ADC_DAC_CTRL, 0x00},
+	{MAP_TRANS_CTRL, 0x00},
+	{MAP_MUTE_CTRL, 0x00},
+	{MAP_DAC_A_VOL, 0x00},
+	{MAP_DAC_B_VOL, 0x00}
+};
+
+static const reg_map_t CS4270_MAP = {
+	.chip_addr = CS4270_ADDRESS_WRITE,
+	.count = CS4270_NUM_REGS,
+	.freeze = 0,	//MAP_PWR_CTRL
+	.freeze_mask = CS4270_FREEZE,
+	.regs = CS4270_REGS
+};
+
+static reg_map_dev_t cs4270_dev = {
+	.map = &CS4270_MAP,
+	.spi = SPI_CODEC,
+	.device = &spi_device_codec,
+	.valid = false
+};
+
+//! Last target state, the single register functions change it and apply it again
+static cs4270_regs_t cs4270_regs;
+
 void CS4270_send_data(uint8_t* data, uint8_t length, uint8_t start_reg) {
 	uint8_t i;
 	
@@ -53,48 +82,88 @@ uint8_t CS4270_read_data(void) {
 	return data;
 }
 
-void CS4270_set_vol(uint8_t db_times_two) {
-	uint8_t volume = db_times_two;
-	CS4270_send_data(&volume, 1, MAP_DAC_A_VOL);
-	CS4270_send_data(&volume, 1, MAP_DAC_B_VOL);
-	return;
+//! Writes whatever differs between the chip and regs
+/*! \return number of SPI transfers it took
+*/
+uint32_t CS4270_apply(const cs4270_regs_t *regs) {
+	
+	cs4270_regs = *regs;
+	
+	return reg_map_apply(&cs4270_dev, cs4270_regs.b);
 }
 
-void CS4270_headphone_amp_mode(bool enable) {
-	adc_dac_ctrl_t adc_dac_ctrl;
+//! Call after the chip has been reset, the next apply writes every register
+void CS4270_reset(void) {
 	
-	CS4270_send_data(NULL, 0, MAP_ADC_DAC_CTRL);
+	reg_map_invalidate(&cs4270_dev);
 	
-	adc_dac_ctrl.b = CS4270_read_data();
+	return;
+}
+
+//! Sets both DAC volumes. The chip ramps to the new value by itself, in 1/8dB steps
+//! at zero crossings (trans_ctrl_t.dac_soft_ramp and dac_zero_cross, see CS4270_config)
+void CS4270_set_vol(uint8_t db_times_two) {
+	cs4270_regs_t regs = cs4270_regs;
 	
-	adc_dac_ctrl.dig_loopback = enable;
+	// Both channels in one transfer
+	regs.dac_a_vol = db_times_two;
+	regs.dac_b_vol = db_times_two;
+	CS4270_apply(&regs);
 	
-	CS4270_send_data(&adc_dac_ctrl.b, 1, MAP_ADC_DAC_CTRL);
+	return;
+}
+
+void CS4270_headphone_amp_mode(bool enable) {
+	cs4270_regs_t regs = cs4270_regs;
+	
+	// The shadow knows the register, no read needed
+	regs.adc_dac_ctrl.dig_loopback = enable;
+	CS4270_apply(&regs);
 	
 	return;
 }
 
 void CS4270_power_down(void) {
+	cs4270_regs_t regs = cs4270_regs;
 	pwr_ctrl_t pwr_ctrl = {
 		{	.freeze = 0,
 			.power_down_adc = 1,
 			.power_down_dac = 1,
 			.power_down = 1	}
 	};
-	CS4270_send_data(&pwr_ctrl.b, 1, MAP_PWR_CTRL);
+	regs.pwr_ctrl = pwr_ctrl;
+	CS4270_apply(&regs);
 	
 	return;
 }
 
+//! Powers the ADC and DAC back up with the settings they had
+void CS4270_power_up(void) {
+	cs4270_regs_t regs = cs4270_regs;
+	pwr_ctrl_t pwr_ctrl = {
+		{	.freeze = 0,
+			.power_down_adc = 0,
+			.power_down_dac = 0,
+			.power_down = 0	}
+	};
+	regs.pwr_ctrl = pwr_ctrl;
+	CS4270_apply(&regs);
+	
+	return;
+}
+
+//! Describes the whole configuration, the register map sends it frozen in two transfers
 void CS4270_config(void) {
-	// Freeze registers, power down adc and dac
+	cs4270_regs_t regs;
+	
+	// ADC and DAC on
 	pwr_ctrl_t pwr_ctrl = {
-		{	.freeze = 1,
-			.power_down_adc = 1,
-			.power_down_dac = 1,
+		{	.freeze = 0,
+			.power_down_adc = 0,
+			.power_down_dac = 0,
 			.power_down = 0	}
 	};
-	CS4270_send_data(&pwr_ctrl.b, 1, MAP_PWR_CTRL);
+	regs.pwr_ctrl = pwr_ctrl;
 	
 	// I2S slave, MCLK = 24.576MHz or 22.5792MHz
 	mode_ctrl_t mode_ctrl = {
@@ -102,7 +171,7 @@ void CS4270_config(void) {
 			.ratio_sel = RATIO_DIV2,
 			.popguard = 0	}
 	};
-	CS4270_send_data(&mode_ctrl.b, 1, MAP_MODE_CTRL);
+	regs.mode_ctrl = mode_ctrl;
 	
 	// I2S 24b mode
 	adc_dac_ctrl_t adc_dac_ctrl = {
@@ -112,7 +181,7 @@ void CS4270_config(void) {
 			.dac_dig_format = I2S_24b,
 			.adc_dig_format = I2S_24b	}
 	};
-	CS4270_send_data(&adc_dac_ctrl.b, 1, MAP_ADC_DAC_CTRL);
+	regs.adc_dac_ctrl = adc_dac_ctrl;
 	
 	// Soft ramping and zero crossing enabled
 	trans_ctrl_t trans_ctrl = {
@@ -125,7 +194,7 @@ void CS4270_config(void) {
 			.dac_inv_pol_a = 0,
 			.de_emphasis = 0	}
 	};
-	CS4270_send_data(&trans_ctrl.b, 1, MAP_TRANS_CTRL);
+	regs.trans_ctrl = trans_ctrl;
 	
 	// Nothing muted
 	mute_ctrl_t mute_ctrl = {
@@ -135,18 +204,13 @@ void CS4270_config(void) {
 			.mute_dac_b = 0,
 			.mute_dac_a = 0	}
 	};
-	CS4270_send_data(&mute_ctrl.b, 1, MAP_MUTE_CTRL);
+	regs.mute_ctrl = mute_ctrl;
 	
 	// Volume at 0dB
-	CS4270_set_vol(0);
-	
-	// Freeze off, power on adc, dac
-	pwr_ctrl.freeze = 0;
-	pwr_ctrl.power_down_adc = 0;
-	pwr_ctrl.power_down_dac = 0;
-	pwr_ctrl.power_down = 0;
+	regs.dac_a_vol = 0;
+	regs.dac_b_vol = 0;
 	
-	CS4270_send_data(&pwr_ctrl.b, 1, MAP_PWR_CTRL);
+	CS4270_apply(&regs);
 	
 	return;
 }
\ No newline at end of file
@@ -21,6 +21,11 @@
 #define MAP_DAC_A_VOL	0x07
 #define MAP_DAC_B_VOL	0x08
 
+// Writable registers, MAP_PWR_CTRL to MAP_DAC_B_VOL
+#define CS4270_NUM_REGS	7
+// pwr_ctrl_t.freeze
+#define CS4270_FREEZE	0x80
+
 // mode_ctrl_t.func_mode values
 #define SINGLE_SPEED	0x0		//fs = 4..54kHz
 #define DOUBLE_SPEED	0x1		//fs = 50..108kHz
@@ -111,11 +116,28 @@ typedef union{
 	uint8_t b;
 }mute_ctrl_t;
 
+// Target state for the register map, in address order
+typedef union{
+	struct {
+		pwr_ctrl_t pwr_ctrl;
+		mode_ctrl_t mode_ctrl;
+		adc_dac_ctrl_t adc_dac_ctrl;
+		trans_ctrl_t trans_ctrl;
+		mute_ctrl_t mute_ctrl;
+		uint8_t dac_a_vol;
+		uint8_t dac_b_vol;
+	};
+	uint8_t b[CS4270_NUM_REGS];
+}cs4270_regs_t;
+
 extern void CS4270_send_data(uint8_t* data, uint8_t length, uint8_t start_reg);
 extern uint8_t CS4270_read_data(void);
 extern void CS4270_set_vol(uint8_t db_times_two);
 extern void CS4270_headphone_amp_mode(bool enable);
 extern void CS4270_power_down(void);
+extern void CS4270_power_up(void);
 extern void CS4270_config(void);
+extern uint32_t CS4270_apply(const cs4270_regs_t *regs);
+extern void CS4270_reset(void);
 
 #endif /* CS4270_H_ */
\ No newline at end of file
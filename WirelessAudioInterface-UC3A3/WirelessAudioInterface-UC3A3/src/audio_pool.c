@@ -0,0 +1,150 @@
+/*
+ * audio_pool.c
+ *
+ * Created: 4/24/2013 10:27:36 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "interrupt.h"
+#include "audio_pool.h"
+
+//! The blocks themselves, never allocated from the heap
+static audio_block_t audio_blocks[AUDIO_POOL_BLOCKS];
+
+//! AUDIO_BLOCK_WORDS per block, the static block takes the one after the pool
+#define AUDIO_DMA_BLOCK(n)		((uint32_t *)AUDIO_DMA_ADDRESS + (n) * AUDIO_BLOCK_WORDS)
+
+//! Fails the build when the DMA buffers outgrow the bank
+typedef char audio_dma_size_check[((AUDIO_POOL_BLOCKS + 1) * AUDIO_BLOCK_WORDS * 4 <= AUDIO_DMA_SIZE) ? 1 : -1];
+
+//! Free list as a stack of block indices
+static uint8_t free_list[AUDIO_POOL_BLOCKS];
+static uint32_t free_count;
+
+static audio_pool_stats_t pool_stats;
+
+//! Fills the free list. Only call while no block is in use
+void audio_pool_init(void) {
+	uint32_t i;
+	
+	for (i = 0; i < AUDIO_POOL_BLOCKS; i++) {
+		audio_blocks[i].dma = AUDIO_DMA_BLOCK(i);
+		audio_blocks[i].index = i;
+		audio_blocks[i].refcount = 0;
+		free_list[i] = i;
+	}
+	
+	free_count = AUDIO_POOL_BLOCKS;
+	
+	pool_stats.allocs = 0;
+	pool_stats.failures = 0;
+	pool_stats.in_use = 0;
+	pool_stats.in_use_max = 0;
+	
+	return;
+}
+
+//! Sets up a block that is not part of the pool, giving it the spare DMA buffer. One such block only
+void audio_pool_init_static(audio_block_t *block) {
+	
+	block->dma = AUDIO_DMA_BLOCK(AUDIO_POOL_BLOCKS);
+	block->refcount = AUDIO_BLOCK_STATIC;
+	block->index = AUDIO_POOL_BLOCKS;
+	
+	return;
+}
+
+//! Takes a block from the pool with one reference held by the caller
+/*!
+	Safe from tasks and interrupts alike.
+	\return the block, or NULL if the pool is empty
+*/
+audio_block_t *audio_pool_alloc(void) {
+	audio_block_t *block = NULL;
+	irqflags_t flags;
+	
+	flags = cpu_irq_save();
+	
+	if (free_count) {
+		block = &audio_blocks[free_list[--free_count]];
+		block->refcount = 1;
+		
+		pool_stats.allocs++;
+		pool_stats.in_use = AUDIO_POOL_BLOCKS - free_count;
+		if (pool_stats.in_use > pool_stats.in_use_max) pool_stats.in_use_max = pool_stats.in_use;
+	}
+	else {
+		pool_stats.failures++;
+	}
+	
+	cpu_irq_restore(flags);
+	
+	return block;
+}
+
+//! Adds a reference, for a stage that keeps the block while also passing it on
+void audio_pool_retain(audio_block_t *block) {
+	irqflags_t flags;
+	
+	if (block->refcount == AUDIO_BLOCK_STATIC) return;
+	
+	flags = cpu_irq_save();
+	block->refcount++;
+	cpu_irq_restore(flags);
+	
+	return;
+}
+
+//! Drops a reference, the block goes back to the pool with the last one
+void audio_pool_release(audio_block_t *block) {
+	irqflags_t flags;
+	
+	if (block == NULL || block->refcount == AUDIO_BLOCK_STATIC) return;
+	
+	flags = cpu_irq_save();
+	
+	if (block->refcount && !--block->refcount) {
+		free_list[free_count++] = block->index;
+		pool_stats.in_use = AUDIO_POOL_BLOCKS - free_count;
+	}
+	
+	cpu_irq_restore(flags);
+	
+	return;
+}
+
+//! Converts the received SSC words of a block into its pcm channels, top 16 of 24 bits
+void audio_pool_unpack(audio_block_t *block) {
+	uint32_t i;
+	
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		block->pcm.left[i] = (int16_t)(block->dma[2*i] >> 8);
+		block->pcm.right[i] = (int16_t)(block->dma[2*i + 1] >> 8);
+	}
+	
+	return;
+}
+
+//! Converts the pcm channels of a block back into SSC words for transmission
+void audio_pool_pack(audio_block_t *block) {
+	uint32_t i;
+	
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		block->dma[2*i] = (uint32_t)(uint16_t)block->pcm.left[i] << 8;
+		block->dma[2*i + 1] = (uint32_t)(uint16_t)block->pcm.right[i] << 8;
+	}
+	
+	return;
+}
+
+//! Copies the pool statistics
+void audio_pool_get_stats(audio_pool_stats_t *stats) {
+	irqflags_t flags;
+	
+	flags = cpu_irq_save();
+	*stats = pool_stats;
+	cpu_irq_restore(flags);
+	
+	return;
+}
\ No newline at end of file
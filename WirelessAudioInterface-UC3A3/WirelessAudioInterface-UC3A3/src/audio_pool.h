@@ -0,0 +1,58 @@
+/*
+ * audio_pool.h
+ *
+ * Created: 4/24/2013 10:27:51 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef AUDIO_POOL_H_
+#define AUDIO_POOL_H_
+
+#include "task_DSP.h"
+
+//! Blocks in the pool: two per PDCA channel in flight plus the processing pipeline
+#define AUDIO_POOL_BLOCKS		8
+
+//! 32 bit SSC words per block: DSP_BLOCK_FRAMES stereo frames
+#define AUDIO_BLOCK_WORDS		(2 * DSP_BLOCK_FRAMES)
+
+//! refcount value of blocks that are not part of the pool and are never freed
+#define AUDIO_BLOCK_STATIC		0xFF
+
+//! DMA buffers of the pool and of one static block, in HSB SRAM bank 0 (HRAMC0)
+/*!
+	The PDCA reaches CPU SRAM through the CPU's own bus interface and competes with it there,
+	HSB SRAM is a separate slave, so the transfers run beside the CPU. Only the dma words go
+	there, pcm and the DSP state stay in single cycle CPU SRAM. The linker script does not
+	place anything in the bank, the pool owns all of it.
+*/
+#define AUDIO_DMA_ADDRESS		0xFF000000UL
+#define AUDIO_DMA_SIZE			(16 * 1024UL)
+
+//! One audio block. Stages hand the block itself on by pointer and work on it in place:
+//! the PDCA reads/writes dma, the DSP works on pcm
+typedef struct {
+	uint32_t *dma;
+	dsp_block_t pcm;
+	volatile uint8_t refcount;
+	uint8_t index;
+} audio_block_t;
+
+typedef struct {
+	uint32_t allocs;
+	uint32_t failures;
+	uint32_t in_use;
+	uint32_t in_use_max;
+} audio_pool_stats_t;
+
+extern void audio_pool_init(void);
+extern void audio_pool_init_static(audio_block_t *block);
+extern audio_block_t *audio_pool_alloc(void);
+extern void audio_pool_retain(audio_block_t *block);
+extern void audio_pool_release(audio_block_t *block);
+extern void audio_pool_unpack(audio_block_t *block);
+extern void audio_pool_pack(audio_block_t *block);
+extern void audio_pool_get_stats(audio_pool_stats_t *stats);
+
+#endif /* AUDIO_POOL_H_ */
\ No newline at end of file
@@ -62,15 +62,16 @@
  *----------------------------------------------------------*/
 
 #define configUSE_PREEMPTION      1
-#define configUSE_IDLE_HOOK       0
-#define configUSE_TICK_HOOK       0
-#define configCPU_CLOCK_HZ        ( FOSC0 ) /* Hz clk gen */
-#define configPBA_CLOCK_HZ        ( FOSC0 )
+#define configUSE_IDLE_HOOK       1
+#define configUSE_TICK_HOOK       1
+#define configCPU_CLOCK_HZ        ( FCPU_HZ ) /* Hz clk gen */
+#define configPBA_CLOCK_HZ        ( FPBA_HZ )
 #define configTICK_RATE_HZ        ( ( portTickType ) 1000 )
 #define configMAX_PRIORITIES      ( ( unsigned portBASE_TYPE ) 8 )
 #define configMINIMAL_STACK_SIZE  ( ( unsigned portSHORT ) 256 )
-/* configTOTAL_HEAP_SIZE is not used when heap_3.c is used. */
-#define configTOTAL_HEAP_SIZE     ( ( size_t ) ( 1024*25 ) )
+/* configTOTAL_HEAP_SIZE is not used: heap_3.c is replaced by the static arena in
+   rtos_mem.c, which is sized from the tasks and queues the application creates. */
+#define configTOTAL_HEAP_SIZE     ( ( size_t ) 0 )
 #define configMAX_TASK_NAME_LEN   ( 16 )
 #define configUSE_TRACE_FACILITY  0
 #define configUSE_16_BIT_TICKS    0
@@ -105,15 +106,33 @@ to exclude the API function. */
    0xA5 in order to be able to determine the maximal heap consumption. */
 #define configHEAP_INIT               0
 
-// #define configUSE_MUTEXES                   0
+#define configUSE_MUTEXES                   1
 // #define configUSE_RECURSIVE_MUTEXES         0
 // #define configUSE_COUNTING_SEMAPHORES       0
 // #define configUSE_ALTERNATIVE_API           0
-// #define configCHECK_FOR_STACK_OVERFLOW      0
+#define configCHECK_FOR_STACK_OVERFLOW       2
 // #define configQUEUE_REGISTRY_SIZE           10
 // #define configGENERATE_RUN_TIME_STATS       0
 
 // #define INCLUDE_vResumeFromISR              1
-// #define INCLUDE_uxTaskGetStackHighWaterMark 0
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+
+/* Run-time statistics, see rtos_stats.c. Every task carries its statistics slot
+   as its task tag. The trace hooks expand inside vTaskSwitchContext(): a task
+   that is still in its ready list when switched out was preempted. */
+#define configUSE_APPLICATION_TASK_TAG      1
+
+extern void rtos_stats_switched_out(void *tag, unsigned long preempted);
+extern void rtos_stats_switched_in(void *tag);
+
+#define traceTASK_SWITCHED_OUT()  rtos_stats_switched_out( ( void * ) pxCurrentTCB->pxTaskTag, \
+                                    listIS_CONTAINED_WITHIN( &( pxReadyTasksLists[ pxCurrentTCB->uxPriority ] ), \
+                                                             &( pxCurrentTCB->xGenericListItem ) ) )
+/* Tickless idle, see task_power.c. The idle hook sleeps until the first delayed
+   task is due, which only the kernel knows. */
+extern void task_power_next_unblock(unsigned long tick);
+
+#define traceTASK_SWITCHED_IN()   do { rtos_stats_switched_in( ( void * ) pxCurrentTCB->pxTaskTag ); \
+                                       task_power_next_unblock( xNextTaskUnblockTime ); } while( 0 )
 
 #endif /* FREERTOS_CONFIG_H */
@@ -59,12 +59,13 @@
 //#define CONFIG_SYSCLK_PBA_DIV         0
 //#define CONFIG_SYSCLK_PBB_DIV         0
 
-//#define CONFIG_USBCLK_SOURCE          USBCLK_SRC_OSC0
+// The USBB takes 12MHz, straight from the OSC0 crystal
+#define CONFIG_USBCLK_SOURCE          USBCLK_SRC_OSC0
 //#define CONFIG_USBCLK_SOURCE        USBCLK_SRC_PLL0
 //#define CONFIG_USBCLK_SOURCE        USBCLK_SRC_PLL1
 
 /* Fusb = Fsys / USB_div */
-//#define CONFIG_USBCLK_DIV             1
+#define CONFIG_USBCLK_DIV             1
 
 //#define CONFIG_PLL0_SOURCE          PLL_SRC_OSC0
 //#define CONFIG_PLL0_SOURCE          PLL_SRC_OSC1
@@ -0,0 +1,74 @@
+/*
+ * conf_tasks.h
+ *
+ * Created: 4/24/2013 9:36:15 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef CONF_TASKS_H_
+#define CONF_TASKS_H_
+
+/*
+	Task set, rate monotonic: the shorter the period the higher the priority.
+	Event driven tasks use their minimum inter-arrival time as the period.
+
+	Task	Prio	Period (T)		Budget (C)	Blocking (B)	WCRT (R)	Deadline
+	AUDIO	6		1.33ms (block)	0.35ms		0.01ms			0.36ms		1.33ms
+	EHIF	5		10ms (poll)		0.25ms		0.15ms			0.75ms		10ms
+	CLOCK	4		20ms (min)		0.40ms		0				1.00ms		20ms
+	TOUCH	3		20ms (min)		0.60ms		0				1.95ms		20ms
+	LEDS	2		40ms			0.50ms		0				2.45ms		40ms
+	FFT		1		21.3ms (frame)	2.12ms		0				5.27ms		21.3ms
+
+	R is the fixed point of R = C + B + sum over higher priority tasks j of ceil(R/Tj)*Cj.
+	Utilization is 45%, below the 73% Liu & Layland bound for six tasks.
+
+	- AUDIO is woken by the SSC RX DMA interrupt and has one block period to hand the
+	  processed block to the TX DMA. Its budget includes the PDCA, ADC, GPIO and tick
+	  interrupts (about 2% together), and its only blocking is kernel critical sections.
+	- EHIF shares SPI0 with the codec and clock chip, so it can wait for one CLOCK
+	  reconfiguration (B). The SPI0 mutex has priority inheritance.
+	- Waiting for CMD_REQ_READY on the CC85xx sleeps a tick at a time and is not
+	  counted in C. EHIF deselects the CC85xx and gives SPI0 back before every sleep,
+	  so the wait delays EHIF itself but does not block CLOCK or the codec writes.
+	- TOUCH is woken by the AT42QT1110 CHANGE line, which the device limits to one
+	  report per 16ms cycle. A key read is one burst of request, two bytes and CRC at
+	  150us spacing, and C allows for the read being repeated after a CRC error.
+	- LEDS runs the stack monitor and sends the CPU statistics once a second, its
+	  budget is that worst case.
+	- The statistics hooks add well under 1us to every context switch and tick.
+	- In standby with no audio for POWER_AUDIO_IDLE_MS the CPU runs at half clock. AUDIO
+	  and FFT are idle then, and the others need about 17% with their budgets doubled.
+	- Periodic tasks are released on the 1ms tick, so they jitter by up to one tick.
+
+	The budgets are estimates from instruction counts at 66MHz and must be checked
+	against measured run times whenever a task grows.
+*/
+
+#define TASK_AUDIO_PRIORITY		(tskIDLE_PRIORITY + 6)
+#define TASK_EHIF_PRIORITY		(tskIDLE_PRIORITY + 5)
+#define TASK_CLOCK_PRIORITY		(tskIDLE_PRIORITY + 4)
+#define TASK_TOUCH_PRIORITY		(tskIDLE_PRIORITY + 3)
+#define TASK_LEDS_PRIORITY		(tskIDLE_PRIORITY + 2)
+#define TASK_FFT_PRIORITY		(tskIDLE_PRIORITY + 1)
+
+//! Periods in ms, see the table above for the event driven ones
+#define TASK_EHIF_POLL_MS		10
+#define TASK_CLOCK_HOLDOFF_MS	20
+#define TASK_TOUCH_RESYNC_MS	100
+#define TASK_LEDS_PERIOD_MS		40
+
+//! Stack budgets in words. The stacks are static, see rtos_mem.c
+#define TASK_AUDIO_STACK		(configMINIMAL_STACK_SIZE + 128)
+#define TASK_EHIF_STACK			(configMINIMAL_STACK_SIZE)
+#define TASK_CLOCK_STACK		(configMINIMAL_STACK_SIZE)
+#define TASK_TOUCH_STACK		(configMINIMAL_STACK_SIZE)
+#define TASK_LEDS_STACK			(configMINIMAL_STACK_SIZE)
+#define TASK_FFT_STACK			(configMINIMAL_STACK_SIZE)
+
+//! Inter-task queue lengths. The I2S queues hold block pointers and are sized by the audio pool
+#define QUEUE_EHIF_LENGTH		8
+#define QUEUE_CLOCK_LENGTH		2
+
+#endif /* CONF_TASKS_H_ */
\ No newline at end of file
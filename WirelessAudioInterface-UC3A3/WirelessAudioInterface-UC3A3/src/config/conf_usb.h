@@ -52,6 +52,7 @@
 #include "board.h"
 #include "print_funcs.h"
 #include "usb_ids.h"
+#include "usb_atmel.h"
 
 
 //! @defgroup usb_general_conf USB application configuration
@@ -230,6 +231,69 @@
   //! @}
 
 
+  // _________________ USB DEVICE STACK (UDC) CONFIGURATION _____________
+  //
+  //! @defgroup udc_cdc_conf CDC port of the device stack started by udc_start()
+  //! The statistics, telemetry and power frames go out on it
+  //! @{
+
+#define  USB_DEVICE_VENDOR_ID             USB_VID_ATMEL
+#define  USB_DEVICE_PRODUCT_ID            USB_PID_ATMEL_ASF_CDC
+#define  USB_DEVICE_MAJOR_VERSION         1
+#define  USB_DEVICE_MINOR_VERSION         0
+#define  USB_DEVICE_POWER                 100 // Consumption on VBUS (mA)
+#define  USB_DEVICE_ATTR                  (USB_CONFIG_ATTR_SELF_POWERED)
+
+#define  USB_DEVICE_EP_CTRL_SIZE          64
+#define  USB_DEVICE_NB_INTERFACE          2
+#define  USB_DEVICE_MAX_EP                3
+
+#define  UDI_CDC_PORT_NB                  1
+#define  UDI_CDC_DATA_EP_IN_0             (1 | USB_EP_DIR_IN)  // TX
+#define  UDI_CDC_DATA_EP_OUT_0            (2 | USB_EP_DIR_OUT) // RX
+#define  UDI_CDC_COMM_EP_0                (3 | USB_EP_DIR_IN)  // Notify endpoint
+#define  UDI_CDC_COMM_IFACE_NUMBER_0      0
+#define  UDI_CDC_DATA_IFACE_NUMBER_0      1
+
+#define  UDI_CDC_ENABLE_EXT(port)         true
+#define  UDI_CDC_DISABLE_EXT(port)
+#define  UDI_CDC_RX_NOTIFY(port)
+#define  UDI_CDC_SET_CODING_EXT(port,cfg)
+#define  UDI_CDC_SET_DTR_EXT(port,set)
+#define  UDI_CDC_SET_RTS_EXT(port,set)
+
+    //! Five packet buffers instead of one: the frames are written whole and the
+    //! largest, the task statistics, is longer than a packet
+#define  UDI_CDC_LOW_RATE
+#define  UDI_CDC_FRAME_MAX                (5 * 64)
+
+#define  UDI_CDC_DEFAULT_RATE             115200
+#define  UDI_CDC_DEFAULT_STOPBITS         CDC_STOP_BITS_1
+#define  UDI_CDC_DEFAULT_PARITY           CDC_PAR_NONE
+#define  UDI_CDC_DEFAULT_DATABITS         8
+
+#define UDI_COMPOSITE_DESC_T \
+	usb_iad_desc_t udi_cdc_iad; \
+	udi_cdc_comm_desc_t udi_cdc_comm; \
+	udi_cdc_data_desc_t udi_cdc_data
+
+#define UDI_COMPOSITE_DESC_FS \
+	.udi_cdc_iad               = UDI_CDC_IAD_DESC_0, \
+	.udi_cdc_comm              = UDI_CDC_COMM_DESC_0, \
+	.udi_cdc_data              = UDI_CDC_DATA_DESC_0_FS
+
+#define UDI_COMPOSITE_DESC_HS \
+	.udi_cdc_iad               = UDI_CDC_IAD_DESC_0, \
+	.udi_cdc_comm              = UDI_CDC_COMM_DESC_0, \
+	.udi_cdc_data              = UDI_CDC_DATA_DESC_0_HS
+
+#define UDI_COMPOSITE_API \
+	&udi_api_cdc_comm, \
+	&udi_api_cdc_data
+
+  //! @}
+
+
   //! USB interrupt priority level
 #define USB_INT_LEVEL                   AVR32_INTC_INT0
 
@@ -240,4 +304,7 @@
 //! @}
 
 
+//! The class headers need the configuration above, so they come last
+#include "udi_cdc.h"
+
 #endif  // _CONF_USB_H_
@@ -25,9 +25,17 @@
  * Atmel Software Framework (ASF).
  */
 #include <asf.h>
+#include "FreeRTOS.h"
+#include "task.h"
 #include "task_SPI.h"
 #include "task_I2S.h"
 #include "task_LEDs.h"
+#include "task_clock.h"
+#include "task_EHIF.h"
+#include "task_touch.h"
+#include "task_FFT.h"
+#include "task_power.h"
+#include "rtos_mem.h"
 #include "CS2300.h"
 #include "CS4270.h"
 #include "AT42QT1110.h"
@@ -47,10 +55,38 @@ int main (void)
 	
 	board_init();
 	task_spi_init();
+	task_clock_init();
 	task_I2S_init();
 	task_leds_init();
+	task_ehif_init();
+	task_power_init();
+	// The CDC port the statistics, telemetry and power frames go out on
+	udc_start();
 	#ifdef DEBUG
 		init_dbg_rs232(FPBA_HZ);
 	#endif
 	delay_init(FCPU_HZ);
+	
+	task_spi_start();
+	
+	// MCLK for the codec at the start-up rate, the clock manager only reprograms on a change
+	CS2300_config(INITIAL_BITRATE);
+	
+	// Fills the codec shadow registers, task_power_host only changes the power bits of it
+	CS4270_config();
+	
+	// Tasks and their priorities are laid out in conf_tasks.h
+	task_I2S_start();
+	task_ehif_start();
+	task_clock_start();
+	task_touch_start();
+	task_leds_start();
+	task_fft_start();
+	
+	vTaskStartScheduler();
+	
+	// Only reached if the idle task did not fit the static arena. The arena is sized from
+	// MEM_KERNEL_IDLE, so this is the same kernel object size mismatch the start functions
+	// above stop on, the idle task is the kernel's own
+	rtos_mem_halt(RTOS_MEM_KERNEL);
 }
@@ -0,0 +1,169 @@
+/*
+ * reg_map.c
+ *
+ * Created: 4/29/2013 8:41:52 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "spi_master.h"
+#include "task_SPI.h"
+#include "reg_map.h"
+
+//! Starts a transfer at register index first
+static uint8_t *reg_map_begin(const reg_map_t *map, reg_map_seq_t *seq, uint8_t first) {
+	uint8_t *p = &seq->b[seq->length];
+	
+	p[0] = 2;	//Chip address and MAP so far
+	p[1] = map->chip_addr;
+	p[2] = map->regs[first].addr;
+	
+	seq->transfers++;
+	
+	return p;
+}
+
+//! Adds a data byte to a transfer, setting the auto increment bit from the second one on
+static void reg_map_put(uint8_t *transfer, uint8_t value) {
+	
+	if (transfer[0] > 2) transfer[2] |= REG_MAP_INCR;
+	transfer[++transfer[0]] = value;
+	
+	return;
+}
+
+//! Closes a transfer
+static void reg_map_end(reg_map_seq_t *seq, uint8_t *transfer) {
+	
+	seq->length += transfer[0] + 1;
+	
+	return;
+}
+
+//! Adds the changed registers as runs of consecutive addresses
+/*!
+	A single unchanged register between two changed ones is written again rather than
+	starting a new transfer, which would cost two bytes and a chip select more.
+*/
+static void reg_map_plan_runs(const reg_map_t *map, const uint8_t *value, const bool *changed, reg_map_seq_t *seq) {
+	uint8_t *transfer = NULL;
+	uint8_t i;
+	
+	for (i = 0; i < map->count; i++) {
+		if (transfer != NULL && map->regs[i].addr != map->regs[i - 1].addr + 1) {
+			reg_map_end(seq, transfer);
+			transfer = NULL;
+		}
+		
+		if (!changed[i]) {
+			if (transfer != NULL && i + 1 < map->count && changed[i + 1]
+				&& map->regs[i + 1].addr == map->regs[i].addr + 1) {
+				reg_map_put(transfer, value[i]);
+			}
+			else if (transfer != NULL) {
+				reg_map_end(seq, transfer);
+				transfer = NULL;
+			}
+			continue;
+		}
+		
+		if (transfer == NULL) transfer = reg_map_begin(map, seq, i);
+		reg_map_put(transfer, value[i]);
+	}
+	if (transfer != NULL) reg_map_end(seq, transfer);
+	
+	return;
+}
+
+//! Plans the writes that take a chip from current to target
+/*!
+	\param map the chip
+	\param current what the chip holds, NULL if unknown (after reset): everything is written
+	\param target the wanted state, one byte per register of the map
+	\param seq receives the transfers
+	\return number of transfers, 0 if nothing changes
+*/
+uint32_t reg_map_plan(const reg_map_t *map, const uint8_t *current, const uint8_t *target, reg_map_seq_t *seq) {
+	uint8_t value[REG_MAP_MAX_REGS];
+	bool changed[REG_MAP_MAX_REGS];
+	uint8_t *transfer;
+	uint8_t unfrozen;
+	uint8_t first;
+	uint8_t i;
+	
+	seq->transfers = 0;
+	seq->length = 0;
+	
+	for (i = 0; i < map->count; i++) {
+		value[i] = target[i] | map->regs[i].set;
+		if (i == map->freeze) value[i] &= ~map->freeze_mask;
+		changed[i] = (current == NULL) || (current[i] != value[i]);
+	}
+	
+	reg_map_plan_runs(map, value, changed, seq);
+	
+	if (map->freeze == REG_MAP_NONE) return seq->transfers;
+	if (seq->transfers <= 1 && !(changed[map->freeze] && seq->b[0] > 3)) return seq->transfers;
+	
+	// Freeze first, so the chip sees all changes at once
+	seq->transfers = 0;
+	seq->length = 0;
+	
+	unfrozen = value[map->freeze];
+	value[map->freeze] = ((current != NULL) ? current[map->freeze] : unfrozen) | map->freeze_mask;
+	
+	for (first = 0; !changed[first]; first++);
+	
+	if (first != map->freeze
+		&& (first != map->freeze + 1 || map->regs[first].addr != map->regs[map->freeze].addr + 1)) {
+		// The freeze register cannot lead the first run, so it goes on its own
+		transfer = reg_map_begin(map, seq, map->freeze);
+		reg_map_put(transfer, value[map->freeze]);
+		reg_map_end(seq, transfer);
+		changed[map->freeze] = false;
+	}
+	else {
+		changed[map->freeze] = true;
+	}
+	
+	reg_map_plan_runs(map, value, changed, seq);
+	
+	transfer = reg_map_begin(map, seq, map->freeze);
+	reg_map_put(transfer, unfrozen);
+	reg_map_end(seq, transfer);
+	
+	return seq->transfers;
+}
+
+//! Brings a chip to the target state. The bus must be locked
+/*!
+	\return number of transfers sent
+*/
+uint32_t reg_map_apply(reg_map_dev_t *dev, const uint8_t *target) {
+	reg_map_seq_t seq;
+	uint8_t *p = seq.b;
+	uint8_t i;
+	
+	reg_map_plan(dev->map, dev->valid ? dev->value : NULL, target, &seq);
+	
+	for (i = 0; i < seq.transfers; i++) {
+		task_spi_write_dma(dev->spi, dev->device, &p[1], p[0]);
+		p += p[0] + 1;
+	}
+	
+	for (i = 0; i < dev->map->count; i++) {
+		dev->value[i] = target[i] | dev->map->regs[i].set;
+		if (i == dev->map->freeze) dev->value[i] &= ~dev->map->freeze_mask;
+	}
+	dev->valid = true;
+	
+	return seq.transfers;
+}
+
+//! Forgets the shadow, for when the chip has been reset
+void reg_map_invalidate(reg_map_dev_t *dev) {
+	
+	dev->valid = false;
+	
+	return;
+}
\ No newline at end of file
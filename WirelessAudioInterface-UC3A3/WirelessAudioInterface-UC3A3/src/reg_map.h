@@ -0,0 +1,67 @@
+/*
+ * reg_map.h
+ *
+ * Created: 4/29/2013 8:42:10 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef REG_MAP_H_
+#define REG_MAP_H_
+
+/*
+	Register maps for the Cirrus parts on SPI0 (CS4270, CS2300). A chip is described by
+	a const table of its writable registers in address order, and is configured by
+	handing over the complete target state. The planner works out which registers differ
+	from the shadow of what was last written and turns them into as few transfers as it
+	can: chip address, MAP with the auto increment bit, then the data.
+
+	If the changes need more than one transfer, or change the freeze register along with
+	others, and the chip has a freeze bit, freeze is set in the first transfer and cleared
+	in the last, so the chip applies everything at once. Bits in the set mask (enable_config) are written as 1 whatever the target says.
+*/
+
+//! Largest map, the CS2300
+#define REG_MAP_MAX_REGS	10
+//! MAP auto increment bit
+#define REG_MAP_INCR		0x80
+//! No freeze register
+#define REG_MAP_NONE		0xFF
+
+//! Worst case plan: every register on its own plus the freeze transfers, 4 bytes each
+#define REG_MAP_SEQ_MAX		(4 * (REG_MAP_MAX_REGS + 2))
+
+typedef struct {
+	uint8_t addr;	//MAP address
+	uint8_t set;	//Bits always written as 1
+} reg_map_reg_t;
+
+typedef struct {
+	uint8_t chip_addr;	//First byte of every write
+	uint8_t count;		//Registers in regs
+	uint8_t freeze;		//Index of the register with the freeze bit, REG_MAP_NONE if none
+	uint8_t freeze_mask;
+	const reg_map_reg_t *regs;
+} reg_map_t;
+
+//! A chip on the bus and the shadow of its registers
+typedef struct {
+	const reg_map_t *map;
+	volatile avr32_spi_t *spi;
+	struct spi_device *device;
+	bool valid;		//False until the first write after reset
+	uint8_t value[REG_MAP_MAX_REGS];
+} reg_map_dev_t;
+
+//! Planned write sequence: each transfer is its length, then the bytes to send
+typedef struct {
+	uint8_t transfers;
+	uint8_t length;
+	uint8_t b[REG_MAP_SEQ_MAX];
+} reg_map_seq_t;
+
+extern uint32_t reg_map_plan(const reg_map_t *map, const uint8_t *current, const uint8_t *target, reg_map_seq_t *seq);
+extern uint32_t reg_map_apply(reg_map_dev_t *dev, const uint8_t *target);
+extern void reg_map_invalidate(reg_map_dev_t *dev);
+
+#endif /* REG_MAP_H_ */
\ No newline at end of file
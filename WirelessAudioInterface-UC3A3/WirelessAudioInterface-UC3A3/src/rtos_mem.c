@@ -0,0 +1,217 @@
+/*
+ * rtos_mem.c
+ *
+ * Created: 4/26/2013 7:48:09 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "conf_tasks.h"
+#include "audio_pool.h"
+#include "task_EHIF.h"
+#include "task_FFT.h"
+#include "rtos_mem.h"
+#include "rtos_stats.h"
+#include "telemetry.h"
+
+#define RTOS_ALIGN(x)			(((x) + 3) & ~3UL)
+
+//! One queue as queue.c allocates it: the queue struct, then len*size+1 bytes of storage
+#define RTOS_QUEUE_SIZE(len, size)	(RTOS_ALIGN(RTOS_QUEUE_BYTES) + RTOS_ALIGN((len) * (size) + 1))
+//! Mutexes have no storage
+#define RTOS_MUTEX_SIZE			RTOS_ALIGN(RTOS_QUEUE_BYTES)
+#define RTOS_STACK_SIZE(words)	((words) * sizeof(portSTACK_TYPE))
+
+//! Kernel objects per subsystem. Add new tasks, queues and semaphores here
+#define MEM_KERNEL_AUDIO		(RTOS_TCB_BYTES + 2 * RTOS_QUEUE_SIZE(AUDIO_POOL_BLOCKS, sizeof(audio_block_t *)))
+#define MEM_KERNEL_EHIF			(RTOS_TCB_BYTES + RTOS_QUEUE_SIZE(QUEUE_EHIF_LENGTH, sizeof(ehif_msg_t)))
+#define MEM_KERNEL_CLOCK		(RTOS_TCB_BYTES + RTOS_QUEUE_SIZE(QUEUE_CLOCK_LENGTH, sizeof(uint32_t)))
+#define MEM_KERNEL_TOUCH		(RTOS_TCB_BYTES + RTOS_QUEUE_SIZE(1, 0))
+#define MEM_KERNEL_LEDS			(RTOS_TCB_BYTES)
+#define MEM_KERNEL_FFT			(RTOS_TCB_BYTES + RTOS_QUEUE_SIZE(1, 0))
+#define MEM_KERNEL_SPI			(2 * RTOS_MUTEX_SIZE)
+#define MEM_KERNEL_IDLE			(RTOS_TCB_BYTES + RTOS_STACK_SIZE(configMINIMAL_STACK_SIZE))
+
+//! Everything the kernel allocates, nothing else comes out of the arena
+#define RTOS_ARENA_SIZE			(MEM_KERNEL_AUDIO + MEM_KERNEL_EHIF + MEM_KERNEL_CLOCK + MEM_KERNEL_TOUCH \
+								+ MEM_KERNEL_LEDS + MEM_KERNEL_FFT + MEM_KERNEL_SPI + MEM_KERNEL_IDLE)
+
+//! Static buffers owned by the subsystems, counted for the report only
+//! The pool plus the silence block, their DMA buffers are in HSB SRAM (AUDIO_DMA_ADDRESS)
+#define MEM_BUFFERS_AUDIO		((AUDIO_POOL_BLOCKS + 1) * sizeof(audio_block_t))
+//! Status and statistics results, and the telemetry rings the EHIF task fills
+#define MEM_BUFFERS_EHIF		(EHIF_NWM_STATUS_LENGTH + EHIF_PS_STATS_LENGTH + TELEMETRY_MEM_BYTES)
+#define MEM_BUFFERS_FFT			(4 * FFT_SIZE * sizeof(int16_t))
+
+#define MEM_AUDIO				(MEM_KERNEL_AUDIO + RTOS_STACK_SIZE(TASK_AUDIO_STACK) + MEM_BUFFERS_AUDIO)
+#define MEM_EHIF				(MEM_KERNEL_EHIF + RTOS_STACK_SIZE(TASK_EHIF_STACK) + MEM_BUFFERS_EHIF)
+#define MEM_CLOCK				(MEM_KERNEL_CLOCK + RTOS_STACK_SIZE(TASK_CLOCK_STACK))
+#define MEM_TOUCH				(MEM_KERNEL_TOUCH + RTOS_STACK_SIZE(TASK_TOUCH_STACK))
+#define MEM_LEDS				(MEM_KERNEL_LEDS + RTOS_STACK_SIZE(TASK_LEDS_STACK))
+#define MEM_FFT					(MEM_KERNEL_FFT + RTOS_STACK_SIZE(TASK_FFT_STACK) + MEM_BUFFERS_FFT)
+#define MEM_KERNEL				(MEM_KERNEL_SPI + MEM_KERNEL_IDLE)
+#define MEM_SRAM_TOTAL			(MEM_AUDIO + MEM_EHIF + MEM_CLOCK + MEM_TOUCH + MEM_LEDS + MEM_FFT + MEM_KERNEL)
+
+//! Fails the build when the accounted memory outgrows the budget
+typedef char rtos_mem_budget_check[(MEM_SRAM_TOTAL <= RTOS_MEM_SRAM_BUDGET) ? 1 : -1];
+
+const rtos_mem_report_t rtos_mem_report[] = {
+	{"AUDIO", MEM_AUDIO},
+	{"EHIF", MEM_EHIF},
+	{"CLOCK", MEM_CLOCK},
+	{"TOUCH", MEM_TOUCH},
+	{"LEDS", MEM_LEDS},
+	{"FFT", MEM_FFT},
+	{"KERNEL", MEM_KERNEL},
+	{"TOTAL", MEM_SRAM_TOTAL}
+};
+
+typedef struct {
+	const char *name;
+	unsigned portBASE_TYPE priority;
+	portSTACK_TYPE *stack;
+	unsigned short depth;
+	xTaskHandle handle;
+	uint32_t free_min;
+} rtos_task_slot_t;
+
+static portSTACK_TYPE stack_audio[TASK_AUDIO_STACK];
+static portSTACK_TYPE stack_ehif[TASK_EHIF_STACK];
+static portSTACK_TYPE stack_clock[TASK_CLOCK_STACK];
+static portSTACK_TYPE stack_touch[TASK_TOUCH_STACK];
+static portSTACK_TYPE stack_leds[TASK_LEDS_STACK];
+static portSTACK_TYPE stack_fft[TASK_FFT_STACK];
+
+static rtos_task_slot_t rtos_tasks[RTOS_NUM_TASKS] = {
+	{"AUDIO", TASK_AUDIO_PRIORITY, stack_audio, TASK_AUDIO_STACK, NULL, TASK_AUDIO_STACK},
+	{"EHIF", TASK_EHIF_PRIORITY, stack_ehif, TASK_EHIF_STACK, NULL, TASK_EHIF_STACK},
+	{"CLOCK", TASK_CLOCK_PRIORITY, stack_clock, TASK_CLOCK_STACK, NULL, TASK_CLOCK_STACK},
+	{"TOUCH", TASK_TOUCH_PRIORITY, stack_touch, TASK_TOUCH_STACK, NULL, TASK_TOUCH_STACK},
+	{"LEDS", TASK_LEDS_PRIORITY, stack_leds, TASK_LEDS_STACK, NULL, TASK_LEDS_STACK},
+	{"FFT", TASK_FFT_PRIORITY, stack_fft, TASK_FFT_STACK, NULL, TASK_FFT_STACK}
+};
+
+//! TCBs, queues and the idle stack, handed out once and never returned
+static uint32_t rtos_arena[RTOS_ALIGN(RTOS_ARENA_SIZE) / sizeof(uint32_t)];
+
+static rtos_mem_stats_t rtos_mem_stats = {
+	.arena_size = sizeof(rtos_arena),
+	.arena_used = 0,
+	.alloc_failures = 0,
+	.frees = 0
+};
+
+//! Name of the task that overflowed its stack, for the debugger
+static volatile signed char *rtos_mem_overflow = NULL;
+
+//! Name of the task that could not be created, for the debugger
+static volatile const char *rtos_mem_create_failed = NULL;
+
+//! Replaces heap_3: a bump allocator over rtos_arena
+/*!
+	Everything is allocated before the scheduler starts and lives forever, so there is
+	nothing to fragment and no free list to search.
+*/
+void *pvPortMalloc(size_t xWantedSize) {
+	void *block = NULL;
+
+	xWantedSize = RTOS_ALIGN(xWantedSize);
+
+	vTaskSuspendAll();
+
+	if (rtos_mem_stats.arena_used + xWantedSize <= sizeof(rtos_arena)) {
+		block = (uint8_t *)rtos_arena + rtos_mem_stats.arena_used;
+		rtos_mem_stats.arena_used += xWantedSize;
+	}
+	else {
+		rtos_mem_stats.alloc_failures++;
+	}
+
+	xTaskResumeAll();
+
+	return block;
+}
+
+//! The application never deletes tasks or queues, a call here is only counted
+void vPortFree(void *pv) {
+
+	if (pv != NULL) rtos_mem_stats.frees++;
+
+	return;
+}
+
+//! Called by the kernel on a context switch away from a task whose stack end was overwritten
+void vApplicationStackOverflowHook(xTaskHandle *pxTask, signed char *pcTaskName) {
+
+	rtos_mem_overflow = pcTaskName;
+
+	// Memory next to the stack is gone, stop here rather than run on it
+	Disable_global_interrupt();
+	while (1);
+}
+
+//! Creates a task on its static stack
+/*!
+	\param task RTOS_TASK_xxx, selects name, priority and stack
+	\param code the task function
+	\return false if the TCB did not fit in the arena
+*/
+bool rtos_mem_task_create(uint32_t task, pdTASK_CODE code) {
+	rtos_task_slot_t *slot = &rtos_tasks[task];
+
+	if (xTaskGenericCreate(code, (const signed char *)slot->name, slot->depth, NULL,
+			slot->priority, &slot->handle, slot->stack, NULL) != pdPASS) return false;
+
+	// The tag is only read by the statistics hooks, the task has not run yet
+	vTaskSetApplicationTaskTag(slot->handle, (pdTASK_HOOK_CODE)RTOS_STATS_SLOT(task));
+
+	return true;
+}
+
+//! Stops the firmware when a task, queue or semaphore could not be created
+/*!
+	Called by the init and start functions when rtos_mem_task_create fails or a create call
+	returns NULL. The arena is sized at build time, so this is a kernel object size mismatch
+	(RTOS_TCB_BYTES, RTOS_QUEUE_BYTES), not something to run on.
+	\param task RTOS_TASK_xxx that owns the object, or RTOS_MEM_KERNEL
+*/
+void rtos_mem_halt(uint32_t task) {
+	
+	// The report lists the tasks in slot order, then the kernel
+	rtos_mem_create_failed = rtos_mem_report[task].name;
+	
+	Disable_global_interrupt();
+	while (1);
+}
+
+//! Refreshes the lowest free stack seen per task, run every RTOS_MEM_MONITOR_MS
+void rtos_mem_monitor(void) {
+	uint32_t i;
+	uint32_t free;
+
+	for (i = 0; i < RTOS_NUM_TASKS; i++) {
+		if (rtos_tasks[i].handle == NULL) continue;
+
+		free = uxTaskGetStackHighWaterMark(rtos_tasks[i].handle);
+		if (free < rtos_tasks[i].free_min) rtos_tasks[i].free_min = free;
+	}
+
+	return;
+}
+
+//! Returns the lowest free stack of a task seen by the monitor, in words
+uint32_t rtos_mem_get_stack_free(uint32_t task) {
+	return rtos_tasks[task].free_min;
+}
+
+//! Copies the arena statistics
+void rtos_mem_get_stats(rtos_mem_stats_t *stats) {
+
+	vTaskSuspendAll();
+	*stats = rtos_mem_stats;
+	xTaskResumeAll();
+
+	return;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+/*
+ * rtos_mem.h
+ *
+ * Created: 4/26/2013 7:48:22 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef RTOS_MEM_H_
+#define RTOS_MEM_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+//! Task slots, each with a stack sized in conf_tasks.h
+#define RTOS_TASK_AUDIO			0
+#define RTOS_TASK_EHIF			1
+#define RTOS_TASK_CLOCK			2
+#define RTOS_TASK_TOUCH			3
+#define RTOS_TASK_LEDS			4
+#define RTOS_TASK_FFT			5
+#define RTOS_NUM_TASKS			6
+//! Kernel objects no task owns (the SPI mutexes), for rtos_mem_halt
+#define RTOS_MEM_KERNEL			RTOS_NUM_TASKS
+
+//! Kernel object sizes for FreeRTOS 7.0.0 on UC3 with mutexes, task tags and stack checking.
+//! The arena is sized from these, rtos_mem_stats.alloc_failures catches a mismatch at boot
+#define RTOS_TCB_BYTES			80
+#define RTOS_QUEUE_BYTES		76
+
+//! Upper limit for everything accounted in rtos_mem_report, in CPU SRAM (64KB)
+#define RTOS_MEM_SRAM_BUDGET	(48 * 1024UL)
+
+//! Stack high water marks are refreshed this often
+#define RTOS_MEM_MONITOR_MS		1000
+
+typedef struct {
+	const char *name;
+	uint32_t bytes;
+} rtos_mem_report_t;
+
+typedef struct {
+	uint32_t arena_size;
+	uint32_t arena_used;
+	uint32_t alloc_failures;
+	uint32_t frees;
+} rtos_mem_stats_t;
+
+//! Static memory per subsystem, computed at build time. The last entry is the total
+extern const rtos_mem_report_t rtos_mem_report[];
+
+extern bool rtos_mem_task_create(uint32_t task, pdTASK_CODE code);
+extern void rtos_mem_halt(uint32_t task);
+extern void rtos_mem_monitor(void);
+extern uint32_t rtos_mem_get_stack_free(uint32_t task);
+extern void rtos_mem_get_stats(rtos_mem_stats_t *stats);
+
+#endif /* RTOS_MEM_H_ */
\ No newline at end of file
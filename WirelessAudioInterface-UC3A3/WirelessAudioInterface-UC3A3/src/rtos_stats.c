@@ -0,0 +1,186 @@
+/*
+ * rtos_stats.c
+ *
+ * Created: 4/27/2013 3:12:31 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "udi_cdc.h"
+#include "rtos_mem.h"
+#include "rtos_stats.h"
+#include "task_power.h"
+
+//! Fails the build when a frame no longer fits the CDC buffer, it would never be sent
+typedef char rtos_stats_frame_check[(RTOS_STATS_FRAME_BYTES <= UDI_CDC_FRAME_MAX) ? 1 : -1];
+
+//! Window being accumulated and the last one completed
+static rtos_stats_task_t stats_acc[RTOS_STATS_SLOTS];
+static rtos_stats_task_t stats_last[RTOS_STATS_SLOTS];
+
+static uint32_t stats_window_start;
+static uint32_t stats_window_last;
+
+//! Ticks seen by the tick hook, the upper part of the time base
+static uint32_t stats_ticks = 0;
+//! Last time base value handed out
+static uint32_t stats_now_last = 0;
+
+//! Slot of the running task and when it was switched in
+static uint32_t stats_current = RTOS_STATS_IDLE;
+static uint32_t stats_switched_in = 0;
+
+//! Frames not sent because the CDC buffer was full or the port closed
+static uint32_t stats_dropped = 0;
+
+static uint8_t stats_frame[RTOS_STATS_FRAME_BYTES];
+
+//! Full speed CPU cycles since the scheduler started, modulo 2^32. Interrupts must be masked
+/*!
+	COUNT restarts when it matches COMPARE. With interrupts masked that may have happened
+	without the tick hook running yet, which shows up as time going backwards. At the
+	reduced clock each COUNT step is worth more than one full speed cycle.
+*/
+static uint32_t rtos_stats_now(void) {
+	uint32_t now;
+
+	now = stats_ticks * RTOS_STATS_CYCLES_PER_TICK + (Get_system_register(AVR32_COUNT) << task_power_get_clock_shift());
+	if ((int32_t)(now - stats_now_last) < 0) now += RTOS_STATS_CYCLES_PER_TICK;
+	stats_now_last = now;
+
+	return now;
+}
+
+//! Charges the running task up to now
+static void rtos_stats_charge(void) {
+	uint32_t now = rtos_stats_now();
+
+	stats_acc[stats_current].run += now - stats_switched_in;
+	stats_switched_in = now;
+
+	return;
+}
+
+//! traceTASK_SWITCHED_OUT, from vTaskSwitchContext
+/*!
+	\param tag the task tag, the statistics slot
+	\param preempted true if the task is still ready, i.e. did not block
+*/
+void rtos_stats_switched_out(void *tag, unsigned long preempted) {
+
+	rtos_stats_charge();
+	if (preempted) stats_acc[(uint32_t)tag].preemptions++;
+
+	return;
+}
+
+//! traceTASK_SWITCHED_IN, from vTaskSwitchContext
+void rtos_stats_switched_in(void *tag) {
+
+	stats_current = (uint32_t)tag;
+	stats_acc[stats_current].switches++;
+
+	return;
+}
+
+//! Extends the time base and samples the tick interrupt latency
+/*!
+	COUNT started from 0 when the tick fired, so its value here is the time the interrupt
+	waited behind masked sections and higher levels plus the kernel's entry code.
+*/
+void vApplicationTickHook(void) {
+	uint32_t latency = Get_system_register(AVR32_COUNT) << task_power_get_clock_shift();
+
+	stats_ticks++;
+
+	if (latency > 0xFFFF) latency = 0xFFFF;
+	if (latency > stats_acc[stats_current].isr_latency_max) {
+		stats_acc[stats_current].isr_latency_max = latency;
+	}
+
+	return;
+}
+
+//! Writes a big endian field into the frame
+static uint8_t *rtos_stats_put(uint8_t *p, uint32_t value, uint32_t bytes) {
+
+	while (bytes--) {
+		*p++ = value >> (8 * bytes);
+	}
+
+	return p;
+}
+
+//! Closes the window and sends it over CDC, run every RTOS_MEM_MONITOR_MS
+void rtos_stats_report(void) {
+	uint32_t i;
+	uint32_t now;
+	uint8_t *p;
+	uint8_t sum = 0;
+
+	portENTER_CRITICAL();
+	rtos_stats_charge();
+	now = stats_now_last;
+	stats_window_last = now - stats_window_start;
+	stats_window_start = now;
+	for (i = 0; i < RTOS_STATS_SLOTS; i++) {
+		stats_last[i] = stats_acc[i];
+		stats_acc[i].run = 0;
+		stats_acc[i].switches = 0;
+		stats_acc[i].preemptions = 0;
+		stats_acc[i].isr_latency_max = 0;
+	}
+	portEXIT_CRITICAL();
+
+	p = stats_frame;
+	*p++ = RTOS_STATS_SYNC0;
+	*p++ = RTOS_STATS_SYNC1;
+	*p++ = RTOS_STATS_FRAME_TASKS;
+	*p++ = RTOS_STATS_PAYLOAD;
+	p = rtos_stats_put(p, stats_window_last, 4);
+	*p++ = RTOS_STATS_SLOTS;
+
+	for (i = 0; i < RTOS_STATS_SLOTS; i++) {
+		*p++ = i;
+		p = rtos_stats_put(p, stats_last[i].run, 4);
+		p = rtos_stats_put(p, stats_last[i].switches, 2);
+		p = rtos_stats_put(p, stats_last[i].preemptions, 2);
+		p = rtos_stats_put(p, stats_last[i].isr_latency_max, 2);
+	}
+
+	for (i = 2; i < RTOS_STATS_FRAME_BYTES - 1; i++) {
+		sum += stats_frame[i];
+	}
+	*p = -sum;
+
+	// Never wait for the host, a closed port or a slow reader just loses frames
+	if (udi_cdc_get_free_tx_buffer() < RTOS_STATS_FRAME_BYTES) {
+		stats_dropped++;
+		return;
+	}
+	udi_cdc_write_buf(stats_frame, RTOS_STATS_FRAME_BYTES);
+
+	return;
+}
+
+//! Copies the statistics of the last completed window
+void rtos_stats_get(uint32_t slot, rtos_stats_task_t *stats) {
+
+	portENTER_CRITICAL();
+	*stats = stats_last[slot];
+	portEXIT_CRITICAL();
+
+	return;
+}
+
+//! Returns the length of the last completed window in CPU cycles
+uint32_t rtos_stats_get_window(void) {
+	return stats_window_last;
+}
+
+//! Returns the number of frames dropped because CDC was not ready
+uint32_t rtos_stats_get_dropped(void) {
+	return stats_dropped;
+}
\ No newline at end of file
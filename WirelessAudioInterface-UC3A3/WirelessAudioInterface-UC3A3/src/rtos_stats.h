@@ -0,0 +1,60 @@
+/*
+ * rtos_stats.h
+ *
+ * Created: 4/27/2013 3:12:44 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef RTOS_STATS_H_
+#define RTOS_STATS_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos_mem.h"
+
+//! Statistics slots: the idle task, then the RTOS_TASK_xxx slots shifted by one.
+//! The slot is kept in the task tag, which is NULL (slot 0) for the idle task
+#define RTOS_STATS_IDLE			0
+#define RTOS_STATS_SLOT(task)	((task) + 1)
+#define RTOS_STATS_SLOTS		(RTOS_NUM_TASKS + 1)
+
+//! Time base: the tick counter extended by COUNT, which restarts at every tick
+#define RTOS_STATS_CYCLES_PER_TICK	(configCPU_CLOCK_HZ / configTICK_RATE_HZ)
+
+/*
+	Frame sent over CDC at the end of each window, multi-byte fields big endian:
+
+	[0]		RTOS_STATS_SYNC0
+	[1]		RTOS_STATS_SYNC1
+	[2]		RTOS_STATS_FRAME_TASKS
+	[3]		payload length
+	[4]		window length, full speed CPU cycles (4 bytes)
+	[8]		number of slots n
+	[9]		n times:
+				slot (1), run time in cycles (4), switches in (2),
+				preemptions (2), max tick interrupt latency in cycles (2)
+	[end]	checksum: the two's complement of the sum of bytes [2] to [end-1]
+
+	ISR time is charged to the task it interrupted.
+*/
+#define RTOS_STATS_SYNC0		0xA5
+#define RTOS_STATS_SYNC1		0x5A
+#define RTOS_STATS_FRAME_TASKS	0x54
+#define RTOS_STATS_SLOT_BYTES	11
+#define RTOS_STATS_PAYLOAD		(5 + RTOS_STATS_SLOTS * RTOS_STATS_SLOT_BYTES)
+#define RTOS_STATS_FRAME_BYTES	(4 + RTOS_STATS_PAYLOAD + 1)
+
+typedef struct {
+	uint32_t run;
+	uint16_t switches;
+	uint16_t preemptions;
+	uint16_t isr_latency_max;
+} rtos_stats_task_t;
+
+extern void rtos_stats_report(void);
+extern void rtos_stats_get(uint32_t slot, rtos_stats_task_t *stats);
+extern uint32_t rtos_stats_get_window(void);
+extern uint32_t rtos_stats_get_dropped(void);
+
+#endif /* RTOS_STATS_H_ */
\ No newline at end of file
@@ -9,9 +9,104 @@
 #include "board.h"
 #include "gpio.h"
 #include "adc.h"
+#include "interrupt.h"
 #include "power_clocks_lib.h"
 #include "task_ADC.h"
 
+//! Meter fed by the TC triggered ADC conversions
+static volatile level_meter_t adc_meter;
+//! Meter fed by the I2S DMA blocks
+static volatile level_meter_t i2s_meter;
+//! Meter the getters read from
+static volatile level_meter_t *active_meter = &adc_meter;
+
+//! Clears a meter
+static void meter_clear(volatile level_meter_t *meter) {
+	uint32_t i;
+	
+	for (i = 0; i < NUM_AVERAGE_SAMPLES; i++) {
+		meter->buffer[i] = 0;
+	}
+	
+	meter->buffer_count = 0;
+	meter->latest_val = 0;
+	meter->sum = 0;
+	meter->average = 0;
+	meter->peak = 0;
+	meter->peak_hold = 0;
+	meter->mean_square = 0;
+	
+	return;
+}
+
+//! Adds one value to a meter in constant time
+/*!
+	\param meter the meter to update
+	\param val the new magnitude
+	\param peak the largest magnitude since the last call, val for single samples
+*/
+static void meter_push(volatile level_meter_t *meter, uint32_t val, uint32_t peak) {
+	uint32_t count = meter->buffer_count;
+	
+	meter->latest_val = val;
+	
+	// Running sum: drop the oldest value, add the newest
+	meter->sum += val - meter->buffer[count];
+	meter->buffer[count] = val;
+	meter->buffer_count = (count < (NUM_AVERAGE_SAMPLES - 1)) ? (count + 1) : 0;
+	meter->average = meter->sum / NUM_AVERAGE_SAMPLES;
+	
+	if (peak >= meter->peak) {
+		meter->peak = peak;
+		meter->peak_hold = PEAK_HOLD_SAMPLES;
+	}
+	else if (meter->peak_hold) {
+		meter->peak_hold--;
+	}
+	else if (meter->peak) {
+		meter->peak -= (meter->peak >> PEAK_DECAY_SHIFT) + 1;
+	}
+	
+	meter->mean_square += (int32_t)(((val * val) << RMS_FRAC) - meter->mean_square) >> RMS_SHIFT;
+	
+	return;
+}
+
+//! Integer square root
+static uint32_t isqrt(uint32_t x) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	
+	while (bit > x) bit >>= 2;
+	
+	while (bit) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	
+	return root;
+}
+
+//! End of conversion handler, one sample per TIOA0 period
+ISR(task_adc_int_handler, AVR32_ADC_IRQ_GROUP, ADC_INT_LEVEL) {
+	uint32_t adc_val;
+	
+	// EOC is already set so this does not wait, reading CDR clears it
+	adc_val = adc_get_value(&AVR32_ADC, ADC_CHAN_AUDIO);
+	
+	// Fold around mid scale to 0 to ADC_MAX_VALUE/2
+	if (adc_val < (ADC_MAX_VALUE / 2)) adc_val = (ADC_MAX_VALUE / 2) - adc_val;
+	else adc_val = adc_val - (ADC_MAX_VALUE / 2);
+	
+	meter_push(&adc_meter, adc_val, adc_val);
+}
+
 void task_adc_init(void) {
 	
 	static const gpio_map_t ADC_GPIO_MAP = {
@@ -25,19 +120,18 @@ void task_adc_init(void) {
 	
 	adc_configure(&AVR32_ADC);
 	
+	//Conversions are started by hardware, see task_leds_init for the TIOA0 waveform
+	AVR32_ADC.mr |= AVR32_ADC_TRGEN_MASK | (ADC_TRIGGER_TIOA0 << AVR32_ADC_TRGSEL_OFFSET);
+	
+	irq_register_handler(task_adc_int_handler, AVR32_ADC_IRQ, ADC_INT_LEVEL);
+	
 	return;
 }
 
 void task_adc_clear(void) {
-	uint32_t i;
-	
-	adc_data.average = 0;
-	adc_data.buffer_count = 0;
-	adc_data.latest_val = 0;
 	
-	for (i = 0; i < NUM_AVERAGE_SAMPLES; i++) {
-		adc_data.buffer[i] = 0;
-	}
+	meter_clear(&adc_meter);
+	meter_clear(&i2s_meter);
 	
 	return;
 }
@@ -46,52 +140,80 @@ void task_adc_enable(void) {
 	task_adc_clear();
 	
 	adc_enable(&AVR32_ADC, ADC_CHAN_AUDIO);
+	AVR32_ADC.ier = ADC_MASK_AUDIO;
 	
 	return;
 }
 
 void task_adc_disable(void) {
-	task_adc_clear();
-	
+	AVR32_ADC.idr = ADC_MASK_AUDIO;
 	adc_disable(&AVR32_ADC, ADC_CHAN_AUDIO);
 	
+	task_adc_clear();
+	
 	return;
 }
 
-//Returns the adc value on a scale of 0 to ADC_MAX_VALUE/2
-
-uint32_t task_adc_get_abs_val(void) {
-	uint32_t adc_val;
-	adc_start(&AVR32_ADC);
-	
-	adc_val = adc_get_value(&AVR32_ADC, ADC_CHAN_AUDIO);
-	
-	if (adc_val < (ADC_MAX_VALUE / 2)) adc_val = (ADC_MAX_VALUE / 2) - adc_val;
-	else adc_val = adc_val - (ADC_MAX_VALUE / 2);
+//! Selects the meter the level getters read
+/*!
+	The conversions only run for the analog meter, the I2S meter is fed by the audio task
+	either way.
+	\param source ADC_SOURCE_ANALOG or ADC_SOURCE_I2S
+*/
+void task_adc_set_source(uint32_t source) {
+	
+	if (source == ADC_SOURCE_I2S) {
+		task_adc_disable();
+		active_meter = &i2s_meter;
+	}
+	else {
+		active_meter = &adc_meter;
+		task_adc_enable();
+	}
 	
-	return  adc_val;
+	return;
 }
 
-//Computes average of NUM_AVERAGE_SAMPLES samples
-
-uint32_t task_adc_update(void) {
-	uint32_t i;
+//! Digital-domain meter input, called with every I2S DMA block
+/*!
+	The mean magnitude of (L+R)/2 over the block is pushed as one value, scaled
+	to the same 0 to ADC_MAX_VALUE/2 range as the analog meter.
+	\param left the left channel samples
+	\param right the right channel samples
+	\param frames the number of frames in the block
+*/
+void task_adc_feed_block(const int16_t *left, const int16_t *right, uint32_t frames) {
 	uint32_t sum = 0;
+	uint32_t peak = 0;
+	uint32_t val;
+	int32_t mid;
+	uint32_t i;
 	
-	adc_data.latest_val = task_adc_get_abs_val();
-	
-	adc_data.buffer[adc_data.buffer_count] = adc_data.latest_val;
-	
-	if (adc_data.buffer_count < (NUM_AVERAGE_SAMPLES - 1)) adc_data.buffer_count++;
-	else adc_data.buffer_count = 0;
+	if (!frames) return;
 	
-	for (i = 0; i < NUM_AVERAGE_SAMPLES; i++)
-	{
-		sum += adc_data.buffer[i];
+	for (i = 0; i < frames; i++) {
+		mid = ((int32_t)left[i] + right[i]) >> 1;
+		val = (mid < 0) ? -mid : mid;
+		sum += val;
+		if (val > peak) peak = val;
 	}
 	
-	adc_data.average = sum / NUM_AVERAGE_SAMPLES;
+	meter_push(&i2s_meter, (sum / frames) >> 6, peak >> 6);
 	
-	return adc_data.average;
+	return;
+}
+
+//! Returns the running average level, 0 to ADC_MAX_VALUE/2. Never waits for a conversion
+uint32_t task_adc_get_level(void) {
+	return active_meter->average;
 }
 
+//! Returns the held peak level
+uint32_t task_adc_get_peak(void) {
+	return active_meter->peak;
+}
+
+//! Returns the exponentially weighted RMS level
+uint32_t task_adc_get_rms(void) {
+	return isqrt(active_meter->mean_square >> RMS_FRAC);
+}
@@ -18,18 +18,53 @@
 
 #define NUM_AVERAGE_SAMPLES		10
 
-static volatile struct {
+//! Samples the peak is held for before it starts to decay
+#define PEAK_HOLD_SAMPLES		64
+//! Peak decays by 1/2^shift per sample after the hold
+#define PEAK_DECAY_SHIFT		4
+//! Exponential RMS time constant, 2^shift samples
+#define RMS_SHIFT				4
+//! Fractional bits kept in the mean square
+#define RMS_FRAC				8
+
+//! Conversions are started by TIOA of TC0 channel 0, which free-runs as the BLUE_TOP PWM
+/*!
+	That is one conversion per 0xFFFF counts of PBA/8, about 126Hz at the full PBA clock and
+	half that in the low clock mode. There is no anti-alias filter ahead of AD7, so every
+	conversion is the waveform at an unrelated phase: the analog meter only follows the
+	envelope, averaged over many samples, and a tone near a multiple of the rate beats with it.
+*/
+#define ADC_TRIGGER_TIOA0		0
+#define ADC_INT_LEVEL			1
+
+//! Where the level served to the LEDs comes from
+#define ADC_SOURCE_ANALOG		0
+#define ADC_SOURCE_I2S			1
+
+//! Source selected when the LEDs start. The I2S meter sees every sample, so it is the default
+#ifndef ADC_SOURCE
+#define ADC_SOURCE				ADC_SOURCE_I2S
+#endif
+
+typedef struct {
 	uint32_t buffer[NUM_AVERAGE_SAMPLES];
 	uint32_t buffer_count;
 	uint32_t latest_val;
+	uint32_t sum;
 	uint32_t average;
-} adc_data;
+	uint32_t peak;
+	uint32_t peak_hold;
+	uint32_t mean_square;
+} level_meter_t;
 
 extern void task_adc_init(void);
 extern void task_adc_clear(void);
 extern void task_adc_enable(void);
 extern void task_adc_disable(void);
-extern uint32_t task_adc_get_abs_val(void);
-extern uint32_t task_adc_update(void);
+extern void task_adc_set_source(uint32_t source);
+extern void task_adc_feed_block(const int16_t *left, const int16_t *right, uint32_t frames);
+extern uint32_t task_adc_get_level(void);
+extern uint32_t task_adc_get_peak(void);
+extern uint32_t task_adc_get_rms(void);
 
 #endif /* TASK_ADC_H_ */
\ No newline at end of file
@@ -0,0 +1,437 @@
+/*
+ * task_DSP.c
+ *
+ * Created: 4/18/2013 8:40:47 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "task_DSP.h"
+
+//! Biquad coefficients, Q30, for the crossover sections which sit too close to DC for Q14
+typedef struct {
+	int32_t b0;
+	int32_t b1;
+	int32_t b2;
+	int32_t a1;
+	int32_t a2;
+} dsp_biquad32_coef_t;
+
+//! State for a Q14 biquad. err carries the rounding remainder into the next sample (first order error feedback)
+typedef struct {
+	int16_t x1;
+	int16_t x2;
+	int16_t y1;
+	int16_t y2;
+	int32_t err;
+} dsp_biquad_state_t;
+
+//! State for a Q30 biquad, samples are Q23
+typedef struct {
+	int32_t x1;
+	int32_t x2;
+	int32_t y1;
+	int32_t y2;
+} dsp_biquad32_state_t;
+
+//! Crossover coefficients for one sample rate: Linkwitz-Riley 4th order = two identical Butterworth sections
+typedef struct {
+	uint32_t fs;
+	dsp_biquad32_coef_t lp;
+	dsp_biquad32_coef_t hp;
+} dsp_crossover_coef_t;
+
+//! 100Hz LR4 crossover, one entry per supported sample rate
+static const dsp_crossover_coef_t crossover_table[] = {
+	{44100,	{53946, 107893, 53946, -2125849407, 1052323368},
+			{1062978650, -2125957299, 1062978650, -2125849407, 1052323368}},
+	{48000,	{45573, 91146, 45573, -2127607086, 1054047555},
+			{1063849116, -2127698232, 1063849116, -2127607086, 1054047555}},
+	{88200,	{13554, 27109, 13554, -2136666258, 1062978651},
+			{1068346683, -2136693366, 1068346683, -2136666258, 1062978651}},
+	{96000,	{11446, 22892, 11446, -2137545158, 1063849117},
+			{1068784025, -2137568049, 1068784025, -2137545158, 1063849117}},
+};
+
+#define NUM_CROSSOVER_RATES		(sizeof(crossover_table)/sizeof(crossover_table[0]))
+
+//! Pass-through EQ section
+static const dsp_biquad_coef_t biquad_flat = {DSP_Q14_ONE, 0, 0, 0, 0};
+
+static struct {
+	dsp_biquad_coef_t eq_coef[DSP_NUM_EQ_STAGES];
+	dsp_biquad_state_t eq_left[DSP_NUM_EQ_STAGES];
+	dsp_biquad_state_t eq_right[DSP_NUM_EQ_STAGES];
+
+	const dsp_crossover_coef_t *crossover;
+	uint32_t crossover_mode;
+	dsp_biquad32_state_t lp[2];
+	dsp_biquad32_state_t hp_left[2];
+	dsp_biquad32_state_t hp_right[2];
+
+	int16_t delay_left[DSP_LIMITER_LOOKAHEAD];
+	int16_t delay_right[DSP_LIMITER_LOOKAHEAD];
+	uint32_t delay_pos;
+	int32_t gain;
+	int32_t target;
+	int32_t step;
+	uint32_t hold;
+
+	uint32_t cycles[DSP_NUM_STAGES];
+	uint32_t cycles_max[DSP_NUM_STAGES];
+} dsp;
+
+//! Scratch buffers for the crossover, Q23
+static int32_t xover_left[DSP_BLOCK_FRAMES];
+static int32_t xover_right[DSP_BLOCK_FRAMES];
+
+//! Saturates a 32 bit value to 16 bits
+static inline int16_t dsp_sat16(int32_t x) {
+	if (x > 32767) return 32767;
+	if (x < -32768) return -32768;
+	return (int16_t)x;
+}
+
+//! Records the cycles spent in a stage since start
+static inline void dsp_count_cycles(uint32_t stage, uint32_t start) {
+	uint32_t cycles = Get_sys_count() - start;
+
+	dsp.cycles[stage] = cycles;
+	if (cycles > dsp.cycles_max[stage]) dsp.cycles_max[stage] = cycles;
+
+	return;
+}
+
+//! Runs one Q14 biquad in place over a block
+/*!
+	All products are 16x16 so they map onto the AVR32 halfword multiply-accumulate
+	(mulhh/machh), and the accumulator is 64 bit so no coefficient set can overflow it.
+	\param c the coefficients
+	\param s the section state
+	\param buf the samples, filtered in place
+	\param n the number of samples
+*/
+static void dsp_biquad_q14(const dsp_biquad_coef_t *c, dsp_biquad_state_t *s, int16_t *buf, uint32_t n) {
+	const int16_t b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+	int16_t x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+	int32_t err = s->err;
+	int64_t acc;
+	int16_t x0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		x0 = buf[i];
+
+		acc = err;
+		acc += (int32_t)b0 * x0;
+		acc += (int32_t)b1 * x1;
+		acc += (int32_t)b2 * x2;
+		acc -= (int32_t)a1 * y1;
+		acc -= (int32_t)a2 * y2;
+
+		err = (int32_t)(acc & (DSP_Q14_ONE - 1));
+		acc >>= 14;
+		if (acc > 32767) acc = 32767;
+		else if (acc < -32768) acc = -32768;
+
+		x2 = x1;
+		x1 = x0;
+		y2 = y1;
+		y1 = (int16_t)acc;
+		buf[i] = y1;
+	}
+
+	s->x1 = x1;
+	s->x2 = x2;
+	s->y1 = y1;
+	s->y2 = y2;
+	s->err = err;
+
+	return;
+}
+
+//! Runs one Q30 biquad in place over a block of Q23 samples
+/*!
+	32x32 products into a 64 bit accumulator (macs.d on AVR32). Q23 samples leave
+	8 bits of headroom so the sum of five Q53 products cannot overflow.
+	\param c the coefficients
+	\param s the section state
+	\param buf the Q23 samples, filtered in place
+	\param n the number of samples
+*/
+static void dsp_biquad_q30(const dsp_biquad32_coef_t *c, dsp_biquad32_state_t *s, int32_t *buf, uint32_t n) {
+	int32_t x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+	int64_t acc;
+	int32_t x0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		x0 = buf[i];
+
+		acc = (int64_t)c->b0 * x0;
+		acc += (int64_t)c->b1 * x1;
+		acc += (int64_t)c->b2 * x2;
+		acc -= (int64_t)c->a1 * y1;
+		acc -= (int64_t)c->a2 * y2;
+
+		x2 = x1;
+		x1 = x0;
+		y2 = y1;
+		y1 = (int32_t)(acc >> 30);
+		buf[i] = y1;
+	}
+
+	s->x1 = x1;
+	s->x2 = x2;
+	s->y1 = y1;
+	s->y2 = y2;
+
+	return;
+}
+
+//! Runs the crossover in the selected mode
+/*!
+	DSP_CROSSOVER_MAINS high passes left and right. DSP_CROSSOVER_SUB low passes
+	(L+R)/2 and puts the result on both channels, the SSC has no third slot for it.
+*/
+static void dsp_crossover(dsp_block_t *block) {
+	uint32_t i;
+
+	if (dsp.crossover_mode == DSP_CROSSOVER_SUB) {
+		for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+			xover_left[i] = ((int32_t)block->left[i] + block->right[i]) << 7;
+		}
+
+		dsp_biquad_q30(&dsp.crossover->lp, &dsp.lp[0], xover_left, DSP_BLOCK_FRAMES);
+		dsp_biquad_q30(&dsp.crossover->lp, &dsp.lp[1], xover_left, DSP_BLOCK_FRAMES);
+
+		for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+			block->left[i] = dsp_sat16(xover_left[i] >> 8);
+			block->right[i] = block->left[i];
+		}
+
+		return;
+	}
+
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		xover_left[i] = (int32_t)block->left[i] << 8;
+		xover_right[i] = (int32_t)block->right[i] << 8;
+	}
+
+	dsp_biquad_q30(&dsp.crossover->hp, &dsp.hp_left[0], xover_left, DSP_BLOCK_FRAMES);
+	dsp_biquad_q30(&dsp.crossover->hp, &dsp.hp_left[1], xover_left, DSP_BLOCK_FRAMES);
+	dsp_biquad_q30(&dsp.crossover->hp, &dsp.hp_right[0], xover_right, DSP_BLOCK_FRAMES);
+	dsp_biquad_q30(&dsp.crossover->hp, &dsp.hp_right[1], xover_right, DSP_BLOCK_FRAMES);
+
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		block->left[i] = dsp_sat16(xover_left[i] >> 8);
+		block->right[i] = dsp_sat16(xover_right[i] >> 8);
+	}
+
+	return;
+}
+
+//! Stereo-linked look-ahead peak limiter
+/*!
+	Samples are delayed by DSP_LIMITER_LOOKAHEAD frames. When a peak enters the delay line
+	the gain ramps down linearly so it has reached threshold/peak by the time the peak
+	leaves, holds until then and releases exponentially afterwards.
+*/
+static void dsp_limiter(dsp_block_t *block) {
+	int32_t l, r, peak, required, step;
+	uint32_t pos = dsp.delay_pos;
+	uint32_t i;
+
+	for (i = 0; i < DSP_BLOCK_FRAMES; i++) {
+		l = block->left[i];
+		r = block->right[i];
+
+		peak = (l < 0) ? -l : l;
+		if (r > peak) peak = r;
+		else if (-r > peak) peak = -r;
+
+		if (peak > DSP_LIMITER_THRESHOLD) {
+			required = (DSP_LIMITER_THRESHOLD * DSP_Q15_ONE) / peak;
+			if (required < dsp.target) {
+				dsp.target = required;
+				step = (dsp.gain - required + DSP_LIMITER_LOOKAHEAD - 1) / DSP_LIMITER_LOOKAHEAD;
+				// Never slow an attack that is already under way, an earlier peak may still need it
+				if (step > dsp.step) dsp.step = step;
+			}
+			dsp.hold = DSP_LIMITER_LOOKAHEAD + 1;
+		}
+
+		if (dsp.hold) dsp.hold--;
+
+		if (dsp.gain > dsp.target) {
+			dsp.gain -= dsp.step;
+			if (dsp.gain <= dsp.target) {
+				dsp.gain = dsp.target;
+				dsp.step = 0;
+			}
+		}
+		else if (!dsp.hold && dsp.gain < DSP_Q15_ONE) {
+			dsp.gain += ((DSP_Q15_ONE - dsp.gain) >> DSP_LIMITER_RELEASE_SHIFT) + 1;
+			if (dsp.gain > DSP_Q15_ONE) dsp.gain = DSP_Q15_ONE;
+			dsp.target = dsp.gain;
+		}
+
+		block->left[i] = (int16_t)((dsp.delay_left[pos] * dsp.gain) >> 15);
+		block->right[i] = (int16_t)((dsp.delay_right[pos] * dsp.gain) >> 15);
+
+		dsp.delay_left[pos] = (int16_t)l;
+		dsp.delay_right[pos] = (int16_t)r;
+
+		if (++pos == DSP_LIMITER_LOOKAHEAD) pos = 0;
+	}
+
+	dsp.delay_pos = pos;
+
+	return;
+}
+
+//! Initializes the DSP chain: flat EQ, crossover off, limiter at unity
+void task_dsp_init(void) {
+	uint32_t i;
+
+	for (i = 0; i < DSP_NUM_EQ_STAGES; i++) {
+		dsp.eq_coef[i] = biquad_flat;
+	}
+
+	dsp.crossover = &crossover_table[1];
+	dsp.crossover_mode = DSP_CROSSOVER_MODE;
+
+	task_dsp_reset();
+	task_dsp_clear_cycles();
+
+	return;
+}
+
+//! Clears all filter, delay line and limiter state, e.g. after a stream restart
+void task_dsp_reset(void) {
+	uint32_t i;
+
+	for (i = 0; i < DSP_NUM_EQ_STAGES; i++) {
+		dsp.eq_left[i] = (dsp_biquad_state_t){0, 0, 0, 0, 0};
+		dsp.eq_right[i] = (dsp_biquad_state_t){0, 0, 0, 0, 0};
+	}
+
+	for (i = 0; i < 2; i++) {
+		dsp.lp[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+		dsp.hp_left[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+		dsp.hp_right[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+	}
+
+	for (i = 0; i < DSP_LIMITER_LOOKAHEAD; i++) {
+		dsp.delay_left[i] = 0;
+		dsp.delay_right[i] = 0;
+	}
+
+	dsp.delay_pos = 0;
+	dsp.gain = DSP_Q15_ONE;
+	dsp.target = DSP_Q15_ONE;
+	dsp.step = 0;
+	dsp.hold = 0;
+
+	return;
+}
+
+//! Sets the coefficients of one EQ stage on both channels
+/*!
+	\param stage the EQ stage, 0 to DSP_NUM_EQ_STAGES-1
+	\param coef Q14 coefficients, NULL for a flat stage
+*/
+void task_dsp_set_eq(uint32_t stage, const dsp_biquad_coef_t *coef) {
+
+	if (stage >= DSP_NUM_EQ_STAGES) return;
+
+	dsp.eq_coef[stage] = (coef != NULL) ? *coef : biquad_flat;
+
+	return;
+}
+
+//! Selects what the crossover puts on the SSC channels
+/*!
+	\param mode DSP_CROSSOVER_OFF, DSP_CROSSOVER_MAINS for a board whose low end a
+	subwoofer elsewhere plays, or DSP_CROSSOVER_SUB for a board that drives the subwoofer
+*/
+void task_dsp_set_crossover(uint32_t mode) {
+	uint32_t i;
+
+	dsp.crossover_mode = mode;
+
+	for (i = 0; i < 2; i++) {
+		dsp.lp[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+		dsp.hp_left[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+		dsp.hp_right[i] = (dsp_biquad32_state_t){0, 0, 0, 0};
+	}
+
+	return;
+}
+
+//! Selects the crossover coefficients for a sample rate
+/*!
+	\param fs the sample rate in Hz
+	\return false if there are no coefficients for fs, the previous set stays active
+*/
+bool task_dsp_set_fs(uint32_t fs) {
+	uint32_t i;
+
+	for (i = 0; i < NUM_CROSSOVER_RATES; i++) {
+		if (crossover_table[i].fs == fs) {
+			dsp.crossover = &crossover_table[i];
+			task_dsp_set_crossover(dsp.crossover_mode);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//! Runs EQ, crossover and limiter over one block in place
+void task_dsp_process(dsp_block_t *block) {
+	uint32_t start;
+	uint32_t i;
+
+	start = Get_sys_count();
+	for (i = 0; i < DSP_NUM_EQ_STAGES; i++) {
+		if (dsp.eq_coef[i].b0 == DSP_Q14_ONE && !dsp.eq_coef[i].b1 && !dsp.eq_coef[i].b2
+				&& !dsp.eq_coef[i].a1 && !dsp.eq_coef[i].a2) continue;
+		dsp_biquad_q14(&dsp.eq_coef[i], &dsp.eq_left[i], block->left, DSP_BLOCK_FRAMES);
+		dsp_biquad_q14(&dsp.eq_coef[i], &dsp.eq_right[i], block->right, DSP_BLOCK_FRAMES);
+	}
+	dsp_count_cycles(DSP_STAGE_EQ, start);
+
+	start = Get_sys_count();
+	if (dsp.crossover_mode != DSP_CROSSOVER_OFF) dsp_crossover(block);
+	dsp_count_cycles(DSP_STAGE_CROSSOVER, start);
+
+	start = Get_sys_count();
+	dsp_limiter(block);
+	dsp_count_cycles(DSP_STAGE_LIMITER, start);
+
+	return;
+}
+
+//! Returns the CPU cycles the given stage took on the last block
+uint32_t task_dsp_get_cycles(uint32_t stage) {
+	return (stage < DSP_NUM_STAGES) ? dsp.cycles[stage] : 0;
+}
+
+//! Returns the most CPU cycles the given stage has taken on any block since the last clear
+uint32_t task_dsp_get_cycles_max(uint32_t stage) {
+	return (stage < DSP_NUM_STAGES) ? dsp.cycles_max[stage] : 0;
+}
+
+//! Clears the cycle counters
+void task_dsp_clear_cycles(void) {
+	uint32_t i;
+
+	for (i = 0; i < DSP_NUM_STAGES; i++) {
+		dsp.cycles[i] = 0;
+		dsp.cycles_max[i] = 0;
+	}
+
+	return;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+ * task_DSP.h
+ *
+ * Created: 4/18/2013 8:41:02 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TASK_DSP_H_
+#define TASK_DSP_H_
+
+//! Stereo frames per audio block (1.33ms at 48kHz)
+#define DSP_BLOCK_FRAMES		64
+
+//! Cascaded EQ biquads per channel
+#define DSP_NUM_EQ_STAGES		4
+
+//! Limiter look-ahead in frames, also the limiter attack time
+#define DSP_LIMITER_LOOKAHEAD	32
+//! Limiter threshold, Q15 (-1dBFS)
+#define DSP_LIMITER_THRESHOLD	29204
+//! Limiter release, gain recovers by 1/2^shift of the remaining distance per frame
+#define DSP_LIMITER_RELEASE_SHIFT	9
+
+//! Crossover frequency of the coefficient tables in task_DSP.c
+#define DSP_CROSSOVER_HZ		100
+
+//! Crossover modes, which part of the split the two SSC channels carry
+#define DSP_CROSSOVER_OFF		0	//Full range left and right
+#define DSP_CROSSOVER_MAINS		1	//Left and right high passed, a subwoofer elsewhere plays the rest
+#define DSP_CROSSOVER_SUB		2	//The SUBWOOFER channel, (L+R)/2 low passed, on both
+
+//! Mode task_dsp_init starts in
+#ifndef DSP_CROSSOVER_MODE
+#define DSP_CROSSOVER_MODE		DSP_CROSSOVER_OFF
+#endif
+
+//! Stage indices for the cycle counters
+#define DSP_STAGE_EQ			0
+#define DSP_STAGE_CROSSOVER		1
+#define DSP_STAGE_LIMITER		2
+#define DSP_NUM_STAGES			3
+
+#define DSP_Q14_ONE				(1 << 14)
+#define DSP_Q15_ONE				(1L << 15)
+
+//! Biquad coefficients, Q14. a1 and a2 are the denominator terms, y = b0x0 + b1x1 + b2x2 - a1y1 - a2y2
+typedef struct {
+	int16_t b0;
+	int16_t b1;
+	int16_t b2;
+	int16_t a1;
+	int16_t a2;
+} dsp_biquad_coef_t;
+
+//! One block of audio, deinterleaved
+typedef struct {
+	int16_t left[DSP_BLOCK_FRAMES];
+	int16_t right[DSP_BLOCK_FRAMES];
+} dsp_block_t;
+
+extern void task_dsp_init(void);
+extern void task_dsp_reset(void);
+extern void task_dsp_set_eq(uint32_t stage, const dsp_biquad_coef_t *coef);
+extern void task_dsp_set_crossover(uint32_t mode);
+extern bool task_dsp_set_fs(uint32_t fs);
+extern void task_dsp_process(dsp_block_t *block);
+extern uint32_t task_dsp_get_cycles(uint32_t stage);
+extern uint32_t task_dsp_get_cycles_max(uint32_t stage);
+extern void task_dsp_clear_cycles(void);
+
+#endif /* TASK_DSP_H_ */
\ No newline at end of file
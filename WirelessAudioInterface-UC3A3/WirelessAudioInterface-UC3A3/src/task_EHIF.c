@@ -0,0 +1,547 @@
+/*
+ * task_EHIF.c
+ *
+ * Created: 4/24/2013 10:52:28 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "board.h"
+#include "gpio.h"
+#include "power_clocks_lib.h"
+#include "spi_master.h"
+#include "interrupt.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "conf_tasks.h"
+#include "task_SPI.h"
+#include "task_clock.h"
+#include "task_power.h"
+#include "task_EHIF.h"
+#include "rtos_mem.h"
+#include "telemetry.h"
+
+static xQueueHandle ehif_queue = NULL;
+
+static volatile ehif_state_t ehif_state;
+
+static uint8_t nwm_status[EHIF_NWM_STATUS_LENGTH];
+static uint8_t ps_stats[EHIF_PS_STATS_LENGTH];
+
+//! Statistics sampling: the tick the next sample is due, the tick of the last one, and
+//! whether the CC8530 counters have been read since they last covered a gap
+static portTickType ehif_stats_due = 0;
+static portTickType ehif_stats_last = 0;
+static bool ehif_stats_primed = false;
+
+//! The tick the next PM_GET_DATA poll is due
+static portTickType ehif_pm_due = 0;
+
+//! Volume change not yet sent, EHIF_DB_TO_VOL units, and the tick the next step is due
+static int32_t ehif_volume_pending = 0;
+static portTickType ehif_volume_due = 0;
+
+//! CC8530 event interrupt, hands the work to the EHIF task
+ISR_FREERTOS(task_ehif_irq_handler, AVR32_GPIO_IRQ_GROUP, EHIF_INT_LEVEL) {
+	portBASE_TYPE woken = pdFALSE;
+	ehif_msg_t msg = {
+		.type = EHIF_MSG_IRQ,
+		.arg = 0
+	};
+
+	gpio_clear_pin_interrupt_flag(PIN_CC8530_nIRQ);
+
+	ehif_state.irqs++;
+	xQueueSendFromISR(ehif_queue, &msg, &woken);
+
+	return woken;
+}
+
+//! Shifts one byte out and returns the byte shifted in
+static uint8_t ehif_spi_exchange(uint8_t data) {
+
+	while (!spi_is_tx_ready(SPI_CC8530));
+	spi_write_single(SPI_CC8530, data);
+	while (!spi_is_rx_full(SPI_CC8530));
+	spi_read_single(SPI_CC8530, &data);
+
+	return data;
+}
+
+static void ehif_begin(void) {
+	task_spi_lock(SPI_CC8530);
+	spi_select_device(SPI_CC8530, &spi_device_cc8530);
+
+	return;
+}
+
+static void ehif_end(void) {
+	spi_deselect_device(SPI_CC8530, &spi_device_cc8530);
+	task_spi_unlock(SPI_CC8530);
+
+	return;
+}
+
+//! Waits for MISO to go high with CSn low, which is CMD_REQ_READY
+/*!
+	Called between ehif_begin and ehif_end. The CC8530 answers most commands within
+	a few us, longer waits give the CPU away a tick at a time with CSn high and SPI0
+	released, so the codec and clock chip are not held up behind it.
+*/
+static void ehif_wait_ready(void) {
+	uint32_t spin;
+	portTickType ticks = EHIF_READY_TIMEOUT_MS / portTICK_RATE_MS;
+
+	for (;;) {
+		for (spin = 64; spin; spin--) {
+			if (gpio_get_pin_value(PIN_MISO0)) return;
+		}
+		if (!ticks--) {
+			ehif_state.timeouts++;
+			return;
+		}
+		ehif_end();
+		vTaskDelay(1);
+		ehif_begin();
+	}
+}
+
+//! Sends the two header bytes of an operation and returns the status word
+static uint16_t ehif_header(uint8_t b0, uint8_t b1) {
+	uint16_t status;
+
+	status = ehif_spi_exchange(b0) << 8;
+	status |= ehif_spi_exchange(b1);
+
+	return status;
+}
+
+//! Reads the EHIF status word
+uint16_t task_ehif_get_status(void) {
+	uint16_t status;
+
+	ehif_begin();
+	status = ehif_header(0x80, 0x00);
+	ehif_end();
+
+	return status;
+}
+
+//! Sends a command request
+/*!
+	\param cmd the EHIF command ID
+	\param length the number of parameter bytes
+	\param param the parameters, in EHIF (big endian) byte order
+	\return the status word
+*/
+uint16_t task_ehif_cmd_req(uint8_t cmd, uint8_t length, const uint8_t *param) {
+	uint16_t status;
+
+	ehif_begin();
+	ehif_wait_ready();
+
+	status = ehif_header(0xC0 | cmd, length);
+	while (length--) {
+		ehif_spi_exchange(*param++);
+	}
+
+	ehif_end();
+
+	return status;
+}
+
+//! Reads a fixed length command result
+uint16_t task_ehif_read(uint16_t length, uint8_t *data) {
+	uint16_t status;
+
+	ehif_begin();
+	ehif_wait_ready();
+
+	status = ehif_header(0x90 | ((length >> 8) & 0x0F), length & 0xFF);
+	while (length--) {
+		*data++ = ehif_spi_exchange(0x00);
+	}
+
+	ehif_end();
+
+	return status;
+}
+
+//! Reads a command result of the length the CC8530 reports
+/*!
+	\param length in: the buffer size, out: the number of bytes read
+	\param data the buffer
+	\return the status word
+*/
+uint16_t task_ehif_readbc(uint16_t *length, uint8_t *data) {
+	uint16_t status;
+	uint16_t count;
+
+	ehif_begin();
+	ehif_wait_ready();
+
+	status = ehif_header(0xA0, 0x00);
+	count = ehif_spi_exchange(0x00) << 8;
+	count |= ehif_spi_exchange(0x00);
+
+	if (count > *length) count = *length;
+	*length = count;
+
+	while (count--) {
+		*data++ = ehif_spi_exchange(0x00);
+	}
+
+	ehif_end();
+
+	return status;
+}
+
+//! Reads the network sample rate from NWM_GET_STATUS, 0 if unknown
+static uint32_t ehif_read_sample_rate(void) {
+	uint16_t length = EHIF_NWM_STATUS_LENGTH;
+
+	task_ehif_cmd_req(EHIF_CMD_NWM_GET_STATUS, 0, NULL);
+	task_ehif_readbc(&length, nwm_status);
+
+	if (length < 3) return 0;
+
+	//[1:2] tsPeriod[15:12] smplRate[11:0]
+	return ((((uint32_t)nwm_status[1] << 8) | nwm_status[2]) & 0x0FFF) * EHIF_SMPL_RATE_UNIT;
+}
+
+//! Handles the events flagged in the status word and clears them
+static void ehif_service_events(void) {
+	uint16_t status;
+	uint8_t events;
+	uint32_t fs;
+
+	status = task_ehif_get_status();
+	ehif_state.status = status;
+	task_power_update(status);
+
+	events = status & EHIF_EVT_MASK;
+	if (!events) return;
+
+	if (events & EHIF_EVT_SR_CHG) {
+		fs = ehif_read_sample_rate();
+		if (fs) {
+			ehif_state.sample_rate = fs;
+			task_clock_request_fs(fs);
+		}
+	}
+
+	// Network, power state and volume changes are kept in the status word for now
+
+	task_ehif_cmd_req(EHIF_CMD_EHC_EVT_CLR, 1, &events);
+
+	return;
+}
+
+//! Changes the network output volume relative to the current one
+static void ehif_volume_step(int32_t step) {
+	uint32_t op;
+	uint8_t param[4];
+
+	// value[10:0], setOp[21:20] = relative, everything else 0
+	op = ((uint32_t)step & 0x7FF) | (2UL << 20);
+
+	param[0] = op >> 24;
+	param[1] = op >> 16;
+	param[2] = op >> 8;
+	param[3] = op;
+
+	task_ehif_cmd_req(EHIF_CMD_VC_SET_VOLUME, 4, param);
+
+	return;
+}
+
+//! Adds a volume change to the one waiting, presses that come faster than the ramp add up
+static void ehif_volume_request(int32_t step) {
+
+	ehif_volume_pending += step;
+	if (ehif_volume_pending > EHIF_VOL_PENDING_MAX) ehif_volume_pending = EHIF_VOL_PENDING_MAX;
+	if (ehif_volume_pending < -EHIF_VOL_PENDING_MAX) ehif_volume_pending = -EHIF_VOL_PENDING_MAX;
+	ehif_state.volume_pending = ehif_volume_pending;
+
+	return;
+}
+
+//! Sends the next step of the waiting volume change, if one is due
+/*!
+	The ramp runs in dB, the CC85xx volume unit, one EHIF_VOL_RAMP_STEP per
+	EHIF_VOL_RAMP_MS, so a 3dB press takes three ticks and a held key glides.
+*/
+static void ehif_volume_ramp(void) {
+	portTickType now = xTaskGetTickCount();
+	int32_t step = ehif_volume_pending;
+
+	if (step == 0) return;
+	if ((int32_t)(now - ehif_volume_due) < 0) return;
+
+	if (step > EHIF_VOL_RAMP_STEP) step = EHIF_VOL_RAMP_STEP;
+	if (step < -EHIF_VOL_RAMP_STEP) step = -EHIF_VOL_RAMP_STEP;
+
+	ehif_volume_step(step);
+
+	ehif_volume_pending -= step;
+	ehif_state.volume_pending = ehif_volume_pending;
+	ehif_volume_due = now + EHIF_VOL_RAMP_MS / portTICK_RATE_MS;
+
+	return;
+}
+
+//! Reads a big endian field of a command result
+static uint32_t ehif_get(const uint8_t *p, uint32_t bytes) {
+	uint32_t value = 0;
+
+	while (bytes--) {
+		value = (value << 8) | *p++;
+	}
+
+	return value;
+}
+
+//! Scales a count over an interval to a telemetry rate
+static uint16_t ehif_rate(uint32_t count, uint32_t scale, uint32_t ms) {
+	uint64_t rate = (uint64_t)count * scale;
+
+	rate = ms ? rate / ms : 0;
+
+	return (rate > TELEMETRY_RATE_MAX) ? TELEMETRY_RATE_MAX : rate;
+}
+
+//! Reads PS_AUDIO_STATS and PS_RF_STATS and records them as rates
+/*!
+	Both commands return the counts since they were last read. The first read after
+	power up or standby covers an unknown time and only restarts the counts.
+*/
+static void ehif_sample_stats(portTickType now) {
+	uint16_t rates[TELEMETRY_METRICS];
+	uint16_t length;
+	uint32_t ms = (now - ehif_stats_last) * portTICK_RATE_MS;
+	uint32_t packets;
+
+	ehif_stats_last = now;
+
+	if (EHIF_STAT_PWR_STATE(ehif_state.status) != EHIF_PWR_ACTIVE) {
+		ehif_stats_primed = false;
+		telemetry_add(NULL);
+		return;
+	}
+
+	//[0:3] smplProcessedCountDiv16, [4:7] smplConcealedCountDiv16, [8:11] smplMutedCountDiv16
+	length = EHIF_AUDIO_STATS_LENGTH;
+	task_ehif_cmd_req(EHIF_CMD_PS_AUDIO_STATS, 0, NULL);
+	task_ehif_readbc(&length, ps_stats);
+	if (length < 12) {
+		ehif_stats_primed = false;
+		telemetry_add(NULL);
+		return;
+	}
+	rates[TELEMETRY_CONCEAL] = ehif_rate(ehif_get(&ps_stats[4], 4), 16 * 1000, ms);
+	rates[TELEMETRY_MUTED] = ehif_rate(ehif_get(&ps_stats[8], 4), 16 * 1000, ms);
+
+	//[0:3] timeslotCount, [4:7] pktRxCount, [8:11] pktRxErrCount, [12:15] sliceRxTxCount,
+	//[16:19] sliceRxErrCount, [20] nwkJoinCount, [21] nwkDropCount, [22:23] afhSwapCount
+	length = EHIF_RF_STATS_LENGTH;
+	task_ehif_cmd_req(EHIF_CMD_PS_RF_STATS, 0, NULL);
+	task_ehif_readbc(&length, ps_stats);
+	if (length < 24) {
+		ehif_stats_primed = false;
+		telemetry_add(NULL);
+		return;
+	}
+	packets = ehif_get(&ps_stats[4], 4);
+	rates[TELEMETRY_PKT_FAIL] = ehif_rate(ehif_get(&ps_stats[8], 4), 1000, ms);
+	rates[TELEMETRY_PER] = ehif_rate(ehif_get(&ps_stats[8], 4), 10000, packets);
+	rates[TELEMETRY_SLICE_ERR] = ehif_rate(ehif_get(&ps_stats[16], 4), 1000, ms);
+	rates[TELEMETRY_AFH_SWAP] = ehif_rate(ehif_get(&ps_stats[22], 2), 1000, ms);
+
+	if (!ehif_stats_primed) {
+		ehif_stats_primed = true;
+		telemetry_add(NULL);
+		return;
+	}
+
+	telemetry_add(rates);
+
+	return;
+}
+
+//! Takes a statistics sample if one is due
+/*!
+	Intervals missed while the task was held up are recorded as such, so the telemetry
+	rings stay aligned with time.
+*/
+static void ehif_stats_poll(void) {
+	portTickType now = xTaskGetTickCount();
+	portTickType period = TELEMETRY_SAMPLE_MS / portTICK_RATE_MS;
+
+	if ((int32_t)(now - ehif_stats_due) < 0) return;
+
+	while ((int32_t)(now - ehif_stats_due) >= (int32_t)period) {
+		ehif_stats_due += period;
+		ehif_stats_primed = false;
+		telemetry_add(NULL);
+	}
+
+	ehif_sample_stats(now);
+	ehif_stats_due += period;
+
+	return;
+}
+
+//! Moves the CC85xx to a power state, the codec and LEDs go down first and come up last
+static void ehif_set_power(uint32_t state) {
+	uint8_t param = state;
+
+	if (state != EHIF_PWR_ACTIVE) task_power_host(false);
+
+	task_ehif_cmd_req(EHIF_CMD_PM_SET_STATE, 1, &param);
+
+	if (state == EHIF_PWR_ACTIVE) task_power_host(true);
+
+	return;
+}
+
+//! Reads PM_GET_DATA and applies the power policy, if a poll is due
+/*!
+	Only while active or in low power. In standby the CC85xx wakes by itself on network
+	activity, or the host wakes it with EHIF_MSG_POWER_WAKE.
+*/
+static void ehif_pm_poll(void) {
+	power_pm_data_t pm;
+	uint8_t data[EHIF_PM_DATA_LENGTH];
+	portTickType now = xTaskGetTickCount();
+	uint32_t state = EHIF_STAT_PWR_STATE(ehif_state.status);
+	uint32_t target;
+
+	if ((int32_t)(now - ehif_pm_due) < 0) return;
+	ehif_pm_due = now + POWER_PM_POLL_MS / portTICK_RATE_MS;
+
+	if (state != EHIF_PWR_ACTIVE && state != EHIF_PWR_LOW_POWER) return;
+
+	task_ehif_cmd_req(EHIF_CMD_PM_GET_DATA, 0, NULL);
+	task_ehif_read(EHIF_PM_DATA_LENGTH, data);
+
+	//[0:3] inSilenceDuration, [4:7] outSilenceDuration, [8:11] nwkInactivityDuration, [12:13] vbatVoltage
+	pm.in_silence = ehif_get(&data[0], 4);
+	pm.out_silence = ehif_get(&data[4], 4);
+	pm.nwk_inactivity = ehif_get(&data[8], 4);
+	pm.vbat_mv = ehif_get(&data[12], 2);
+
+	target = task_power_policy(&pm);
+	if (target != state) ehif_set_power(target);
+
+	return;
+}
+
+//! EHIF event handler task
+/*!
+	Woken by the interrupt or by other tasks through the queue. The interrupt is edge
+	triggered on a level output, so an event that lands between the status read and
+	the clear leaves the pin low without a new edge; the poll timeout picks it up.
+*/
+static void task_ehif(void *pvParameters) {
+	ehif_msg_t msg;
+	uint8_t param[2];
+
+	// Active low interrupt on the events we handle
+	param[0] = 0x00;
+	param[1] = EHIF_EVT_MASK;
+	task_ehif_cmd_req(EHIF_CMD_EHC_EVT_MASK, 2, param);
+
+	// Only from here on: the interrupt may switch context
+	gpio_clear_pin_interrupt_flag(PIN_CC8530_nIRQ);
+	gpio_enable_pin_interrupt(PIN_CC8530_nIRQ, GPIO_FALLING_EDGE);
+
+	ehif_stats_last = xTaskGetTickCount();
+	ehif_stats_due = ehif_stats_last + TELEMETRY_SAMPLE_MS / portTICK_RATE_MS;
+
+	for (;;) {
+		if (xQueueReceive(ehif_queue, &msg, TASK_EHIF_POLL_MS / portTICK_RATE_MS) != pdTRUE) {
+			msg.type = EHIF_MSG_IRQ;
+		}
+
+		switch (msg.type)
+		{
+			case EHIF_MSG_IRQ:
+				ehif_service_events();
+			break;
+
+			case EHIF_MSG_VOLUME_STEP:
+				ehif_volume_request(msg.arg);
+			break;
+
+			case EHIF_MSG_POWER_WAKE:
+				if (EHIF_STAT_PWR_STATE(ehif_state.status) != EHIF_PWR_ACTIVE) ehif_set_power(EHIF_PWR_ACTIVE);
+				else task_power_host(true);
+			break;
+
+			default:
+			break;
+		}
+
+		ehif_volume_ramp();
+		ehif_stats_poll();
+		ehif_pm_poll();
+	}
+}
+
+//! Sets up the CC8530 interrupt pin and the message queue
+void task_ehif_init(void) {
+
+	ehif_state.status = 0;
+	ehif_state.sample_rate = 0;
+	ehif_state.irqs = 0;
+	ehif_state.timeouts = 0;
+	ehif_state.volume_pending = 0;
+
+	ehif_queue = xQueueCreate(QUEUE_EHIF_LENGTH, sizeof(ehif_msg_t));
+	if (ehif_queue == NULL) rtos_mem_halt(RTOS_TASK_EHIF);
+
+	gpio_configure_pin(PIN_CC8530_nIRQ, GPIO_DIR_INPUT | GPIO_PULL_UP);
+	irq_register_handler(task_ehif_irq_handler, AVR32_GPIO_IRQ_0 + (PIN_CC8530_nIRQ / 8), EHIF_INT_LEVEL);
+
+	return;
+}
+
+//! Creates the EHIF task, which enables the interrupt when it first runs
+void task_ehif_start(void) {
+
+	if (!rtos_mem_task_create(RTOS_TASK_EHIF, task_ehif)) rtos_mem_halt(RTOS_TASK_EHIF);
+
+	return;
+}
+
+//! Queues a message for the EHIF task without blocking
+/*!
+	\param type EHIF_MSG_xxx
+	\param arg message argument
+	\return false if the queue was full
+*/
+bool task_ehif_post(uint32_t type, int32_t arg) {
+	ehif_msg_t msg = {
+		.type = type,
+		.arg = arg
+	};
+
+	if (ehif_queue == NULL) return false;
+
+	return (xQueueSend(ehif_queue, &msg, 0) == pdTRUE);
+}
+
+//! Copies the cached CC8530 state
+void task_ehif_get_state(ehif_state_t *state) {
+
+	portENTER_CRITICAL();
+	state->status = ehif_state.status;
+	state->sample_rate = ehif_state.sample_rate;
+	state->irqs = ehif_state.irqs;
+	state->timeouts = ehif_state.timeouts;
+	state->volume_pending = ehif_state.volume_pending;
+	portEXIT_CRITICAL();
+
+	return;
+}
\ No newline at end of file
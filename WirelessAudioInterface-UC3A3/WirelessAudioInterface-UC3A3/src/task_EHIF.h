@@ -0,0 +1,96 @@
+/*
+ * task_EHIF.h
+ *
+ * Created: 4/24/2013 10:52:40 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TASK_EHIF_H_
+#define TASK_EHIF_H_
+
+//! CC8530 event interrupt, configured active low through EHC_EVT_MASK
+#define PIN_CC8530_nIRQ			PIN_nGPIO
+#define EHIF_INT_LEVEL			0
+
+//! EHIF SPI status word
+#define EHIF_STAT_CMD_REQ_RDY	(1 << 15)
+#define EHIF_STAT_CONNECTED		(1 << 8)
+#define EHIF_EVT_DSC_RX_AVAIL	(1 << 7)
+#define EHIF_EVT_DSC_TX_AVAIL	(1 << 6)
+#define EHIF_EVT_DSC_RESET		(1 << 5)
+#define EHIF_EVT_SPI_ERROR		(1 << 4)
+#define EHIF_EVT_VOL_CHG		(1 << 3)
+#define EHIF_EVT_PS_CHG			(1 << 2)
+#define EHIF_EVT_NWK_CHG		(1 << 1)
+#define EHIF_EVT_SR_CHG			(1 << 0)
+
+//! PWR_STATE field of the status word and its values
+#define EHIF_STAT_PWR_STATE(s)	(((s) >> 9) & 0x07)
+#define EHIF_PWR_OFF			0
+#define EHIF_PWR_NWK_STANDBY	2
+#define EHIF_PWR_LOCAL_STANDBY	3
+#define EHIF_PWR_LOW_POWER		4
+#define EHIF_PWR_ACTIVE			5
+
+//! Events that raise the interrupt
+#define EHIF_EVT_MASK			(EHIF_EVT_VOL_CHG | EHIF_EVT_PS_CHG | EHIF_EVT_NWK_CHG | EHIF_EVT_SR_CHG)
+
+//! EHIF command IDs used here
+#define EHIF_CMD_NWM_GET_STATUS	0x0A
+#define EHIF_CMD_PS_RF_STATS	0x10
+#define EHIF_CMD_PS_AUDIO_STATS	0x11
+#define EHIF_CMD_VC_SET_VOLUME	0x17
+#define EHIF_CMD_EHC_EVT_CLR	0x19
+#define EHIF_CMD_EHC_EVT_MASK	0x1A
+#define EHIF_CMD_PM_SET_STATE	0x1C
+#define EHIF_CMD_PM_GET_DATA	0x1D
+
+//! Longest wait for CMD_REQ_READY, ms
+#define EHIF_READY_TIMEOUT_MS	50
+//! NWM_GET_STATUS sample rate unit, Hz
+#define EHIF_SMPL_RATE_UNIT		25
+//! NWM_GET_STATUS data for a protocol master with six slaves
+#define EHIF_NWM_STATUS_LENGTH	101
+//! PS_RF_STATS and PS_AUDIO_STATS data, the longer of the two sizes the buffer
+#define EHIF_RF_STATS_LENGTH	64
+#define EHIF_AUDIO_STATS_LENGTH	40
+#define EHIF_PS_STATS_LENGTH	EHIF_RF_STATS_LENGTH
+//! PM_GET_DATA data: three silence and inactivity timers and VBAT
+#define EHIF_PM_DATA_LENGTH		14
+//! Volume unit of VC_SET_VOLUME, 1/8 dB
+#define EHIF_DB_TO_VOL(x)		((int32_t)(x) << 3)
+//! Volume ramp: at most one VC_SET_VOLUME of this size per EHIF_VOL_RAMP_MS
+#define EHIF_VOL_RAMP_STEP		EHIF_DB_TO_VOL(1)
+#define EHIF_VOL_RAMP_MS		10
+//! Largest change that may be waiting, more presses in the same direction are dropped
+#define EHIF_VOL_PENDING_MAX	EHIF_DB_TO_VOL(60)
+
+//! Messages to the EHIF task
+#define EHIF_MSG_IRQ			0	//arg unused
+#define EHIF_MSG_VOLUME_STEP	1	//arg: relative volume, EHIF_DB_TO_VOL units
+#define EHIF_MSG_POWER_WAKE		2	//arg unused
+
+typedef struct {
+	uint32_t type;
+	int32_t arg;
+} ehif_msg_t;
+
+typedef struct {
+	uint16_t status;
+	uint32_t sample_rate;
+	uint32_t irqs;
+	uint32_t timeouts;
+	int32_t volume_pending;
+} ehif_state_t;
+
+extern void task_ehif_init(void);
+extern void task_ehif_start(void);
+extern bool task_ehif_post(uint32_t type, int32_t arg);
+extern void task_ehif_get_state(ehif_state_t *state);
+extern uint16_t task_ehif_get_status(void);
+extern uint16_t task_ehif_cmd_req(uint8_t cmd, uint8_t length, const uint8_t *param);
+extern uint16_t task_ehif_read(uint16_t length, uint8_t *data);
+extern uint16_t task_ehif_readbc(uint16_t *length, uint8_t *data);
+
+#endif /* TASK_EHIF_H_ */
\ No newline at end of file
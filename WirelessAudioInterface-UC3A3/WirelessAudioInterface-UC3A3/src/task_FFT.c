@@ -0,0 +1,322 @@
+/*
+ * task_FFT.c
+ *
+ * Created: 4/21/2013 3:12:20 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "conf_tasks.h"
+#include "task_FFT.h"
+#include "task_LEDs.h"
+#include "rtos_mem.h"
+
+//! sin(2*pi*n/FFT_SIZE), Q15. cos is read a quarter turn ahead
+static const int16_t fft_sine[FFT_SIZE] = {
+	     0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+	  6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+	 12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+	 18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+	 23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+	 27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+	 30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+	 32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+	 32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+	 32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+	 30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+	 27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+	 23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+	 18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+	 12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+	  6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+	     0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+	 -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+	 -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+};
+
+#define FFT_SIN(n)		fft_sine[(n) & (FFT_SIZE - 1)]
+#define FFT_COS(n)		fft_sine[((n) + FFT_SIZE/4) & (FFT_SIZE - 1)]
+
+//! Last FFT bin (inclusive) of each band, roughly an octave each from 47Hz up to 6kHz
+static const uint8_t band_edges[FFT_NUM_BANDS] = {2, 5, 10, 21, 42, FFT_SIZE/2 - 1};
+
+//! Decimated capture, the audio task fills one half while the analyzer reads the other
+static int16_t capture[2][FFT_SIZE];
+static uint32_t capture_fill;
+static uint32_t capture_pos;
+static int32_t decimate_sum;
+static uint32_t decimate_count;
+static volatile uint32_t capture_ready;
+static volatile bool analyzer_busy;
+
+static int16_t fft_re[FFT_SIZE];
+static int16_t fft_im[FFT_SIZE];
+static uint16_t band_level[FFT_NUM_BANDS];
+
+static xSemaphoreHandle fft_frame_ready = NULL;
+static volatile fft_stats_t fft_stats;
+
+//! Base-4 digit reversal of an FFT index
+static inline uint32_t fft_digit_reverse(uint32_t i) {
+	uint32_t j = 0;
+	uint32_t d;
+	
+	for (d = 0; d < FFT_LOG4_SIZE; d++) {
+		j = (j << 2) | (i & 3);
+		i >>= 2;
+	}
+	
+	return j;
+}
+
+//! Integer square root
+static uint32_t fft_isqrt(uint32_t x) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	
+	while (bit > x) bit >>= 2;
+	
+	while (bit) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	
+	return root;
+}
+
+//! In-place radix-4 decimation in time FFT of FFT_SIZE points, Q15
+/*!
+	Every stage scales by 1/4 so the result is the DFT divided by FFT_SIZE and
+	cannot overflow.
+	\param re the real parts, natural order in and out
+	\param im the imaginary parts, natural order in and out
+*/
+void task_fft_transform(int16_t *re, int16_t *im) {
+	uint32_t i, j, len, quarter, step, start, k;
+	uint32_t i0, i1, i2, i3;
+	int32_t a0r, a0i, a1r, a1i, a2r, a2i, a3r, a3i;
+	int32_t t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+	int32_t wr, wi;
+	int16_t tmp;
+	
+	for (i = 0; i < FFT_SIZE; i++) {
+		j = fft_digit_reverse(i);
+		if (j > i) {
+			tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+			tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+		}
+	}
+	
+	for (len = 4; len <= FFT_SIZE; len <<= 2) {
+		quarter = len >> 2;
+		step = FFT_SIZE / len;
+		
+		for (start = 0; start < FFT_SIZE; start += len) {
+			for (k = 0; k < quarter; k++) {
+				i0 = start + k;
+				i1 = i0 + quarter;
+				i2 = i1 + quarter;
+				i3 = i2 + quarter;
+				
+				// a_r = x_r * W^(r*k*step), W = cos - j*sin
+				a0r = re[i0];
+				a0i = im[i0];
+				
+				wr = FFT_COS(k * step);
+				wi = FFT_SIN(k * step);
+				a1r = (re[i1] * wr + im[i1] * wi) >> 15;
+				a1i = (im[i1] * wr - re[i1] * wi) >> 15;
+				
+				wr = FFT_COS(2 * k * step);
+				wi = FFT_SIN(2 * k * step);
+				a2r = (re[i2] * wr + im[i2] * wi) >> 15;
+				a2i = (im[i2] * wr - re[i2] * wi) >> 15;
+				
+				wr = FFT_COS(3 * k * step);
+				wi = FFT_SIN(3 * k * step);
+				a3r = (re[i3] * wr + im[i3] * wi) >> 15;
+				a3i = (im[i3] * wr - re[i3] * wi) >> 15;
+				
+				t0r = a0r + a2r;	t0i = a0i + a2i;
+				t1r = a0r - a2r;	t1i = a0i - a2i;
+				t2r = a1r + a3r;	t2i = a1i + a3i;
+				t3r = a1r - a3r;	t3i = a1i - a3i;
+				
+				re[i0] = (int16_t)((t0r + t2r) >> 2);
+				im[i0] = (int16_t)((t0i + t2i) >> 2);
+				// t1 - j*t3
+				re[i1] = (int16_t)((t1r + t3i) >> 2);
+				im[i1] = (int16_t)((t1i - t3r) >> 2);
+				re[i2] = (int16_t)((t0r - t2r) >> 2);
+				im[i2] = (int16_t)((t0i - t2i) >> 2);
+				// t1 + j*t3
+				re[i3] = (int16_t)((t1r - t3i) >> 2);
+				im[i3] = (int16_t)((t1i + t3r) >> 2);
+			}
+		}
+	}
+	
+	return;
+}
+
+//! Windows the captured frame, transforms it and updates the band levels
+static void fft_analyze(const int16_t *samples) {
+	uint32_t energy;
+	uint32_t level;
+	uint32_t band;
+	uint32_t bin;
+	int32_t hann;
+	
+	// Hann window, 0.5 - 0.5*cos
+	for (bin = 0; bin < FFT_SIZE; bin++) {
+		hann = (32768 - FFT_COS(bin)) >> 1;
+		fft_re[bin] = (int16_t)((samples[bin] * hann) >> 15);
+		fft_im[bin] = 0;
+	}
+	
+	// The capture half may be refilled from here on
+	analyzer_busy = false;
+	
+	task_fft_transform(fft_re, fft_im);
+	
+	bin = 1;
+	for (band = 0; band < FFT_NUM_BANDS; band++) {
+		energy = 0;
+		for (; bin <= band_edges[band]; bin++) {
+			energy += ((int32_t)fft_re[bin] * fft_re[bin] + (int32_t)fft_im[bin] * fft_im[bin]) >> 8;
+		}
+		
+		// A full scale sine lands around 512 after the root, which maps to full brightness
+		level = fft_isqrt(energy) << 7;
+		if (level > 0xFFFF) level = 0xFFFF;
+		
+		if (level >= band_level[band]) band_level[band] = level;
+		else band_level[band] -= (band_level[band] - level) >> FFT_BAND_DECAY_SHIFT;
+	}
+	
+	return;
+}
+
+//! Analyzer task: one frame per semaphore, frames that arrive while busy are dropped
+static void task_fft(void *pvParameters) {
+	uint32_t start;
+	uint32_t cycles;
+	
+	for (;;) {
+		xSemaphoreTake(fft_frame_ready, portMAX_DELAY);
+		
+		start = Get_sys_count();
+		fft_analyze(capture[capture_ready]);
+		cycles = Get_sys_count() - start;
+		
+		fft_stats.frames++;
+		fft_stats.cycles = cycles;
+		if (cycles > fft_stats.cycles_max) fft_stats.cycles_max = cycles;
+		if (cycles > FFT_CYCLE_BUDGET) fft_stats.overruns++;
+		
+		if (task_leds_get_mode() == LEDS_MODE_SPECTRUM) {
+			task_leds_set_RGB(band_level[0], band_level[1], band_level[2],
+							band_level[3], band_level[4], band_level[5]);
+		}
+	}
+}
+
+//! Creates the analyzer task
+void task_fft_start(void) {
+	uint32_t i;
+	
+	capture_fill = 0;
+	capture_pos = 0;
+	decimate_sum = 0;
+	decimate_count = 0;
+	analyzer_busy = false;
+	
+	for (i = 0; i < FFT_NUM_BANDS; i++) {
+		band_level[i] = 0;
+	}
+	
+	vSemaphoreCreateBinary(fft_frame_ready);
+	if (fft_frame_ready == NULL) rtos_mem_halt(RTOS_TASK_FFT);
+	xSemaphoreTake(fft_frame_ready, 0);
+	
+	if (!rtos_mem_task_create(RTOS_TASK_FFT, task_fft)) rtos_mem_halt(RTOS_TASK_FFT);
+	
+	return;
+}
+
+//! Decimates an I2S block into the capture buffer, called from the audio task
+/*!
+	When a frame is complete and the analyzer has not taken the previous one yet the
+	new frame is thrown away, so a starved analyzer costs frame rate and nothing else.
+	\param left the left channel samples
+	\param right the right channel samples
+	\param frames the number of frames in the block
+*/
+void task_fft_feed_block(const int16_t *left, const int16_t *right, uint32_t frames) {
+	uint32_t i;
+	
+	// Not running until task_fft_start
+	if (fft_frame_ready == NULL) return;
+	
+	for (i = 0; i < frames; i++) {
+		decimate_sum += (int32_t)left[i] + right[i];
+		
+		if (++decimate_count < FFT_DECIMATION) continue;
+		
+		capture[capture_fill][capture_pos] = (int16_t)(decimate_sum / (2 * FFT_DECIMATION));
+		decimate_sum = 0;
+		decimate_count = 0;
+		
+		if (++capture_pos < FFT_SIZE) continue;
+		capture_pos = 0;
+		
+		if (analyzer_busy) {
+			fft_stats.dropped++;
+			continue;
+		}
+		
+		capture_ready = capture_fill;
+		capture_fill ^= 1;
+		analyzer_busy = true;
+		xSemaphoreGive(fft_frame_ready);
+	}
+	
+	return;
+}
+
+//! Copies the analyzer statistics
+void task_fft_get_stats(fft_stats_t *stats) {
+	
+	portENTER_CRITICAL();
+	stats->frames = fft_stats.frames;
+	stats->dropped = fft_stats.dropped;
+	stats->overruns = fft_stats.overruns;
+	stats->cycles = fft_stats.cycles;
+	stats->cycles_max = fft_stats.cycles_max;
+	portEXIT_CRITICAL();
+	
+	return;
+}
\ No newline at end of file
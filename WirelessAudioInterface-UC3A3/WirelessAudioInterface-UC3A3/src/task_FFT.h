@@ -0,0 +1,40 @@
+/*
+ * task_FFT.h
+ *
+ * Created: 4/21/2013 3:12:37 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TASK_FFT_H_
+#define TASK_FFT_H_
+
+//! FFT length, a power of 4 for the radix-4 kernel
+#define FFT_SIZE				256
+#define FFT_LOG4_SIZE			4
+//! I2S frames averaged into one FFT input sample (48kHz -> 12kHz, 47Hz bins)
+#define FFT_DECIMATION			4
+//! LED channels driven by the analyzer
+#define FFT_NUM_BANDS			6
+
+//! One frame is FFT_SIZE*FFT_DECIMATION I2S frames, 21.3ms or 1.41M cycles at 48kHz.
+//! The analyzer may use 10% of that; frames above it are counted in fft_stats.overruns
+#define FFT_CYCLE_BUDGET		140000
+
+//! Band brightness falls by 1/2^shift per frame when the band gets quieter
+#define FFT_BAND_DECAY_SHIFT	3
+
+typedef struct {
+	uint32_t frames;
+	uint32_t dropped;
+	uint32_t overruns;
+	uint32_t cycles;
+	uint32_t cycles_max;
+} fft_stats_t;
+
+extern void task_fft_start(void);
+extern void task_fft_feed_block(const int16_t *left, const int16_t *right, uint32_t frames);
+extern void task_fft_transform(int16_t *re, int16_t *im);
+extern void task_fft_get_stats(fft_stats_t *stats);
+
+#endif /* TASK_FFT_H_ */
\ No newline at end of file
@@ -10,7 +10,102 @@
 #include "gpio.h"
 #include "power_clocks_lib.h"
 #include "ssc_i2s.h"
+#include "pdca.h"
+#include "interrupt.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "conf_tasks.h"
+#include "audio_pool.h"
 #include "task_I2S.h"
+#include "task_DSP.h"
+#include "task_ADC.h"
+#include "task_FFT.h"
+#include "task_power.h"
+#include "rtos_mem.h"
+
+//! Blocks loaded into the PDCA channels: the one being transferred and the one queued behind it
+static audio_block_t *rx_current;
+static audio_block_t *rx_next;
+static audio_block_t *tx_current;
+static audio_block_t *tx_next;
+
+//! Played whenever no processed block is ready
+static audio_block_t silence_block;
+
+//! Received blocks waiting for the audio task and processed blocks waiting for the TX channel, passed by pointer
+static xQueueHandle i2s_rx_queue;
+static xQueueHandle i2s_tx_queue;
+
+static volatile i2s_stats_t i2s_stats;
+
+//! Runs the processing stages on a received block, in place
+static void task_I2S_process_block(audio_block_t *block) {
+	
+	audio_pool_unpack(block);
+	
+	task_dsp_process(&block->pcm);
+	task_adc_feed_block(block->pcm.left, block->pcm.right, DSP_BLOCK_FRAMES);
+	task_fft_feed_block(block->pcm.left, block->pcm.right, DSP_BLOCK_FRAMES);
+	
+	audio_pool_pack(block);
+	
+	return;
+}
+
+//! SSC RX DMA handler, runs once per block
+/*!
+	The block that just filled goes to the audio task by pointer, and a fresh pool block
+	is queued behind the one now being filled. When the pool is empty the finished block
+	is recycled and its audio dropped.
+*/
+ISR_FREERTOS(task_I2S_pdca_rx_int_handler, AVR32_PDCA_IRQ_GROUP, I2S_PDCA_INT_LEVEL) {
+	portBASE_TYPE woken = pdFALSE;
+	audio_block_t *done = rx_current;
+	
+	rx_current = rx_next;
+	rx_next = audio_pool_alloc();
+	
+	if (rx_next == NULL) {
+		rx_next = done;
+		i2s_stats.rx_dropped++;
+	}
+	
+	// Reloading also clears the reload counter zero interrupt
+	pdca_reload_channel(PDCA_CHANNEL_SSC_RX, rx_next->dma, AUDIO_BLOCK_WORDS);
+	
+	if (rx_next == done) return woken;
+	
+	if (xQueueSendFromISR(i2s_rx_queue, &done, &woken) != pdTRUE) {
+		audio_pool_release(done);
+		i2s_stats.rx_dropped++;
+	}
+	
+	return woken;
+}
+
+//! SSC TX DMA handler, runs once per block
+/*!
+	The block that finished playing goes back to the pool and the next processed
+	block, or silence on underrun, is queued behind the one now playing.
+*/
+ISR_FREERTOS(task_I2S_pdca_tx_int_handler, AVR32_PDCA_IRQ_GROUP, I2S_PDCA_INT_LEVEL) {
+	portBASE_TYPE woken = pdFALSE;
+	audio_block_t *done = tx_current;
+	
+	tx_current = tx_next;
+	
+	if (xQueueReceiveFromISR(i2s_tx_queue, &tx_next, &woken) != pdTRUE) {
+		tx_next = &silence_block;
+		i2s_stats.tx_underrun++;
+	}
+	
+	pdca_reload_channel(PDCA_CHANNEL_SSC_TX, tx_next->dma, AUDIO_BLOCK_WORDS);
+	
+	audio_pool_release(done);
+	
+	return woken;
+}
 
 //! Initializes the I2S function
 void task_I2S_init(void) {
@@ -29,9 +124,108 @@ void task_I2S_init(void) {
 	
 	ssc_i2s_init(&AVR32_SSC, INITIAL_BITRATE, INITIAL_BITDEPTH, 32, SSC_I2S_MODE_STEREO_OUT_STEREO_IN, FPBA_HZ);
 	
+	static const pdca_channel_options_t PDCA_OPTIONS_SSC_RX = {
+		.pid = AVR32_PDCA_PID_SSC_RX,
+		.transfer_size = PDCA_TRANSFER_SIZE_WORD
+	};
+	
+	static const pdca_channel_options_t PDCA_OPTIONS_SSC_TX = {
+		.pid = AVR32_PDCA_PID_SSC_TX,
+		.transfer_size = PDCA_TRANSFER_SIZE_WORD
+	};
+	
+	// Buffers are loaded in task_I2S_start
+	pdca_init_channel(PDCA_CHANNEL_SSC_RX, &PDCA_OPTIONS_SSC_RX);
+	pdca_init_channel(PDCA_CHANNEL_SSC_TX, &PDCA_OPTIONS_SSC_TX);
+	
+	irq_register_handler(task_I2S_pdca_rx_int_handler, AVR32_PDCA_IRQ_0 + PDCA_CHANNEL_SSC_RX, I2S_PDCA_INT_LEVEL);
+	irq_register_handler(task_I2S_pdca_tx_int_handler, AVR32_PDCA_IRQ_0 + PDCA_CHANNEL_SSC_TX, I2S_PDCA_INT_LEVEL);
+	
+	audio_pool_init_static(&silence_block);
+	
+	audio_pool_init();
+	i2s_rx_queue = xQueueCreate(AUDIO_POOL_BLOCKS, sizeof(audio_block_t *));
+	i2s_tx_queue = xQueueCreate(AUDIO_POOL_BLOCKS, sizeof(audio_block_t *));
+	if (i2s_rx_queue == NULL || i2s_tx_queue == NULL) rtos_mem_halt(RTOS_TASK_AUDIO);
+	
+	task_dsp_init();
+	task_dsp_set_fs(INITIAL_BITRATE);
+	
 	return;
 }	
 
+//! Starts the I2S DMA, only from a task: the RX interrupt may switch context
+static void task_I2S_dma_start(void) {
+	uint32_t i;
+	
+	for (i = 0; i < AUDIO_BLOCK_WORDS; i++) {
+		silence_block.dma[i] = 0;
+	}
+	
+	i2s_stats.rx_dropped = 0;
+	i2s_stats.tx_underrun = 0;
+	i2s_stats.tx_overflow = 0;
+	
+	task_dsp_reset();
+	
+	rx_current = audio_pool_alloc();
+	rx_next = audio_pool_alloc();
+	tx_current = &silence_block;
+	tx_next = &silence_block;
+	
+	pdca_load_channel(PDCA_CHANNEL_SSC_RX, rx_current->dma, AUDIO_BLOCK_WORDS);
+	pdca_reload_channel(PDCA_CHANNEL_SSC_RX, rx_next->dma, AUDIO_BLOCK_WORDS);
+	pdca_load_channel(PDCA_CHANNEL_SSC_TX, tx_current->dma, AUDIO_BLOCK_WORDS);
+	pdca_reload_channel(PDCA_CHANNEL_SSC_TX, tx_next->dma, AUDIO_BLOCK_WORDS);
+	
+	pdca_enable_interrupt_reload_counter_zero(PDCA_CHANNEL_SSC_RX);
+	pdca_enable_interrupt_reload_counter_zero(PDCA_CHANNEL_SSC_TX);
+	pdca_enable(PDCA_CHANNEL_SSC_TX);
+	pdca_enable(PDCA_CHANNEL_SSC_RX);
+	
+	return;
+}
+
+//! Audio DMA service task, one pass per received block
+static void task_I2S_audio(void *pvParameters) {
+	audio_block_t *block;
+	
+	task_I2S_dma_start();
+	
+	for (;;) {
+		xQueueReceive(i2s_rx_queue, &block, portMAX_DELAY);
+		
+		task_power_audio_activity();
+		task_I2S_process_block(block);
+		
+		if (xQueueSend(i2s_tx_queue, &block, 0) != pdTRUE) {
+			audio_pool_release(block);
+			i2s_stats.tx_overflow++;
+		}
+	}
+}
+
+//! Creates the audio task, which starts the DMA when it first runs
+void task_I2S_start(void) {
+	
+	if (!rtos_mem_task_create(RTOS_TASK_AUDIO, task_I2S_audio)) rtos_mem_halt(RTOS_TASK_AUDIO);
+	
+	return;
+}
+
+//! Copies the I2S pipeline statistics
+void task_I2S_get_stats(i2s_stats_t *stats) {
+	irqflags_t flags = cpu_irq_save();
+	
+	stats->rx_dropped = i2s_stats.rx_dropped;
+	stats->tx_underrun = i2s_stats.tx_underrun;
+	stats->tx_overflow = i2s_stats.tx_overflow;
+	
+	cpu_irq_restore(flags);
+	
+	return;
+}
+
 void task_I2S_set_mclk(uint32_t fs) {
 	
 	switch (fs)
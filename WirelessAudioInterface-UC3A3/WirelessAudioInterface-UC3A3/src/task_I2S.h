@@ -12,6 +12,16 @@
 #define INITIAL_BITRATE 48000
 #define INITIAL_BITDEPTH 24
 
+#define PDCA_CHANNEL_SSC_RX		0
+#define PDCA_CHANNEL_SSC_TX		1
+#define I2S_PDCA_INT_LEVEL		3
+
+typedef struct {
+	uint32_t rx_dropped;
+	uint32_t tx_underrun;
+	uint32_t tx_overflow;
+} i2s_stats_t;
+
 #define PIN_SSC_RX_DATA			AVR32_SSC_RX_DATA_0_2_PIN
 #define FUNC_SSC_RX_DATA		AVR32_SSC_RX_DATA_0_2_FUNCTION
 #define PIN_SSC_RX_FSYNC		AVR32_SSC_RX_FRAME_SYNC_0_2_PIN
@@ -27,6 +37,8 @@
 #define	FUNC_SSC_TX_CLOCK		AVR32_SSC_TX_CLOCK_0_1_FUNCTION
 
 extern void task_I2S_init(void);
+extern void task_I2S_start(void);
+extern void task_I2S_get_stats(i2s_stats_t *stats);
 extern void task_I2S_change_mclk(uint32_t fs);
 
 #endif /* TASK_I2S_H_ */
\ No newline at end of file
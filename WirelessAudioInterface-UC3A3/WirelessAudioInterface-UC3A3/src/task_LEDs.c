@@ -10,11 +10,20 @@
 #include "gpio.h"
 #include "power_clocks_lib.h"
 #include "tc.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "conf_tasks.h"
 #include "task_LEDs.h"
 #include "task_ADC.h"
+#include "rtos_mem.h"
+#include "rtos_stats.h"
+#include "telemetry.h"
+#include "task_power.h"
 
 #define INCR_LUT(var) ((var < (SINE_LUT_SIZE-1)) ? (var++) : (var=0))
 
+static volatile uint32_t leds_mode = LEDS_MODE_LFO;
+
 //! Initialize the LED timer/counter PWM function
 void task_leds_init(void) {
 	
@@ -134,6 +143,9 @@ void task_leds_init(void) {
 	tc_write_rc(TC_GREEN_BOT, CHAN_GREEN_BOT, 0xFFFF);
 	tc_write_rc(TC_BLUE_BOT, CHAN_BLUE_BOT, 0xFFFF);
 	
+	// TIOA0 is unused by the LEDs and triggers the ADC: one conversion per PWM period
+	tc_write_ra(TC_BLUE_TOP, CHAN_BLUE_TOP, 0x8000);
+	
 	task_adc_init();
 	
 	return;
@@ -181,7 +193,26 @@ void task_leds_set_RGB_hex(uint32_t hex_top, uint32_t hex_bot) {
 	return;
 }
 
-//! Starts the LED PWM
+//! LED task, steps the LFO every TASK_LEDS_PERIOD_MS and runs the stack monitor, CPU, power and telemetry reports
+static void task_leds(void *pvParameters) {
+	portTickType wake = xTaskGetTickCount();
+	uint32_t monitor = 0;
+	
+	for (;;) {
+		vTaskDelayUntil(&wake, TASK_LEDS_PERIOD_MS / portTICK_RATE_MS);
+		task_leds_update();
+		telemetry_report();
+		
+		if (++monitor >= RTOS_MEM_MONITOR_MS / TASK_LEDS_PERIOD_MS) {
+			monitor = 0;
+			rtos_mem_monitor();
+			rtos_stats_report();
+			task_power_report();
+		}
+	}
+}
+
+//! Starts the LED PWM and the LED task
 void task_leds_start(void) {
 	tc_start(TC_RED_TOP, CHAN_RED_TOP);
 	tc_start(TC_GREEN_TOP, CHAN_GREEN_TOP);
@@ -198,7 +229,9 @@ void task_leds_start(void) {
 	green_bottom_index = 4 * (SINE_LUT_SIZE / 6);
 	blue_bottom_index = 5 * (SINE_LUT_SIZE / 6);
 	
-	task_adc_enable();
+	task_adc_set_source(ADC_SOURCE);
+	
+	if (!rtos_mem_task_create(RTOS_TASK_LEDS, task_leds)) rtos_mem_halt(RTOS_TASK_LEDS);
 	
 	return;
 }
@@ -206,7 +239,16 @@ void task_leds_start(void) {
 //! Updates the LEDs with audio average * LFO
 void task_leds_update(void) {
 	
-	uint32_t adc_val = task_adc_update();
+	// Kept dark every period, a last analyzer frame may land after the mode change
+	if (leds_mode == LEDS_MODE_OFF) {
+		task_leds_set_RGB(0, 0, 0, 0, 0, 0);
+		return;
+	}
+	
+	// The analyzer task writes the LEDs itself
+	if (leds_mode != LEDS_MODE_LFO) return;
+	
+	uint32_t adc_val = task_adc_get_level();
 	
 	task_leds_set_RGB(	adc_val*sine_lookup[red_top_index], 
 						adc_val*sine_lookup[green_top_index],
@@ -223,4 +265,19 @@ void task_leds_update(void) {
 	INCR_LUT(blue_bottom_index);
 	
 	return;
+}
+
+//! Selects what drives the LEDs
+/*!
+	\param mode LEDS_MODE_LFO, LEDS_MODE_SPECTRUM or LEDS_MODE_OFF
+*/
+void task_leds_set_mode(uint32_t mode) {
+	leds_mode = mode;
+	
+	return;
+}
+
+//! Returns what drives the LEDs
+uint32_t task_leds_get_mode(void) {
+	return leds_mode;
 }
\ No newline at end of file
@@ -44,11 +44,18 @@
 #define TC_BLUE_BOT		&AVR32_TC0
 #define CLK_BLUE_BOT	TC_CH2_EXT_CLK2_SRC_NO_CLK
 
+//! What drives the LEDs: the audio level scaled LFO or the spectrum analyzer, or nothing (dark)
+#define LEDS_MODE_LFO		0
+#define LEDS_MODE_SPECTRUM	1
+#define LEDS_MODE_OFF		2
+
 extern void task_leds_init(void);
 extern void task_leds_set_RGB(uint16_t red_top, uint16_t green_top, uint16_t blue_top, uint16_t red_bot, uint16_t green_bot, uint16_t blue_bot);
 extern void task_leds_set_RGB_hex(uint32_t hex_top, uint32_t hex_bot);
 extern void task_leds_start(void);
 extern void task_leds_update(void);
+extern void task_leds_set_mode(uint32_t mode);
+extern uint32_t task_leds_get_mode(void);
 
 static volatile uint8_t red_top_index;
 static volatile uint8_t green_top_index;
@@ -59,7 +66,7 @@ static volatile uint8_t blue_bottom_index;
 
 #define SINE_LUT_SIZE	256
 
-const uint8_t sine_lookup[SINE_LUT_SIZE] = {
+static const uint8_t sine_lookup[SINE_LUT_SIZE] = {
 	0x40, 0x41, 0x43, 0x44, 0x46, 0x47, 0x49, 0x4A,
 	0x4C, 0x4E, 0x4F, 0x51, 0x52, 0x54, 0x55, 0x57,
 	0x58, 0x59, 0x5B, 0x5C, 0x5E, 0x5F, 0x60, 0x62,
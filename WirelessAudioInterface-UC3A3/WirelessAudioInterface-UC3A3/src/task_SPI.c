@@ -10,7 +10,21 @@
 #include "gpio.h"
 #include "power_clocks_lib.h"
 #include "spi_master.h"
+#include "pdca.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 #include "task_SPI.h"
+#include "rtos_mem.h"
+
+struct spi_device spi_device_cc8530;
+struct spi_device spi_device_codec;
+struct spi_device spi_device_clock;
+struct spi_device spi_device_touch;
+
+//! One owner per bus between select and deselect. SPI0 is shared by the CC8530, codec and clock chip
+static xSemaphoreHandle spi0_mutex;
+static xSemaphoreHandle spi1_mutex;
 
 //! Initializes the SPI function
 void task_spi_init(void) {
@@ -52,6 +66,22 @@ void task_spi_init(void) {
 	// AT42QT1110: fmax=1.5MHz, CPOL=1, CPHA=1
 	spi_master_setup_device(&AVR32_SPI1, &spi_device_touch, SPI_MODE_3, 1000000, 0);
 	
+	static const pdca_channel_options_t PDCA_OPTIONS_SPI0_TX = {
+		.pid = AVR32_PDCA_PID_SPI0_TX,
+		.transfer_size = PDCA_TRANSFER_SIZE_BYTE
+	};
+	static const pdca_channel_options_t PDCA_OPTIONS_SPI1_TX = {
+		.pid = AVR32_PDCA_PID_SPI1_TX,
+		.transfer_size = PDCA_TRANSFER_SIZE_BYTE
+	};
+	
+	pdca_init_channel(PDCA_CHANNEL_SPI0_TX, &PDCA_OPTIONS_SPI0_TX);
+	pdca_init_channel(PDCA_CHANNEL_SPI1_TX, &PDCA_OPTIONS_SPI1_TX);
+	
+	spi0_mutex = xSemaphoreCreateMutex();
+	spi1_mutex = xSemaphoreCreateMutex();
+	if (spi0_mutex == NULL || spi1_mutex == NULL) rtos_mem_halt(RTOS_MEM_KERNEL);
+	
 	return;
 }
 
@@ -59,4 +89,54 @@ void task_spi_init(void) {
 void task_spi_start(void) {
 	spi_enable(&AVR32_SPI0);
 	spi_enable(&AVR32_SPI1);
+}
+
+//! Takes a bus for a sequence of transfers
+/*!
+	Does nothing before the scheduler runs, init code owns both buses then.
+	\param spi the bus, &AVR32_SPI0 or &AVR32_SPI1
+*/
+void task_spi_lock(volatile avr32_spi_t *spi) {
+	
+	if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return;
+	
+	xSemaphoreTake((spi == &AVR32_SPI0) ? spi0_mutex : spi1_mutex, portMAX_DELAY);
+	
+	return;
+}
+
+//! Releases a bus taken with task_spi_lock
+void task_spi_unlock(volatile avr32_spi_t *spi) {
+	
+	if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return;
+	
+	xSemaphoreGive((spi == &AVR32_SPI0) ? spi0_mutex : spi1_mutex);
+	
+	return;
+}
+
+//! Writes a block under one chip select, the PDCA feeds the SPI. The bus must be locked
+/*!
+	Waits for the last bit to leave before deselecting, short register writes do not
+	pay for a context switch. Received bytes are dropped, and the receive register is
+	left empty for the byte-wise transfers that follow.
+	\param data block to send, must stay valid until the function returns
+*/
+void task_spi_write_dma(volatile avr32_spi_t *spi, struct spi_device *device, const uint8_t *data, uint32_t length) {
+	uint32_t channel = (spi == &AVR32_SPI0) ? PDCA_CHANNEL_SPI0_TX : PDCA_CHANNEL_SPI1_TX;
+	uint8_t dummy;
+	
+	spi_select_device(spi, device);
+	
+	pdca_load_channel(channel, (volatile void *)data, length);
+	pdca_enable(channel);
+	while (!(pdca_get_transfer_status(channel) & PDCA_TRANSFER_COMPLETE));
+	while (!spi_is_tx_empty(spi));
+	pdca_disable(channel);
+	
+	if (spi_is_rx_full(spi)) spi_read_single(spi, &dummy);
+	
+	spi_deselect_device(spi, device);
+	
+	return;
 }
\ No newline at end of file
@@ -43,12 +43,19 @@
 #define ID_TOUCH_nCS		1
 #define SPI_TOUCH			(&AVR32_SPI1)
 
-static struct spi_device spi_device_cc8530;
-static struct spi_device spi_device_codec;
-static struct spi_device spi_device_clock;
-static struct spi_device spi_device_touch;
+//! PDCA channels for register writes, after the SSC channels of task_I2S.h
+#define PDCA_CHANNEL_SPI0_TX		2
+#define PDCA_CHANNEL_SPI1_TX		3
+
+extern struct spi_device spi_device_cc8530;
+extern struct spi_device spi_device_codec;
+extern struct spi_device spi_device_clock;
+extern struct spi_device spi_device_touch;
 
 extern void task_spi_init(void);
 extern void task_spi_start(void);
+extern void task_spi_lock(volatile avr32_spi_t *spi);
+extern void task_spi_unlock(volatile avr32_spi_t *spi);
+extern void task_spi_write_dma(volatile avr32_spi_t *spi, struct spi_device *device, const uint8_t *data, uint32_t length);
 
 #endif /* TASK_SPI_H_ */
\ No newline at end of file
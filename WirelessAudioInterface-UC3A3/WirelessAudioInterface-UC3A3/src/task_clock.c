@@ -9,7 +9,23 @@
 #include "board.h"
 #include "gpio.h"
 #include "power_clocks_lib.h"
+#include "spi_master.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "conf_tasks.h"
+#include "task_SPI.h"
+#include "task_I2S.h"
+#include "task_DSP.h"
+#include "CS2300.h"
 #include "task_clock.h"
+#include "rtos_mem.h"
+
+//! Sample rate requests, newest wins
+static xQueueHandle clock_queue = NULL;
+
+//! Rate the CS2300, clocks and DSP are set for. main() programs the CS2300 for INITIAL_BITRATE
+static volatile uint32_t clock_fs = INITIAL_BITRATE;
 
 //! Initializes clocks
 void task_clock_init(void) {
@@ -31,6 +47,9 @@ void task_clock_init(void) {
 	//MCLK is replica of OSC0 = 12MHz
 	pm_gc_setup(&AVR32_PM, AVR32_PM_GCLK_GCLK3, 0, 0, 0, 0);
 	
+	clock_queue = xQueueCreate(QUEUE_CLOCK_LENGTH, sizeof(uint32_t));
+	if (clock_queue == NULL) rtos_mem_halt(RTOS_TASK_CLOCK);
+	
 	return;
 }
 
@@ -78,4 +97,69 @@ void task_clock_change_bclk_wclk(uint32_t fs) {
 	//Not implemented
 	
 	return;
+}
+
+//! Clock/sample rate manager task
+/*!
+	Reprograms the CS2300, the word and bit clocks and the DSP for each new rate. Requests
+	that pile up while a change is in progress collapse into the newest one, and a change
+	is followed by TASK_CLOCK_HOLDOFF_MS of rest so a chattering source cannot starve the
+	tasks below.
+*/
+static void task_clock(void *pvParameters) {
+	uint32_t fs;
+	bool ok;
+	
+	for (;;) {
+		xQueueReceive(clock_queue, &fs, portMAX_DELAY);
+		while (xQueueReceive(clock_queue, &fs, 0) == pdTRUE);
+		
+		if (fs == clock_fs) continue;
+		
+		task_spi_lock(SPI_CLOCK);
+		CS2300_config(fs);
+		task_spi_unlock(SPI_CLOCK);
+		
+		task_clock_change_bclk_wclk(fs);
+		
+		// The audio task must not see half a coefficient switch
+		portENTER_CRITICAL();
+		ok = task_dsp_set_fs(fs);
+		portEXIT_CRITICAL();
+		
+		if (ok) clock_fs = fs;
+		
+		vTaskDelay(TASK_CLOCK_HOLDOFF_MS / portTICK_RATE_MS);
+	}
+}
+
+//! Creates the clock manager task
+void task_clock_start(void) {
+	
+	if (!rtos_mem_task_create(RTOS_TASK_CLOCK, task_clock)) rtos_mem_halt(RTOS_TASK_CLOCK);
+	
+	return;
+}
+
+//! Asks the clock manager for a new sample rate, never blocks
+/*!
+	\param fs the sample rate in Hz
+	\return false if the request was dropped
+*/
+bool task_clock_request_fs(uint32_t fs) {
+	uint32_t oldest;
+	
+	if (clock_queue == NULL) return false;
+	
+	if (xQueueSend(clock_queue, &fs, 0) == pdTRUE) return true;
+	
+	// Full, make room: the oldest request would be overridden anyway
+	xQueueReceive(clock_queue, &oldest, 0);
+	
+	return (xQueueSend(clock_queue, &fs, 0) == pdTRUE);
+}
+
+//! Returns the sample rate the clocks and DSP are running at
+uint32_t task_clock_get_fs(void) {
+	return clock_fs;
 }
\ No newline at end of file
@@ -22,6 +22,9 @@
 #define BCLK_MULT	64		//BCLK = BCLK_MULT * FS	(2 x 32-bit words)
 
 extern void task_clock_init(void);
+extern void task_clock_start(void);
 extern void task_clock_change_bclk_wclk(uint32_t fs);
+extern bool task_clock_request_fs(uint32_t fs);
+extern uint32_t task_clock_get_fs(void);
 
 #endif /* TASK_CLOCK_H_ */
\ No newline at end of file
@@ -0,0 +1,450 @@
+/*
+ * task_power.c
+ *
+ * Created: 4/28/2013 11:01:54 AM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "board.h"
+#include "gpio.h"
+#include "power_clocks_lib.h"
+#include "sleepmgr.h"
+#include "usb_drv.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "udi_cdc.h"
+#include "audio_pool.h"
+#include "task_SPI.h"
+#include "task_EHIF.h"
+#include "task_LEDs.h"
+#include "CS4270.h"
+#include "rtos_stats.h"
+#include "task_power.h"
+
+//! Fails the build when a frame no longer fits the CDC buffer, it would never be sent
+typedef char power_frame_check[(POWER_FRAME_BYTES <= UDI_CDC_FRAME_MAX) ? 1 : -1];
+
+/*
+	The kernel tick comes from COUNT/COMPARE, and COUNT is clocked by the CPU, so it
+	stops in every sleep mode. The CPU only sleeps when nothing needs a steady tick:
+	the CC85xx is in standby or off and no audio blocks arrive. The idle hook then
+	sleeps until the next delayed task is due, on an RTC wake up, unless the EHIF
+	event or touch CHANGE interrupt comes first. On waking it steps the kernel over
+	the ticks the RTC counted, with the scheduler suspended, so xTaskResumeAll() plays
+	them back as missed ticks. FreeRTOS 7.0 has no tickless idle of its own.
+
+	While the CC85xx is active the CPU never sleeps and runs at full clock. Sample
+	rate, network and power state changes all raise the EHIF interrupt, and the audio
+	task restores the full clock on the first block it sees.
+
+	The CC85xx power state itself follows task_power_policy, which the EHIF task runs
+	on the PM_GET_DATA timers. The codec and LEDs go down before the CC85xx leaves the
+	active state and come back as soon as it is active again, whether the host asked
+	for it (audio blocks, a touch) or the CC85xx woke by itself (network activity).
+*/
+
+static volatile uint32_t power_clock = POWER_CLOCK_FULL;
+static uint32_t power_radio_state = EHIF_PWR_ACTIVE;
+
+//! Audio pool allocations at the last update and the tick they last changed at
+static uint32_t power_audio_allocs = 0;
+static portTickType power_audio_tick = 0;
+
+static volatile power_stats_t power_stats;
+
+//! Codec and LEDs, the LED mode to return to, and whether a wake up is on its way
+static bool power_host_on = true;
+static uint32_t power_leds_mode = LEDS_MODE_LFO;
+static volatile bool power_wake_posted = false;
+static portTickType power_wake_tick = 0;
+
+//! RTC value at the last update, and the time in state in RTC counts
+static uint32_t power_rtc_last = 0;
+static uint32_t power_state_counts[POWER_STATES];
+
+//! Counts lost when a sleep ends on TOP and the RTC starts over from 0, so the RTC time
+//! base runs on without a jump
+static uint32_t power_rtc_offset = 0;
+//! Tick the first delayed task is due at, from the last context switch. A task that
+//! blocks switches out, so it can only have moved later since
+static volatile portTickType power_next_unblock = portMAX_DELAY;
+//! RTC counts slept that did not make up a whole tick yet, in 1/configTICK_RATE_HZ counts
+static uint32_t power_sleep_rem = 0;
+
+static uint8_t power_frame[POWER_FRAME_BYTES];
+
+//! Starts a full tick period at the current clock
+static void task_power_restart_tick(void) {
+
+	Set_system_register(AVR32_COMPARE, (configCPU_CLOCK_HZ >> power_clock) / configTICK_RATE_HZ);
+	Set_system_register(AVR32_COUNT, 0);
+
+	return;
+}
+
+//! Switches the CPU, HSB and PB clocks and moves the tick along with them
+static void task_power_set_clock(uint32_t clock) {
+
+	portENTER_CRITICAL();
+
+	if (clock == power_clock) {
+		portEXIT_CRITICAL();
+		return;
+	}
+
+	if (clock == POWER_CLOCK_REDUCED) {
+		// CPU, HSB, PBA main/2, PBB main/4
+		pm_cksel(&AVR32_PM, 1, 0, 1, 1, 1, 0);
+		sleepmgr_unlock_mode(SLEEPMGR_ACTIVE);
+		sleepmgr_lock_mode(SLEEPMGR_FROZEN);
+	}
+	else {
+		// CPU, HSB, PBA main, PBB main/2
+		pm_cksel(&AVR32_PM, 0, 0, 1, 0, 0, 0);
+		sleepmgr_lock_mode(SLEEPMGR_ACTIVE);
+		sleepmgr_unlock_mode(SLEEPMGR_FROZEN);
+	}
+
+	// COUNT may already be past the new COMPARE, so restart the tick period
+	power_clock = clock;
+	task_power_restart_tick();
+
+	power_stats.clock = clock;
+	power_stats.clock_changes++;
+
+	portEXIT_CRITICAL();
+
+	return;
+}
+
+//! Writes the RTC TOP value, which ends a sleep when the RTC reaches it
+static void task_power_rtc_set_top(uint32_t top) {
+
+	while (AVR32_RTC.ctrl & AVR32_RTC_CTRL_BUSY_MASK);
+	AVR32_RTC.top = top;
+	while (AVR32_RTC.ctrl & AVR32_RTC_CTRL_BUSY_MASK);
+
+	return;
+}
+
+//! Returns the RTC time base, in RTC counts
+static uint32_t task_power_rtc_now(void) {
+	return AVR32_RTC.val + power_rtc_offset;
+}
+
+//! Starts the RTC from RCSYS as a free running counter that wakes the CPU at TOP
+static void task_power_rtc_init(void) {
+
+	while (AVR32_RTC.ctrl & AVR32_RTC_CTRL_BUSY_MASK);
+	AVR32_RTC.top = 0xFFFFFFFF;
+	while (AVR32_RTC.ctrl & AVR32_RTC_CTRL_BUSY_MASK);
+	AVR32_RTC.val = 0;
+	while (AVR32_RTC.ctrl & AVR32_RTC_CTRL_BUSY_MASK);
+	AVR32_RTC.ctrl = (POWER_RTC_PSEL << AVR32_RTC_CTRL_PSEL_OFFSET) | AVR32_RTC_CTRL_WAKE_EN_MASK | AVR32_RTC_CTRL_EN_MASK;
+
+	return;
+}
+
+//! Starts at full clock with sleep disabled
+void task_power_init(void) {
+	uint32_t i;
+
+	sleepmgr_init();
+	sleepmgr_lock_mode(SLEEPMGR_ACTIVE);
+
+	task_power_rtc_init();
+
+	power_stats.radio_state = power_radio_state;
+	power_stats.clock = POWER_CLOCK_FULL;
+	power_stats.clock_changes = 0;
+	power_stats.sleeps = 0;
+	power_stats.sleep_ticks = 0;
+	for (i = 0; i < POWER_STATES; i++) {
+		power_state_counts[i] = 0;
+	}
+	power_stats.transitions = 0;
+	power_stats.vbat_mv = 0;
+	power_stats.host_on = power_host_on;
+
+	return;
+}
+
+//! Applies the power policy, called by the EHIF task with every status word it reads
+void task_power_update(uint16_t status) {
+	audio_pool_stats_t pool;
+	portTickType now = xTaskGetTickCount();
+	uint32_t rtc = task_power_rtc_now();
+	uint32_t state = EHIF_STAT_PWR_STATE(status);
+	bool standby;
+	bool quiet;
+
+	// The time since the last status read was spent in the state that read showed
+	power_state_counts[power_radio_state] += rtc - power_rtc_last;
+	power_rtc_last = rtc;
+
+	// Woken by the network, or the wake up request has gone through. Only on the change,
+	// every status read while active would otherwise restart the wake hold
+	if (state != power_radio_state) {
+		power_radio_state = state;
+		power_stats.radio_state = state;
+		power_stats.transitions++;
+		if (state == EHIF_PWR_ACTIVE) task_power_host(true);
+	}
+	else if (state == EHIF_PWR_ACTIVE && !power_host_on) {
+		task_power_host(true);
+	}
+
+	audio_pool_get_stats(&pool);
+	if (pool.allocs != power_audio_allocs) {
+		power_audio_allocs = pool.allocs;
+		power_audio_tick = now;
+	}
+
+	standby = (power_radio_state <= EHIF_PWR_LOCAL_STANDBY);
+	quiet = ((now - power_audio_tick) >= POWER_AUDIO_IDLE_MS / portTICK_RATE_MS);
+
+	task_power_set_clock((standby && quiet) ? POWER_CLOCK_REDUCED : POWER_CLOCK_FULL);
+
+	return;
+}
+
+//! Called by the audio task for every block, restores the full clock on the first one
+//! and wakes the codec if it was powered down
+void task_power_audio_activity(void) {
+
+	if (!power_host_on) task_power_wake();
+
+	if (power_clock == POWER_CLOCK_FULL) return;
+
+	task_power_set_clock(POWER_CLOCK_FULL);
+
+	return;
+}
+
+//! Asks the EHIF task to make the CC85xx active and power the codec and LEDs
+void task_power_wake(void) {
+
+	if (power_wake_posted) return;
+
+	power_wake_posted = task_ehif_post(EHIF_MSG_POWER_WAKE, 0);
+
+	return;
+}
+
+//! Chooses the CC85xx power state from the PM_GET_DATA timers
+/*!
+	\return the EHIF_PWR_xxx state the CC85xx should be in
+*/
+uint32_t task_power_policy(const power_pm_data_t *pm) {
+	uint32_t silence = (pm->in_silence < pm->out_silence) ? pm->in_silence : pm->out_silence;
+	uint32_t shift = (pm->vbat_mv && pm->vbat_mv < POWER_VBAT_LOW_MV) ? 2 : 0;
+
+	power_stats.vbat_mv = pm->vbat_mv;
+
+	if ((xTaskGetTickCount() - power_wake_tick) < (POWER_WAKE_HOLD_S * 1000UL) / portTICK_RATE_MS) {
+		return EHIF_PWR_ACTIVE;
+	}
+
+	// The timers count in 10ms
+	if (pm->nwk_inactivity >= (POWER_NWK_STANDBY_S * 100UL) >> shift) return EHIF_PWR_NWK_STANDBY;
+	if (silence >= (POWER_LOCAL_STANDBY_S * 100UL) >> shift) return EHIF_PWR_LOCAL_STANDBY;
+	if (silence >= (POWER_LOW_POWER_S * 100UL) >> shift) return EHIF_PWR_LOW_POWER;
+
+	return EHIF_PWR_ACTIVE;
+}
+
+//! Powers the codec and LEDs up or down, from the EHIF task
+/*!
+	Down before PM_SET_STATE takes the CC85xx out of the active state, up right after
+	it is active again. Powering up restarts the wake hold time.
+*/
+void task_power_host(bool on) {
+
+	if (on) {
+		power_wake_tick = xTaskGetTickCount();
+		power_wake_posted = false;
+	}
+
+	if (on == power_host_on) return;
+
+	task_spi_lock(SPI_CODEC);
+	if (on) CS4270_power_up();
+	else CS4270_power_down();
+	task_spi_unlock(SPI_CODEC);
+
+	if (on) {
+		task_leds_set_mode(power_leds_mode);
+	}
+	else {
+		power_leds_mode = task_leds_get_mode();
+		task_leds_set_mode(LEDS_MODE_OFF);
+	}
+
+	power_host_on = on;
+	power_stats.host_on = on;
+
+	return;
+}
+
+//! Writes a big endian field into the frame
+static uint8_t *task_power_put(uint8_t *p, uint32_t value, uint32_t bytes) {
+
+	while (bytes--) {
+		*p++ = value >> (8 * bytes);
+	}
+
+	return p;
+}
+
+//! Sends the time in state over CDC, run every RTOS_MEM_MONITOR_MS next to rtos_stats_report
+void task_power_report(void) {
+	power_stats_t stats;
+	uint32_t i;
+	uint8_t *p;
+	uint8_t sum = 0;
+
+	task_power_get_stats(&stats);
+
+	p = power_frame;
+	*p++ = RTOS_STATS_SYNC0;
+	*p++ = RTOS_STATS_SYNC1;
+	*p++ = POWER_FRAME_STATES;
+	*p++ = POWER_PAYLOAD;
+	for (i = 0; i < POWER_STATES; i++) {
+		p = task_power_put(p, stats.state_ms[i], 4);
+	}
+	p = task_power_put(p, stats.transitions, 2);
+	p = task_power_put(p, stats.vbat_mv, 2);
+	*p++ = stats.host_on;
+
+	for (i = 2; i < POWER_FRAME_BYTES - 1; i++) {
+		sum += power_frame[i];
+	}
+	*p = -sum;
+
+	// Never wait for the host, like the rtos_stats frames
+	if (udi_cdc_get_free_tx_buffer() < POWER_FRAME_BYTES) return;
+	udi_cdc_write_buf(power_frame, POWER_FRAME_BYTES);
+
+	return;
+}
+
+//! Returns how far the CPU clock is divided, as a shift
+uint32_t task_power_get_clock_shift(void) {
+	return power_clock;
+}
+
+//! Copies the power statistics
+void task_power_get_stats(power_stats_t *stats) {
+
+	uint32_t i;
+
+	portENTER_CRITICAL();
+	stats->radio_state = power_stats.radio_state;
+	stats->clock = power_stats.clock;
+	stats->clock_changes = power_stats.clock_changes;
+	stats->sleeps = power_stats.sleeps;
+	stats->sleep_ticks = power_stats.sleep_ticks;
+	for (i = 0; i < POWER_STATES; i++) {
+		stats->state_ms[i] = ((uint64_t)power_state_counts[i] * 1000) / POWER_RTC_HZ;
+	}
+	stats->transitions = power_stats.transitions;
+	stats->vbat_mv = power_stats.vbat_mv;
+	stats->host_on = power_stats.host_on;
+	portEXIT_CRITICAL();
+
+	return;
+}
+
+//! traceTASK_SWITCHED_IN, with the kernel's xNextTaskUnblockTime
+void task_power_next_unblock(unsigned long tick) {
+
+	power_next_unblock = tick;
+
+	return;
+}
+
+//! Sleeps in the deepest mode the policy allows, until the next delayed task is due
+/*!
+	Frozen keeps the PBA running, so the GPIO edge detector can still wake the CPU.
+	USB needs the HSB clock, so the CPU stays awake while VBUS is present, and a CC85xx
+	event or touch report that is already pending has no edge left to wake on.
+
+	Interrupts are masked from the checks until the sleep instruction, which unmasks
+	them, so no task can become ready unseen. The scheduler is suspended over the
+	sleep: whatever the waking interrupt readies waits until the tick count has
+	caught up. Sleeps are cut to POWER_SLEEP_MAX_TICKS, every tick slept is played
+	back on waking. The RTC runs from RCSYS, so kernel time is a few % off while asleep.
+*/
+void vApplicationIdleHook(void) {
+	portTickType ticks;
+	uint32_t start;
+	uint32_t top;
+	uint32_t slept;
+
+	if (sleepmgr_get_sleep_mode() == SLEEPMGR_ACTIVE) return;
+	if (Is_usb_vbus_high()) return;
+
+	Disable_global_interrupt();
+
+	if (!gpio_get_pin_value(PIN_CC8530_nIRQ) || !gpio_get_pin_value(PIN_TOUCH_nCHANGE)) {
+		Enable_global_interrupt();
+		return;
+	}
+
+	// Already due by the time of the last switch, or not worth the RTC writes. With no task
+	// delayed only as far as the tick count wrap, tasks delayed past it are not in the list yet
+	ticks = power_next_unblock - xTaskGetTickCountFromISR();
+	if (power_next_unblock != portMAX_DELAY && (int32_t)ticks < 0) ticks = 0;
+	if (ticks < POWER_SLEEP_MIN_TICKS) {
+		Enable_global_interrupt();
+		return;
+	}
+	if (ticks > POWER_SLEEP_MAX_TICKS) ticks = POWER_SLEEP_MAX_TICKS;
+
+	// Rounded down, the last part of the wait is left to the tick
+	start = AVR32_RTC.val;
+	top = start + (ticks * POWER_RTC_HZ) / configTICK_RATE_HZ;
+	AVR32_RTC.icr = AVR32_RTC_ICR_TOPI_MASK;
+	task_power_rtc_set_top(top);
+
+	// Past TOP already the RTC would only stop at 2^32, and near the end it cannot be set at all
+	if (top < start || AVR32_RTC.val >= top) {
+		task_power_rtc_set_top(0xFFFFFFFF);
+		Enable_global_interrupt();
+		return;
+	}
+
+	vTaskSuspendAll();
+	power_stats.sleeps++;
+	sleepmgr_enter_sleep();
+
+	// Free running again first, then see whether the sleep ended on TOP
+	Disable_global_interrupt();
+	task_power_rtc_set_top(0xFFFFFFFF);
+	if (AVR32_RTC.isr & AVR32_RTC_ISR_TOPI_MASK) {
+		AVR32_RTC.icr = AVR32_RTC_ICR_TOPI_MASK;
+		power_rtc_offset += top + 1;
+		slept = (top - start + 1) + AVR32_RTC.val;
+	}
+	else {
+		slept = AVR32_RTC.val - start;
+	}
+
+	slept = slept * configTICK_RATE_HZ + power_sleep_rem;
+	ticks = slept / POWER_RTC_HZ;
+	power_sleep_rem = slept % POWER_RTC_HZ;
+	power_stats.sleep_ticks += ticks;
+
+	// COUNT stood still, and the tick hook samples it for the interrupt latency
+	task_power_restart_tick();
+	while (ticks--) {
+		vTaskIncrementTick();
+	}
+	Enable_global_interrupt();
+
+	xTaskResumeAll();
+
+	return;
+}
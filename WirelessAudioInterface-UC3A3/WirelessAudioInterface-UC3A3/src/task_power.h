@@ -0,0 +1,95 @@
+/*
+ * task_power.h
+ *
+ * Created: 4/28/2013 11:02:17 AM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TASK_POWER_H_
+#define TASK_POWER_H_
+
+//! Clock modes: CPU, HSB and PBA at the main clock or at half of it. The PLLs keep running
+//! in both, so switching back is immediate
+#define POWER_CLOCK_FULL		0
+#define POWER_CLOCK_REDUCED		1
+
+//! Audio blocks must have stopped this long before the clock is reduced, ms
+#define POWER_AUDIO_IDLE_MS		1000
+
+//! CC85xx power state policy, from the PM_GET_DATA timers. Silence is the shorter of the
+//! input and output silence. Thresholds in seconds
+#define POWER_LOW_POWER_S		30		//silence: low power, codec and LEDs off
+#define POWER_LOCAL_STANDBY_S	600		//silence: local standby
+#define POWER_NWK_STANDBY_S		300		//no network connection: network standby
+//! After a wake up the CC85xx stays active at least this long, s
+#define POWER_WAKE_HOLD_S		POWER_LOW_POWER_S
+//! Below this battery voltage all thresholds are divided by four, mV. VBAT 0 is not measured
+#define POWER_VBAT_LOW_MV		3300
+//! PM_GET_DATA poll period while active or in low power, ms
+#define POWER_PM_POLL_MS		1000
+
+//! Time in state is counted with the RTC on RCSYS (115.2kHz nominal, a few % off), which
+//! keeps running while the CPU sleeps and the tick stands still. It also ends the sleeps
+#define POWER_RTC_PSEL			6
+#define POWER_RTC_HZ			(115200UL >> (POWER_RTC_PSEL + 1))
+
+//! Idle sleeps, in ticks. Shorter waits stay awake, longer ones are cut: every tick
+//! slept is played back by xTaskResumeAll() on waking
+#define POWER_SLEEP_MIN_TICKS	4
+#define POWER_SLEEP_MAX_TICKS	2000
+
+//! One slot per PWR_STATE value
+#define POWER_STATES			8
+
+/*
+	Frame sent over CDC with the rtos_stats frames, multi-byte fields big endian:
+
+	[0]		RTOS_STATS_SYNC0
+	[1]		RTOS_STATS_SYNC1
+	[2]		POWER_FRAME_STATES
+	[3]		payload length
+	[4]		POWER_STATES times: ms spent in PWR_STATE n since power up (4 bytes)
+	[36]	PWR_STATE changes since power up (2)
+	[38]	last VBAT from PM_GET_DATA, mV (2)
+	[40]	1 if the codec and LEDs are powered
+	[end]	checksum: the two's complement of the sum of bytes [2] to [end-1]
+
+	Battery life follows from the time fractions and the current drawn in each state.
+*/
+#define POWER_FRAME_STATES		0x50
+#define POWER_PAYLOAD			(POWER_STATES * 4 + 5)
+#define POWER_FRAME_BYTES		(4 + POWER_PAYLOAD + 1)
+
+//! PM_GET_DATA, durations in 10ms units
+typedef struct {
+	uint32_t in_silence;
+	uint32_t out_silence;
+	uint32_t nwk_inactivity;
+	uint32_t vbat_mv;
+} power_pm_data_t;
+
+typedef struct {
+	uint32_t radio_state;
+	uint32_t clock;
+	uint32_t clock_changes;
+	uint32_t sleeps;
+	uint32_t sleep_ticks;
+	uint32_t state_ms[POWER_STATES];
+	uint32_t transitions;
+	uint32_t vbat_mv;
+	uint32_t host_on;
+} power_stats_t;
+
+extern void task_power_init(void);
+extern void task_power_update(uint16_t status);
+extern void task_power_audio_activity(void);
+extern void task_power_wake(void);
+extern uint32_t task_power_policy(const power_pm_data_t *pm);
+extern void task_power_host(bool on);
+extern void task_power_report(void);
+extern uint32_t task_power_get_clock_shift(void);
+extern void task_power_next_unblock(unsigned long tick);
+extern void task_power_get_stats(power_stats_t *stats);
+
+#endif /* TASK_POWER_H_ */
\ No newline at end of file
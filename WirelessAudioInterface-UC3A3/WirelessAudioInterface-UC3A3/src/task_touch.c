@@ -0,0 +1,165 @@
+/*
+ * task_touch.c
+ *
+ * Created: 4/25/2013 12:07:39 AM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "board.h"
+#include "gpio.h"
+#include "power_clocks_lib.h"
+#include "spi_master.h"
+#include "interrupt.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "conf_tasks.h"
+#include "task_SPI.h"
+#include "task_EHIF.h"
+#include "task_power.h"
+#include "AT42QT1110.h"
+#include "task_touch.h"
+#include "rtos_mem.h"
+
+// The GPIO interrupt handler is per group of 8 pins, and the EHIF one owns its group
+#if (PIN_TOUCH_nCHANGE / 8) == (PIN_CC8530_nIRQ / 8)
+#error "PIN_TOUCH_nCHANGE and PIN_CC8530_nIRQ share a GPIO interrupt group"
+#endif
+
+static xSemaphoreHandle touch_change = NULL;
+
+static volatile uint16_t touch_keys;
+
+static volatile touch_stats_t touch_stats;
+
+//! AT42QT1110 CHANGE interrupt, wakes the touch task
+ISR_FREERTOS(task_touch_irq_handler, AVR32_GPIO_IRQ_GROUP, TOUCH_INT_LEVEL) {
+	portBASE_TYPE woken = pdFALSE;
+
+	gpio_clear_pin_interrupt_flag(PIN_TOUCH_nCHANGE);
+
+	touch_stats.changes++;
+	xSemaphoreGiveFromISR(touch_change, &woken);
+
+	return woken;
+}
+
+//! Turns a newly pressed key into a message for the task that owns the action
+static void task_touch_pressed(uint32_t key) {
+	
+	switch (key)
+	{
+		case KEY_VOL_UP:
+			task_ehif_post(EHIF_MSG_VOLUME_STEP, EHIF_DB_TO_VOL(TOUCH_VOLUME_STEP_DB));
+		break;
+		
+		case KEY_VOL_DN:
+			task_ehif_post(EHIF_MSG_VOLUME_STEP, -EHIF_DB_TO_VOL(TOUCH_VOLUME_STEP_DB));
+		break;
+		
+		default:
+			//No action yet
+		break;
+	}
+	
+	return;
+}
+
+//! Reads all keys in one burst, once more if the CRC does not match
+/*! \return false if both reads failed, keys is then left alone
+*/
+static bool task_touch_read(all_keys_t *keys) {
+	bool ok;
+	
+	task_spi_lock(SPI_TOUCH);
+	ok = AT42QT1110_read_report(RPT_REQ_SEND_ALL_KEYS, keys->b, LENGTH_SEND_ALL_KEYS);
+	if (!ok) {
+		touch_stats.crc_errors++;
+		ok = AT42QT1110_read_report(RPT_REQ_SEND_ALL_KEYS, keys->b, LENGTH_SEND_ALL_KEYS);
+	}
+	task_spi_unlock(SPI_TOUCH);
+	
+	touch_stats.reads++;
+	if (!ok) touch_stats.failures++;
+	
+	return ok;
+}
+
+//! Touch task, reads the keys when CHANGE goes low and acts on new presses
+/*!
+	CHANGE stays low until the device has been read, so an edge missed while the
+	task was busy is caught by the check at each TASK_TOUCH_RESYNC_MS timeout.
+*/
+static void task_touch(void *pvParameters) {
+	all_keys_t all_keys;
+	uint16_t changed;
+	uint32_t key;
+	
+	task_spi_lock(SPI_TOUCH);
+	AT42QT1110_init();
+	task_spi_unlock(SPI_TOUCH);
+	
+	// Only from here on: the interrupt may switch context
+	gpio_clear_pin_interrupt_flag(PIN_TOUCH_nCHANGE);
+	gpio_enable_pin_interrupt(PIN_TOUCH_nCHANGE, GPIO_FALLING_EDGE);
+	
+	for (;;) {
+		if (xSemaphoreTake(touch_change, TASK_TOUCH_RESYNC_MS / portTICK_RATE_MS) != pdTRUE) {
+			if (gpio_get_pin_value(PIN_TOUCH_nCHANGE)) continue;
+		}
+		
+		if (!task_touch_read(&all_keys)) continue;
+		
+		changed = all_keys.c ^ touch_keys;
+		touch_keys = all_keys.c;
+		
+		for (key = KEY_STOP; key <= KEY_PLAY_PAUSE; key++) {
+			if (!(changed & (1 << key))) continue;
+			
+			if (all_keys.c & (1 << key)) {
+				task_power_wake();
+				task_touch_pressed(key);
+			}
+		}
+	}
+}
+
+//! Sets up the CHANGE interrupt and creates the touch task
+void task_touch_start(void) {
+	
+	touch_keys = 0;
+	touch_stats.changes = 0;
+	touch_stats.reads = 0;
+	touch_stats.crc_errors = 0;
+	touch_stats.failures = 0;
+	
+	vSemaphoreCreateBinary(touch_change);
+	if (touch_change == NULL) rtos_mem_halt(RTOS_TASK_TOUCH);
+	xSemaphoreTake(touch_change, 0);
+	
+	gpio_configure_pin(PIN_TOUCH_nCHANGE, GPIO_DIR_INPUT | GPIO_PULL_UP);
+	irq_register_handler(task_touch_irq_handler, AVR32_GPIO_IRQ_0 + (PIN_TOUCH_nCHANGE / 8), TOUCH_INT_LEVEL);
+	
+	if (!rtos_mem_task_create(RTOS_TASK_TOUCH, task_touch)) rtos_mem_halt(RTOS_TASK_TOUCH);
+	
+	return;
+}
+
+//! Returns the last key states, bit n is key n
+uint16_t task_touch_get_keys(void) {
+	return touch_keys;
+}
+
+//! Copies the touch statistics
+void task_touch_get_stats(touch_stats_t *stats) {
+	
+	portENTER_CRITICAL();
+	stats->changes = touch_stats.changes;
+	stats->reads = touch_stats.reads;
+	stats->crc_errors = touch_stats.crc_errors;
+	stats->failures = touch_stats.failures;
+	portEXIT_CRITICAL();
+	
+	return;
+}
\ No newline at end of file
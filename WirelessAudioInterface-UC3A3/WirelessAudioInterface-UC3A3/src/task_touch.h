@@ -0,0 +1,31 @@
+/*
+ * task_touch.h
+ *
+ * Created: 4/25/2013 12:07:51 AM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TASK_TOUCH_H_
+#define TASK_TOUCH_H_
+
+#include "FreeRTOS.h"
+
+//! Network volume change per VOL_UP/VOL_DN press, dB
+#define TOUCH_VOLUME_STEP_DB	3
+
+//! CHANGE interrupt level, the same as the CC85xx event interrupt
+#define TOUCH_INT_LEVEL			0
+
+typedef struct {
+	uint32_t changes;		//CHANGE interrupts
+	uint32_t reads;			//Key reports read
+	uint32_t crc_errors;	//Reports read again because the CRC did not match
+	uint32_t failures;		//Reports still bad after the retry
+} touch_stats_t;
+
+extern void task_touch_start(void);
+extern uint16_t task_touch_get_keys(void);
+extern void task_touch_get_stats(touch_stats_t *stats);
+
+#endif /* TASK_TOUCH_H_ */
\ No newline at end of file
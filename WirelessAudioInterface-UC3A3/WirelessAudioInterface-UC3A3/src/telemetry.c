@@ -0,0 +1,287 @@
+/*
+ * telemetry.c
+ *
+ * Created: 5/11/2013 8:41:05 PM
+ *  Author: Eva
+ */ 
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "udi_cdc.h"
+#include "rtos_stats.h"
+#include "telemetry.h"
+
+//! Fails the build when a frame no longer fits the CDC buffer, it would never be sent
+typedef char telemetry_frame_check[(TELEMETRY_FRAME_BYTES <= UDI_CDC_FRAME_MAX) ? 1 : -1];
+
+//! One second per slot, TELEMETRY_NO_SAMPLE where there was none
+static uint16_t tm_seconds[TELEMETRY_SECONDS][TELEMETRY_METRICS];
+static telemetry_bucket_t tm_minutes[TELEMETRY_MINUTES];
+static telemetry_bucket_t tm_hours[TELEMETRY_HOURS];
+
+//! Minute and hour being filled, and the seconds or minutes they have seen so far
+static telemetry_bucket_t tm_acc[TELEMETRY_LEVELS - 1];
+static uint32_t tm_acc_length[TELEMETRY_LEVELS - 1];
+
+//! Buckets closed per level since power up, the sequence number of the next one
+static uint32_t tm_count[TELEMETRY_LEVELS];
+
+//! Buckets streamed per level, and the dump in progress (level TELEMETRY_LEVELS when idle)
+static uint32_t tm_sent[TELEMETRY_LEVELS];
+static uint32_t tm_dump_level = TELEMETRY_LEVELS;
+static uint32_t tm_dump_seq;
+static uint32_t tm_dump_end;
+
+//! Frames not sent because the CDC buffer was full or the port closed
+static uint32_t tm_dropped = 0;
+
+static uint8_t tm_frame[TELEMETRY_FRAME_BYTES];
+
+static const uint32_t tm_length[TELEMETRY_LEVELS] = {
+	TELEMETRY_SECONDS, TELEMETRY_MINUTES, TELEMETRY_HOURS
+};
+
+//! Sequence number of the oldest bucket still held at a level
+static uint32_t telemetry_oldest(uint32_t level) {
+	uint32_t count = tm_count[level];
+
+	return (count > tm_length[level]) ? count - tm_length[level] : 0;
+}
+
+//! Empties a bucket
+static void telemetry_clear(telemetry_bucket_t *bucket) {
+	uint32_t i;
+
+	bucket->samples = 0;
+	for (i = 0; i < TELEMETRY_METRICS; i++) {
+		bucket->stat[i].min = 0;
+		bucket->stat[i].max = 0;
+		bucket->stat[i].sum = 0;
+	}
+
+	return;
+}
+
+//! Adds a bucket to a longer one, empty buckets leave it as it is
+static void telemetry_merge(telemetry_bucket_t *dst, const telemetry_bucket_t *src) {
+	uint32_t i;
+
+	if (!src->samples) return;
+
+	for (i = 0; i < TELEMETRY_METRICS; i++) {
+		if (!dst->samples || src->stat[i].min < dst->stat[i].min) dst->stat[i].min = src->stat[i].min;
+		if (!dst->samples || src->stat[i].max > dst->stat[i].max) dst->stat[i].max = src->stat[i].max;
+		dst->stat[i].sum += src->stat[i].sum;
+	}
+	dst->samples += src->samples;
+
+	return;
+}
+
+//! Makes a one second bucket from a slot of the seconds ring
+static void telemetry_second(uint32_t slot, telemetry_bucket_t *bucket) {
+	uint32_t i;
+
+	telemetry_clear(bucket);
+	if (tm_seconds[slot][0] == TELEMETRY_NO_SAMPLE) return;
+
+	bucket->samples = 1;
+	for (i = 0; i < TELEMETRY_METRICS; i++) {
+		bucket->stat[i].min = tm_seconds[slot][i];
+		bucket->stat[i].max = tm_seconds[slot][i];
+		bucket->stat[i].sum = tm_seconds[slot][i];
+	}
+
+	return;
+}
+
+//! Records one sample interval, from the EHIF task every TELEMETRY_SAMPLE_MS
+/*!
+	\param rates TELEMETRY_METRICS rates, up to TELEMETRY_RATE_MAX, or NULL if the
+	interval has no sample. Either way the interval takes its place in the rings,
+	so bucket sequence numbers stay a measure of time.
+*/
+void telemetry_add(const uint16_t *rates) {
+	telemetry_bucket_t second;
+	uint32_t slot;
+	uint32_t i;
+
+	portENTER_CRITICAL();
+
+	slot = tm_count[TELEMETRY_LEVEL_SECOND] % TELEMETRY_SECONDS;
+	for (i = 0; i < TELEMETRY_METRICS; i++) {
+		tm_seconds[slot][i] = rates ? rates[i] : TELEMETRY_NO_SAMPLE;
+	}
+	tm_count[TELEMETRY_LEVEL_SECOND]++;
+
+	telemetry_second(slot, &second);
+	telemetry_merge(&tm_acc[0], &second);
+
+	if (++tm_acc_length[0] >= TELEMETRY_SECONDS) {
+		tm_minutes[tm_count[TELEMETRY_LEVEL_MINUTE] % TELEMETRY_MINUTES] = tm_acc[0];
+		tm_count[TELEMETRY_LEVEL_MINUTE]++;
+		telemetry_merge(&tm_acc[1], &tm_acc[0]);
+		telemetry_clear(&tm_acc[0]);
+		tm_acc_length[0] = 0;
+
+		if (++tm_acc_length[1] >= TELEMETRY_MINUTES) {
+			tm_hours[tm_count[TELEMETRY_LEVEL_HOUR] % TELEMETRY_HOURS] = tm_acc[1];
+			tm_count[TELEMETRY_LEVEL_HOUR]++;
+			telemetry_clear(&tm_acc[1]);
+			tm_acc_length[1] = 0;
+		}
+	}
+
+	portEXIT_CRITICAL();
+
+	return;
+}
+
+//! Copies a closed bucket
+/*!
+	\param level TELEMETRY_LEVEL_xxx
+	\param seq bucket sequence number
+	\return false if the bucket is not closed yet or has been overwritten
+*/
+bool telemetry_get(uint32_t level, uint32_t seq, telemetry_bucket_t *bucket) {
+	bool held;
+
+	if (level >= TELEMETRY_LEVELS) return false;
+
+	portENTER_CRITICAL();
+	held = (seq >= telemetry_oldest(level)) && (seq < tm_count[level]);
+	if (held) {
+		if (level == TELEMETRY_LEVEL_SECOND) telemetry_second(seq % TELEMETRY_SECONDS, bucket);
+		else if (level == TELEMETRY_LEVEL_MINUTE) *bucket = tm_minutes[seq % TELEMETRY_MINUTES];
+		else *bucket = tm_hours[seq % TELEMETRY_HOURS];
+	}
+	portEXIT_CRITICAL();
+
+	return held;
+}
+
+//! Writes a big endian field into the frame
+static uint8_t *telemetry_put(uint8_t *p, uint32_t value, uint32_t bytes) {
+
+	while (bytes--) {
+		*p++ = value >> (8 * bytes);
+	}
+
+	return p;
+}
+
+//! Sends one bucket over CDC
+/*!
+	\param level TELEMETRY_LEVEL_xxx, with TELEMETRY_FRAME_DUMP if part of a dump
+	\return false if there was no room for the frame
+*/
+static bool telemetry_send(uint32_t level, uint32_t seq, const telemetry_bucket_t *bucket) {
+	uint32_t i;
+	uint8_t *p;
+	uint8_t sum = 0;
+
+	if (udi_cdc_get_free_tx_buffer() < TELEMETRY_FRAME_BYTES) return false;
+
+	p = tm_frame;
+	*p++ = RTOS_STATS_SYNC0;
+	*p++ = RTOS_STATS_SYNC1;
+	*p++ = TELEMETRY_FRAME_BUCKET;
+	*p++ = TELEMETRY_PAYLOAD;
+	*p++ = level;
+	p = telemetry_put(p, seq, 4);
+	p = telemetry_put(p, bucket->samples, 2);
+
+	for (i = 0; i < TELEMETRY_METRICS; i++) {
+		p = telemetry_put(p, bucket->stat[i].min, 2);
+		p = telemetry_put(p, bucket->stat[i].max, 2);
+		p = telemetry_put(p, bucket->stat[i].sum, 4);
+	}
+
+	for (i = 2; i < TELEMETRY_FRAME_BYTES - 1; i++) {
+		sum += tm_frame[i];
+	}
+	*p = -sum;
+
+	udi_cdc_write_buf(tm_frame, TELEMETRY_FRAME_BYTES);
+
+	return true;
+}
+
+//! Sends the next few buckets of the dump in progress
+static void telemetry_dump(void) {
+	telemetry_bucket_t bucket;
+	uint32_t frames = 0;
+
+	while (tm_dump_level < TELEMETRY_LEVELS && frames < TELEMETRY_DUMP_FRAMES) {
+		if (tm_dump_seq >= tm_dump_end) {
+			if (++tm_dump_level >= TELEMETRY_LEVELS) break;
+			tm_dump_seq = telemetry_oldest(tm_dump_level);
+			tm_dump_end = tm_count[tm_dump_level];
+			continue;
+		}
+
+		// Overwritten since the dump started, carry on from the oldest one left
+		if (!telemetry_get(tm_dump_level, tm_dump_seq, &bucket)) {
+			tm_dump_seq = telemetry_oldest(tm_dump_level);
+			continue;
+		}
+
+		// Wait for the host rather than leave gaps in the history
+		if (!telemetry_send(tm_dump_level | TELEMETRY_FRAME_DUMP, tm_dump_seq, &bucket)) break;
+
+		tm_dump_seq++;
+		frames++;
+	}
+
+	return;
+}
+
+//! Streams the buckets closed since the last call and serves dump commands
+/*!
+	Run from the LED task every TASK_LEDS_PERIOD_MS, which keeps all CDC writes in one
+	task. Streamed buckets are dropped when the host does not keep up, the history is
+	still there for a dump. A dump started while one is running starts over.
+*/
+void telemetry_report(void) {
+	telemetry_bucket_t bucket;
+	uint32_t level;
+	uint32_t oldest;
+
+	while (udi_cdc_is_rx_ready()) {
+		if (udi_cdc_getc() == TELEMETRY_CMD_DUMP) {
+			tm_dump_level = TELEMETRY_LEVEL_SECOND;
+			tm_dump_seq = telemetry_oldest(TELEMETRY_LEVEL_SECOND);
+			tm_dump_end = tm_count[TELEMETRY_LEVEL_SECOND];
+		}
+	}
+
+	for (level = 0; level < TELEMETRY_LEVELS; level++) {
+		oldest = telemetry_oldest(level);
+		if (tm_sent[level] < oldest) {
+			tm_dropped += oldest - tm_sent[level];
+			tm_sent[level] = oldest;
+		}
+
+		while (tm_sent[level] < tm_count[level]) {
+			if (telemetry_get(level, tm_sent[level], &bucket) && !telemetry_send(level, tm_sent[level], &bucket)) {
+				tm_dropped++;
+			}
+			tm_sent[level]++;
+		}
+	}
+
+	telemetry_dump();
+
+	return;
+}
+
+//! Returns the number of buckets closed at a level since power up
+uint32_t telemetry_get_count(uint32_t level) {
+	return tm_count[level];
+}
+
+//! Returns the number of streamed frames dropped because CDC was not ready
+uint32_t telemetry_get_dropped(void) {
+	return tm_dropped;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+ * telemetry.h
+ *
+ * Created: 5/11/2013 8:41:17 PM
+ *  Author: Eva
+ */ 
+
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "compiler.h"
+
+//! Metrics, all rates derived from PS_AUDIO_STATS and PS_RF_STATS over the sample interval
+#define TELEMETRY_CONCEAL		0	//concealed samples per second
+#define TELEMETRY_MUTED			1	//muted samples per second
+#define TELEMETRY_PKT_FAIL		2	//failed packets per second
+#define TELEMETRY_PER			3	//packet error rate, 1/10000
+#define TELEMETRY_SLICE_ERR		4	//slices with errors per second
+#define TELEMETRY_AFH_SWAP		5	//AFH channel swaps per second
+#define TELEMETRY_METRICS		6
+
+//! Largest rate, 0xFFFF marks a second without a sample
+#define TELEMETRY_RATE_MAX		0xFFFE
+#define TELEMETRY_NO_SAMPLE		0xFFFF
+
+//! Sample interval and ring lengths: a minute of seconds, an hour of minutes, a day of hours
+#define TELEMETRY_SAMPLE_MS		1000
+#define TELEMETRY_SECONDS		60
+#define TELEMETRY_MINUTES		60
+#define TELEMETRY_HOURS			24
+
+//! Levels, bucket n of a level covers buckets 60n to 60n+59 of the one below
+#define TELEMETRY_LEVEL_SECOND	0
+#define TELEMETRY_LEVEL_MINUTE	1
+#define TELEMETRY_LEVEL_HOUR	2
+#define TELEMETRY_LEVELS		3
+
+//! Host command byte on CDC: send every bucket still held, oldest first, seconds to hours
+#define TELEMETRY_CMD_DUMP		'D'
+
+/*
+	Frame sent over CDC for each bucket, multi-byte fields big endian, framed as the
+	rtos_stats frames so one reader handles both:
+
+	[0]		RTOS_STATS_SYNC0
+	[1]		RTOS_STATS_SYNC1
+	[2]		TELEMETRY_FRAME_BUCKET
+	[3]		payload length
+	[4]		level, TELEMETRY_FRAME_DUMP set if sent for a dump command
+	[5]		bucket sequence number since power up (4 bytes)
+	[9]		seconds sampled in the bucket (2)
+	[11]	TELEMETRY_METRICS times:
+				min (2), max (2), sum (4), the average is sum / seconds sampled
+	[end]	checksum: the two's complement of the sum of bytes [2] to [end-1]
+
+	Buckets are streamed as they close. Seconds without a sample (CC8530 not active,
+	EHIF busy) count towards the bucket length but not towards seconds sampled.
+*/
+#define TELEMETRY_FRAME_BUCKET	0x42
+#define TELEMETRY_FRAME_DUMP	0x80
+#define TELEMETRY_PAYLOAD		(7 + TELEMETRY_METRICS * 8)
+#define TELEMETRY_FRAME_BYTES	(4 + TELEMETRY_PAYLOAD + 1)
+
+//! Frames sent per telemetry_report call while dumping
+#define TELEMETRY_DUMP_FRAMES	4
+
+typedef struct {
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;
+} telemetry_stat_t;
+
+typedef struct {
+	uint16_t samples;
+	telemetry_stat_t stat[TELEMETRY_METRICS];
+} telemetry_bucket_t;
+
+//! Static memory of the store, for rtos_mem
+#define TELEMETRY_MEM_BYTES		(TELEMETRY_SECONDS * TELEMETRY_METRICS * sizeof(uint16_t) \
+								+ (TELEMETRY_MINUTES + TELEMETRY_HOURS + 2) * sizeof(telemetry_bucket_t) \
+								+ TELEMETRY_FRAME_BYTES)
+
+extern void telemetry_add(const uint16_t *rates);
+extern void telemetry_report(void);
+extern bool telemetry_get(uint32_t level, uint32_t seq, telemetry_bucket_t *bucket);
+extern uint32_t telemetry_get_count(uint32_t level);
+extern uint32_t telemetry_get_dropped(void);
+
+#endif /* TELEMETRY_H_ */
\ No newline at end of file
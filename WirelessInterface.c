@@ -91,6 +91,7 @@ D0	D1	D2	Status	Limit
 
 static bool bCC8531Programmed = false;	//Was CC8531 already programmed?
 static bool bMaster;
+static unsigned long nVolumeTick;	//millis() of the next CODEC.volumeTick()
 
 ////////////////////////////////////////
 // Functions
@@ -185,7 +186,10 @@ void setup() {
 ////////////////////////////////////////
 
 void loop() {
-	
-
+	//Runs the driver gain ramp, CODEC.rampDriverVolume() only sets where it goes
+	if (USE_CODEC && (long)(millis() - nVolumeTick) >= 0) {
+		nVolumeTick = millis() + CODEC_VOLUME_TICK_MS;
+		CODEC.volumeTick();
+	}
 }
 
@@ -25,6 +25,51 @@ EHIF_CMD_DATA_T  ehifCmdData;
 
 // Converts from volume in whole dB's to the resolution used by CC85XX
 #define DB_TO_VOL(x)                (((int16_t) (x)) << 3)
+// Largest volume change sent per 10 ms main loop pass
+#define VOLUME_RAMP_STEP            DB_TO_VOL(1)
+
+// Network monitor: NWM_GET_STATUS is only read when the EHIF interrupt signals a network change (or an
+// SPI error), and otherwise once per fallback interval in case an event was missed
+#define NWK_FALLBACK_INTERVAL       1000        // 10 ms passes = 10 seconds
+#define NWK_EVENT_MASK              (BV_EHIF_EVT_NWK_CHG | BV_EHIF_EVT_SPI_ERROR)
+#define NWK_SLOT_NONE               0xFF
+
+// Network monitor events, the differences between two reads
+#define NWK_EVT_JOIN                0
+#define NWK_EVT_LEAVE               1
+#define NWK_EVT_ACH                 2           // Audio channel usage of the slave changed
+#define NWK_EVT_QUEUE_SIZE          8           // Power of two
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  spSlot;                            // WPS slave slot (1-7)
+    uint16_t bvAch;                             // Audio channels used by the slave after the event
+    uint32_t devId;
+} NWK_EVT_T;
+
+// Network status from the last read, compared with the next one
+EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T nwkCache;
+uint16_t nwkFallbackLeft;
+
+// Events not yet fetched with nwkEventGet(). Events that do not fit are counted and dropped
+NWK_EVT_T pNwkEvtQueue[NWK_EVT_QUEUE_SIZE];
+uint8_t nwkEvtHead;
+uint8_t nwkEvtTail;
+uint16_t nwkEvtDropped;
+
+// Remote control: the status word has no event for new RC data, so RC_GET_DATA is only read for the
+// slaves the network monitor lists, one slave per poll interval, and only changes are acted upon. With
+// the default and three slaves each one is read every 300 ms, which is still quick for volume buttons
+#ifndef RC_POLL_INTERVAL
+#define RC_POLL_INTERVAL            10          // 10 ms passes = 100 ms
+#endif
+#define RC_SLOT_COUNT               8           // WPS slave slots are 1-7
+
+// Last RC_GET_DATA per slave slot, the next slave to read (index into nwkCache.pWpsInfo[]) and the
+// passes left until that read
+EHIF_CMD_RC_GET_DATA_DATA_T pRcCache[RC_SLOT_COUNT];
+uint8_t rcNext;
+uint8_t rcPollLeft;
 
 
 
@@ -56,12 +101,284 @@ uint8_t pollButtons(void) {
 
 
 
+void nwkEventPut(uint8_t type, uint8_t spSlot, uint16_t bvAch, uint32_t devId) {
+    NWK_EVT_T* pEvt;
+
+    if ((uint8_t) (nwkEvtHead - nwkEvtTail) == NWK_EVT_QUEUE_SIZE) {
+        nwkEvtDropped++;
+        return;
+    }
+    pEvt = &pNwkEvtQueue[nwkEvtHead++ & (NWK_EVT_QUEUE_SIZE - 1)];
+    pEvt->type   = type;
+    pEvt->spSlot = spSlot;
+    pEvt->bvAch  = bvAch;
+    pEvt->devId  = devId;
+} // nwkEventPut
+
+
+
+
+// Fetches the oldest network event. Returns 0 if there is none
+uint8_t nwkEventGet(NWK_EVT_T* pEvt) {
+    if (nwkEvtHead == nwkEvtTail) {
+        return 0;
+    }
+    *pEvt = pNwkEvtQueue[nwkEvtTail++ & (NWK_EVT_QUEUE_SIZE - 1)];
+    return 1;
+} // nwkEventGet
+
+
+
+
+// Returns the index of the slave with the given device ID, or NWK_SLOT_NONE
+uint8_t nwkFind(const EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T* pStatus, uint32_t devId) {
+    uint8_t n;
+    for (n = 0; n < pStatus->wpsCount; n++) {
+        if (pStatus->pWpsInfo[n].devId == devId) {
+            return n;
+        }
+    }
+    return NWK_SLOT_NONE;
+} // nwkFind
+
+
+
+
+// Compares the status in ehifCmdData with the cached one, queues an event for each difference and
+// updates the cache. Slaves are matched by device ID, as they need not keep their position in the list
+void nwkDiff(void) {
+    EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T* pNew = &ehifCmdData.nwmGetStatusMaster;
+    uint8_t n, m;
+
+    if (pNew->wpsCount > 6) pNew->wpsCount = 6;
+
+    // Slaves that have left or changed their audio channel usage
+    for (n = 0; n < nwkCache.wpsCount; n++) {
+        m = nwkFind(pNew, nwkCache.pWpsInfo[n].devId);
+        if (m == NWK_SLOT_NONE) {
+            nwkEventPut(NWK_EVT_LEAVE, nwkCache.pWpsInfo[n].spSlot, 0x0000, nwkCache.pWpsInfo[n].devId);
+        } else if (pNew->pWpsInfo[m].bvAchUsedByWps != nwkCache.pWpsInfo[n].bvAchUsedByWps) {
+            nwkEventPut(NWK_EVT_ACH, pNew->pWpsInfo[m].spSlot, pNew->pWpsInfo[m].bvAchUsedByWps, pNew->pWpsInfo[m].devId);
+        }
+    }
+
+    // Slaves that have joined
+    for (m = 0; m < pNew->wpsCount; m++) {
+        if (nwkFind(&nwkCache, pNew->pWpsInfo[m].devId) == NWK_SLOT_NONE) {
+            nwkEventPut(NWK_EVT_JOIN, pNew->pWpsInfo[m].spSlot, pNew->pWpsInfo[m].bvAchUsedByWps, pNew->pWpsInfo[m].devId);
+        }
+    }
+
+    memcpy(&nwkCache, pNew, sizeof(nwkCache));
+} // nwkDiff
+
+
+
+
+// Forgets all slaves, publishing a leave event for each. Call when the CC85XX is reset or powered down
+void nwkClear(void) {
+    memset(&ehifCmdData.nwmGetStatusMaster, 0x00, sizeof(EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T));
+    nwkDiff();
+} // nwkClear
+
+
+
+
+// Starts monitoring after network maintenance has been enabled. The event mask is lost on every reset
+void nwkStart(void) {
+    initParam();
+    ehifCmdParam.ehcEvtClr.clearedEvents = NWK_EVENT_MASK;
+    ehifCmdExec(EHIF_CMD_EHC_EVT_CLR, sizeof(EHIF_CMD_EHC_EVT_CLR_PARAM_T), &ehifCmdParam);
+    initParam();
+    ehifCmdParam.ehcEvtMask.irqGioLevel = 0;
+    ehifCmdParam.ehcEvtMask.eventFilter = NWK_EVENT_MASK;
+    ehifCmdExec(EHIF_CMD_EHC_EVT_MASK, sizeof(EHIF_CMD_EHC_EVT_MASK_PARAM_T), &ehifCmdParam);
+
+    // Read the initial status on the next pass
+    nwkFallbackLeft = 1;
+} // nwkStart
+
+
+
+
+// Runs the network monitor, once per 10 ms pass. Without an interrupt the only EHIF traffic is one read
+// per fallback interval. Returns 1 if the CC85XX is in an unknown state and must be restarted
+uint8_t nwkPoll(void) {
+    uint16_t readbcLength;
+    uint16_t status;
+
+    // Timeouts of earlier operations are recorded without any SPI access
+    if (ehifGetWaitReadyError()) {
+        return 1;
+    }
+
+    if (nwkFallbackLeft) nwkFallbackLeft--;
+    if (!EHIF_INTERRUPT_IS_ACTIVE() && nwkFallbackLeft) {
+        return 0;
+    }
+    nwkFallbackLeft = NWK_FALLBACK_INTERVAL;
+
+    // Clear the event first, so that a change during the read raises the interrupt again
+    initParam();
+    ehifCmdParam.ehcEvtClr.clearedEvents = BV_EHIF_EVT_NWK_CHG;
+    ehifCmdExec(EHIF_CMD_EHC_EVT_CLR, sizeof(EHIF_CMD_EHC_EVT_CLR_PARAM_T), &ehifCmdParam);
+
+    // The length depends on the number of slaves, so clear what may not be written
+    memset(&ehifCmdData.nwmGetStatusMaster, 0x00, sizeof(EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T));
+    readbcLength = sizeof(EHIF_CMD_NWM_GET_STATUS_MASTER_DATA_T);
+    ehifCmdExecWithReadbc(EHIF_EXEC_ALL, EHIF_CMD_NWM_GET_STATUS_M, 0, NULL, &readbcLength, &ehifCmdData.nwmGetStatusMaster);
+
+    // No timeouts or SPI errors shall have occurred, and NWM_GET_STATUS should indicate that we're active
+    status = ehifGetStatus();
+    if (ehifGetWaitReadyError() || (status & BV_EHIF_EVT_SPI_ERROR) || (ehifCmdData.nwmGetStatusMaster.nwkState == 0)) {
+        return 1;
+    }
+
+    nwkDiff();
+    return 0;
+} // nwkPoll
+
+
+
+
+// Shows a network event on LCD lines 6 and 7: the slave count and "<J|L|A> <device ID> <channels>"
+void nwkPrintEvent(const NWK_EVT_T* pEvt) {
+    static const char pHex[] = "0123456789ABCDEF";
+    char pText[18];
+    uint8_t n;
+
+    memset(pText, ' ', 17);
+    pText[17] = 0;
+    memcpy(pText, "Slaves:", 7);
+    pText[8] = '0' + nwkCache.wpsCount;
+    halLcdPrintLine(pText, 6, OVERWRITE_TEXT );
+
+    memset(pText, ' ', 17);
+    pText[0] = "JLA"[pEvt->type];
+    for (n = 0; n < 8; n++) {
+        pText[2 + n] = pHex[(pEvt->devId >> (28 - 4 * n)) & 0x0F];
+    }
+    for (n = 0; n < 4; n++) {
+        pText[11 + n] = pHex[(pEvt->bvAch >> (12 - 4 * n)) & 0x0F];
+    }
+    halLcdPrintLine(pText, 7, OVERWRITE_TEXT );
+} // nwkPrintEvent
+
+
+
+
+// Forgets the remote control state of a slave slot, so that its next report counts as new
+void rcClear(uint8_t spSlot) {
+    memset(&pRcCache[spSlot & (RC_SLOT_COUNT - 1)], 0x00, sizeof(EHIF_CMD_RC_GET_DATA_DATA_T));
+} // rcClear
+
+
+
+
+// Returns whether a proprietary command code is active in the given RC data
+uint8_t rcHasCmd(const EHIF_CMD_RC_GET_DATA_DATA_T* pData, uint8_t cmd) {
+    uint8_t n;
+    for (n = pData->rcKeyCount; (n < pData->rcKeyCount + pData->rcCmdCount) && (n < sizeof(pData->pRcCmds)); n++) {
+        if (pData->pRcCmds[n] == cmd) return 1;
+    }
+    return 0;
+} // rcHasCmd
+
+
+
+
+// Shows remote control data on LCD line 8: "<slot> <first command> <mouse X> <mouse Y> <buttons>"
+void rcPrint(uint8_t spSlot, const EHIF_CMD_RC_GET_DATA_DATA_T* pData) {
+    static const char pHex[] = "0123456789ABCDEF";
+    char pText[18];
+    uint8_t n;
+
+    memset(pText, ' ', 17);
+    pText[17] = 0;
+    pText[0] = '0' + spSlot;
+    if (pData->rcCmdCount && (pData->rcKeyCount < sizeof(pData->pRcCmds))) {
+        pText[2] = pHex[pData->pRcCmds[pData->rcKeyCount] >> 4];
+        pText[3] = pHex[pData->pRcCmds[pData->rcKeyCount] & 0x0F];
+    } else {
+        pText[2] = '-';
+        pText[3] = '-';
+    }
+    if (pData->extSel == 1) {
+        for (n = 0; n < 4; n++) {
+            pText[5 + n] = pHex[(pData->mousePosX >> (12 - 4 * n)) & 0x0F];
+            pText[10 + n] = pHex[(pData->mousePosY >> (12 - 4 * n)) & 0x0F];
+        }
+        pText[15] = pHex[pData->bvMouseButtons & 0x0F];
+    }
+    halLcdPrintLine(pText, 8, OVERWRITE_TEXT );
+} // rcPrint
+
+
+
+
+// Reads the remote control data of the next slave once per RC_POLL_INTERVAL and acts on what changed:
+// volume commands move the target volume the same way as the buttons, and mute toggles directly
+void rcPoll(int16_t* pVolume) {
+    EHIF_CMD_RC_GET_DATA_DATA_T* pNew = &ehifCmdData.rcGetData;
+    EHIF_CMD_RC_GET_DATA_DATA_T* pOld;
+    uint8_t spSlot;
+    uint8_t n;
+
+    if (nwkCache.wpsCount == 0) {
+        return;
+    }
+    if (rcPollLeft) rcPollLeft--;
+    if (rcPollLeft) {
+        return;
+    }
+    rcPollLeft = RC_POLL_INTERVAL;
+
+    if (rcNext >= nwkCache.wpsCount) {
+        rcNext = 0;
+    }
+    spSlot = nwkCache.pWpsInfo[rcNext++].spSlot;
+
+    initParam();
+    ehifCmdParam.rcGetData.spSlot = spSlot;
+    ehifCmdExecWithRead(EHIF_EXEC_ALL, EHIF_CMD_RC_GET_DATA,
+                        sizeof(EHIF_CMD_RC_GET_DATA_PARAM_T), &ehifCmdParam,
+                        sizeof(EHIF_CMD_RC_GET_DATA_DATA_T), &ehifCmdData);
+
+    pOld = &pRcCache[spSlot & (RC_SLOT_COUNT - 1)];
+    if (memcmp(pNew, pOld, sizeof(EHIF_CMD_RC_GET_DATA_DATA_T)) == 0) {
+        return;
+    }
+
+    // Commands act once, when they first appear
+    for (n = pNew->rcKeyCount; (n < pNew->rcKeyCount + pNew->rcCmdCount) && (n < sizeof(pNew->pRcCmds)); n++) {
+        if (rcHasCmd(pOld, pNew->pRcCmds[n])) continue;
+        switch (pNew->pRcCmds[n]) {
+        case EHIF_RC_CMD_OUT_VOL_INCR:
+            *pVolume += DB_TO_VOL(3);
+            break;
+        case EHIF_RC_CMD_OUT_VOL_DECR:
+            *pVolume -= DB_TO_VOL(3);
+            break;
+        case EHIF_RC_CMD_OUT_VOL_MUTE_TOGGLE:
+            initParam();
+            ehifCmdParam.vcSetVolume.muteOp = 3; // Toggle
+            ehifCmdExec(EHIF_CMD_VC_SET_VOLUME, sizeof(EHIF_CMD_VC_SET_VOLUME_PARAM_T), &ehifCmdParam);
+            break;
+        }
+    }
+
+    memcpy(pOld, pNew, sizeof(EHIF_CMD_RC_GET_DATA_DATA_T));
+    rcPrint(spSlot, pOld);
+} // rcPoll
+
+
+
+
 int main(void) {
     uint8_t  currState;
     uint8_t  targetState;
-    uint16_t readbcLength;
-    uint8_t  errorCheckInterval = 100;
     uint16_t pairingDurationLeft = 0;
+    NWK_EVT_T nwkEvt;
 
     // Stop watchdog timer to prevent time out reset
     WDTCTL = WDTPW + WDTHOLD;
@@ -96,14 +413,15 @@ int main(void) {
     targetState = CC85XX_STATE_ACTIVE;
 
     // Get the initial volume setting from non-volatile storage
-    // The difference between currVolume and prevVolume will trigger an update below
+    // volumeSync makes the update below jump straight to it
     initParam();
     ehifCmdParam.nvsGetData.index = 0;
     ehifCmdExecWithRead(EHIF_EXEC_ALL, EHIF_CMD_NVS_GET_DATA, 
                         sizeof(EHIF_CMD_NVS_GET_DATA_PARAM_T), &ehifCmdParam, 
                         sizeof(EHIF_CMD_NVS_GET_DATA_DATA_T), &ehifCmdData);
     int16_t currVolume = (int16_t) ((uint16_t) ehifCmdData.nvsGetData.data);
-    int16_t prevVolume = ~currVolume;
+    int16_t prevVolume = currVolume;
+    bool volumeSync = true;
 
     // Main loop
     while (1) {
@@ -148,13 +466,13 @@ int main(void) {
 
         // VOLUME DOWN
         case BUTTON_DOWN:
-            // Change the target volume by -3 dB and let the update procedure below handle it
+            // Change the target volume by -3 dB and let the update procedure below ramp to it
             currVolume -= DB_TO_VOL(3);
             break;
 
         // VOLUME UP
         case BUTTON_UP:
-            // Change the target volume by +3 dB and let the update procedure below handle it
+            // Change the target volume by +3 dB and let the update procedure below ramp to it
             currVolume += DB_TO_VOL(3);
             break;
         }
@@ -175,6 +493,7 @@ int main(void) {
                 // Ensure known state (power state 5)
                 ehifSysResetPin(true);
                 currState = CC85XX_STATE_INACTIVE;
+                nwkClear();
 
                 // Save the current volume setting to non-volatile storage
                 initParam();
@@ -196,9 +515,10 @@ int main(void) {
                 ehifCmdParam.nwmControlEnable.wmEnable = 1;
                 ehifCmdExec(EHIF_CMD_NWM_CONTROL_ENABLE, sizeof(EHIF_CMD_NWM_CONTROL_ENABLE_PARAM_T), &ehifCmdParam);
                 currState = CC85XX_STATE_ACTIVE;
+                nwkStart();
 
                 // Trigger volume update
-                prevVolume = ~currVolume;
+                volumeSync = true;
             }
 
         } else {
@@ -207,38 +527,48 @@ int main(void) {
             // handle the ACTIVE state.
             if (currState == CC85XX_STATE_ACTIVE) {
 
-                // Perform error checking at 10 ms * 100 = 1 second intervals:
-                // - No timeouts or SPI errors shall have occurred
-                // - NWM_GET_STATUS should indicate that we're active
-                if (--errorCheckInterval == 0) {
-                    errorCheckInterval = 100;
-
-                    // Get the network status, which is the first byte
-                    uint8_t nwkStatus;
-                    readbcLength = 1;
-                    ehifCmdExecWithReadbc(EHIF_EXEC_ALL, EHIF_CMD_NWM_GET_STATUS_M, 0, NULL, &readbcLength, &nwkStatus);
+                // Follow the network and check for errors. NWM_GET_STATUS is read on network change
+                // and SPI error events, and at the slow fallback interval
+                if (nwkPoll()) {
 
-                    // Check for errors
-                    uint16_t status = ehifGetStatus();
-                    if (ehifGetWaitReadyError() || (status & BV_EHIF_EVT_SPI_ERROR) || (nwkStatus == 0)) {
+                    // The device is in an unknown state -> restart everything
+                    ehifSysResetPin(true);
+                    currState = CC85XX_STATE_INACTIVE;
+                    nwkClear();
+                }
 
-                        // The device is in an unknown state -> restart everything
-                        ehifSysResetPin(true);
-                        currState = CC85XX_STATE_INACTIVE;
+                // Only redraw what has changed. Slaves that join or leave start with no remote control state
+                while (nwkEventGet(&nwkEvt)) {
+                    nwkPrintEvent(&nwkEvt);
+                    if (nwkEvt.type != NWK_EVT_ACH) {
+                        rcClear(nwkEvt.spSlot);
                     }
                 }
 
+                // Remote control from the slaves
+                rcPoll(&currVolume);
+
                 // Limit the new volume setting to range -51 dB to 0 dB (-51 is 1 dB below minimum volume
                 // of -50 dB, causing soft-muting, and is also a multiple of 3 dB, which is the used
                 // increment size)
-                if (currVolume < DB_TO_VOL(-51)) currVolume = -51;
-                if (currVolume > DB_TO_VOL(0)) currVolume = 0;
+                if (currVolume < DB_TO_VOL(-51)) currVolume = DB_TO_VOL(-51);
+                if (currVolume > DB_TO_VOL(0)) currVolume = DB_TO_VOL(0);
+
+                // Update the remote volume control if needed. Button presses only move currVolume,
+                // prevVolume follows it by at most VOLUME_RAMP_STEP per 10 ms pass, so a 3 dB press
+                // becomes a short ramp and several quick presses become one
+                int16_t volumeStep = currVolume - prevVolume;
+                if (volumeSync || volumeStep) {
+                    if (!volumeSync) {
+                        if (volumeStep > VOLUME_RAMP_STEP) volumeStep = VOLUME_RAMP_STEP;
+                        if (volumeStep < -VOLUME_RAMP_STEP) volumeStep = -VOLUME_RAMP_STEP;
+                    }
+                    prevVolume += volumeStep;
+                    volumeSync = false;
 
-                // Update the remote volume control if needed
-                if (currVolume != prevVolume) {
                     initParam();
                     ehifCmdParam.vcSetVolume.setOp = 1; // Absolute
-                    ehifCmdParam.vcSetVolume.value = currVolume;
+                    ehifCmdParam.vcSetVolume.value = prevVolume;
                     ehifCmdExec(EHIF_CMD_VC_SET_VOLUME, sizeof(EHIF_CMD_VC_SET_VOLUME_PARAM_T), &ehifCmdParam);
                 }
                 
@@ -11,6 +11,7 @@
 #include "hal_lcd.h"
 #include "hal_int.h"
 #include "hal_buttons.h"
+#include "rc_encoder.h"
 
 
 // Shared parameter/data memory for most EHIF commands (to save RAM and avoid using stack)
@@ -20,13 +21,10 @@ EHIF_CMD_DATA_T  ehifCmdData;
 // Scan data (not included in EHIF_CMD_DATA_T due to size)
 EHIF_CMD_NWM_DO_SCAN_DATA_T ehifNwmDoScanData;
 
-// Have the remote control data in a separate variable because mouse operation depends on previous values
-EHIF_CMD_RC_SET_DATA_PARAM_T ehifRcSetDataParam;
 
-
-// User interface functions
+// User interface functions. They feed the remote control encoder, which keeps the state between reports
 void uifLcdPrintJoystickInfo(void);
-uint8_t uifPollFunc(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam);
+void uifPoll(void);
 
 
 // CC85XX states
@@ -35,6 +33,62 @@ uint8_t uifPollFunc(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam);
 #define CC85XX_STATE_PAIRING        2
 #define CC85XX_STATE_ACTIVE         3
 
+// Connection manager stages, tried in this order until one of them connects
+#define CONN_STAGE_JOIN             0   // Join the cached network ID directly
+#define CONN_STAGE_SCAN             1   // Short scan for a master of the cached product, then join it
+#define CONN_STAGE_PAIR             2   // Full scan for a master signalling pairing, then join it
+#define CONN_STAGE_COUNT            3
+#define CONN_STAGE_DONE             0xFF
+
+// Steps within a stage
+#define CONN_STEP_START             0
+#define CONN_STEP_SCANNING          1
+#define CONN_STEP_JOINING           2
+
+// Operation timeouts, in units of 10 ms
+#define CONN_JOIN_TO                30
+#define CONN_SCAN_TO                100
+#define CONN_PAIR_TO                1000
+
+// Scan stage filters. The manufacturer ID is our own, the product ID comes from the last paired master
+#define CONN_MFCT_ID                0x00000000  // 0 = any manufacturer
+#define CONN_PROD_ID_MASK           0xFFFFFFFF
+#define CONN_SCAN_RSSI              -70         // dBm, only masters close by
+
+// CC85XX non-volatile storage slots
+#define NVS_INDEX_NWK_ID            0
+#define NVS_INDEX_PROD_ID           1
+
+// Illegal network IDs that may occur first time after programming are replaced by this
+#define NWK_ID_NONE                 0xFFFFFFFE
+
+// Connection timing, TA1 runs from ACLK / 64 = 512 Hz and wraps after 128 seconds
+#define CONN_TIMER_HZ               512
+#define CONN_TIMER_TO_MS(x)         (((uint32_t) (x) * 125) / (CONN_TIMER_HZ / 8))
+
+// Timing of the last connection attempt, from power-on, reset or link loss. Read with the debugger or
+// on LCD line 1
+typedef struct {
+    uint32_t pStageMs[CONN_STAGE_COUNT];   // Time spent in each stage
+    uint32_t connectMs;                    // Start to connected
+    uint32_t audioMs;                      // Start to audio channels subscribed
+    uint8_t  connectStage;                 // Stage that connected
+    uint8_t  rounds;                       // Number of times all stages failed
+} CONN_TIMING_T;
+
+CONN_TIMING_T connTiming;
+
+// Connection manager state
+uint8_t  connStage = CONN_STAGE_DONE;
+uint8_t  connStep;
+uint32_t connStartTime;
+uint32_t connStageTime;
+uint32_t connTimerHigh = 0;
+uint32_t nwkId;
+uint32_t prodId;
+uint32_t candNwkId;
+uint32_t candProdId;
+
 
 
 
@@ -65,11 +119,224 @@ uint8_t pollButtons(void) {
 
 
 
+void connTimerInit(void) {
+    TA1CTL = TASSEL_1 + ID_3 + TACLR;
+    TA1EX0 = TAIDEX_7;
+    TA1CTL |= MC_2;
+} // connTimerInit
+
+
+
+
+// Returns the time in timer ticks. Must be called at least once every 128 seconds to catch the wrap
+uint32_t connTimerGet(void) {
+    uint16_t count;
+
+    // TA1 runs from ACLK, so read until two reads agree
+    do {
+        count = TA1R;
+    } while (count != TA1R);
+
+    if (TA1CTL & TAIFG) {
+        TA1CTL &= ~TAIFG;
+        connTimerHigh += 0x10000;
+        do {
+            count = TA1R;
+        } while (count != TA1R);
+    }
+    return connTimerHigh + count;
+} // connTimerGet
+
+
+
+
+void connPrintTime(uint32_t ms, char tag) {
+    char pText[18];
+    uint8_t n;
+
+    // "<tag> sssss.ss s", padded to the full line width
+    memset(pText, ' ', 17);
+    pText[17] = 0;
+    pText[0] = tag;
+    ms /= 10;
+    pText[9] = '0' + (ms % 10); ms /= 10;
+    pText[8] = '0' + (ms % 10); ms /= 10;
+    pText[7] = '.';
+    n = 6;
+    do {
+        pText[n--] = '0' + (ms % 10);
+        ms /= 10;
+    } while (ms && (n > 1));
+    pText[11] = 's';
+    halLcdPrintLine(pText, 1, OVERWRITE_TEXT );
+} // connPrintTime
+
+
+
+
+// Starts a connection attempt at the given stage. Time is counted from here
+void connStart(uint8_t stage) {
+    memset(&connTiming, 0x00, sizeof(connTiming));
+    connTiming.connectStage = CONN_STAGE_DONE;
+    connStartTime = connTimerGet();
+    connStageTime = connStartTime;
+    connStage = stage;
+    connStep = CONN_STEP_START;
+} // connStart
+
+
+
+
+void connNextStage(void) {
+    uint32_t now = connTimerGet();
+    connTiming.pStageMs[connStage] += CONN_TIMER_TO_MS(now - connStageTime);
+    connStageTime = now;
+
+    // After a full pairing scan the cached network may have come back, so start over
+    if (++connStage == CONN_STAGE_COUNT) {
+        connStage = CONN_STAGE_JOIN;
+        connTiming.rounds++;
+    }
+    connStep = CONN_STEP_START;
+} // connNextStage
+
+
+
+
+void connJoin(uint32_t deviceId, uint32_t mfctId, uint32_t prodIdMask, uint32_t prodIdRef) {
+
+    // Enable disconnection notification to avoid unnecessary EHIF activity while active
+    initParam();
+    ehifCmdParam.ehcEvtClr.clearedEvents = BV_EHIF_EVT_NWK_CHG;
+    ehifCmdExec(EHIF_CMD_EHC_EVT_CLR, sizeof(EHIF_CMD_EHC_EVT_CLR_PARAM_T), &ehifCmdParam);
+    initParam();
+    ehifCmdParam.ehcEvtMask.irqGioLevel = 0;
+    ehifCmdParam.ehcEvtMask.eventFilter = BV_EHIF_EVT_NWK_CHG;
+    ehifCmdExec(EHIF_CMD_EHC_EVT_MASK, sizeof(EHIF_CMD_EHC_EVT_MASK_PARAM_T), &ehifCmdParam);
+
+    // Start JOIN operation
+    initParam();
+    ehifCmdParam.nwmDoJoin.joinTo     = CONN_JOIN_TO;
+    ehifCmdParam.nwmDoJoin.deviceId   = deviceId;
+    ehifCmdParam.nwmDoJoin.mfctId     = mfctId;
+    ehifCmdParam.nwmDoJoin.prodIdMask = prodIdMask;
+    ehifCmdParam.nwmDoJoin.prodIdRef  = prodIdRef;
+    ehifCmdExec(EHIF_CMD_NWM_DO_JOIN, sizeof(EHIF_CMD_NWM_DO_JOIN_PARAM_T), &ehifCmdParam);
+    connStep = CONN_STEP_JOINING;
+} // connJoin
+
+
+
+
+// Runs the connection manager one step. Only call when EHIF is ready, so that no call waits for an
+// operation to complete. Returns 1 once connected
+uint8_t connPoll(uint16_t status) {
+    uint16_t readbcLength;
+
+    if (status & BV_EHIF_STAT_CONNECTED) {
+        if (connStage != CONN_STAGE_DONE) {
+            uint32_t now = connTimerGet();
+            connTiming.pStageMs[connStage] += CONN_TIMER_TO_MS(now - connStageTime);
+            connTiming.connectMs = CONN_TIMER_TO_MS(now - connStartTime);
+            connTiming.connectStage = connStage;
+
+            // Remember a network found by scanning, so that the next power-on can join it directly
+            if (connStage != CONN_STAGE_JOIN) {
+                nwkId = candNwkId;
+                initParam();
+                ehifCmdParam.nvsSetData.index = NVS_INDEX_NWK_ID;
+                ehifCmdParam.nvsSetData.data  = nwkId;
+                ehifCmdExec(EHIF_CMD_NVS_SET_DATA, sizeof(EHIF_CMD_NVS_SET_DATA_PARAM_T), &ehifCmdParam);
+                if (candProdId != prodId) {
+                    prodId = candProdId;
+                    initParam();
+                    ehifCmdParam.nvsSetData.index = NVS_INDEX_PROD_ID;
+                    ehifCmdParam.nvsSetData.data  = prodId;
+                    ehifCmdExec(EHIF_CMD_NVS_SET_DATA, sizeof(EHIF_CMD_NVS_SET_DATA_PARAM_T), &ehifCmdParam);
+                }
+            }
+            connStage = CONN_STAGE_DONE;
+        }
+        return 1;
+    }
+
+    // Restart after link loss
+    if (connStage == CONN_STAGE_DONE) {
+        connStart(CONN_STAGE_JOIN);
+    }
+
+    switch (connStep) {
+    case CONN_STEP_START:
+        if (connStage == CONN_STAGE_JOIN) {
+            // Nothing cached yet, go straight to scanning
+            if (nwkId == NWK_ID_NONE) {
+                connNextStage();
+                break;
+            }
+
+            // Only the cached master will do, so the product filter costs nothing and catches a
+            // network ID that has been reused
+            if (prodId == 0xFFFFFFFF) {
+                connJoin(nwkId, CONN_MFCT_ID, 0, 0);
+            } else {
+                connJoin(nwkId, CONN_MFCT_ID, CONN_PROD_ID_MASK, prodId);
+            }
+
+        } else {
+            initParam();
+            ehifCmdParam.nwmDoScan.scanMax = 1;
+            if (connStage == CONN_STAGE_SCAN) {
+                // Any master of the cached product with a good signal
+                ehifCmdParam.nwmDoScan.scanTo     = CONN_SCAN_TO;
+                ehifCmdParam.nwmDoScan.mfctId     = CONN_MFCT_ID;
+                ehifCmdParam.nwmDoScan.prodIdMask = (prodId == 0xFFFFFFFF) ? 0 : CONN_PROD_ID_MASK;
+                ehifCmdParam.nwmDoScan.prodIdRef  = (prodId == 0xFFFFFFFF) ? 0 : prodId;
+                ehifCmdParam.nwmDoScan.reqRssi    = CONN_SCAN_RSSI;
+            } else {
+                // Any master with pairing signal enabled
+                ehifCmdParam.nwmDoScan.scanTo           = CONN_PAIR_TO;
+                ehifCmdParam.nwmDoScan.reqPairingSignal = 1;
+                ehifCmdParam.nwmDoScan.reqRssi          = -128;
+            }
+            ehifCmdExecWithReadbc(EHIF_EXEC_CMD, EHIF_CMD_NWM_DO_SCAN, 
+                                  sizeof(EHIF_CMD_NWM_DO_SCAN_PARAM_T), &ehifCmdParam, 
+                                  NULL, NULL);
+            connStep = CONN_STEP_SCANNING;
+        }
+        break;
+
+    case CONN_STEP_SCANNING:
+        // Fetch the network information
+        readbcLength = sizeof(ehifNwmDoScanData);
+        ehifCmdExecWithReadbc(EHIF_EXEC_DATA, EHIF_CMD_NWM_DO_SCAN, 
+                              0, NULL, 
+                              &readbcLength, &ehifNwmDoScanData);
+
+        // If found, join it
+        if (readbcLength == sizeof(EHIF_CMD_NWM_DO_SCAN_DATA_T)) {
+            candNwkId = ehifNwmDoScanData.deviceId;
+            candProdId = ehifNwmDoScanData.prodId;
+            connJoin(candNwkId, 0, 0, 0);
+        } else {
+            connNextStage();
+        }
+        break;
+
+    case CONN_STEP_JOINING:
+        // EHIF is ready without a connection, so the join has timed out
+        connNextStage();
+        break;
+    }
+
+    return 0;
+} // connPoll
+
+
+
+
 int main(void) {
     uint8_t  currState;
     uint8_t  targetState;
-    uint16_t readbcLength;
-    uint32_t nwkId;
     uint8_t  errorCheckInterval = 100;
 
     // Stop watchdog timer to prevent time out reset
@@ -93,27 +360,35 @@ int main(void) {
     uifLcdPrintJoystickInfo();
 
     // Wipe remote control information
-    memset(&ehifRcSetDataParam, 0x00, sizeof(ehifRcSetDataParam));
+    rcEncInit(RC_ENC_MIN_INTERVAL);
 
-    // Initialize EHIF IO
+    // Initialize EHIF IO and the connection timer
     ehifIoInit();
+    connTimerInit();
 
     // Reset into the application
+    connStart(CONN_STAGE_JOIN);
     ehifSysResetPin(true);
     currState = CC85XX_STATE_ALONE;
     targetState = CC85XX_STATE_ACTIVE;
 
-    // Get the last used network ID from CC85XX non-volatile storage
+    // Get the last used network ID and its product ID from CC85XX non-volatile storage
     initParam();
-    ehifCmdParam.nvsGetData.index = 0;
+    ehifCmdParam.nvsGetData.index = NVS_INDEX_NWK_ID;
     ehifCmdExecWithRead(EHIF_EXEC_ALL, EHIF_CMD_NVS_GET_DATA, 
                         sizeof(EHIF_CMD_NVS_GET_DATA_PARAM_T), &ehifCmdParam, 
                         sizeof(EHIF_CMD_NVS_GET_DATA_DATA_T), &ehifCmdData);
     nwkId = ehifCmdData.nvsGetData.data;
+    initParam();
+    ehifCmdParam.nvsGetData.index = NVS_INDEX_PROD_ID;
+    ehifCmdExecWithRead(EHIF_EXEC_ALL, EHIF_CMD_NVS_GET_DATA, 
+                        sizeof(EHIF_CMD_NVS_GET_DATA_PARAM_T), &ehifCmdParam, 
+                        sizeof(EHIF_CMD_NVS_GET_DATA_DATA_T), &ehifCmdData);
+    prodId = ehifCmdData.nvsGetData.data;
 
     // Handle illegal default network IDs that may occur first time after programming
     if ((nwkId == 0x00000000) || (nwkId == 0xFFFFFFFF)) {
-        nwkId = 0xFFFFFFFE;
+        nwkId = NWK_ID_NONE;
     }
 
     // Main loop
@@ -122,6 +397,9 @@ int main(void) {
         // Wait 10 ms
         EHIF_DELAY_MS(10);
 
+        // Keep the connection timer going across its wrap
+        connTimerGet();
+
         // Perform action according to edge-triggered button events (debouncing with 100 ms delay)
         switch (pollButtons()) {
 
@@ -149,6 +427,7 @@ int main(void) {
                 // HANDLE POWER ON
 
                 // Ensure known state (power state 5)
+                connStart(CONN_STAGE_JOIN);
                 ehifSysResetPin(true);
                 currState = CC85XX_STATE_ALONE;
 
@@ -167,50 +446,25 @@ int main(void) {
             } else if (targetState == CC85XX_STATE_PAIRING) {
                 // HANDLE PAIRING
 
-                // Let the last executed EHIF command complete, with 5 second timeout
-                ehifWaitReadyMs(5000);
-
-                // Disconnect if currently connected
-                if (ehifGetStatus() & BV_EHIF_STAT_CONNECTED) {
-                    initParam();
-                    // All parameters should be zero
-                    ehifCmdExec(EHIF_CMD_NWM_DO_JOIN, sizeof(EHIF_CMD_NWM_DO_JOIN_PARAM_T), &ehifCmdParam);
-                }
-
-                // Search for one protocol master with pairing signal enabled for 10 seconds
-                initParam();
-                ehifCmdParam.nwmDoScan.scanTo           = 1000;
-                ehifCmdParam.nwmDoScan.scanMax          = 1;
-                ehifCmdParam.nwmDoScan.reqPairingSignal = 1;
-                ehifCmdParam.nwmDoScan.reqRssi          = -128;
-                ehifCmdExecWithReadbc(EHIF_EXEC_CMD, EHIF_CMD_NWM_DO_SCAN, 
-                                      sizeof(EHIF_CMD_NWM_DO_SCAN_PARAM_T), &ehifCmdParam, 
-                                      NULL, NULL);
-
-                // Fetch network information once ready
-                ehifWaitReadyMs(12000);
-                readbcLength = sizeof(ehifNwmDoScanData);
-                ehifCmdExecWithReadbc(EHIF_EXEC_DATA, EHIF_CMD_NWM_DO_SCAN, 
-                                      0, NULL, 
-                                      &readbcLength, &ehifNwmDoScanData);
-
-                // If found ...
-                if (readbcLength == sizeof(EHIF_CMD_NWM_DO_SCAN_DATA_T)) {
+                // Proceed only once the last EHIF operation has completed, so that the buttons can
+                // still be operated
+                uint16_t status = ehifGetStatus();
+                if (status & BV_EHIF_STAT_CMD_REQ_RDY) {
 
-                    // Update the network ID to be used next
-                    nwkId = ehifNwmDoScanData.deviceId;
+                    // Disconnect if currently connected
+                    if (status & BV_EHIF_STAT_CONNECTED) {
+                        initParam();
+                        // All parameters should be zero
+                        ehifCmdExec(EHIF_CMD_NWM_DO_JOIN, sizeof(EHIF_CMD_NWM_DO_JOIN_PARAM_T), &ehifCmdParam);
+                    }
 
-                    // Place the new network ID in CC85XX non-volatile storage
-                    initParam();
-                    ehifCmdParam.nvsSetData.index = 0;
-                    ehifCmdParam.nvsSetData.data  = ehifNwmDoScanData.deviceId;
-                    ehifCmdExec(EHIF_CMD_NVS_SET_DATA, sizeof(EHIF_CMD_NVS_SET_DATA_PARAM_T), &ehifCmdParam);
+                    // Let the connection manager search for a protocol master with pairing signal
+                    // enabled. It stores the new network ID once joined
+                    connStart(CONN_STAGE_PAIR);
+                    currState = CC85XX_STATE_ALONE;
+                    targetState = CC85XX_STATE_ACTIVE;
                 }
 
-                // Done
-                currState = CC85XX_STATE_ALONE;
-                targetState = CC85XX_STATE_ACTIVE;
-
             } else if (targetState == CC85XX_STATE_ACTIVE) {
 
                 // We're disconnected. Proceed only if EHIF is ready, so that power toggle and pairing
@@ -218,32 +472,24 @@ int main(void) {
                 uint16_t status = ehifGetStatus();
                 if (status & BV_EHIF_STAT_CMD_REQ_RDY) {
 
-                    // Perform join operation first and then activate audio channels. We're using remote
-                    // volume control
-                    if (!(status & BV_EHIF_STAT_CONNECTED)) {
-
-                        // Enable disconnection notification to avoid unnecessary EHIF activity while active
-                        initParam();
-                        ehifCmdParam.ehcEvtClr.clearedEvents = BV_EHIF_EVT_NWK_CHG;
-                        ehifCmdExec(EHIF_CMD_EHC_EVT_CLR, sizeof(EHIF_CMD_EHC_EVT_CLR_PARAM_T), &ehifCmdParam);
-                        initParam();
-                        ehifCmdParam.ehcEvtMask.irqGioLevel = 0;
-                        ehifCmdParam.ehcEvtMask.eventFilter = BV_EHIF_EVT_NWK_CHG;
-                        ehifCmdExec(EHIF_CMD_EHC_EVT_MASK, sizeof(EHIF_CMD_EHC_EVT_MASK_PARAM_T), &ehifCmdParam);
-
-                        // Not connected: Start JOIN operation
-                        initParam();
-                        ehifCmdParam.nwmDoJoin.joinTo = 100;
-                        ehifCmdParam.nwmDoJoin.deviceId = nwkId;
-                        ehifCmdExec(EHIF_CMD_NWM_DO_JOIN, sizeof(EHIF_CMD_NWM_DO_JOIN_PARAM_T), &ehifCmdParam);
-
-                    } else {
+                    // Let the connection manager join a network first and then activate audio channels.
+                    // We're using remote volume control
+                    if (connPoll(status)) {
                         // Connected: Subscribe to audio channels (0xFF = unused)
                         memset(&ehifCmdParam, 0xFF, sizeof(EHIF_CMD_NWM_ACH_SET_USAGE_PARAM_T));
                         ehifCmdParam.nwmAchSetUsage.pAchUsage[0] = 0; // Front left  -> I2S LEFT
                         ehifCmdParam.nwmAchSetUsage.pAchUsage[1] = 1; // Front right -> I2S RIGHT
                         ehifCmdExec(EHIF_CMD_NWM_ACH_SET_USAGE, sizeof(EHIF_CMD_NWM_ACH_SET_USAGE_PARAM_T), &ehifCmdParam);
                         currState = CC85XX_STATE_ACTIVE;
+
+                        // The master has no remote control state from us yet
+                        rcEncResync();
+
+                        // Power-on (or link loss) to audio time
+                        if ((connTiming.audioMs == 0) && (connTiming.connectStage < CONN_STAGE_COUNT)) {
+                            connTiming.audioMs = CONN_TIMER_TO_MS(connTimerGet() - connStartTime);
+                            connPrintTime(connTiming.audioMs, "JSP"[connTiming.connectStage]);
+                        }
                     }
                 }
             }
@@ -278,9 +524,11 @@ int main(void) {
                 if (currState == CC85XX_STATE_ACTIVE) {
 
                     // Send remote control commands (mouse or play control, depending on which uif file
-                    // is included in the build)
-                    if (uifPollFunc(&ehifRcSetDataParam)) {
-                        ehifCmdExec(EHIF_CMD_RC_SET_DATA, sizeof(EHIF_CMD_RC_SET_DATA_PARAM_T), &ehifRcSetDataParam);
+                    // is included in the build). The encoder only returns a report when it has changed,
+                    // and at most one per RC_ENC_MIN_INTERVAL passes
+                    uifPoll();
+                    if (rcEncPoll(&ehifCmdParam.rcSetData)) {
+                        ehifCmdExec(EHIF_CMD_RC_SET_DATA, sizeof(EHIF_CMD_RC_SET_DATA_PARAM_T), &ehifCmdParam);
                     }
                 }
             }
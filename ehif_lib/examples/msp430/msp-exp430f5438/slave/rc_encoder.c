@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <string.h>
+#include <cc85xx_ehif_defs.h>
+#include "rc_encoder.h"
+
+
+// What the user interface holds now, and what was pressed since the last report
+uint8_t rcEncModifiers;
+uint8_t rcEncTapModifiers;
+uint8_t pRcEncKeys[RC_ENC_MAX_CODES];
+uint8_t rcEncKeyCount;
+uint8_t pRcEncCmds[RC_ENC_MAX_CODES];
+uint8_t rcEncCmdCount;
+uint8_t pRcEncTapKeys[RC_ENC_MAX_CODES];
+uint8_t rcEncTapKeyCount;
+uint8_t pRcEncTapCmds[RC_ENC_MAX_CODES];
+uint8_t rcEncTapCmdCount;
+uint8_t rcEncButtons;
+uint8_t rcEncTapButtons;
+
+// Mouse movement not yet reported, and whether the mouse extension is in use
+int16_t rcEncMoveX;
+int16_t rcEncMoveY;
+uint8_t rcEncMouse;
+
+// Last report sent, and passes since then
+EHIF_CMD_RC_SET_DATA_PARAM_T rcEncLast;
+uint8_t rcEncMinInterval;
+uint8_t rcEncSinceLast;
+uint8_t rcEncSync;
+
+
+
+
+// Returns whether code is in the list
+uint8_t rcEncFind(const uint8_t* pList, uint8_t count, uint8_t code) {
+    while (count--) {
+        if (*pList++ == code) return 1;
+    }
+    return 0;
+} // rcEncFind
+
+
+
+
+// Adds the codes of pOld that are neither in pNew nor in the last report (pSent) to the tap list, so a
+// code released before it was reported still goes out once as pressed
+void rcEncTap(const uint8_t* pOld, uint8_t oldCount, const uint8_t* pNew, uint8_t newCount,
+              const uint8_t* pSent, uint8_t sentCount, uint8_t* pTap, uint8_t* pTapCount) {
+    while (oldCount--) {
+        if (!rcEncFind(pNew, newCount, *pOld) && !rcEncFind(pSent, sentCount, *pOld) &&
+            !rcEncFind(pTap, *pTapCount, *pOld) && (*pTapCount < RC_ENC_MAX_CODES)) {
+            pTap[(*pTapCount)++] = *pOld;
+        }
+        pOld++;
+    }
+} // rcEncTap
+
+
+
+
+// Appends the codes of pList that are not yet in pCodes[first..count-1]. Returns the new count
+uint8_t rcEncAdd(uint8_t* pCodes, uint8_t first, uint8_t count, const uint8_t* pList, uint8_t listCount) {
+    while (listCount--) {
+        if ((count < RC_ENC_MAX_CODES) && !rcEncFind(pCodes + first, count - first, *pList)) {
+            pCodes[count++] = *pList;
+        }
+        pList++;
+    }
+    return count;
+} // rcEncAdd
+
+
+
+
+// Saturating add, a burst of movement is clipped rather than wrapped
+int16_t rcEncSum(int16_t a, int16_t b) {
+    int32_t sum = (int32_t) a + b;
+    if (sum > INT16_MAX) return INT16_MAX;
+    if (sum < INT16_MIN) return INT16_MIN;
+    return (int16_t) sum;
+} // rcEncSum
+
+
+
+
+void rcEncInit(uint8_t minInterval) {
+    rcEncModifiers = 0x00;
+    rcEncTapModifiers = 0x00;
+    rcEncKeyCount = 0;
+    rcEncCmdCount = 0;
+    rcEncTapKeyCount = 0;
+    rcEncTapCmdCount = 0;
+    rcEncButtons = 0x00;
+    rcEncTapButtons = 0x00;
+    rcEncMoveX = 0;
+    rcEncMoveY = 0;
+    rcEncMouse = 0;
+    memset(&rcEncLast, 0x00, sizeof(rcEncLast));
+    rcEncMinInterval = minInterval;
+    rcEncSinceLast = minInterval;
+    rcEncSync = 1;
+} // rcEncInit
+
+
+
+
+// The receiving side may have lost track (new connection): send the next report even if unchanged
+void rcEncResync(void) {
+    rcEncSync = 1;
+} // rcEncResync
+
+
+
+
+// Sets the keyboard modifiers and key codes held now
+void rcEncSetKeys(uint8_t modifiers, const uint8_t* pKeys, uint8_t keyCount) {
+    uint8_t sentKeys = rcEncLast.rcKeyCount ? rcEncLast.rcKeyCount - 1 : 0;
+    if (keyCount > RC_ENC_MAX_CODES - 1) keyCount = RC_ENC_MAX_CODES - 1;
+    rcEncTap(pRcEncKeys, rcEncKeyCount, pKeys, keyCount, &rcEncLast.pRcCmds[1], sentKeys,
+             pRcEncTapKeys, &rcEncTapKeyCount);
+    rcEncTapModifiers |= rcEncModifiers & ~modifiers & ~(rcEncLast.rcKeyCount ? rcEncLast.pRcCmds[0] : 0x00);
+    rcEncModifiers = modifiers;
+    memcpy(pRcEncKeys, pKeys, keyCount);
+    rcEncKeyCount = keyCount;
+} // rcEncSetKeys
+
+
+
+
+// Sets the proprietary command codes held now (EHIF_RC_CMD_...)
+void rcEncSetCmds(const uint8_t* pCmds, uint8_t cmdCount) {
+    if (cmdCount > RC_ENC_MAX_CODES) cmdCount = RC_ENC_MAX_CODES;
+    rcEncTap(pRcEncCmds, rcEncCmdCount, pCmds, cmdCount, &rcEncLast.pRcCmds[rcEncLast.rcKeyCount],
+             rcEncLast.rcCmdCount, pRcEncTapCmds, &rcEncTapCmdCount);
+    memcpy(pRcEncCmds, pCmds, cmdCount);
+    rcEncCmdCount = cmdCount;
+} // rcEncSetCmds
+
+
+
+
+// Adds relative mouse movement
+void rcEncMouseMove(int16_t dx, int16_t dy) {
+    rcEncMoveX = rcEncSum(rcEncMoveX, dx);
+    rcEncMoveY = rcEncSum(rcEncMoveY, dy);
+    rcEncMouse = 1;
+} // rcEncMouseMove
+
+
+
+
+// Sets the mouse buttons held now
+void rcEncMouseButtons(uint8_t bvButtons) {
+    rcEncTapButtons |= rcEncButtons & ~bvButtons & ~rcEncLast.bvMouseButtons;
+    rcEncButtons = bvButtons;
+    rcEncMouse = 1;
+} // rcEncMouseButtons
+
+
+
+
+// Call once per main loop pass. Returns 1 with the report in pParam when one should be sent with
+// RC_SET_DATA, 0 when nothing has changed or the last report was too recent
+uint8_t rcEncPoll(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam) {
+    uint8_t keyCount;
+    uint8_t cmdCount;
+
+    if (rcEncSinceLast < rcEncMinInterval) {
+        rcEncSinceLast++;
+        return 0;
+    }
+
+    // Held codes, then the ones tapped since the last report. The modifiers and keys come first in
+    // pRcCmds[], then the proprietary commands
+    memset(pParam, 0x00, sizeof(EHIF_CMD_RC_SET_DATA_PARAM_T));
+    keyCount = 0;
+    if (rcEncModifiers || rcEncTapModifiers || rcEncKeyCount || rcEncTapKeyCount) {
+        pParam->pRcCmds[0] = rcEncModifiers | rcEncTapModifiers;
+        keyCount = rcEncAdd(pParam->pRcCmds, 1, 1, pRcEncKeys, rcEncKeyCount);
+        keyCount = rcEncAdd(pParam->pRcCmds, 1, keyCount, pRcEncTapKeys, rcEncTapKeyCount);
+    }
+    cmdCount = rcEncAdd(pParam->pRcCmds, keyCount, keyCount, pRcEncCmds, rcEncCmdCount);
+    cmdCount = rcEncAdd(pParam->pRcCmds, keyCount, cmdCount, pRcEncTapCmds, rcEncTapCmdCount);
+    pParam->rcKeyCount = keyCount;
+    pParam->rcCmdCount = cmdCount - keyCount;
+
+    if (rcEncMouse) {
+        pParam->extSel = 1;
+        pParam->bvMouseButtons = rcEncButtons | rcEncTapButtons;
+        pParam->mousePosX = rcEncLast.mousePosX + rcEncMoveX;
+        pParam->mousePosY = rcEncLast.mousePosY + rcEncMoveY;
+    }
+
+    if (!rcEncSync && !memcmp(pParam, &rcEncLast, sizeof(EHIF_CMD_RC_SET_DATA_PARAM_T))) {
+        return 0;
+    }
+
+    memcpy(&rcEncLast, pParam, sizeof(EHIF_CMD_RC_SET_DATA_PARAM_T));
+    rcEncTapModifiers = 0x00;
+    rcEncTapKeyCount = 0;
+    rcEncTapCmdCount = 0;
+    rcEncTapButtons = 0x00;
+    rcEncMoveX = 0;
+    rcEncMoveY = 0;
+    rcEncSinceLast = 1;
+    rcEncSync = 0;
+    return 1;
+} // rcEncPoll
@@ -0,0 +1,32 @@
+#ifndef RC_ENCODER_H
+#define RC_ENCODER_H
+
+#include <stdint.h>
+#include <cc85xx_ehif_defs.h>
+
+
+// Remote control encoder. The user interface reports what is held and how far the mouse moved, and the
+// encoder turns that into RC_SET_DATA reports:
+// - Nothing is sent while the report would not change
+// - Mouse movement is accumulated and added to the position once per report
+// - Keys, commands and mouse buttons that are pressed and released between two reports are still sent
+//   once as pressed, so short taps are not lost
+// - Reports are at least minInterval main loop passes (10 ms) apart, changes in between are merged into
+//   the next one
+#define RC_ENC_MIN_INTERVAL         2   // 20 ms, at most 50 reports per second
+
+// Codes that fit in one report: the keyboard modifiers and key codes and the proprietary command codes
+// together
+#define RC_ENC_MAX_CODES            7
+
+
+void rcEncInit(uint8_t minInterval);
+void rcEncResync(void);
+void rcEncSetKeys(uint8_t modifiers, const uint8_t* pKeys, uint8_t keyCount);
+void rcEncSetCmds(const uint8_t* pCmds, uint8_t cmdCount);
+void rcEncMouseMove(int16_t dx, int16_t dy);
+void rcEncMouseButtons(uint8_t bvButtons);
+uint8_t rcEncPoll(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam);
+
+
+#endif
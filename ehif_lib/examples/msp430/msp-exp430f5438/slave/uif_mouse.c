@@ -6,6 +6,7 @@
 #include "hal_lcd.h"
 #include "hal_int.h"
 #include "hal_buttons.h"
+#include "rc_encoder.h"
 
 
 uint32_t xMouseMoveDuration = 0;
@@ -25,38 +26,29 @@ void uifLcdPrintJoystickInfo(void) {
 
 
 
-uint8_t uifPollFunc(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam) {
+void uifPoll(void) {
 
-    // Update mouse position and button state and send if changed
-    uint8_t doRcSetData = 0;
+    // Hand mouse movement and button state to the encoder, which sends them when they change
+    int16_t dx = 0;
+    int16_t dy = 0;
     uint8_t buttonState = halButtonsPressed();
     if (buttonState & BUTTON_LEFT) { 
-        pParam->mousePosX -= 1 + ((++xMouseMoveDuration) >> 5);
-        doRcSetData = 1; 
+        dx = -(1 + ((++xMouseMoveDuration) >> 5));
     } else if (buttonState & BUTTON_RIGHT) {
-        pParam->mousePosX += 1 + ((++xMouseMoveDuration) >> 5);
-        doRcSetData = 1; 
+        dx = 1 + ((++xMouseMoveDuration) >> 5);
     } else {
         xMouseMoveDuration = 0;
     }
     if (buttonState & BUTTON_UP) { 
-        pParam->mousePosY -= 1 + ((++yMouseMoveDuration) >> 5);
-        doRcSetData = 1; 
+        dy = -(1 + ((++yMouseMoveDuration) >> 5));
     } else if (buttonState & BUTTON_DOWN) { 
-        pParam->mousePosY += 1 + ((++yMouseMoveDuration) >> 5);
-        doRcSetData = 1; 
+        dy = 1 + ((++yMouseMoveDuration) >> 5);
     } else {
         yMouseMoveDuration = 0;
     }
-    uint8_t bvMouseButtons = ((buttonState & BUTTON_SELECT) != 0) << 0;
-    if (bvMouseButtons != pParam->bvMouseButtons) {
-        pParam->bvMouseButtons = bvMouseButtons;
-        doRcSetData = 1;
+    if (dx || dy) {
+        rcEncMouseMove(dx, dy);
     }
+    rcEncMouseButtons(((buttonState & BUTTON_SELECT) != 0) << 0);
     
-    // Set fixed parameters
-    pParam->extSel = 1;
-    
-    return doRcSetData;
-    
-} // uifPollFunc
\ No newline at end of file
+} // uifPoll
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "hal_lcd.h"
 #include "hal_int.h"
 #include "hal_buttons.h"
+#include "rc_encoder.h"
 
 
 
@@ -21,34 +22,27 @@ void uifLcdPrintJoystickInfo(void) {
 
 
 
-uint8_t uifPollFunc(EHIF_CMD_RC_SET_DATA_PARAM_T* pParam) {
-    static uint8_t prevButtonState = 0x00;
+void uifPoll(void) {
+    uint8_t pRcCmds[5];
 
-    // Update remote control commands if the button state has changed
+    // Hand the commands held to the encoder, which sends them when they change
     uint8_t buttonState = halButtonsPressed();
-    if (buttonState != prevButtonState) {
-        prevButtonState = buttonState;
-        
-        uint8_t rcCmdCount = 0;
-        if (buttonState & BUTTON_LEFT) {
-            pParam->pRcCmds[rcCmdCount++] = EHIF_RC_CMD_SCAN_PREV_TRACK;
-        }
-        if (buttonState & BUTTON_RIGHT) {
-            pParam->pRcCmds[rcCmdCount++] = EHIF_RC_CMD_SCAN_NEXT_TRACK;
-        }
-        if (buttonState & BUTTON_UP) {
-            pParam->pRcCmds[rcCmdCount++] = EHIF_RC_CMD_OUT_VOL_INCR;
-        }
-        if (buttonState & BUTTON_DOWN) {
-            pParam->pRcCmds[rcCmdCount++] = EHIF_RC_CMD_OUT_VOL_DECR;
-        }
-        if (buttonState & BUTTON_SELECT) {
-            pParam->pRcCmds[rcCmdCount++] = EHIF_RC_CMD_PLAY_PAUSE_TOGGLE;
-        }
-        pParam->rcCmdCount = rcCmdCount;
-        return 1;
-    } else { 
-        return 0;
+    uint8_t rcCmdCount = 0;
+    if (buttonState & BUTTON_LEFT) {
+        pRcCmds[rcCmdCount++] = EHIF_RC_CMD_SCAN_PREV_TRACK;
     }
+    if (buttonState & BUTTON_RIGHT) {
+        pRcCmds[rcCmdCount++] = EHIF_RC_CMD_SCAN_NEXT_TRACK;
+    }
+    if (buttonState & BUTTON_UP) {
+        pRcCmds[rcCmdCount++] = EHIF_RC_CMD_OUT_VOL_INCR;
+    }
+    if (buttonState & BUTTON_DOWN) {
+        pRcCmds[rcCmdCount++] = EHIF_RC_CMD_OUT_VOL_DECR;
+    }
+    if (buttonState & BUTTON_SELECT) {
+        pRcCmds[rcCmdCount++] = EHIF_RC_CMD_PLAY_PAUSE_TOGGLE;
+    }
+    rcEncSetCmds(pRcCmds, rcCmdCount);
     
-} // uifPollFunc
\ No newline at end of file
+} // uifPoll
\ No newline at end of file